@@ -0,0 +1,537 @@
+/* benchmark program for the date-time functions
+
+   For gcc under linux compile with :
+
+  gcc -Wall -O3 -DSEC_TO_TM_PREV -o bench bench.c strftime.c strptime.c time_batch.c
+  ./bench
+
+   SEC_TO_TM_PREV must be defined so strftime.c includes the previous versions of sec_to_tm() that are compared with it.
+   Each benchmark calls the functions being compared with the same inputs and prints the average time per call in ns.
+   Timing uses clock() so it works on Windows & Linux, run times are chosen to be a few tenths of a second per test so the results are reasonably repeatable.
+   The results from the functions are summed into a volatile variable so the compiler cannot optimise the calls away.
+*/
+
+/*----------------------------------------------------------------------------
+ * Copyright (c) 2022 Peter Miller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHOR OR COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include "time_local.h"
+
+#ifndef SEC_TO_TM_PREV
+#error "compile with -DSEC_TO_TM_PREV so strftime.c includes sec_to_tm_approx() and sec_to_tm_bsearch()"
+#endif
+/* previous versions of sec_to_tm() - defined in strftime.c (when SEC_TO_TM_PREV is defined) but not in time_local.h */
+void sec_to_tm_approx(time_t t,struct tm *tp);
+void sec_to_tm_bsearch(time_t t,struct tm *tp);
+time_t ya_mktime_tm(const struct tm *tp); /* in strftime.c */
+int tz_zone_offset_bsearch(const struct tz_zone *z, time_t t, int *isdst, const char **abbrev); /* tz_zone_offset() using a binary search - in strftime.c */
+
+#define NOS_TIMES 4096 /* number of different inputs used for each test (small enough to stay in the cache) */
+
+static volatile int64_t sink; /* results are added here so calls cannot be optimised away */
+static time_t times[NOS_TIMES];
+
+static double secs(void) /* processor time used in secs */
+{return (double)clock()/CLOCKS_PER_SEC;
+}
+
+static uint64_t rand64(void) /* simple (xorshift) pseudo random number generator so results are the same on all platforms */
+{static uint64_t x=UINT64_C(88172645463325252);
+ x^=x<<13;
+ x^=x>>7;
+ x^=x<<17;
+ return x;
+}
+
+static void fill_times(time_t lo,time_t hi) /* fill times[] with random values lo..hi */
+{for(int i=0;i<NOS_TIMES;++i)
+	times[i]=lo+(time_t)(rand64()%(uint64_t)(hi-lo));
+}
+
+static double bench_sec_to_tm(void (*f)(time_t,struct tm *),unsigned int reps) /* returns ns per call of f() */
+{struct tm tm;
+ int64_t sum=0;
+ double start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{f(times[i],&tm);
+		 sum+=tm.tm_mday+tm.tm_wday;
+		}
+ sink+=sum;
+ return (secs()-start)*1e9/((double)reps*NOS_TIMES);
+}
+
+static void compare_sec_to_tm(const char *range,time_t lo,time_t hi)
+{double t_new,t_approx,t_bsearch;
+ fill_times(lo,hi);
+ t_new=bench_sec_to_tm(sec_to_tm,2000);
+ t_approx=bench_sec_to_tm(sec_to_tm_approx,200);
+ t_bsearch=bench_sec_to_tm(sec_to_tm_bsearch,100);
+ printf("  %-28s sec_to_tm() %6.1f ns, sec_to_tm_approx() %6.1f ns (x%.1f), sec_to_tm_bsearch() %6.1f ns (x%.1f)\n",
+ 	range,t_new,t_approx,t_approx/t_new,t_bsearch,t_bsearch/t_new);
+}
+
+static void bench_mktime(void) /* ya_mktime_tm() and day_of_week() for the dates in times[] */
+{static struct tm tms[NOS_TIMES];
+ int64_t sum=0;
+ double start,t_mktime,t_dow;
+ const unsigned int reps=2000;
+ for(int i=0;i<NOS_TIMES;++i)
+ 	{sec_to_tm(times[i],&tms[i]);
+ 	 tms[i].tm_yday=0; // so ya_mktime_tm() has to use day_of_year()
+ 	}
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		sum+=ya_mktime_tm(&tms[i]);
+ t_mktime=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		sum+=day_of_week((int64_t)tms[i].tm_year+1900,tms[i].tm_mon,tms[i].tm_mday);
+ t_dow=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ sink+=sum;
+ printf("  ya_mktime_tm() %6.1f ns, day_of_week() %6.1f ns\n",t_mktime,t_dow);
+}
+
+#define NOS_BATCH (1<<20) /* batch conversions use 1M values (too big for L1/L2 cache, as would normally be the case) */
+
+static void bench_sec_to_tm_batch(const char *range,time_t lo,time_t hi) /* conversions per second for each batch kernel */
+{static time_t bt[NOS_BATCH];
+ static int b_year[NOS_BATCH],b_mon[NOS_BATCH],b_mday[NOS_BATCH],b_hour[NOS_BATCH],b_min[NOS_BATCH],b_sec[NOS_BATCH],b_wday[NOS_BATCH],b_yday[NOS_BATCH];
+ const struct tm_soa soa={b_year,b_mon,b_mday,b_hour,b_min,b_sec,b_wday,b_yday};
+ const char *kernel_names[]={"scalar","AVX2","AVX-512"};
+ const unsigned int reps=20;
+ double start,t_k,t_scalar=0;
+ for(int i=0;i<NOS_BATCH;++i)
+	bt[i]=lo+(time_t)(rand64()%(uint64_t)(hi-lo));
+ printf("  %s\n",range);
+ for(int k=BATCH_SCALAR;k<=BATCH_AVX512;++k)
+ 	{if(batch_kernel_supported((enum batch_kernel)k)!=(enum batch_kernel)k)
+ 		{printf("    %-8s not supported by this processor\n",kernel_names[k]);
+ 		 continue;
+ 		}
+ 	 start=secs();
+ 	 for(unsigned int r=0;r<reps;++r)
+ 	 	{sec_to_tm_batch_k(bt,NOS_BATCH,&soa,(enum batch_kernel)k);
+ 	 	 sink+=b_mday[r];
+ 	 	}
+ 	 t_k=(secs()-start)/((double)reps*NOS_BATCH); // secs per conversion
+ 	 if(k==BATCH_SCALAR) t_scalar=t_k;
+ 	 printf("    %-8s %7.1f million conversions/sec (x%.1f)\n",kernel_names[k],1e-6/t_k,t_scalar/t_k);
+ 	}
+}
+
+static void bench_mktime_batch(const char *range,time_t lo,time_t hi) /* conversions per second for each batch kernel of ya_mktime_tm_batch() */
+{static time_t bt[NOS_BATCH];
+ static int b_year[NOS_BATCH],b_mon[NOS_BATCH],b_mday[NOS_BATCH],b_hour[NOS_BATCH],b_min[NOS_BATCH],b_sec[NOS_BATCH];
+ const struct tm_soa soa={b_year,b_mon,b_mday,b_hour,b_min,b_sec,NULL,NULL}; // no yday so day_of_year() is needed
+ const char *kernel_names[]={"scalar","AVX2","AVX-512"};
+ const unsigned int reps=20;
+ double start,t_k,t_scalar=0;
+ for(int i=0;i<NOS_BATCH;++i)
+	bt[i]=lo+(time_t)(rand64()%(uint64_t)(hi-lo));
+ sec_to_tm_batch(bt,NOS_BATCH,&soa);
+ printf("  %s\n",range);
+ for(int k=BATCH_SCALAR;k<=BATCH_AVX512;++k)
+ 	{if(batch_kernel_supported((enum batch_kernel)k)!=(enum batch_kernel)k)
+ 		{printf("    %-8s not supported by this processor\n",kernel_names[k]);
+ 		 continue;
+ 		}
+ 	 start=secs();
+ 	 for(unsigned int r=0;r<reps;++r)
+ 	 	{ya_mktime_tm_batch_k(&soa,NOS_BATCH,bt,(enum batch_kernel)k);
+ 	 	 sink+=bt[r];
+ 	 	}
+ 	 t_k=(secs()-start)/((double)reps*NOS_BATCH); // secs per conversion
+ 	 if(k==BATCH_SCALAR) t_scalar=t_k;
+ 	 printf("    %-8s %7.1f million conversions/sec (x%.1f)\n",kernel_names[k],1e-6/t_k,t_scalar/t_k);
+ 	}
+}
+
+static void bench_strptime(const char *format) /* ya_strptime_r() and ya_strptime_plan_r() for strings created from the times in times[] */
+{static char strs[NOS_TIMES][64];
+ struct tm tm;
+ struct strp_tz_struct tz;
+ int64_t sum=0;
+ double start,t_strp,t_plan;
+ const unsigned int reps=200;
+ struct strp_plan *plan=strp_compile(format);
+ init_strp_tz(&tz);
+ tz.tz_off_mins=-300;
+ tz.f_secs=0.123456; tz.f_secs_p10=6; tz.f_asecs=UINT64_C(123456000000000000);
+ for(int i=0;i<NOS_TIMES;++i)
+ 	{sec_to_tm(times[i],&tm);
+ 	 ya_strftime_r(strs[i],sizeof(strs[i]),format,&tm,&tz);
+ 	}
+ memset(&tm,0,sizeof(tm));
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{ya_strptime_r(strs[i],format,&tm,&tz);
+		 sum+=tm.tm_mday;
+		}
+ t_strp=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{ya_strptime_plan_r(strs[i],plan,&tm,&tz);
+		 sum+=tm.tm_mday;
+		}
+ t_plan=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ strp_free_plan(plan);
+ sink+=sum;
+ printf("  %-30s ya_strptime_r() %6.1f ns, ya_strptime_plan_r() %6.1f ns\n",format,t_strp,t_plan);
+}
+
+static void bench_strptime_multi(void) /* several formats tried in turn with ya_strptime_r() vs ya_strptime_multi_r(), the most common format is last in the list */
+{static char strs[NOS_TIMES][64];
+ static const char *formats[]={"%d/%m/%Y %H:%M","%b %e %H:%M:%S","%a, %d %b %Y %H:%M:%S %z","%Y-%m-%d %H:%M:%S"};
+ const int nf=(int)(sizeof(formats)/sizeof(formats[0]));
+ struct tm tm;
+ struct strp_tz_struct tz;
+ int64_t sum=0;
+ double start,t_seq,t_multi,t_adapt;
+ const unsigned int reps=100;
+ struct strp_multi *m=strp_multi_compile(formats,nf,false),*ma=strp_multi_compile(formats,nf,true);
+ init_strp_tz(&tz);
+ for(int i=0;i<NOS_TIMES;++i)
+ 	{sec_to_tm(times[i],&tm);
+ 	 ya_strftime_r(strs[i],sizeof(strs[i]),formats[i%10==0 ? (i/10)%(nf-1) : nf-1],&tm,&tz); // 90% use the last format
+ 	}
+ memset(&tm,0,sizeof(tm));
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{for(int j=0;j<nf;++j)
+			if(ya_strptime_r(strs[i],formats[j],&tm,&tz)!=NULL) {sum+=j; break;}
+		 sum+=tm.tm_mday;
+		}
+ t_seq=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{int which;
+		 ya_strptime_multi_r(strs[i],m,&tm,&tz,&which);
+		 sum+=which+tm.tm_mday;
+		}
+ t_multi=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{int which;
+		 ya_strptime_multi_r(strs[i],ma,&tm,&tz,&which);
+		 sum+=which+tm.tm_mday;
+		}
+ t_adapt=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ strp_multi_free(m);
+ strp_multi_free(ma);
+ sink+=sum;
+ printf("  %d formats: ya_strptime_r() in turn %6.1f ns, ya_strptime_multi_r() %6.1f ns, adaptive %6.1f ns\n",nf,t_seq,t_multi,t_adapt);
+}
+
+static void bench_strptime_cached(const char *format) /* ya_strptime_r()+ya_mktime_tm() vs ya_strptime_cached() for a log with a line every ms (each repeat continues the log) */
+{static char strs[NOS_TIMES][64];
+ struct tm tm;
+ struct strp_tz_struct tz;
+ struct strp_epoch e;
+ int64_t sum=0;
+ double t_strp=0,t_cached=0,start;
+ const unsigned int reps=100;
+ struct strp_cache *cache=strp_cache_create(format);
+ time_t t0=(time_t)(rand64()%UINT64_C(4102444800));
+ for(unsigned int r=0;r<reps;++r)
+ 	{for(int i=0;i<NOS_TIMES;++i)
+ 		{int64_t ms=(int64_t)r*NOS_TIMES+i; // 1 line per ms
+ 		 ya_strftime_epoch(strs[i],sizeof(strs[i]),format,t0+ms/1000,(int32_t)(ms%1000)*1000000,-300);
+ 		}
+ 	 start=secs();
+ 	 for(int i=0;i<NOS_TIMES;++i)
+ 	 	{memset(&tm,0,sizeof(tm));
+ 	 	 ya_strptime_r(strs[i],format,&tm,&tz);
+ 	 	 sum+=ya_mktime_tm(&tm);
+ 	 	}
+ 	 t_strp+=secs()-start;
+ 	 start=secs();
+ 	 for(int i=0;i<NOS_TIMES;++i)
+ 	 	{ya_strptime_cached(strs[i],cache,&e);
+ 	 	 sum+=e.secs;
+ 	 	}
+ 	 t_cached+=secs()-start;
+ 	}
+ strp_cache_free(cache);
+ sink+=sum;
+ printf("  %-30s ya_strptime_r()+ya_mktime_tm() %6.1f ns, ya_strptime_cached() %6.1f ns\n",format,t_strp*1e9/((double)reps*NOS_TIMES),t_cached*1e9/((double)reps*NOS_TIMES));
+}
+
+static void bench_strftime(const char *format) /* ya_strftime_r() and ya_strftime_plan_r() for the times in times[] */
+{static struct tm tms[NOS_TIMES];
+ char buf[128];
+ struct strp_tz_struct tz;
+ int64_t sum=0;
+ double start,t_strf,t_plan;
+ const unsigned int reps=200;
+ struct strf_plan *plan=strf_compile(format);
+ init_strp_tz(&tz);
+ tz.tz_off_mins=-300; // so %z does not use the OS
+ tz.f_secs=0.123456; tz.f_secs_p10=6; tz.f_asecs=UINT64_C(123456000000000000);
+ for(int i=0;i<NOS_TIMES;++i)
+ 	sec_to_tm(times[i],&tms[i]);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		sum+=ya_strftime_r(buf,sizeof(buf),format,&tms[i],&tz);
+ t_strf=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		sum+=ya_strftime_plan_r(buf,sizeof(buf),plan,&tms[i],&tz);
+ t_plan=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ strf_free_plan(plan);
+ sink+=sum;
+ printf("  %-30s ya_strftime_r() %6.1f ns, ya_strftime_plan_r() %6.1f ns\n",format,t_strf,t_plan);
+}
+
+static void bench_strftime_epoch(const char *format) /* sec_to_tm()+ya_strftime_r() vs ya_strftime_epoch() for the times in times[] */
+{char buf[128];
+ struct tm tm;
+ struct strp_tz_struct tz;
+ int64_t sum=0;
+ double start,t_tm,t_epoch,t_tm_p,t_epoch_p;
+ const unsigned int reps=200;
+ struct strf_plan *plan=strf_compile(format);
+ init_strp_tz(&tz);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{sec_to_tm(times[i],&tm);
+		 sum+=ya_strftime_r(buf,sizeof(buf),format,&tm,&tz);
+		}
+ t_tm=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		sum+=ya_strftime_epoch(buf,sizeof(buf),format,times[i],0,strp_tz_default);
+ t_epoch=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{sec_to_tm(times[i],&tm);
+		 sum+=ya_strftime_plan_r(buf,sizeof(buf),plan,&tm,&tz);
+		}
+ t_tm_p=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		sum+=ya_strftime_plan_epoch(buf,sizeof(buf),plan,times[i],0,strp_tz_default);
+ t_epoch_p=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ strf_free_plan(plan);
+ sink+=sum;
+ printf("  %-20s sec_to_tm()+ya_strftime_r() %6.1f ns, ya_strftime_epoch() %6.1f ns, sec_to_tm()+ya_strftime_plan_r() %6.1f ns, ya_strftime_plan_epoch() %6.1f ns\n",
+ 	format,t_tm,t_epoch,t_tm_p,t_epoch_p);
+}
+
+static void bench_strftime_cached(const char *format) /* ya_strftime_plan_epoch() vs ya_strftime_cached() for a log writer with a record every 10us */
+{char buf[128];
+ int64_t sum=0;
+ double start,t_plan,t_cached;
+ const unsigned int reps=200;
+ const time_t t0=INT64_C(1700000000);
+ struct strf_plan *plan=strf_compile(format);
+ struct strf_cache *cache=strf_cache_create(format);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{int64_t us=((int64_t)r*NOS_TIMES+i)*10;
+		 sum+=ya_strftime_plan_epoch(buf,sizeof(buf),plan,t0+us/1000000,(int32_t)(us%1000000)*1000,-300);
+		}
+ t_plan=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{int64_t us=((int64_t)r*NOS_TIMES+i)*10;
+		 sum+=ya_strftime_cached(buf,sizeof(buf),cache,t0+us/1000000,(int32_t)(us%1000000)*1000,-300);
+		}
+ t_cached=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ strf_free_plan(plan);
+ strf_cache_free(cache);
+ sink+=sum;
+ printf("  %-30s ya_strftime_plan_epoch() %6.1f ns, ya_strftime_cached() %6.1f ns\n",format,t_plan,t_cached);
+}
+
+static void bench_tz_zone(const char *name) /* tz_zone_offset() (index) vs tz_zone_offset_bsearch() and the full conversions for the times in times[], name is a file in zoneinfo/ or a TZ string */
+{struct tm tm;
+ struct strp_tz_struct tz;
+ int64_t sum=0;
+ double start,t_index,t_bsearch,t_to_tm,t_mktime;
+ const unsigned int reps=500;
+ struct tz_zone *z= strchr(name,',')!=NULL ? tz_zone_from_posix(name) : tz_zone_load("zoneinfo",name); /* the copy in the test tree, so bench must be run from the directory that contains zoneinfo/ */
+ if(z==NULL)
+ 	{printf("  %-20s cannot load zoneinfo/%s\n",name,name);
+ 	 return;
+ 	}
+ init_strp_tz(&tz);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		sum+=tz_zone_offset(z,times[i],NULL,NULL);
+ t_index=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		sum+=tz_zone_offset_bsearch(z,times[i],NULL,NULL);
+ t_bsearch=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{UTC_sec_to_tm_zone(times[i],&tm,&tz,z);
+		 sum+=tm.tm_mday+tm.tm_hour;
+		}
+ t_to_tm=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<NOS_TIMES;++i)
+		{sec_to_tm(times[i],&tm); /* as a local time */
+		 tm.tm_isdst=-1;
+		 sum+=UTC_mktime_zone(&tm,&tz,z);
+		}
+ t_mktime=(secs()-start)*1e9/((double)reps*NOS_TIMES);
+ tz_zone_free(z);
+ sink+=sum;
+ printf("  %-20s tz_zone_offset() %5.1f ns, tz_zone_offset_bsearch() %5.1f ns, UTC_sec_to_tm_zone() %5.1f ns, sec_to_tm()+UTC_mktime_zone() %5.1f ns\n",name,t_index,t_bsearch,t_to_tm,t_mktime);
+}
+
+static void bench_tz_zone_batch(const char *name) /* UTC_sec_to_tm_zone() for each value vs sec_to_tm_zone_batch() for times in ascending order (an event every ~10 mins from 2000) and the same times shuffled */
+{static time_t sorted[NOS_TIMES*16],shuffled[NOS_TIMES*16];
+ static int year[NOS_TIMES*16],mon[NOS_TIMES*16],mday[NOS_TIMES*16],hour[NOS_TIMES*16],min[NOS_TIMES*16],sec[NOS_TIMES*16];
+ const int n=NOS_TIMES*16;
+ struct tm_soa soa={year,mon,mday,hour,min,sec,NULL,NULL};
+ struct tm tm;
+ struct strp_tz_struct tz;
+ struct tz_cursor c;
+ int64_t sum=0;
+ double start,t_each,t_sorted,t_shuffled;
+ const unsigned int reps=30;
+ struct tz_zone *z=tz_zone_load("zoneinfo",name);
+ if(z==NULL)
+ 	{printf("  %-20s cannot load zoneinfo/%s\n",name,name);
+ 	 return;
+ 	}
+ init_strp_tz(&tz);
+ sorted[0]=INT64_C(946684800);
+ for(int i=1;i<n;++i)
+ 	sorted[i]=sorted[i-1]+(time_t)(rand64()%1200);
+ for(int i=0;i<n;++i)
+ 	shuffled[i]=sorted[i];
+ for(int i=n-1;i>0;--i)
+ 	{int j=(int)(rand64()%(uint64_t)(i+1));
+ 	 time_t tmp=shuffled[i];
+ 	 shuffled[i]=shuffled[j];
+ 	 shuffled[j]=tmp;
+ 	}
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	for(int i=0;i<n;++i)
+		{UTC_sec_to_tm_zone(sorted[i],&tm,&tz,z);
+		 sum+=tm.tm_mday+tm.tm_hour;
+		}
+ t_each=(secs()-start)*1e9/((double)reps*n);
+ tz_cursor_init(&c,z);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	{sec_to_tm_zone_batch(sorted,n,&c,&soa,NULL,NULL);
+	 sum+=mday[r]+hour[r];
+	}
+ t_sorted=(secs()-start)*1e9/((double)reps*n);
+ start=secs();
+ for(unsigned int r=0;r<reps;++r)
+	{sec_to_tm_zone_batch(shuffled,n,&c,&soa,NULL,NULL);
+	 sum+=mday[r]+hour[r];
+	}
+ t_shuffled=(secs()-start)*1e9/((double)reps*n);
+ tz_zone_free(z);
+ sink+=sum;
+ printf("  %-20s UTC_sec_to_tm_zone() %5.1f ns, sec_to_tm_zone_batch() ascending %5.1f ns, shuffled %5.1f ns\n",name,t_each,t_sorted,t_shuffled);
+}
+
+int main(void)
+{const time_t y1970_2100=INT64_C(4102444800); /* 2100-01-01 00:00:00 */
+ const time_t t_max=((time_t)INT_MAX-1900)*INT64_C(31556952); /* approx limit of years that fit into tm_year */
+ printf("sec_to_tm() (time per call, speed up vs sec_to_tm()):\n");
+ compare_sec_to_tm("1970-2100:",0,y1970_2100);
+ compare_sec_to_tm("-10000 to +10000:",-INT64_C(377705116800),INT64_C(253402300800));
+ compare_sec_to_tm("full range of years:",-t_max,t_max);
+ printf("ya_mktime_tm() and day_of_week() (time per call, -10000 to +10000):\n");
+ fill_times(-INT64_C(377705116800),INT64_C(253402300800));
+ bench_mktime();
+ fill_times(0,y1970_2100);
+ printf("ya_strptime() (time per call, 1970-2100):\n");
+ bench_strptime("%Y-%m-%d %H:%M:%S");
+ bench_strptime("%Y-%m-%dT%H:%M:%S.%f%z");
+ bench_strptime("%a, %d %b %Y %H:%M:%S %z");
+ bench_strptime("%A %B %d %Y");
+ bench_strptime("%Y-%m-%d %H:%M:%S %Z");
+ bench_strptime_multi();
+ printf("ya_strptime_cached() (time per call, log with a line every ms):\n");
+ bench_strptime_cached("%Y-%m-%dT%H:%M:%S.%f%z");
+ bench_strptime_cached("%d/%b/%Y:%H:%M:%S.%f %z");
+ bench_strptime_cached("%d/%b/%Y:%H:%M:%S %z");
+ bench_strptime_cached("%b %e %H:%M:%S");
+ printf("ya_strftime() (time per call, 1970-2100):\n");
+ bench_strftime("%H:%M:%S");
+ bench_strftime("%Y-%m-%d %H:%M:%S");
+ bench_strftime("%Y-%m-%dT%H:%M:%S.%f%z");
+ bench_strftime("%a %b %e %j %U %V %W %s %C%y");
+ printf("ya_strftime_epoch() (time per call, 1970-2100):\n");
+ bench_strftime_epoch("%H:%M:%S");
+ bench_strftime_epoch("%Y-%m-%d %H:%M:%S");
+ printf("ya_strftime_cached() (time per call, a record every 10us):\n");
+ bench_strftime_cached("%Y-%m-%dT%H:%M:%S.%f%z");
+ bench_strftime_cached("%d/%b/%Y:%H:%M:%S %z");
+ printf("time zones (time per call, 1900-2037):\n");
+ fill_times(-INT64_C(2208988800),INT64_C(2145916800));
+ bench_tz_zone("Europe/London");
+ bench_tz_zone("America/New_York");
+ bench_tz_zone("Asia/Kolkata");
+ printf("time zones after the last transition, from the TZ string (time per call, 2038-2400):\n");
+ fill_times(INT64_C(2145916800),INT64_C(13569465600));
+ bench_tz_zone("Europe/London");
+ bench_tz_zone("America/New_York");
+ bench_tz_zone("EST5EDT,M3.2.0,M11.1.0");
+ printf("time zone batch conversion (time per value, 2000-2001):\n");
+ bench_tz_zone_batch("Europe/London");
+ bench_tz_zone_batch("America/New_York");
+ printf("sec_to_tm_batch() (speed up vs scalar):\n");
+ bench_sec_to_tm_batch("1970-2100:",0,y1970_2100);
+ bench_sec_to_tm_batch("full range of years:",-t_max,t_max);
+ printf("ya_mktime_tm_batch() (speed up vs scalar):\n");
+ bench_mktime_batch("1970-2100:",0,y1970_2100);
+ bench_mktime_batch("full range of years:",-t_max,t_max);
+ return 0;
+}
@@ -0,0 +1,425 @@
+/* logtimes - extract the timestamp from every line of a (large) log file using all the cores of the machine
+
+   For gcc (or clang) under linux compile with :
+
+  gcc -Wall -O3 -pthread -o logtimes logtimes.c strftime.c strptime.c time_batch.c
+
+   Usage: logtimes [-f format] [-k field] [-t threads] [-n] [-o epochs_file] [-l offsets_file] [-s] logfile
+     -f format  format of the timestamp as for ya_strptime(), default "%Y-%m-%dT%H:%M:%S"
+     -k field   the timestamp starts at this field of each line (fields are separated by spaces or tabs, the 1st is 1), default 1
+     -t threads number of threads to use, default the number of processors
+     -n         output nanoseconds since the epoch (including %f) rather than seconds, times more than about 292 years from 1970 are treated as invalid
+     -o file    write the epochs to file, one int64_t per line of the log (INT64_MIN if the line has no valid timestamp)
+     -l file    write the offset in the log of the start of each line to file, one int64_t per line
+     -s         time the extraction with 1, 2, 4 ... threads up to the number given by -t and print the results, including how evenly the chunks were
+                shared and the number of steals (no files are written). Speed ups are only meaningful up to the number of processors
+   Times with a %z, or a %Z whose abbreviation is in the built in table (see ya_strptime()), are converted to UTC, otherwise they are as written. The int64_t values are written in the byte order of the machine.
+
+   The log is memory mapped and split into chunks of about 1MB, each starting at the beginning of a line. A 1st pass counts the lines in each chunk (so the index
+   of the 1st line of every chunk is known) then a 2nd pass matches the timestamps, writing each result directly into its place in the output arrays.
+   Each pass is shared between the threads by a work-stealing pool: every thread starts with an equal share of the chunks and takes them from the front of its
+   own share, a thread that has run out steals half of what is left of another thread's share (from the back), so threads that get through their chunks
+   quicker (eg because their lines are shorter) help the others. Each thief starts looking at a random other thread (rather than always the next one)
+   so thieves that run out at the same time do not all queue up on the same victim.
+   A share is a pair of 32 bit chunk numbers (next, end) in one 64 bit word that is only changed with a compare and swap, so each chunk is done exactly once.
+   Each thread uses its own struct strp_cache (see ya_strptime_cached()) as successive lines in a log usually only differ in the last few characters of the time.
+*/
+
+/*----------------------------------------------------------------------------
+ * Copyright (c) 2022 Peter Miller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHOR OR COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *--------------------------------------------------------------------------*/
+
+#ifndef _WIN32
+ #define _POSIX_C_SOURCE 200809L /* for clock_gettime() and sysconf() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#ifdef _WIN32
+ #include <windows.h>
+#else
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+#endif
+#include "time_local.h"
+
+#define CHUNK_SIZE (1<<20) /* approximate size of the chunks the log is split into */
+#define MAX_THREADS 256
+
+struct share /* chunks not yet taken from one thread's share, on its own cache line so threads do not slow each other down */
+	{
+	 uint64_t range; /* next | (uint64_t)end<<32 , chunks next..end-1 are left */
+	 char pad[64-sizeof(uint64_t)];
+	};
+
+struct job /* everything the threads need */
+	{
+	 const char *log; /* the memory mapped log */
+	 size_t size; /* number of characters in log */
+	 size_t nchunks;
+	 size_t *chunk_start; /* chunk i is log[chunk_start[i]]..log[chunk_start[i+1]-1] (nchunks+1 entries) */
+	 size_t *chunk_line; /* number of the 1st line in each chunk (after the counting pass) */
+	 const char *format;
+	 int field; /* field of each line the timestamp starts at (1 is the 1st) */
+	 bool nanosecs; /* output nanoseconds rather than seconds */
+	 int64_t *epochs; /* result for each line */
+	 int64_t *offsets; /* start of each line in log */
+	 int nthreads;
+	 struct share *shares; /* one per thread */
+	 bool counting; /* true for the pass that counts lines, false for the pass that matches timestamps */
+	 size_t min_chunks,max_chunks,nsteals; /* for -s, the fewest and most chunks done by one thread and the total steals in the last pass */
+	};
+
+struct worker /* argument for each thread */
+	{
+	 struct job *job;
+	 int id; /* 0..nthreads-1 */
+	 uint32_t seed; /* xorshift state used to pick the 1st thread to steal from */
+	 size_t nchunks; /* chunks done by this thread */
+	 size_t nsteals; /* successful steals by this thread */
+	};
+
+static double wall_secs(void) /* elapsed (not processor) time in secs, as all the threads are timed together */
+{
+#ifdef _WIN32
+ LARGE_INTEGER t,f;
+ QueryPerformanceCounter(&t);
+ QueryPerformanceFrequency(&f);
+ return (double)t.QuadPart/(double)f.QuadPart;
+#else
+ struct timespec t;
+ clock_gettime(CLOCK_MONOTONIC,&t);
+ return (double)t.tv_sec+t.tv_nsec*1e-9;
+#endif
+}
+
+static int nos_processors(void)
+{
+#ifdef _WIN32
+ SYSTEM_INFO si;
+ GetSystemInfo(&si);
+ return (int)si.dwNumberOfProcessors;
+#else
+ long n=sysconf(_SC_NPROCESSORS_ONLN);
+ return n<1 ? 1 : (int)n;
+#endif
+}
+
+static const char *map_file(const char *name, size_t *size) /* memory map file name (read only), returns NULL on error. An empty file gives "" */
+{
+#ifdef _WIN32
+ HANDLE f,m;
+ LARGE_INTEGER len;
+ const char *p;
+ f=CreateFileA(name,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+ if(f==INVALID_HANDLE_VALUE) return NULL;
+ if(!GetFileSizeEx(f,&len)) {CloseHandle(f); return NULL;}
+ *size=(size_t)len.QuadPart;
+ if(*size==0) {CloseHandle(f); return "";}
+ m=CreateFileMappingA(f,NULL,PAGE_READONLY,0,0,NULL);
+ CloseHandle(f);
+ if(m==NULL) return NULL;
+ p=(const char *)MapViewOfFile(m,FILE_MAP_READ,0,0,0);
+ CloseHandle(m); // the view keeps the mapping open
+ return p;
+#else
+ struct stat st;
+ void *p;
+ int fd=open(name,O_RDONLY);
+ if(fd<0) return NULL;
+ if(fstat(fd,&st)!=0) {close(fd); return NULL;}
+ *size=(size_t)st.st_size;
+ if(*size==0) {close(fd); return "";}
+ p=mmap(NULL,*size,PROT_READ,MAP_PRIVATE,fd,0);
+ close(fd); // the mapping keeps the file open
+ if(p==MAP_FAILED) return NULL;
+ posix_madvise(p,*size,POSIX_MADV_SEQUENTIAL); // only a hint, each thread reads its chunks in order
+ return (const char *)p;
+#endif
+}
+
+static void unmap_file(const char *p, size_t size)
+{if(size==0) return;
+#ifdef _WIN32
+ UnmapViewOfFile(p);
+#else
+ munmap((void *)p,size);
+#endif
+}
+
+static bool take_chunk(struct share *s, size_t *chunk) /* take the next chunk from the front of share s, returns false if none are left */
+{uint64_t r=__atomic_load_n(&s->range,__ATOMIC_ACQUIRE);
+ for(;;)
+ 	{uint32_t next=(uint32_t)r,end=(uint32_t)(r>>32);
+ 	 if(next>=end) return false;
+ 	 if(__atomic_compare_exchange_n(&s->range,&r,r+1,false,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE)) // r is updated if this fails
+ 	 	{*chunk=next;
+ 	 	 return true;
+ 	 	}
+ 	}
+}
+
+static bool steal_chunks(struct job *job, struct worker *w) /* move half the chunks left in another thread's share to the (empty) share of w, returns false if there are none left anywhere */
+{int thief=w->id,start;
+ if(job->nthreads<2) return false;
+ w->seed^=w->seed<<13; // xorshift32, each thread has its own so no locking is needed
+ w->seed^=w->seed>>17;
+ w->seed^=w->seed<<5;
+ start=(int)(w->seed%(uint32_t)(job->nthreads-1)); // 1st victim is a random other thread, then the rest in turn
+ for(int i=0;i<job->nthreads-1;++i)
+ 	{struct share *victim=job->shares+(thief+1+(start+i)%(job->nthreads-1))%job->nthreads; // never thief itself
+ 	 uint64_t r=__atomic_load_n(&victim->range,__ATOMIC_ACQUIRE);
+ 	 for(;;)
+ 	 	{uint32_t next=(uint32_t)r,end=(uint32_t)(r>>32),mid;
+ 	 	 if(next>=end) break; // nothing to steal here
+ 	 	 mid=end-(end-next+1)/2; // take end-mid chunks from the back, at least 1
+ 	 	 if(__atomic_compare_exchange_n(&victim->range,&r,next|(uint64_t)mid<<32,false,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE))
+ 	 	 	{__atomic_store_n(&job->shares[thief].range,mid|(uint64_t)end<<32,__ATOMIC_RELEASE);
+ 	 	 	 ++w->nsteals;
+ 	 	 	 return true;
+ 	 	 	}
+ 	 	}
+ 	}
+ return false;
+}
+
+static void count_lines(struct job *job, size_t chunk) /* set chunk_line[chunk] to the number of lines that start in the chunk */
+{const char *p=job->log+job->chunk_start[chunk],*e=job->log+job->chunk_start[chunk+1];
+ size_t n=0;
+ while(p<e)
+ 	{const char *nl=(const char *)memchr(p,'\n',(size_t)(e-p));
+ 	 ++n; // a last line without a newline still counts
+ 	 if(nl==NULL) break;
+ 	 p=nl+1;
+ 	}
+ job->chunk_line[chunk]=n;
+}
+
+static void match_lines(struct job *job, size_t chunk, struct strp_cache *cache) /* match the timestamp of every line in the chunk */
+{const char *p=job->log+job->chunk_start[chunk],*e=job->log+job->chunk_start[chunk+1];
+ size_t line=job->chunk_line[chunk];
+ while(p<e)
+ 	{const char *nl=(const char *)memchr(p,'\n',(size_t)(e-p));
+ 	 const char *end= nl==NULL ? e : nl,*s=p;
+ 	 struct strp_epoch ep;
+ 	 int64_t result=INT64_MIN; // no valid timestamp
+ 	 for(int f=1;f<job->field;++f)
+ 	 	{// skip to the start of the field
+ 	 	 while(s<end && (*s==' ' || *s=='\t')) ++s;
+ 	 	 while(s<end && *s!=' ' && *s!='\t') ++s;
+ 	 	}
+ 	 while(s<end && (*s==' ' || *s=='\t')) ++s;
+ 	 if(ya_strptime_cached_n(s,(size_t)(end-s),cache,&ep)!=NULL)
+ 	 	{int64_t secs=ep.secs;
+ 	 	 if(ep.tz_off_mins!=strp_tz_default) secs-=60*(int64_t)ep.tz_off_mins; // to UTC
+ 	 	 if(!job->nanosecs) result=secs;
+ 	 	 else if(secs>=INT64_MIN/1000000000 && (secs<INT64_MAX/1000000000 || (secs==INT64_MAX/1000000000 && ep.nsecs<=INT64_MAX%1000000000))) result=secs*1000000000+ep.nsecs; // nanoseconds only cover +/- 292 years around 1970, times outside that are treated as invalid
+ 	 	}
+ 	 job->epochs[line]=result;
+ 	 if(job->offsets!=NULL) job->offsets[line]=(int64_t)(p-job->log);
+ 	 ++line;
+ 	 if(nl==NULL) break;
+ 	 p=nl+1;
+ 	}
+}
+
+static void *run_worker(void *arg) /* thread function, does chunks from its own share then steals from the others until there are none left */
+{struct worker *w=(struct worker *)arg;
+ struct job *job=w->job;
+ struct strp_cache *cache=NULL;
+ size_t chunk;
+ if(!job->counting)
+ 	{cache=strp_cache_create(job->format);
+ 	 if(cache==NULL) return (void *)1;
+ 	}
+ do
+ 	{while(take_chunk(job->shares+w->id,&chunk))
+ 	 	{if(job->counting) count_lines(job,chunk);
+ 	 	 else match_lines(job,chunk,cache);
+ 	 	 ++w->nchunks;
+ 	 	}
+ 	} while(steal_chunks(job,w));
+ strp_cache_free(cache);
+ return NULL;
+}
+
+static bool run_pass(struct job *job, bool counting) /* do one pass over all the chunks with job->nthreads threads, returns false on error */
+{pthread_t threads[MAX_THREADS];
+ struct worker workers[MAX_THREADS];
+ bool ok=true;
+ int started=0;
+ job->counting=counting;
+ for(int i=0;i<job->nthreads;++i)
+ 	{// equal shares of the chunks
+ 	 uint64_t lo=job->nchunks*(uint64_t)i/(uint64_t)job->nthreads,hi=job->nchunks*(uint64_t)(i+1)/(uint64_t)job->nthreads;
+ 	 job->shares[i].range=lo|hi<<32;
+ 	}
+ for(int i=0;i<job->nthreads;++i)
+ 	{workers[i].job=job;
+ 	 workers[i].id=i;
+ 	 workers[i].seed=2654435769u*(uint32_t)(i+1); // any non zero value, different for each thread
+ 	 workers[i].nchunks=0;
+ 	 workers[i].nsteals=0;
+ 	}
+ for(int i=1;i<job->nthreads;++i,++started) // this thread is worker 0
+ 	if(pthread_create(threads+i,NULL,run_worker,workers+i)!=0) break; // the threads that did start steal the work of those that did not
+ if(run_worker(workers)!=NULL) ok=false;
+ for(int i=1;i<=started;++i)
+ 	{void *r;
+ 	 pthread_join(threads[i],&r);
+ 	 if(r!=NULL) ok=false;
+ 	}
+ job->min_chunks=job->max_chunks=workers[0].nchunks;
+ job->nsteals=0;
+ for(int i=0;i<job->nthreads;++i)
+ 	{if(workers[i].nchunks<job->min_chunks) job->min_chunks=workers[i].nchunks;
+ 	 if(workers[i].nchunks>job->max_chunks) job->max_chunks=workers[i].nchunks;
+ 	 job->nsteals+=workers[i].nsteals;
+ 	}
+ return ok;
+}
+
+static bool extract(struct job *job) /* count the lines then match their timestamps, returns false if out of memory */
+{size_t nlines=0;
+ if(!run_pass(job,true)) return false;
+ for(size_t i=0;i<job->nchunks;++i)
+ 	{// number of the 1st line of each chunk
+ 	 size_t n=job->chunk_line[i];
+ 	 job->chunk_line[i]=nlines;
+ 	 nlines+=n;
+ 	}
+ job->chunk_line[job->nchunks]=nlines;
+ free(job->epochs);
+ free(job->offsets);
+ job->epochs=(int64_t *)malloc((nlines+1)*sizeof(int64_t));
+ job->offsets=(int64_t *)malloc((nlines+1)*sizeof(int64_t));
+ if(job->epochs==NULL || job->offsets==NULL) return false;
+ return run_pass(job,false);
+}
+
+static bool write_array(const char *name, const int64_t *a, size_t n) /* write n values of a to file name */
+{FILE *f=fopen(name,"wb");
+ bool ok;
+ if(f==NULL) return false;
+ ok=fwrite(a,sizeof(int64_t),n,f)==n;
+ if(fclose(f)!=0) ok=false;
+ return ok;
+}
+
+int main(int argc, char *argv[])
+{struct job job;
+ const char *logfile=NULL,*epochs_file=NULL,*offsets_file=NULL;
+ int nthreads=nos_processors();
+ bool scaling=false;
+ size_t nlines;
+ memset(&job,0,sizeof(job));
+ job.format="%Y-%m-%dT%H:%M:%S";
+ job.field=1;
+ for(int i=1;i<argc;++i)
+ 	{if(argv[i][0]!='-' || argv[i][1]==0 || argv[i][2]!=0) logfile=argv[i];
+ 	 else if(argv[i][1]=='n') job.nanosecs=true;
+ 	 else if(argv[i][1]=='s') scaling=true;
+ 	 else if(i+1<argc && argv[i][1]=='f') job.format=argv[++i];
+ 	 else if(i+1<argc && argv[i][1]=='k') job.field=atoi(argv[++i]);
+ 	 else if(i+1<argc && argv[i][1]=='t') nthreads=atoi(argv[++i]);
+ 	 else if(i+1<argc && argv[i][1]=='o') epochs_file=argv[++i];
+ 	 else if(i+1<argc && argv[i][1]=='l') offsets_file=argv[++i];
+ 	 else logfile=NULL,i=argc; // unknown option
+ 	}
+ if(logfile==NULL || job.field<1 || nthreads<1)
+ 	{fprintf(stderr,"usage: logtimes [-f format] [-k field] [-t threads] [-n] [-o epochs_file] [-l offsets_file] [-s] logfile\n");
+ 	 return 2;
+ 	}
+ if(nthreads>MAX_THREADS) nthreads=MAX_THREADS;
+ job.log=map_file(logfile,&job.size);
+ if(job.log==NULL)
+ 	{fprintf(stderr,"logtimes: cannot read %s\n",logfile);
+ 	 return 1;
+ 	}
+ job.chunk_start=(size_t *)malloc((job.size/CHUNK_SIZE+2)*sizeof(size_t));
+ job.chunk_line=(size_t *)malloc((job.size/CHUNK_SIZE+2)*sizeof(size_t));
+ job.shares=(struct share *)calloc((size_t)nthreads,sizeof(struct share));
+ if(job.chunk_start==NULL || job.chunk_line==NULL || job.shares==NULL || job.size/CHUNK_SIZE+1>UINT32_MAX)
+ 	{fprintf(stderr,"logtimes: out of memory\n");
+ 	 return 1;
+ 	}
+ job.chunk_start[0]=0;
+ while(job.chunk_start[job.nchunks]<job.size)
+ 	{// each chunk ends after the 1st newline at or after CHUNK_SIZE characters
+ 	 size_t start=job.chunk_start[job.nchunks],end=start+CHUNK_SIZE;
+ 	 if(end>=job.size) end=job.size;
+ 	 else
+ 	 	{const char *nl=(const char *)memchr(job.log+end-1,'\n',job.size-end+1);
+ 	 	 end= nl==NULL ? job.size : (size_t)(nl-job.log)+1;
+ 	 	}
+ 	 job.chunk_start[++job.nchunks]=end;
+ 	}
+ if(scaling)
+ 	{// time 1, 2, 4 ... nthreads threads (and nthreads itself if its not a power of 2)
+ 	 double t1=0;
+ 	 int nprocs=nos_processors();
+ 	 printf("%s: %.1f MB, %lu chunks, %d processors\n",logfile,job.size/1e6,(unsigned long)job.nchunks,nprocs);
+ 	 job.nthreads=1;
+ 	 if(!extract(&job)) {fprintf(stderr,"logtimes: out of memory\n"); return 1;} // untimed, so the log is in memory for all the timed runs
+ 	 for(int n=1;n<=nthreads;n= n<nthreads && n*2>nthreads ? nthreads : n*2)
+ 	 	{double start,t;
+ 	 	 job.nthreads=n;
+ 	 	 start=wall_secs();
+ 	 	 if(!extract(&job)) {fprintf(stderr,"logtimes: out of memory\n"); return 1;}
+ 	 	 t=wall_secs()-start;
+ 	 	 if(n==1) t1=t;
+ 	 	 printf("  %3d threads %8.3f secs %8.1f MB/sec %10.1f million lines/sec speed up %5.2f, chunks per thread %lu-%lu, %lu steals%s\n",n,t,job.size/1e6/t,job.chunk_line[job.nchunks]/1e6/t,t1/t,
+ 	 	 	(unsigned long)job.min_chunks,(unsigned long)job.max_chunks,(unsigned long)job.nsteals,n>nprocs ? " (more threads than processors, so no speed up is possible)" : "");
+ 	 	 if(n==nthreads) break;
+ 	 	}
+ 	}
+ else
+ 	{job.nthreads=nthreads;
+ 	 if(!extract(&job)) {fprintf(stderr,"logtimes: out of memory\n"); return 1;}
+ 	}
+ nlines=job.chunk_line[job.nchunks];
+ if(!scaling && ((epochs_file!=NULL && !write_array(epochs_file,job.epochs,nlines)) || (offsets_file!=NULL && !write_array(offsets_file,job.offsets,nlines))))
+ 	{fprintf(stderr,"logtimes: cannot write output\n");
+ 	 return 1;
+ 	}
+ if(!scaling && epochs_file==NULL)
+ 	{// no output file, so just summarise the results
+ 	 size_t valid=0;
+ 	 for(size_t i=0;i<nlines;++i)
+ 	 	if(job.epochs[i]!=INT64_MIN) ++valid;
+ 	 printf("%lu lines, %lu with a valid timestamp\n",(unsigned long)nlines,(unsigned long)valid);
+ 	}
+ unmap_file(job.log,job.size);
+ free(job.chunk_start);
+ free(job.chunk_line);
+ free(job.shares);
+ free(job.epochs);
+ free(job.offsets);
+ return 0;
+}
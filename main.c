@@ -6,14 +6,14 @@ This file compiles and runs correctly with devC++/TDMgcc 10.3.0 on Windows, Buil
 
 For gcc under linux compile test program with :
 
-  gcc -Wall -O3 -o date-time main.c strftime.c strptime.c 
+  gcc -Wall -O3 -o date-time main.c strftime.c strptime.c time_batch.c 
   ./date-time
   
 For dev-C++ (tested with tdmgcc 10.3.0) there is a *.dev file, and the project files (*.cbproj) for Builder C++ are also present. 
 You should see no errors or warnings when compiling these files.
 
 In all cases when running the executable you should see lots of output with the last line reading:
-7300275 tests conducted, no errors found
+15963570 tests conducted, no errors found
 
 */
 
@@ -49,6 +49,9 @@ In all cases when running the executable you should see lots of output with the
 #include <locale.h>
 #include <stdint.h>
 #include <limits.h>
+#ifdef __linux
+ #include <unistd.h> /* for getcwd() */
+#endif
 #include "time_local.h"
 #ifdef _WIN32 /* defined when compiling for windows, either 32 or 64 bits */
  #include <windows.h> /* to allow colour changes on text output - windows only ! */
@@ -142,6 +145,203 @@ void display_tm(void)
 }
  
 
+bool same_tm(const struct tm *a,const struct tm *b) /* returns true if all the fields of struct tm are identical */
+{return a->tm_sec==b->tm_sec && a->tm_min==b->tm_min && a->tm_hour==b->tm_hour && a->tm_mday==b->tm_mday && a->tm_mon==b->tm_mon &&
+		a->tm_year==b->tm_year && a->tm_wday==b->tm_wday && a->tm_yday==b->tm_yday && a->tm_isdst==b->tm_isdst;
+}
+
+bool same_strp_tz(const struct strp_tz_struct *a,const struct strp_tz_struct *b) /* returns true if all the fields of struct strp_tz_struct are identical */
+{return a->initialised==b->initialised && memcmp(a->tz_name,b->tz_name,sizeof(a->tz_name))==0 && a->tz_off_mins==b->tz_off_mins &&
+		a->week_nos_U==b->week_nos_U && a->week_nos_V==b->week_nos_V && a->week_nos_W==b->week_nos_W && a->year_G==b->year_G &&
+		a->f_secs==b->f_secs && a->f_secs_p10==b->f_secs_p10 && a->f_asecs==b->f_asecs;
+}
+
+void check_plan(const char *string, const char *format, const char *end) /* check ya_strptime_plan(), ya_strptime_epoch() and the reentrant versions give identical results to the strptime() call just made (which set tm, strp_tz and end) */
+{struct tm tm_p,tm_r,tm_pr;
+ struct strp_tz_struct tz_s=strp_tz;// save results from strptime()
+ struct strp_tz_struct tz_r,tz_pr;
+ struct strp_plan *plan=strp_compile(format);
+ struct strp_multi *multi=strp_multi_compile(&format,1,false); // a single format must give the same results, so this checks the prefilters never reject a match
+ char *end_p,*end_r,*end_pr,*end_e,*end_pe;
+ struct strp_epoch e,e_p;
+ time_t ya_mktime_tm(const struct tm *tp); /* in strftime.c */
+ memset(&e,0,sizeof(e)); // so memcmp() can be used
+ memset(&e_p,0,sizeof(e_p));
+ memset(&tm_p, 0, sizeof(struct tm));// zero all members of tm_p, as done for tm
+ memset(&tm_r, 0, sizeof(struct tm));
+ memset(&tm_pr, 0, sizeof(struct tm));
+ memset(&tz_r, 0xff, sizeof(tz_r));// garbage - ya_strptime_r() must initialise it
+ memset(&tz_pr, 0xff, sizeof(tz_pr));
+ strp_tz.initialised=0; // check the reentrant versions leave the global alone
+ end_r=ya_strptime_r(string,format,&tm_r,&tz_r);
+ end_pr=ya_strptime_plan_r(string,plan,&tm_pr,&tz_pr);
+ if(strp_tz.initialised!=0 || end_r!=end || !same_tm(&tm,&tm_r) || !same_strp_tz(&tz_s,&tz_r) || end_pr!=end || !same_tm(&tm,&tm_pr) || !same_strp_tz(&tz_s,&tz_pr))
+ 	{++errs;
+ 	 red_text();
+ 	 printf("Error: ya_strptime_r() or ya_strptime_plan_r() gives a different result to strptime() for %s format %s\n",string,format);
+ 	 normal_text();
+ 	}
+ {struct tm tm_m;
+  struct strp_tz_struct tz_m;
+  int which=99;
+  char *end_m;
+  memset(&tm_m,0,sizeof(tm_m));
+  end_m=ya_strptime_multi_r(string,multi,&tm_m,&tz_m,&which);
+  if(end_m!=end || which!=(end==NULL ? -1 : 0) || (end!=NULL && (!same_tm(&tm,&tm_m) || !same_strp_tz(&tz_s,&tz_m)))) // on failure tm is left unchanged, so only compare results for a match
+  	{++errs;
+  	 red_text();
+  	 printf("Error: ya_strptime_multi_r() gives a different result to strptime() for %s format %s\n",string,format);
+  	 normal_text();
+  	}
+ }
+ {// length bounded versions, for every len the result must be the same as for a null terminated copy of the 1st len characters.
+  // The rest of string follows the len characters, so reading past the end would (almost always) give a different result
+  // Each length is also given to ya_strptime_cached_n() in turn, so it restarts from the field that contains the new last character
+  size_t slen=strlen(string);
+  char *copy=(char *)malloc(slen+1);
+  struct strp_cache *cache=strp_cache_create(format);
+  for(size_t len=0;copy!=NULL && len<=slen;++len)
+  	{struct tm tm_c,tm_n,tm_pn,tm_mn;
+  	 struct strp_tz_struct tz_c,tz_n,tz_pn,tz_mn;
+  	 struct strp_epoch e_c,e_cn;
+  	 char *end_c,*end_n,*end_pn,*end_mn,*end_ec,*end_cn;
+  	 int which;
+  	 memcpy(copy,string,len);
+  	 copy[len]=0;
+  	 memset(&tm_c,0,sizeof(tm_c));
+  	 memset(&tm_n,0,sizeof(tm_n));
+  	 memset(&tm_pn,0,sizeof(tm_pn));
+  	 memset(&tm_mn,0,sizeof(tm_mn));
+  	 end_c=ya_strptime_r(copy,format,&tm_c,&tz_c);
+  	 end_n=ya_strptime_n_r(string,len,format,&tm_n,&tz_n);
+  	 end_pn=ya_strptime_plan_n_r(string,len,plan,&tm_pn,&tz_pn);
+  	 end_mn=ya_strptime_multi_n_r(string,len,multi,&tm_mn,&tz_mn,&which);
+  	 if((end_c==NULL ? end_n!=NULL || end_pn!=NULL : end_n!=string+(end_c-copy) || end_pn!=end_n) || !same_tm(&tm_c,&tm_n) || !same_tm(&tm_c,&tm_pn) ||
+  	 	!same_strp_tz(&tz_c,&tz_n) || !same_strp_tz(&tz_c,&tz_pn) ||
+  	 	end_mn!=end_n || (end_c!=NULL && (!same_tm(&tm_c,&tm_mn) || !same_strp_tz(&tz_c,&tz_mn))))
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: ya_strptime_n_r(), ya_strptime_plan_n_r() or ya_strptime_multi_n_r() gives a different result for the 1st %d characters of %s format %s\n",(int)len,string,format);
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	 memset(&e_c,0,sizeof(e_c)); // so memcmp() can be used
+  	 memset(&e_cn,0,sizeof(e_cn));
+  	 end_ec=ya_strptime_epoch(copy,format,&e_c);
+  	 end_cn=ya_strptime_cached_n(string,len,cache,&e_cn);
+  	 if((end_ec==NULL ? end_cn!=NULL : end_cn!=string+(end_ec-copy)) || memcmp(&e_c,&e_cn,sizeof(e_c))!=0)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: ya_strptime_cached_n() gives a different result for the 1st %d characters of %s format %s\n",(int)len,string,format);
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	}
+  for(int i=0;i<2;++i)
+  	{// the whole string (which is the same as the last length above), then again
+  	 struct strp_epoch e_s,e_c;
+  	 memset(&e_s,0,sizeof(e_s));
+  	 memset(&e_c,0,sizeof(e_c));
+  	 if(ya_strptime_cached(string,cache,&e_c)!=ya_strptime_epoch(string,format,&e_s) || memcmp(&e_s,&e_c,sizeof(e_s))!=0)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: ya_strptime_cached() gives a different result for %s format %s\n",string,format);
+  	 	 normal_text();
+  	 	}
+  	}
+  strp_cache_free(cache);
+  free(copy);
+ }
+ {// streaming input, the string split into 2 fragments at every position must give the same result as ya_strptime_plan_r() (so must 1 character at a time)
+  size_t slen=strlen(string);
+  struct strp_stream *ss=strp_stream_create(plan);
+  for(size_t split=0;ss!=NULL && split<=slen+1;++split)
+  	{struct tm tm_s;
+  	 struct strp_tz_struct tz_s2;
+  	 enum strp_stream_status status;
+  	 size_t used1=0,used2=0;
+  	 memset(&tm_s,0,sizeof(tm_s));
+  	 strp_stream_begin(ss,&tm_s,&tz_s2);
+  	 if(split<=slen)
+  	 	{status=strp_stream_feed(ss,string,split,&used1);
+  	 	 status=strp_stream_feed(ss,string+split,slen-split,&used2);
+  	 	}
+  	 else
+  	 	for(size_t i=0;i<slen;++i) status=strp_stream_feed(ss,string+i,1,i<strp_stream_length(ss) ? &used1 : &used2); // split==slen+1 is 1 character at a time
+  	 status=strp_stream_end(ss);
+  	 if((end==NULL ? status!=STRP_STREAM_ERROR : status!=STRP_STREAM_DONE || strp_stream_length(ss)!=(size_t)(end-string) || !same_tm(&tm,&tm_s) || !same_strp_tz(&tz_s,&tz_s2)) ||
+  	 	(split<=slen && (used1>split || used2>slen-split)))
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: strp_stream_feed() gives a different result for %s format %s split at %d\n",string,format,(int)split);
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	}
+  strp_stream_free(ss);
+ }
+ if(end!=NULL) 
+ 	{// ya_strptime_epoch() must give the same as ya_mktime_tm() of the struct tm from strptime() (which was zeroed first)
+ 	 time_t secs=ya_mktime_tm(&tm);
+ 	 int64_t ns=tz_s.f_secs_p10==strp_tz_default ? 0 : (int64_t)((tz_s.f_asecs+500000000)/1000000000); // attoseconds rounded to nanoseconds
+ 	 if(ns>=1000000000) {ns-=1000000000; ++secs;}
+ 	 end_e=ya_strptime_epoch(string,format,&e);
+ 	 end_pe=ya_strptime_plan_epoch(string,plan,&e_p);
+ 	 if(end_e!=end || end_pe!=end || e.secs!=secs || e.nsecs!=ns || e.tz_off_mins!=tz_s.tz_off_mins || memcmp(&e,&e_p,sizeof(e))!=0)
+ 	 	{++errs;
+ 	 	 red_text();
+ 	 	 printf("Error: ya_strptime_epoch() or ya_strptime_plan_epoch() gives a different result to strptime() for %s format %s\n",string,format);
+ 	 	 normal_text();
+ 	 	}
+ 	}
+ else if(ya_strptime_epoch(string,format,&e)!=NULL || ya_strptime_plan_epoch(string,plan,&e)!=NULL)
+ 	{++errs;
+ 	 red_text();
+ 	 printf("Error: ya_strptime_epoch() or ya_strptime_plan_epoch() did not fail for %s format %s\n",string,format);
+ 	 normal_text();
+ 	}
+ end_p=ya_strptime_plan(string,plan,&tm_p);
+ strp_free_plan(plan);
+ strp_multi_free(multi);
+ if(end_p!=end || !same_tm(&tm,&tm_p) || !same_strp_tz(&tz_s,&strp_tz))
+ 	{++errs;
+ 	 red_text();
+ 	 printf("Error: ya_strptime_plan() gives a different result to strptime() for %s format %s\n",string,format);
+ 	 normal_text();
+ 	}
+ strp_tz=tz_s; // restore strp_tz as set by strptime()
+}
+
+void check_strf_plan(const char *format) /* check ya_strftime_plan() and the reentrant versions give identical results to strftime() for tm, for all output buffer sizes that matter */
+{char buf[255],buf_p[255],buf_r[255],buf_pr[255];
+ size_t r,r_p,r_r,r_pr,max;
+ struct strp_tz_struct tz=strp_tz;// the reentrant versions use a copy of strp_tz
+ struct strf_plan *plan=strf_compile(format);
+ max=strf_plan_max_width(plan);
+ for(size_t size=1;size<sizeof(buf);++size)
+ 	{r=strftime(buf, size, format, &tm);
+ 	 r_p=ya_strftime_plan(buf_p,size,plan,&tm);
+ 	 r_r=ya_strftime_r(buf_r,size,format,&tm,&tz);
+ 	 r_pr=ya_strftime_plan_r(buf_pr,size,plan,&tm,&tz);
+ 	 if(r!=r_p || (r!=0 && strcmp(buf,buf_p)!=0) || r>max)
+ 	 	{++errs;
+ 	 	 red_text();
+ 	 	 printf("Error: ya_strftime_plan() gives a different result to strftime() for format %s with buffer size %u\n",format,(unsigned)size);
+ 	 	 normal_text();
+ 	 	 break;
+ 	 	}
+ 	 if(r!=r_r || r!=r_pr || (r!=0 && (strcmp(buf,buf_r)!=0 || strcmp(buf,buf_pr)!=0)))
+ 	 	{++errs;
+ 	 	 red_text();
+ 	 	 printf("Error: ya_strftime_r() or ya_strftime_plan_r() gives a different result to strftime() for format %s with buffer size %u\n",format,(unsigned)size);
+ 	 	 normal_text();
+ 	 	 break;
+ 	 	}
+ 	 if(r!=0 && size>max+2) break; // larger buffers make no difference
+ 	}
+ strf_free_plan(plan);
+}
+
 bool test(const char *string, const char *format,enum test_type tt) /* returns true if round loop  strptime -> strftime gives expected result */
 																	/* if tt=good then expect everything to work (ie round loop exact)
 																	   if tt==bad then result is expected to be incorrect 
@@ -164,6 +364,7 @@ bool test(const char *string, const char *format,enum test_type tt) /* returns t
  memset(&tm, 0, sizeof(struct tm));// zero all members of tm
  init_strp_tz(&strp_tz); 
  end=strptime(string, format, &tm);
+ check_plan(string,format,end);
  printf("Input:      %s format %s => ",string,format); 
  display_tm();
  printf(" : ");
@@ -180,6 +381,7 @@ bool test(const char *string, const char *format,enum test_type tt) /* returns t
  	 else puts("Wrong! (error was not detected)"); // if *end==0
  	}	
  strftime(buf, sizeof(buf), format, &tm);
+ check_strf_plan(format);
  printf("  strftime=>%s ",buf);
  if(tt==ignore_0)
  	{buf[sizeof(buf)-1]=0;// make sure buf is zero terminated
@@ -196,6 +398,7 @@ bool test(const char *string, const char *format,enum test_type tt) /* returns t
  ti=ya_mktime(&tm);// convert tm to a time_t, also "normalises" tm and sets other members (like day of week).
  tm.tm_isdst=-1; // make sure daylight savings time is not on
  strftime(buf, sizeof(buf), format, &tm);
+ check_strf_plan(format);
  // printf("  mktime()=>%s (ti=%.0f) ",buf,(double)ti);// convert ti to a double for display as we don't know what type it actually is
  printf("  mktime()=>%s (ti=%.0f) => ",buf,(double)ti); 
  display_tm();
@@ -262,6 +465,10 @@ int main(void)
  err_chk("+9999-12-31 23:59:59","%Y-%m-%d %H:%M:%S",ignore_plus);// value with +ve sign
  err_chk("391220960-11-12 18:31:01","%Y-%m-%d %H:%M:%S",good);// year max +ve  (+391220960)
  err_chk("-39171945-11-12 18:31:01","%Y-%m-%d %H:%M:%S",good);// year max-ve (-39171945 )
+ err_chk("-4-12-31 23:59:59","%Y-%m-%d %H:%M:%S",good);// -4 is a leap year (so is 366 days long)
+ err_chk("-5-12-31 23:59:59","%Y-%m-%d %H:%M:%S",good);// -5 is not a leap year
+ err_chk("-100-12-31 23:59:59","%Y-%m-%d %H:%M:%S",good);// -100 is not a leap year
+ err_chk("-400-12-31 23:59:59","%Y-%m-%d %H:%M:%S",good);// -400 is a leap year
  #endif 
  err_chk("2001-11-12 18:31:01","%Y-%m-%e %H:%M:%S",good);// use of %e instead of %d -> with tdm-gcc 10.3.0 strftime() does not seem to support %e even though its in c99 !
  err_chk("2001-11- 2 18:31:01","%Y-%m-%e %H:%M:%S",good);// use of %e instead of %d (%e has leading space for single digit numbers)
@@ -558,6 +765,958 @@ int main(void)
  err_chk("2001-11-12 18:31:01.1x","%Y-%m-%e %H:%M:%S.%f",bad);// x is not a digit
  // err_chk("2001-11-12 18:31:01.123456789012345678901234567890","%Y-%m-%e %H:%M:%S.%f",bad);// too many significant figures to be round loop exact [ cannot do this test as strptime() returns valid - as it is valid]
  
+ // check precompiled formats give identical results to strptime() for unusual formats, including ones that strptime() will reject
+ {const char *plan_tests[][2]={
+ 	{"+0500 18:31:01","%z %T"}, // composite specifier resets strp_tz (as strptime() makes a recursive call)
+ 	{"12 mon jan  1 12:31:01 2001","%U %c"},
+ 	{"2001 52 mon jan  1 12:31:01 2001","%Y %W %Ec"},
+ 	{"18:31:01.5 -0100","%T.%f %z"},
+ 	{"2021 52 sat 01/01/22","%G %V %a %D"},
+ 	{"12:3","%T"}, // input ends in the middle of a composite specifier
+ 	{"12:31:01","%T "}, // input ends before the format
+ 	{"","%H"},
+ 	{"12","%"},
+ 	{"12","%E"},
+ 	{"12","%Q"},
+ 	{"  12  ","%n%H%t"},
+ 	{"99/12/31x","%D"}
+ 	};
+  printf("checking precompiled formats:\n");
+  for(size_t i=0;i<sizeof(plan_tests)/sizeof(plan_tests[0]);++i)
+  	{nos_tests++;
+	 memset(&tm, 0, sizeof(struct tm));// zero all members of tm
+	 check_plan(plan_tests[i][0],plan_tests[i][1],strptime(plan_tests[i][0],plan_tests[i][1],&tm));
+	}
+ }
+ {const char *strf_plan_tests[]={"%Q","%","100%%","abc","%Ec %Ox %E","%c|%D|%T|%F|%r|%R|%x|%X","%+10Y %010C %+6G %012F %5Y %0200Y %+",
+ 	"%a %A %b %B %h %C %d %e %g %G %H %I %j %m %M %n %p %s %S %t %u %U %V %w %W %y %Y %z %Z %f"};
+  for(size_t i=0;i<sizeof(strf_plan_tests)/sizeof(strf_plan_tests[0]);++i)
+  	{for(int j=0;j<3;++j)
+  		{nos_tests++;
+  		 init_strp_tz(&strp_tz); 
+  		 memset(&tm, 0, sizeof(struct tm));// zero all members of tm
+  		 if(j==1)
+  		 	{// largest values in tm and strp_tz (to check strf_plan_max_width() )
+  		 	 tm.tm_year=INT_MIN; tm.tm_mon=INT_MIN; tm.tm_mday=INT_MAX; tm.tm_hour=INT_MIN; tm.tm_min=INT_MAX; tm.tm_sec=INT_MIN;
+  		 	 tm.tm_wday=INT_MAX; tm.tm_yday=INT_MAX-1; tm.tm_isdst=1;
+  		 	 strp_tz.tz_off_mins=INT_MIN; strp_tz.week_nos_U=INT_MIN; strp_tz.week_nos_V=INT_MIN; strp_tz.week_nos_W=INT_MIN; strp_tz.year_G=INT_MIN;
+  		 	 strp_tz.f_secs=0.123; strp_tz.f_secs_p10=200; memcpy(strp_tz.tz_name,"AKST",4);
+  		 	}
+  		 else if(j==2) 
+  		 	{tm.tm_year=INT_MAX; tm.tm_yday=-2; tm.tm_wday=-1; tm.tm_mon=12;
+			 strp_tz.f_secs=0.5; strp_tz.f_secs_p10=3;
+			}
+  		 check_strf_plan(strf_plan_tests[i]);
+  		}
+	}
+ }
+ {/* %f is stored as integer attoseconds (f_asecs) with the double f_secs derived from it, and strftime() outputs f_asecs exactly */
+  uint64_t x=UINT64_C(0x123456789abcdef);
+  const struct {const char *in,*out;} round_tests[]=
+  	{{"00.1234567890123456785","123456789012345679"}, // more than 18 digits are rounded to 18
+  	 {"00.1234567890123456784999","123456789012345678"},
+  	 {"00.9999999999999999999999","999999999999999999"}, // never rounds up to a whole second
+  	 {"00.0000000000000000005","000000000000000001"},
+  	 {"00.000000000000000000","000000000000000000"}
+  	};
+  printf("checking %%f as integer attoseconds:\n");
+  for(int i=0;i<100000;++i)
+  	{char in[32],out[32],ref[40];
+  	 struct tm tm_f;
+  	 struct strp_tz_struct tz_f;
+  	 int p10;
+  	 uint64_t digits,scale=1;
+  	 x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  	 p10=(int)(x%STRP_F_DIGITS)+1;
+  	 for(int j=0;j<p10;++j) scale*=10;
+  	 digits=(x>>8)%scale;
+  	 if((x>>60)==0) digits=scale-1; // all 9's
+  	 snprintf(in,sizeof(in),"00.%0*llu",p10,(unsigned long long)digits);
+  	 memset(&tm_f,0,sizeof(tm_f));
+  	 nos_tests++;
+  	 if(ya_strptime_r(in,"%S.%f",&tm_f,&tz_f)==NULL || ya_strftime_r(out,sizeof(out),"%f",&tm_f,&tz_f)==0 || strcmp(out,in+3)!=0 || tz_f.f_secs_p10!=p10 || 
+  	 	tz_f.f_asecs*scale!=digits*UINT64_C(1000000000000000000) || (p10<=15 && tz_f.f_secs!=strtod(in+2,NULL)))
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: %%f of \"%s\" gives f_asecs=%llu f_secs=%.17g p10=%d and outputs \"%s\"\n",in,(unsigned long long)tz_f.f_asecs,tz_f.f_secs,tz_f.f_secs_p10,out);
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	 if(p10<=15)
+  	 	{// 15 digits are round loop exact with a double, so the previous snprintf() version gives the same digits
+  	 	 snprintf(ref,sizeof(ref),"%0.*f",p10,tz_f.f_secs);
+  	 	 nos_tests++;
+  	 	 if(strcmp(out,ref+2)!=0)
+  	 	 	{++errs;
+  	 	 	 red_text();
+  	 	 	 printf("Error: %%f gives \"%s\" but snprintf() gives \"%s\"\n",out,ref);
+  	 	 	 normal_text();
+  	 	 	 break;
+  	 	 	}
+  	 	 tz_f.f_secs=0.5; // changing f_secs means strftime() has to use it rather than f_asecs
+  	 	 snprintf(ref,sizeof(ref),"%0.*f",p10,tz_f.f_secs);
+  	 	 nos_tests++;
+  	 	 if(ya_strftime_r(out,sizeof(out),"%f",&tm_f,&tz_f)==0 || strcmp(out,ref+2)!=0)
+  	 	 	{++errs;
+  	 	 	 red_text();
+  	 	 	 printf("Error: %%f gives \"%s\" after changing f_secs to 0.5, expected \"%s\"\n",out,ref+2);
+  	 	 	 normal_text();
+  	 	 	 break;
+  	 	 	}
+  	 	}
+  	}
+  for(size_t i=0;i<sizeof(round_tests)/sizeof(round_tests[0]);++i)
+  	{char out[32];
+  	 struct tm tm_f;
+  	 struct strp_tz_struct tz_f;
+  	 memset(&tm_f,0,sizeof(tm_f));
+  	 nos_tests++;
+  	 if(ya_strptime_r(round_tests[i].in,"%S.%f",&tm_f,&tz_f)==NULL || ya_strftime_r(out,sizeof(out),"%f",&tm_f,&tz_f)==0 || strcmp(out,round_tests[i].out)!=0)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: %%f of \"%s\" outputs \"%s\" expected \"%s\"\n",round_tests[i].in,out,round_tests[i].out);
+  	 	 normal_text();
+  	 	}
+  	}
+ }
+ {/* ISO 8601 timestamps use a fast path in ya_strptime_r() and ya_strptime_plan_r(), "%EY" is identical to "%Y" but does not use the fast path so compare the two */
+  const char *mutate="0123456789-:T .+Za";
+  uint64_t x=UINT64_C(2463534242);
+  printf("checking ISO 8601 fast path:\n");
+  for(int layout=0;layout<8;++layout)
+  	{char format[40],format_g[48];
+  	 struct strp_plan *plan,*plan_g;
+  	 snprintf(format,sizeof(format),"%%Y-%%m-%%d%c%%H:%%M:%%S%s%s",layout&1?' ':'T',layout&2?".%f":"",layout&4?"%z":"");
+  	 snprintf(format_g,sizeof(format_g),"%%E%s",format+1);
+  	 plan=strp_compile(format);
+  	 plan_g=strp_compile(format_g);
+  	 for(int i=0;i<100000;++i)
+  		{char str[64];
+  		 struct tm tm_f,tm_g,tm_pf,tm_pg;
+  		 struct strp_tz_struct tz_f,tz_g,tz_pf,tz_pg;
+  		 char *end_f,*end_g,*end_pf,*end_pg;
+  		 int len;
+  		 x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  		 len=snprintf(str,sizeof(str),"%04d-%02d-%02d%c%02d:%02d:%02d",(int)(x%10000),(int)((x>>14)%14),(int)((x>>18)%33),layout&1?' ':'T',
+  		 		(int)((x>>24)%25),(int)((x>>29)%61),(int)((x>>35)%62));
+  		 if(layout&2) len+=snprintf(str+len,sizeof(str)-(size_t)len,".%0*d",(int)((x>>41)%11)+1,(int)((x>>45)%1000)); // 1-11 digits
+  		 if(layout&4) len+=snprintf(str+len,sizeof(str)-(size_t)len,"%s%04d",(x>>55)%3==0?"-":(x>>55)%3==1?"+":"",(int)((x>>20)%2400));
+  		 x^=x<<13; x^=x>>7; x^=x<<17;
+  		 if(x%3==0) str[(x>>8)%(uint64_t)(len+1)]=mutate[(x>>16)%strlen(mutate)]; // change one character (possibly the null at the end)
+  		 else if(x%5==1) str[(x>>8)%(uint64_t)(len+1)]=0; // truncate
+  		 else if(x%7==2)
+  		 	{// insert a character
+  		 	 int pos=(int)((x>>8)%(uint64_t)(len+1));
+  		 	 memmove(str+pos+1,str+pos,(size_t)(len-pos+1));
+  		 	 str[pos]=mutate[(x>>16)%strlen(mutate)];
+  		 	}
+  		 memset(&tm_f,0x55,sizeof(tm_f)); // fields not set must not be changed
+  		 memset(&tm_g,0x55,sizeof(tm_g));
+  		 memset(&tm_pf,0x55,sizeof(tm_pf));
+  		 memset(&tm_pg,0x55,sizeof(tm_pg));
+  		 end_f=ya_strptime_r(str,format,&tm_f,&tz_f);
+  		 end_g=ya_strptime_r(str,format_g,&tm_g,&tz_g);
+  		 end_pf=ya_strptime_plan_r(str,plan,&tm_pf,&tz_pf);
+  		 end_pg=ya_strptime_plan_r(str,plan_g,&tm_pg,&tz_pg);
+  		 if(x%4==3)
+  		 	{// length bounded versions on (mostly) the first part of str, must match the generic version on a null terminated copy of it
+  		 	 char str_g[64];
+  		 	 size_t len=strlen(str);
+  		 	 len-=(x>>20)%(len+1)*((x>>30)%2);
+  		 	 memcpy(str_g,str,len);
+  		 	 str_g[len]=0;
+  		 	 memset(&tm_f,0x55,sizeof(tm_f));
+  		 	 memset(&tm_g,0x55,sizeof(tm_g));
+  		 	 memset(&tm_pf,0x55,sizeof(tm_pf));
+  		 	 end_f=ya_strptime_n_r(str,len,format,&tm_f,&tz_f);
+  		 	 end_pf=ya_strptime_plan_n_r(str,len,plan,&tm_pf,&tz_pf);
+  		 	 end_g=ya_strptime_r(str_g,format_g,&tm_g,&tz_g);
+  		 	 if(end_g!=NULL) end_g=str+(end_g-str_g);
+  		 	 end_pg=end_g;
+  		 	 tm_pg=tm_g;
+  		 	 tz_pg=tz_g;
+  		 	}
+  		 nos_tests++;
+  		 if(end_f!=end_g || end_pf!=end_g || end_pg!=end_g || !same_tm(&tm_f,&tm_g) || !same_tm(&tm_pf,&tm_g) || !same_tm(&tm_pg,&tm_g) ||
+  		 	!same_strp_tz(&tz_f,&tz_g) || !same_strp_tz(&tz_pf,&tz_g) || !same_strp_tz(&tz_pg,&tz_g))
+  		 	{++errs;
+  		 	 red_text();
+  		 	 printf("Error: ISO 8601 fast path gives a different result for \"%s\" format %s\n",str,format);
+  		 	 normal_text();
+  		 	 break;
+  		 	}
+  		}
+  	 strp_free_plan(plan);
+  	 strp_free_plan(plan_g);
+  	}
+ }
+ {/* month and weekday names are matched using a perfect hash, check the tables are what strp_name_table_init() creates and that results match a simple search */
+  struct strp_name_table t_w,t_m;
+  const struct strp_name_table *tabs[2]={&strp_weekday_table,&strp_month_table};
+  const char *chars="januaryfebmrchpilgstovdbwdhSUNDAYJLOCTMEBR-1 ";
+  uint64_t x=UINT64_C(88172645463325252);
+  printf("checking month and weekday name matching:\n");
+  nos_tests++;
+  if(!strp_name_table_init(&t_w,strp_weekdays,7) || !strp_name_table_init(&t_m,strp_monthnames,12) ||
+     t_w.mult!=strp_weekday_table.mult || memcmp(t_w.slot,strp_weekday_table.slot,sizeof(t_w.slot))!=0 || memcmp(t_w.key,strp_weekday_table.key,sizeof(t_w.key))!=0 ||
+     t_m.mult!=strp_month_table.mult || memcmp(t_m.slot,strp_month_table.slot,sizeof(t_m.slot))!=0 || memcmp(t_m.key,strp_month_table.key,sizeof(t_m.key))!=0)
+  	{++errs;
+  	 red_text();
+  	 printf("Error: strp_name_table_init() does not create the same tables as strp_weekday_table and strp_month_table\n");
+  	 normal_text();
+  	}
+  nos_tests++;
+  {const char *dup[]={"march","marching"},*bad[]={"may","jun3"},*shrt[]={"may","ju"};
+   if(strp_name_table_init(&t_w,dup,2) || strp_name_table_init(&t_w,bad,2) || strp_name_table_init(&t_w,shrt,2))
+  	{++errs;
+  	 red_text();
+  	 printf("Error: strp_name_table_init() accepted invalid names\n");
+  	 normal_text();
+  	}
+  }
+  for(int i=0;i<200000;++i)
+  	{char buf[16];
+  	 const struct strp_name_table *nt=tabs[i&1];
+  	 const char *s=buf,*s_ref=buf;
+  	 int r,r_ref=-1;
+  	 size_t len;
+  	 x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  	 if(i%4<2)
+  	 	{// a name, possibly truncated with random case and trailing characters
+  	 	 const char *name=nt->names[(x>>8)%nt->n];
+  	 	 len=strlen(name);
+  	 	 if((x>>16)%3==0) len=(size_t)((x>>20)%(len+1));
+  	 	 for(size_t j=0;j<len;++j)
+  	 	 	buf[j]=(x>>(24+j))&1 ? (char)toupper(name[j]) : name[j];
+  	 	 buf[len]=0;
+  	 	 if((x>>40)%2) strcat(buf,(x>>41)%2?"s":"7");
+  	 	}
+  	 else
+  	 	{// random characters from names (and some others)
+  	 	 len=(size_t)((x>>8)%12);
+  	 	 for(size_t j=0;j<len;++j)
+  	 	 	buf[j]=chars[(x>>(12+4*(j%12)))%strlen(chars)];
+  	 	 buf[len]=0;
+  	 	}
+  	 r=strp_name_match(nt,&s);
+  	 for(int j=0;j<nt->n;++j) // the way strptime() used to match names
+  	 	{len=strlen(nt->names[j]);
+  	 	 if(!strnicmp(nt->names[j],s_ref,len)) {r_ref=j; s_ref+=len; break;}
+  	 	 else if(!strnicmp(nt->names[j],s_ref,3)) {r_ref=j; s_ref+=3; break;}
+  	 	}
+  	 nos_tests++;
+  	 if(r!=r_ref || s!=s_ref)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: strp_name_match(\"%s\") gives %d (%d characters) expected %d (%d characters)\n",buf,r,(int)(s-buf),r_ref,(int)(s_ref-buf));
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	}
+ }
+ {/* zone abbreviations for %Z, check the built in table is what strp_abbrev_table_init() creates, lookups match a simple search and %Z sets tz_off_mins */
+  struct strp_abbrev_table t;
+  static const struct strp_abbrev local_abbrevs[]={{"IST",60},{"cst",480},{"XYZ",-30}}; // Irish Standard Time, China Standard Time and a made up one
+  const char *chars="ESTDCMPAKGUTZzyxqestb5";
+  uint64_t x=UINT64_C(88172645463325252);
+  int n=strp_abbrev_table.n;
+  printf("checking zone abbreviations:\n");
+  nos_tests++;
+  if(!strp_abbrev_table_init(&t,strp_abbrevs,n) || t.n!=n || t.mult!=strp_abbrev_table.mult || memcmp(t.slot,strp_abbrev_table.slot,sizeof(t.slot))!=0 ||
+     memcmp(t.key,strp_abbrev_table.key,sizeof(t.key))!=0 || memcmp(t.off_mins,strp_abbrev_table.off_mins,sizeof(t.off_mins))!=0)
+  	{++errs;
+  	 red_text();
+  	 printf("Error: strp_abbrev_table_init() does not create the same table as strp_abbrev_table\n");
+  	 normal_text();
+  	}
+  nos_tests++;
+  {const struct strp_abbrev dup[]={{"EST",-300},{"est",-300}},bad[]={{"EST",-300},{"E5T",0}},shrt[]={{"E",0}},lng[]={{"ABCDE",0}},off[]={{"ABC",24*60}},null[]={{NULL,0}};
+   if(strp_abbrev_table_init(&t,dup,2) || strp_abbrev_table_init(&t,bad,2) || strp_abbrev_table_init(&t,shrt,1) || strp_abbrev_table_init(&t,lng,1) ||
+      strp_abbrev_table_init(&t,off,1) || strp_abbrev_table_init(&t,null,1) || strp_abbrev_table_init(&t,strp_abbrevs,0) || strp_abbrev_table_init(&t,strp_abbrevs,STRP_ABBREV_MAX+1))
+  	{++errs;
+  	 red_text();
+  	 printf("Error: strp_abbrev_table_init() accepted invalid abbreviations\n");
+  	 normal_text();
+  	}
+  }
+  for(int i=0;i<200000;++i)
+  	{char buf[8];
+  	 size_t len;
+  	 int r=12345,r_ref=12345;
+  	 bool found,found_ref=false;
+  	 x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  	 if(i%2)
+  	 	{// an abbreviation with random case, sometimes with a letter added or removed
+  	 	 const char *name=strp_abbrevs[(x>>8)%n].name;
+  	 	 len=strlen(name);
+  	 	 for(size_t j=0;j<len;++j)
+  	 	 	buf[j]=(x>>(24+j))&1 ? (char)toupper(name[j]) : (char)tolower(name[j]);
+  	 	 if((x>>32)%4==0) --len;
+  	 	  else if((x>>32)%4==1) buf[len++]='T';
+  	 	 buf[len]=0;
+  	 	}
+  	 else
+  	 	{// random characters
+  	 	 len=(size_t)((x>>8)%6);
+  	 	 for(size_t j=0;j<len;++j)
+  	 	 	buf[j]=chars[(x>>(12+5*j))%strlen(chars)];
+  	 	 buf[len]=0;
+  	 	}
+  	 found=strp_abbrev_lookup(&strp_abbrev_table,buf,&r);
+  	 for(int j=0;j<n;++j)
+  	 	if(strlen(strp_abbrevs[j].name)==len && !strnicmp(strp_abbrevs[j].name,buf,len))
+  	 		{found_ref=true;
+  	 		 r_ref=strp_abbrevs[j].off_mins;
+  	 		 break;
+  	 		}
+  	 nos_tests++;
+  	 if(found!=found_ref || r!=r_ref)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: strp_abbrev_lookup(\"%s\") gives %d (%d) expected %d (%d)\n",buf,(int)found,r,(int)found_ref,r_ref);
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	}
+  for(int i=0;i<n;++i)
+  	{// every abbreviation sets tz_off_mins (and is remembered in tz_name) whatever its case
+  	 char str[40],name[5]={0};
+  	 struct tm tm;
+  	 struct strp_tz_struct tz;
+  	 const char *r;
+  	 for(size_t j=0;strp_abbrevs[i].name[j];++j)
+  	 	name[j]=(char)(i%2 ? tolower(strp_abbrevs[i].name[j]) : toupper(strp_abbrevs[i].name[j]));
+  	 snprintf(str,sizeof(str),"2021-06-01 12:00:00 %s",name);
+  	 memset(&tm,0,sizeof(tm));
+  	 r=ya_strptime_r(str,"%Y-%m-%d %H:%M:%S %Z",&tm,&tz);
+  	 nos_tests++;
+  	 if(r==NULL || *r || tz.tz_off_mins!=strp_abbrevs[i].off_mins || strncmp(tz.tz_name,name,4)!=0 || UTC_mktime(&tm,&tz)!=1622548800-60*strp_abbrevs[i].off_mins)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: ya_strptime_r(\"%s\") gave tz_off_mins=%d expected %d\n",str,tz.tz_off_mins,strp_abbrevs[i].off_mins);
+  	 	 normal_text();
+  	 	}
+  	}
+  {/* unknown names stay unknown, %z is never replaced by %Z, overriding tables given for a call (format, plan, multi and stream) or to a cache */
+   struct {const char *s; const char *format; bool local; int off; const char *name;} checks[]=
+   	{{"ET","%Z",false,strp_tz_default,"ET"},{"XYZ","%Z",false,strp_tz_default,"XYZ"},{"ChST","%Z",false,600,"ChST"},
+   	 {"+0500 EST","%z %Z",false,300,"EST"},{"EST +0500","%Z %z",false,300,"EST"},{"-0000 BST","%z %Z",false,0,"BST"},
+   	 {"CEST UT","%Z %Z",false,120,"UT"},{"UT CEST","%Z %Z",false,0,"CEST"},
+   	 {"IST","%Z",false,strp_tz_default,"IST"},{"IST","%Z",true,60,"IST"},{"Cst","%Z",false,strp_tz_default,"Cst"},{"cST","%Z",true,480,"cST"},
+   	 {"XYZ","%Z",true,-30,"XYZ"},{"EST","%Z",true,-300,"EST"},{"ET","%Z",true,strp_tz_default,"ET"},{"+0100 IST","%z %Z",true,60,"IST"},
+   	 {"PST","%Z",false,strp_tz_default,"PST"},{"cdt","%Z",true,strp_tz_default,"cdt"} // ambiguous, so not in the built in table
+   	};
+   nos_tests++;
+   if(!strp_abbrev_table_init(&t,local_abbrevs,3))
+   	{++errs;
+   	 red_text();
+   	 printf("Error: strp_abbrev_table_init() failed for a valid table\n");
+   	 normal_text();
+   	}
+   for(size_t i=0;i<sizeof(checks)/sizeof(checks[0]);++i)
+   	{struct strp_plan *plan=strp_compile(checks[i].format);
+   	 struct strp_multi *m=strp_multi_compile(&checks[i].format,1,false);
+   	 struct strp_cache *c=strp_cache_create(checks[i].format);
+   	 struct strp_stream *ss;
+   	 struct strp_epoch ep,ep_c;
+   	 struct tm tm,tm_p,tm_m,tm_s,tm_b;
+   	 struct strp_tz_struct tz,tz_p,tz_m,tz_s,tz_b,tz_bp;
+   	 const struct strp_abbrev_table *table= checks[i].local ? &t : NULL;
+   	 size_t len=strlen(checks[i].s);
+   	 int which;
+   	 size_t used;
+   	 bool ok;
+   	 if(plan==NULL || m==NULL || c==NULL) {printf("Out of memory\n"); exit(1);}
+   	 ya_strptime_cached(checks[i].s,c,&ep_c); // so the cache has to forget this result when given the table below
+   	 if(checks[i].local) strp_cache_set_abbrevs(c,&t);
+   	 ss=strp_stream_create(plan);
+   	 if(ss==NULL) {printf("Out of memory\n"); exit(1);}
+   	 memset(&tm,0,sizeof(tm));
+   	 memset(&tm_p,0,sizeof(tm_p));
+   	 memset(&tm_m,0,sizeof(tm_m));
+   	 memset(&tm_s,0,sizeof(tm_s));
+   	 ok=ya_strptime_plan_n_abbrevs_r(checks[i].s,len,plan,&tm_p,&tz_p,table)!=NULL && ya_strptime_multi_n_abbrevs_r(checks[i].s,len,m,&tm_m,&tz_m,&which,table)!=NULL &&
+   	    ya_strptime_cached(checks[i].s,c,&ep_c)!=NULL && ya_strptime_n_abbrevs_r(checks[i].s,len,checks[i].format,&tm,&tz,table)!=NULL;
+   	 strp_stream_begin_abbrevs(ss,&tm_s,&tz_s,table);
+   	 strp_stream_feed(ss,checks[i].s,len,&used);
+   	 ok=ok && strp_stream_end(ss)==STRP_STREAM_DONE;
+   	 if(!checks[i].local) ok=ok && ya_strptime_plan_epoch(checks[i].s,plan,&ep)!=NULL && ep.tz_off_mins==checks[i].off; // no table can be given
+   	 // the plan is not changed by being used with a table, so without one it gives the same result as ya_strptime_r() (the built in table only)
+   	 memset(&tm_b,0,sizeof(tm_b));
+   	 ok=ok && ya_strptime_r(checks[i].s,checks[i].format,&tm_b,&tz_b)!=NULL && ya_strptime_plan_r(checks[i].s,plan,&tm_b,&tz_bp)!=NULL && tz_b.tz_off_mins==tz_bp.tz_off_mins;
+   	 nos_tests++;
+   	 if(!ok || tz_p.tz_off_mins!=checks[i].off || strncmp(tz_p.tz_name,checks[i].name,4)!=0 || tz_m.tz_off_mins!=checks[i].off || tz.tz_off_mins!=checks[i].off ||
+   	    tz_s.tz_off_mins!=checks[i].off || ep_c.tz_off_mins!=checks[i].off)
+   	 	{++errs;
+   	 	 red_text();
+   	 	 printf("Error: \"%s\" with format \"%s\"%s gave tz_off_mins=%d (format %d, multi %d, stream %d, cached %d) expected %d\n",checks[i].s,checks[i].format,
+   	 	        checks[i].local?" and a local table":"",tz_p.tz_off_mins,tz.tz_off_mins,tz_m.tz_off_mins,tz_s.tz_off_mins,ep_c.tz_off_mins,checks[i].off);
+   	 	 normal_text();
+   	 	}
+   	 strp_stream_free(ss);
+   	 strp_cache_free(c);
+   	 strp_multi_free(m);
+   	 strp_free_plan(plan);
+   	}
+  }
+ }
+ {/* multiple formats, the result must be that of the 1st format in the list that matches (or with adaptive ordering of any format that matches) */
+  const char *formats[]={"%Y-%m-%d","%a, %d %b %Y %H:%M:%S %z","%d/%m/%Y %H:%M","%Y-%m-%dT%H:%M:%S.%f","%H:%M:%S","%s","%e-%b-%Y"," %Y%m%d%n","%b %e %H:%M:%S"};
+  const int nf=(int)(sizeof(formats)/sizeof(formats[0]));
+  const char *mutate="0123456789-:/T .,+aMJ";
+  struct strp_multi *m=strp_multi_compile(formats,nf,false),*ma=strp_multi_compile(formats,nf,true);
+  struct strp_tz_struct tz_gen;
+  uint64_t x=UINT64_C(88172645463325252);
+  int order[9];
+  printf("checking multi-format matching:\n");
+  init_strp_tz(&tz_gen);
+  for(int i=0;i<200000;++i)
+  	{char str[80];
+  	 struct tm tm_gen,tm_m,tm_a,tm_f[9];
+  	 struct strp_tz_struct tz_m,tz_a,tz_f[9];
+  	 char *end_m,*end_a,*end_f[9];
+  	 int k,which_m,which_a,first= -1;
+  	 size_t len;
+  	 x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  	 k=i<50000 && x%10!=0 ? 1 : (int)((x>>4)%(uint64_t)nf); // mostly format 1 at first so adaptive ordering should move it to the front
+  	 memset(&tm_gen,0,sizeof(tm_gen));
+  	 tm_gen.tm_year=(int)((x>>8)%300);
+  	 tm_gen.tm_mon=(int)((x>>17)%12);
+  	 tm_gen.tm_mday=(int)((x>>21)%28)+1;
+  	 tm_gen.tm_hour=(int)((x>>26)%24);
+  	 tm_gen.tm_min=(int)((x>>31)%60);
+  	 tm_gen.tm_sec=(int)((x>>37)%60);
+  	 tm_gen.tm_wday=day_of_week(tm_gen.tm_year+1900,tm_gen.tm_mon,tm_gen.tm_mday);
+  	 tz_gen.tz_off_mins=(int)((x>>43)%1440)-720;
+  	 tz_gen.f_secs=0.5;
+  	 tz_gen.f_secs_p10=(int)((x>>55)%3)+1;
+  	 tz_gen.f_asecs=UINT64_C(500000000000000000);
+  	 len=ya_strftime_r(str,sizeof(str)-1,formats[k],&tm_gen,&tz_gen);
+  	 x^=x<<13; x^=x>>7; x^=x<<17;
+  	 if(x%3==0) str[(x>>8)%(len+1)]=mutate[(x>>16)%strlen(mutate)]; // change one character (possibly the null at the end)
+  	 else if(x%5==1) str[(x>>8)%(len+1)]=0; // truncate
+  	 else if(x%7==2)
+  	 	{// insert a character
+  	 	 size_t pos=(x>>8)%(len+1);
+  	 	 memmove(str+pos+1,str+pos,len-pos+1);
+  	 	 str[pos]=mutate[(x>>16)%strlen(mutate)];
+  	 	}
+  	 if((x>>24)%8==0)
+  	 	for(char *p=str;*p;++p) *p=(char)tolower(*p); // names are matched ignoring case
+  	 for(int j=0;j<nf;++j)
+  	 	{memset(&tm_f[j],0x55,sizeof(tm_f[j])); // fields not set must not be changed
+  	 	 end_f[j]=ya_strptime_r(str,formats[j],&tm_f[j],&tz_f[j]);
+  	 	 if(end_f[j]!=NULL && first<0) first=j;
+  	 	}
+  	 memset(&tm_m,0x55,sizeof(tm_m));
+  	 memset(&tm_a,0x55,sizeof(tm_a));
+  	 if(x%4==3)
+  	 	{// length bounded versions, only the 1st len characters of str can be used
+  	 	 len=strlen(str);
+  	 	 end_m=ya_strptime_multi_n_r(str,len,m,&tm_m,&tz_m,&which_m);
+  	 	 end_a=ya_strptime_multi_n_r(str,len,ma,&tm_a,&tz_a,&which_a);
+  	 	}
+  	 else
+  	 	{end_m=ya_strptime_multi_r(str,m,&tm_m,&tz_m,&which_m);
+  	 	 end_a=ya_strptime_multi_r(str,ma,&tm_a,&tz_a,&which_a);
+  	 	}
+  	 nos_tests++;
+  	 if(which_m!=first || (first<0 ? end_m!=NULL : end_m!=end_f[first] || !same_tm(&tm_m,&tm_f[first]) || !same_strp_tz(&tz_m,&tz_f[first])))
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: ya_strptime_multi_r() gives format %d for \"%s\" expected %d\n",which_m,str,first);
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	 nos_tests++;
+  	 if(first<0 ? which_a!=-1 || end_a!=NULL : which_a<0 || end_f[which_a]==NULL || end_a!=end_f[which_a] || !same_tm(&tm_a,&tm_f[which_a]) || !same_strp_tz(&tz_a,&tz_f[which_a]))
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: ya_strptime_multi_r() with adaptive ordering gives format %d for \"%s\" which does not match\n",which_a,str);
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	 if(i==49999)
+  	 	{// format 1 has matched most often, so should now be tried 1st. Without adaptive ordering the order must not change
+  	 	 int order_m[9];
+  	 	 bool seen[9]={false};
+  	 	 nos_tests++;
+  	 	 if(strp_multi_order(ma,order)!=nf || strp_multi_order(m,order_m)!=nf || order[0]!=1)
+  	 	 	{++errs;
+  	 	 	 red_text();
+  	 	 	 printf("Error: strp_multi_order() gives format %d 1st expected 1\n",order[0]);
+  	 	 	 normal_text();
+  	 	 	}
+  	 	 for(int j=0;j<nf;++j)
+  	 	 	{nos_tests++;
+  	 	 	 if(order_m[j]!=j || order[j]<0 || order[j]>=nf || seen[order[j]])
+  	 	 	 	{++errs;
+  	 	 	 	 red_text();
+  	 	 	 	 printf("Error: strp_multi_order() position %d gives %d (%d without adaptive ordering)\n",j,order[j],order_m[j]);
+  	 	 	 	 normal_text();
+  	 	 	 	}
+  	 	 	 else seen[order[j]]=true;
+  	 	 	}
+  	 	}
+  	}
+  strp_multi_free(m);
+  strp_multi_free(ma);
+ }
+ {/* format inference, known results for strings from the tests above and then samples created with ya_strftime_r() for a corpus of formats */
+  const char *known[][2]={{"2001-11-12 18:31:01","%Y-%m-%d %H:%M:%S"},{"2001-Jan-12 18:31:01","%Y-%b-%d %H:%M:%S"},{"2001-January-12 18:31:01","%Y-%B-%d %H:%M:%S"},
+  	{"2001-11- 2 18:31:01","%Y-%m-%e %H:%M:%S"},{"2001-11-12 06:31:01 pm","%Y-%m-%d %I:%M:%S %p"},{"2001-11-12 06:31:01am","%Y-%m-%d %I:%M:%S%p"},
+  	{"2001-11-12 18:31:01.123","%Y-%m-%d %H:%M:%S.%f"},{"1005553861","%s"},{"Monday","%A"},{"+0100","%z"},{"EST",""},{"2001-11-12 18:31:01 EST","%Y-%m-%d %H:%M:%S %Z"},
+  	{"2001-11-12T18:31:01Z","%Y-%m-%dT%H:%M:%SZ"},{"Mon, 12 Nov 2001 18:31:01 +0000","%a, %d %b %Y %H:%M:%S %z"},{"Mon Nov 12 18:31:01 2001","%a %b %d %H:%M:%S %Y"},
+  	{"12/Nov/2001:18:31:01 -0500","%d/%b/%Y:%H:%M:%S %z"},{"2001-W46-1","%G-W%V-%u"},{"2001-316","%Y-%j"},{"11/12/01","%m/%d/%y"},{"13/12/01","%d/%m/%y"},
+  	{"12.11.2001","%d.%m.%Y"},{"Nov  2 18:31:01","%b %e %H:%M:%S"},{"31%","%d%%"},{"18:31:01 x","%H:%M:%S x"},{"",""},{"12 13 14",""}};
+  const char *corpus[]={"%Y-%m-%d %H:%M:%S","%Y-%b-%d %H:%M:%S","%Y-%B-%d %H:%M:%S","%Y-%m-%e %H:%M:%S.%f","%Y-%m-%d %I:%M:%S %p","%Y-%m-%d %I:%M:%S%p",
+  	"%s","%T","%R","%r","%D","%F","%c","%x","%z","%A %B %d %Y","%Y-%m-%dT%H:%M:%S.%f%z","%a, %d %b %Y %H:%M:%S %z","%d/%b/%Y:%H:%M:%S %z",
+  	"%G-W%V-%u","%Y-%j","%b %e %H:%M:%S","%Y-%m-%d %H:%M:%S %Z","%s.%f","%d.%m.%Y %H:%M"};
+  const char *zones[]={"EST","PDT","UTC","AKST","GMT","CET"};
+  uint64_t x=UINT64_C(88172645463325252);
+  char inferred[STRP_INFER_FORMAT_SIZE],again[STRP_INFER_FORMAT_SIZE];
+  printf("checking format inference:\n");
+  for(size_t i=0;i<sizeof(known)/sizeof(known[0]);++i)
+  	{const char *s=known[i][0];
+  	 int r=strp_infer_format(&s,1,inferred,sizeof(inferred));
+  	 nos_tests++;
+  	 if(strcmp(inferred,known[i][1])!=0 || r!=(known[i][1][0]!=0))
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: strp_infer_format(\"%s\") gives \"%s\" (matches %d) expected \"%s\"\n",s,inferred,r,known[i][1]);
+  	 	 normal_text();
+  	 	}
+  	}
+  for(size_t f=0;f<sizeof(corpus)/sizeof(corpus[0]);++f)
+  	for(int rep=0;rep<20;++rep)
+  		{char strs[20][80];
+  		 const char *samples[21];
+  		 int n=1+rep,r;
+  		 for(int i=0;i<n;++i)
+  		 	{struct tm tm_gen;
+  		 	 struct strp_tz_struct tz_gen;
+  		 	 x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  		 	 sec_to_tm((time_t)(INT64_C(1000000000)+(int64_t)(x%UINT64_C(3100000000))),&tm_gen); // 2001 to 2099
+  		 	 init_strp_tz(&tz_gen);
+  		 	 tz_gen.tz_off_mins=(int)((x>>32)%1440)-720;
+  		 	 strcpy(tz_gen.tz_name,zones[(x>>44)%6]); // tz_name has space for 4 characters and the null
+  		 	 tz_gen.f_secs_p10=(int)((x>>48)%9)+1;
+  		 	 tz_gen.f_asecs=(x>>20)%1000000000*UINT64_C(1000000000); // only the 1st f_secs_p10 digits are output
+  		 	 {uint64_t unit=UINT64_C(1000000000000000000);
+  		 	  for(int k=0;k<tz_gen.f_secs_p10;++k) unit/=10;
+  		 	  tz_gen.f_asecs-=tz_gen.f_asecs%unit;
+  		 	 }
+  		 	 tz_gen.f_secs=(double)tz_gen.f_asecs/1e18;
+  		 	 ya_strftime_r(strs[i],sizeof(strs[i]),corpus[f],&tm_gen,&tz_gen);
+  		 	 samples[i]=strs[i];
+  		 	}
+  		 r=strp_infer_format(samples,n,inferred,sizeof(inferred));
+  		 nos_tests++;
+  		 if(r!=n || strp_infer_format(samples,n,again,sizeof(again))!=n || strcmp(inferred,again)!=0)
+  		 	{++errs;
+  		 	 red_text();
+  		 	 printf("Error: strp_infer_format() for %d samples of format %s (eg \"%s\") gives \"%s\" matching %d\n",n,corpus[f],strs[0],inferred,r);
+  		 	 normal_text();
+  		 	 break;
+  		 	}
+  		 for(int i=0;i<n;++i)
+  		 	{// the inferred format must give the same results as the one used to create the samples
+  		 	 struct tm tm_c,tm_i;
+  		 	 struct strp_tz_struct tz_c,tz_i;
+  		 	 char *end_c,*end_i;
+  		 	 memset(&tm_c,0,sizeof(tm_c));
+  		 	 memset(&tm_i,0,sizeof(tm_i));
+  		 	 end_c=ya_strptime_r(samples[i],corpus[f],&tm_c,&tz_c);
+  		 	 end_i=ya_strptime_r(samples[i],inferred,&tm_i,&tz_i);
+  		 	 nos_tests++;
+  		 	 if(end_c!=end_i || !same_tm(&tm_c,&tm_i) || !same_strp_tz(&tz_c,&tz_i))
+  		 	 	{++errs;
+  		 	 	 red_text();
+  		 	 	 printf("Error: inferred format %s gives a different result to %s for \"%s\"\n",inferred,corpus[f],samples[i]);
+  		 	 	 normal_text();
+  		 	 	 break;
+  		 	 	}
+  		 	}
+  		 if(rep==19)
+  		 	{// a line in a different format does not change the result (the majority wins)
+  		 	 samples[n]="Nov 12 2001";
+  		 	 nos_tests++;
+  		 	 if(strp_infer_format(samples,n+1,again,sizeof(again))!=n || strcmp(inferred,again)!=0)
+  		 	 	{++errs;
+  		 	 	 red_text();
+  		 	 	 printf("Error: strp_infer_format() for format %s gives \"%s\" with an extra line, expected \"%s\"\n",corpus[f],again,inferred);
+  		 	 	 normal_text();
+  		 	 	}
+  		 	}
+  		}
+  {// auto parser, the 1st line is ambiguous (so month 1st is assumed) until a line with a day over 12 is seen, then the format is compiled after 5 lines in a row match
+   const char *lines[]={"03/04/2021 10:00","junk","25/04/2021 10:01","26/04/2021 10:02","27/04/2021 10:03","28/04/2021 10:04","01/05/2021 10:05","02/05/2021 10:06"};
+   const char *formats[]={"%m/%d/%Y %H:%M",NULL,"%d/%m/%Y %H:%M","%d/%m/%Y %H:%M","%d/%m/%Y %H:%M","%d/%m/%Y %H:%M","%d/%m/%Y %H:%M","%d/%m/%Y %H:%M"};
+   const bool confirmed[]={false,false,false,false,false,false,true,true};
+   struct strp_auto *a=strp_auto_create(5);
+   for(size_t i=0;i<sizeof(lines)/sizeof(lines[0]);++i)
+   	{struct tm tm_a,tm_c;
+   	 struct strp_tz_struct tz_a,tz_c;
+   	 char *end_a,*end_c=NULL;
+   	 const char *format;
+   	 memset(&tm_a,0,sizeof(tm_a));
+   	 memset(&tm_c,0,sizeof(tm_c));
+   	 end_a=ya_strptime_auto_r(lines[i],a,&tm_a,&tz_a);
+   	 if(formats[i]!=NULL) end_c=ya_strptime_r(lines[i],formats[i],&tm_c,&tz_c);
+   	 format=strp_auto_format(a);
+   	 nos_tests++;
+   	 if(end_a!=end_c || (end_c!=NULL && (!same_tm(&tm_a,&tm_c) || !same_strp_tz(&tz_a,&tz_c))) || format==NULL ||
+   	 	(formats[i]!=NULL && strcmp(format,formats[i])!=0) || strp_auto_confirmed(a)!=confirmed[i])
+   	 	{++errs;
+   	 	 red_text();
+   	 	 printf("Error: ya_strptime_auto_r() for line %d \"%s\" uses format \"%s\" (confirmed=%d)\n",(int)i,lines[i],format==NULL?"":format,strp_auto_confirmed(a));
+   	 	 normal_text();
+   	 	}
+   	}
+   {// a line that only starts with a match fails (both before and after the format is confirmed), this one is too long to infer a new format from
+    struct strp_auto *b=strp_auto_create(5);
+    struct tm tm_a;
+    struct strp_tz_struct tz_a;
+    const char *line="03/05/2021 10:07 followed by more text than ya_strptime_auto_r() keeps to infer a format from";
+    char *end_a,*end_b;
+    memset(&tm_a,0,sizeof(tm_a));
+    ya_strptime_auto_r("25/04/2021 10:01",b,&tm_a,&tz_a); // not confirmed
+    end_a=ya_strptime_auto_r(line,a,&tm_a,&tz_a);
+    end_b=ya_strptime_auto_r(line,b,&tm_a,&tz_a);
+    nos_tests++;
+    if(end_a!=NULL || end_b!=NULL || !strp_auto_confirmed(a) || strp_auto_confirmed(b))
+    	{++errs;
+    	 red_text();
+    	 printf("Error: ya_strptime_auto_r() matched part of \"%s\"\n",line);
+    	 normal_text();
+    	}
+    strp_auto_free(b);
+   }
+   strp_auto_free(a);
+  }
+ }
+ {/* streaming input, fields longer than strp_stream_feed() keeps, names that give back characters and a log read in chunks of random sizes */
+  const char *cases[][2]={{"000000000000000000000000000000000000000000000001000000000","%s"},{"-0000000000000000000000000000000000000000000000000002021-1-1","%Y-%m-%d"},
+  	{"12.123456789012345678901234567890","%H.%f"},{"12.000000000000000000500000000000","%H.%f"},{"+000000000000000000000000000000000000000000100","%z"},
+  	{"Janu","%b"},{"Janux","%bux"},{"Septembe","%Bmbe"},{"Mondayy","%Ay"},{"12 am","%I %p"},{"x","%p"},{" 5","%e"},{"5x","%ex"},{"%","%%"},{"1","%Q"},{"1","%"},
+  	{"210315","%y%m%d"},{"20210315","%Y%m%d"},{"2021","%C%y"},{"2021530","%G%V%u"},{"5310","%w%U%W"}};
+  char log[4096];
+  size_t len=0,pos=0,line_start=0;
+  uint64_t x=UINT64_C(88172645463325252);
+  int lines=0,line=0;
+  struct strp_plan *plan=strp_compile("%Y-%m-%dT%H:%M:%S.%f%z");
+  struct strp_stream *ss=strp_stream_create(plan);
+  struct tm tm_s;
+  struct strp_tz_struct tz_s;
+  printf("checking streaming input:\n");
+  for(size_t i=0;i<sizeof(cases)/sizeof(cases[0]);++i)
+  	{nos_tests++;
+  	 memset(&tm,0,sizeof(struct tm));
+  	 check_plan(cases[i][0],cases[i][1],strptime(cases[i][0],cases[i][1],&tm)); // includes splitting into fragments
+  	}
+  while(len<sizeof(log)-100)
+  	{// lines of timestamps followed by a message
+  	 struct tm tm_gen;
+  	 x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  	 sec_to_tm((time_t)(x%UINT64_C(4102444800)),&tm_gen);
+  	 len+=(size_t)snprintf(log+len,sizeof(log)-len,"%04d-%02d-%02dT%02d:%02d:%02d.%0*d%c%04d message %d\n",tm_gen.tm_year+1900,tm_gen.tm_mon+1,tm_gen.tm_mday,
+  	 	tm_gen.tm_hour,tm_gen.tm_min,tm_gen.tm_sec,(int)((x>>32)%9)+1,(int)((x>>40)%1000),(x>>50)%2?'+':'-',(int)((x>>20)%1400),lines++);
+  	}
+  memset(&tm_s,0,sizeof(tm_s));
+  strp_stream_begin(ss,&tm_s,&tz_s);
+  while(pos<len && ss!=NULL)
+  	{// read the log in chunks of 1-32 characters, each timestamp is parsed from the chunks it is in without being copied
+  	 size_t chunk,used;
+  	 enum strp_stream_status status;
+  	 x^=x<<13; x^=x>>7; x^=x<<17;
+  	 chunk=(size_t)(x%32)+1;
+  	 if(chunk>len-pos) chunk=len-pos;
+  	 if(line_start>pos) 
+  	 	{// skip the rest of the line
+  	 	 pos= line_start<pos+chunk ? line_start : pos+chunk;
+  	 	 continue;
+  	 	}
+  	 status=strp_stream_feed(ss,log+pos,chunk,&used);
+  	 if(status==STRP_STREAM_MORE) 
+  	 	{pos+=chunk;
+  	 	 continue;
+  	 	}
+  	 {struct tm tm_r;
+  	  struct strp_tz_struct tz_r;
+  	  char *end_r;
+  	  memset(&tm_r,0,sizeof(tm_r));
+  	  end_r=ya_strptime_r(log+line_start,"%Y-%m-%dT%H:%M:%S.%f%z",&tm_r,&tz_r);
+  	  nos_tests++;
+  	  if(status!=STRP_STREAM_DONE || end_r!=log+pos+used || end_r!=log+line_start+strp_stream_length(ss) || !same_tm(&tm_r,&tm_s) || !same_strp_tz(&tz_r,&tz_s))
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: strp_stream_feed() gives a different result for line %d of a log read in chunks\n",line);
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	 }
+  	 line_start=(size_t)(strchr(log+pos+used,'\n')+1-log); // next line
+  	 pos+=used;
+  	 ++line;
+  	 memset(&tm_s,0,sizeof(tm_s));
+  	 strp_stream_begin(ss,&tm_s,&tz_s);
+  	}
+  nos_tests++;
+  if(line!=lines)
+  	{++errs;
+  	 red_text();
+  	 printf("Error: strp_stream_feed() found %d timestamps in a log read in chunks, expected %d\n",line,lines);
+  	 normal_text();
+  	}
+  strp_stream_free(ss);
+  strp_free_plan(plan);
+ }
+ {/* cached parsing, logs with a line every 0-1.5 secs (so most lines only differ in the last few characters) with some lines changed or in another format */
+  const char *formats[]={"%Y-%m-%dT%H:%M:%S.%f%z","%d/%b/%Y:%H:%M:%S %z","%b %e %H:%M:%S","%a %b %e %H:%M:%S.%f %Y","%F %T","%D %r","%s","%A, %d %B %Y %H:%M:%S %Z","%Y %j %H%M%S.%f",
+  	 "[%d/%b/%Y:%H:%M:%S %z]","request from a host somewhere on the network received at %H:%M:%S.%f on %d/%m/%Y"}; // the last is longer than the characters kept
+  uint64_t x=UINT64_C(88172645463325252);
+  printf("checking cached parsing:\n");
+  for(size_t i=0;i<sizeof(formats)/sizeof(formats[0]);++i)
+  	{struct strp_cache *cache=strp_cache_create(formats[i]);
+  	 time_t secs;
+  	 int32_t nsecs=0;
+  	 x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  	 secs=(time_t)(x%UINT64_C(4102444800))/86400*86400+86390; // start just before midnight so the date changes
+  	 for(int line=0;line<2000;++line)
+  	 	{char s[100];
+  	 	 struct strp_epoch e_s,e_c;
+  	 	 char *end_s,*end_c;
+  	 	 x^=x<<13; x^=x>>7; x^=x<<17;
+  	 	 nsecs+=(int32_t)(x%1500)*1000000;
+  	 	 secs+=nsecs/1000000000;
+  	 	 nsecs%=1000000000;
+  	 	 ya_strftime_epoch(s,sizeof(s),(x>>20)%50==0 ? formats[(x>>30)%(sizeof(formats)/sizeof(formats[0]))] : formats[i],secs,nsecs,60);
+  	 	 if((x>>40)%20==0) s[(x>>45)%strlen(s)]=(char)(32+(x>>52)%95); // change a character
+  	 	 else if((x>>40)%20==1) s[(x>>45)%(strlen(s)+1)]=0; // truncate
+  	 	 memset(&e_s,0,sizeof(e_s)); // so memcmp() can be used
+  	 	 memset(&e_c,0,sizeof(e_c));
+  	 	 end_s=ya_strptime_epoch(s,formats[i],&e_s);
+  	 	 end_c=ya_strptime_cached(s,cache,&e_c);
+  	 	 nos_tests++;
+  	 	 if(end_c!=end_s || memcmp(&e_s,&e_c,sizeof(e_s))!=0)
+  	 	 	{++errs;
+  	 	 	 red_text();
+  	 	 	 printf("Error: ya_strptime_cached() gives a different result to ya_strptime_epoch() for %s format %s\n",s,formats[i]);
+  	 	 	 normal_text();
+  	 	 	 break;
+  	 	 	}
+  	 	}
+  	 strp_cache_free(cache);
+  	}
+ }
+ {/* strftime() no longer uses snprintf() for integers, check the integer emitters against snprintf() for random values of every field */
+  const char *format="%Y|%C|%y|%j|%U|%V|%W|%G|%g|%z|%s|%d|%e|%H|%I|%M|%S|%m|%u|%w";
+  uint64_t x=UINT64_C(88172645463325252);
+  struct strp_tz_struct tz_i;
+  time_t ya_mktime_tm(const struct tm *tp); /* in strftime.c */
+  printf("checking integer output against snprintf():\n");
+  for(int i=0;i<100000;++i)
+  	{char buf[255],buf_s[255];
+  	 int v[12];
+  	 long long off,y_G;
+  	 int h12,y,wk[3];
+  	 for(int j=0;j<12;++j)
+  	 	{x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  	 	 v[j]=(int)x;
+  	 	 if(i%4==1) v[j]=(int)(x%200)-100; // small values (including negative ones)
+  	 	 else if(i%4==2) v[j]=(x&1)?INT_MAX:INT_MIN; // extremes
+  	 	 if(v[j]==strp_tz_default) v[j]=0;
+  	 	}
+  	 nos_tests++;
+  	 memset(&tm,0,sizeof(tm));
+  	 init_strp_tz(&tz_i);
+  	 tm.tm_year=v[0]; tm.tm_yday=v[1]==INT_MAX?0:v[1]; tm.tm_mday=v[2]; tm.tm_hour=v[3]; tm.tm_min=v[4]; tm.tm_sec=v[5]; tm.tm_mon=v[6]; tm.tm_wday=v[7];
+  	 tz_i.week_nos_U=v[8]; tz_i.week_nos_V=v[9]; tz_i.week_nos_W=v[10]; tz_i.year_G=v[11]; tz_i.tz_off_mins=v[1];
+  	 ya_strftime_r(buf,sizeof(buf),format,&tm,&tz_i);
+  	 off=v[1]<0?-(long long)v[1]:v[1];
+  	 if(off>99*60+59) off=99*60+59; // %z is limited to +/-99:59
+  	 for(int j=8;j<=10;++j) wk[j-8]=v[j]<0?0:v[j]>53?53:v[j]; // week numbers are 00-53
+  	 y_G=v[11];
+  	 h12=tm.tm_hour<0?0:tm.tm_hour>23?23:tm.tm_hour;
+  	 h12=h12==0?12:h12>12?h12-12:h12;
+  	 y=tm.tm_year>=0?tm.tm_year%100:100+tm.tm_year%100;
+  	 snprintf(buf_s,sizeof(buf_s),"%lld|%02lld|%02d|%03lld|%02d|%02d|%02d|%lld|%02lld|%c%02lld%02lld|%lld|%02d|%2d|%02d|%02d|%02d|%02d|%02d|%d|%d",
+  	 	(long long)tm.tm_year+1900,((long long)tm.tm_year+1900)/100,y,(long long)(tm.tm_yday<0?0:tm.tm_yday>365?365:tm.tm_yday)+1,wk[0],wk[1],wk[2],y_G,y_G%100,v[1]<0?'-':'+',off/60,off%60,
+  	 	(long long)ya_mktime_tm(&tm),tm.tm_mday<1?1:tm.tm_mday>31?31:tm.tm_mday,tm.tm_mday<1?1:tm.tm_mday>31?31:tm.tm_mday,tm.tm_hour<0?0:tm.tm_hour>23?23:tm.tm_hour,h12,
+  	 	tm.tm_min<0?0:tm.tm_min>59?59:tm.tm_min,tm.tm_sec<0?0:tm.tm_sec>60?60:tm.tm_sec,(tm.tm_mon<0?0:tm.tm_mon>11?11:tm.tm_mon)+1,
+  	 	tm.tm_wday<=0||tm.tm_wday>6?(tm.tm_wday>6?6:7):tm.tm_wday,tm.tm_wday<0?0:tm.tm_wday>6?6:tm.tm_wday);
+  	 if(strcmp(buf,buf_s)!=0)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: strftime(\"%s\") gave \"%s\" but snprintf() gives \"%s\"\n",format,buf,buf_s);
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	}
+  for(int i=0;i<100000;++i)
+  	{// %f from f_secs (when it has been changed since strptime()) is rounded exactly, as snprintf() does with glibc
+  	 char buf[32],buf_s[32];
+  	 int n=1+i%STRP_F_DIGITS;
+  	 x^=x<<13; x^=x>>7; x^=x<<17;
+  	 init_strp_tz(&tz_i);
+  	 tz_i.f_secs=(i%3==0)?(double)(x%4096)/4096.0:(i%3==1)?(double)(x>>11)/9007199254740992.0:(double)(x>>11)/9007199254740992.0/(double)(1+(x&0xfffff)); // exact binary fractions (so halves), any double in 0..1 and small values
+  	 tz_i.f_secs_p10=n;
+  	 nos_tests++;
+  	 ya_strftime_r(buf,sizeof(buf),"%f",&tm,&tz_i);
+  	 snprintf(buf_s,sizeof(buf_s),"%.*f",n,tz_i.f_secs);
+  	 if(buf_s[0]!='0') memset(buf_s+2,'9',n); // rounds up to 1 gives all 9's
+  	 if(strcmp(buf,buf_s+2)!=0)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: %%f of %.17g with %d digits gave \"%s\" but snprintf() gives \"%s\"\n",tz_i.f_secs,n,buf,buf_s);
+  	 	 normal_text();
+  	 	 break;
+  	 	}
+  	}
+ }
+ {/* direct formatting of seconds, only the fields needed are calculated but the output must be identical to ya_strftime_r() using sec_to_tm() */
+  const char *formats[]={"%H:%M:%S","%T.%f","%a %H:%M","%u %w %A %p %I %k %l","%s","%Y-%m-%dT%H:%M:%S.%f%z","%c|%D|%T|%F|%r|%R|%x|%X","%z %Z %f %n%t%%","abc","%","%f|%f|%f|%f|%f",
+  	"%+10Y %010C %+6G %012F %5Y %0200Y %+","%a %A %b %B %h %C %d %e %g %G %H %I %j %m %M %n %p %s %S %t %u %U %V %w %W %y %Y %z %Z %f"};
+  const int offsets[]={strp_tz_default,0,-300,330,845,-720};
+  const time_t edges[]={INT64_MIN,INT64_MIN+1,INT64_MAX,INT64_MIN/2,INT64_MAX/2,INT64_C(-62167219200),INT64_C(-62135596801),0,-1};
+  uint64_t x=UINT64_C(88172645463325252);
+  struct strf_plan *plans[sizeof(formats)/sizeof(formats[0])];
+  printf("checking ya_strftime_epoch():\n");
+  for(size_t f=0;f<sizeof(formats)/sizeof(formats[0]);++f)
+  	plans[f]=strf_compile(formats[f]);
+  for(int i=0;i<3000;++i)
+  	{time_t secs;
+  	 int32_t nsecs;
+  	 int off;
+  	 x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  	 off=offsets[x%6];
+  	 nsecs=(int32_t)((x>>8)%1000000002)-1; // -1 and 1000000000 are invalid
+  	 if(i<(int)(sizeof(edges)/sizeof(edges[0])))
+  	 	{secs=edges[i];
+  	 	 off=strp_tz_default; // so secs+60*off does not overflow
+  	 	}
+  	 else if(i<1000) secs=(time_t)(x%UINT64_C(20000000000))-INT64_C(10000000000); // +/- 300 years around 1970
+  	 else if(i<2000) secs=(time_t)(x%UINT64_C(1000000000))+INT64_C(-62167219200)-INT64_C(500000000); // around year 0
+  	 else secs=(time_t)(x>>4)-(INT64_C(1)<<59); // any (that does not overflow with the offset)
+  	 for(size_t f=0;f<sizeof(formats)/sizeof(formats[0]);++f)
+  	 	{char buf[255],buf_e[255],buf_p[255];
+  	 	 struct tm tm_s;
+  	 	 struct strp_tz_struct tz_s;
+  	 	 size_t r,r_e,r_p;
+  	 	 nos_tests++;
+  	 	 init_strp_tz(&tz_s);
+  	 	 memset(&tm_s,0,sizeof(tm_s));
+  	 	 if(off!=strp_tz_default) tz_s.tz_off_mins=off;
+  	 	 if(nsecs>=0 && nsecs<1000000000)
+  	 	 	{tz_s.f_secs=nsecs/1e9;
+  	 	 	 tz_s.f_secs_p10=9;
+  	 	 	}
+  	 	 sec_to_tm(off!=strp_tz_default ? secs+60*(time_t)off : secs,&tm_s);
+  	 	 r=ya_strftime_r(buf,sizeof(buf),formats[f],&tm_s,&tz_s);
+  	 	 r_e=ya_strftime_epoch(buf_e,sizeof(buf_e),formats[f],secs,nsecs,off);
+  	 	 r_p=ya_strftime_plan_epoch(buf_p,sizeof(buf_p),plans[f],secs,nsecs,off);
+  	 	 if(r!=r_e || r!=r_p || (r!=0 && (strcmp(buf,buf_e)!=0 || strcmp(buf,buf_p)!=0)))
+  	 	 	{++errs;
+  	 	 	 red_text();
+  	 	 	 printf("Error: ya_strftime_epoch() or ya_strftime_plan_epoch() for secs=%.0f nsecs=%d off=%d format \"%s\" gave \"%s\" and \"%s\" expected \"%s\"\n",
+  	 	 	 	(double)secs,(int)nsecs,off,formats[f],r_e?buf_e:"",r_p?buf_p:"",r?buf:"");
+  	 	 	 normal_text();
+  	 	 	 i=INT_MAX-1; // stop after 1st error
+  	 	 	 break;
+  	 	 	}
+  	 	}
+  	}
+  printf("checking ya_strftime_cached():\n");
+  for(size_t f=0;f<sizeof(formats)/sizeof(formats[0]);++f)
+  	{// times that usually increase by less than a second, with some jumps, other offsets and buffers that are too small. 2 caches are used alternately (as by 2 threads)
+  	 struct strf_cache *caches[2]={strf_cache_create(formats[f]),strf_cache_create(formats[f])};
+  	 time_t secs=INT64_C(1700000000)-70;
+  	 int32_t nsecs=0;
+  	 int off=-300;
+  	 for(int i=0;i<3000;++i)
+  	 	{char buf_e[255],buf_c[255];
+  	 	 size_t size,r_e,r_c;
+  	 	 x^=x<<13; x^=x>>7; x^=x<<17;
+  	 	 nsecs+=(int32_t)(x%300000000);
+  	 	 if(nsecs>=1000000000) {nsecs-=1000000000; ++secs;}
+  	 	 if((x>>32)%100==0) secs+=(time_t)((x>>40)%200000)-100000; // jump
+  	 	 if((x>>32)%100==1)
+  	 	 	{// new offset, sometimes with the same local time
+  	 	 	 int o=offsets[(x>>40)%6];
+  	 	 	 if(o!=strp_tz_default && off!=strp_tz_default && (x>>45)%2) secs-=60*(time_t)(o-off);
+  	 	 	 off=o;
+  	 	 	}
+  	 	 size= (x>>50)%10==0 ? (size_t)((x>>54)%40) : sizeof(buf_e);
+  	 	 memset(buf_e,'x',sizeof(buf_e));
+  	 	 memset(buf_c,'x',sizeof(buf_c));
+  	 	 r_e=ya_strftime_epoch(buf_e,size,formats[f],secs,(x>>32)%100==2 ? -1 : nsecs,off);
+  	 	 r_c=ya_strftime_cached(buf_c,size,caches[i&1],secs,(x>>32)%100==2 ? -1 : nsecs,off);
+  	 	 nos_tests++;
+  	 	 if(r_e!=r_c || (r_e!=0 && strcmp(buf_e,buf_c)!=0))
+  	 	 	{++errs;
+  	 	 	 red_text();
+  	 	 	 printf("Error: ya_strftime_cached() for secs=%.0f nsecs=%d off=%d size=%d format \"%s\" gave \"%s\" expected \"%s\"\n",
+  	 	 	 	(double)secs,(int)nsecs,off,(int)size,formats[f],r_c?buf_c:"",r_e?buf_e:"");
+  	 	 	 normal_text();
+  	 	 	 break;
+  	 	 	}
+  	 	}
+  	 strf_cache_free(caches[0]);
+  	 strf_cache_free(caches[1]);
+  	}
+  for(size_t f=0;f<sizeof(formats)/sizeof(formats[0]);++f)
+  	strf_free_plan(plans[f]);
+ }
+ {/* reentrant versions - two independent contexts must not affect each other (or the global strp_tz) */
+  struct tm tm_a,tm_b;
+  struct strp_tz_struct tz_a,tz_b,tz_d;
+  char buf_a[64]="",buf_b[64]="";
+  printf("checking reentrant versions:\n");
+  nos_tests++;
+  init_strp_tz(&strp_tz);
+  init_strp_tz(&tz_d);
+  memset(&tm_a, 0, sizeof(struct tm));
+  memset(&tm_b, 0, sizeof(struct tm));
+  if(ya_strptime_r("2001-11-12 18:31:01.25 +0500 EST","%Y-%m-%d %H:%M:%S.%f %z %Z",&tm_a,&tz_a)==NULL ||
+     ya_strptime_r("2020-W53-7 -0330","%G-W%V-%u %z",&tm_b,&tz_b)==NULL ||
+     ya_strftime_r(buf_a,sizeof(buf_a),"%F %T.%f %z %Z",&tm_a,&tz_a)==0 ||
+     ya_strftime_r(buf_b,sizeof(buf_b),"%G-W%V-%u %z %F",&tm_b,&tz_b)==0 ||
+     strcmp(buf_a,"2001-11-12 18:31:01.25 +0500 EST")!=0 || strcmp(buf_b,"2020-W53-7 -0330 2021-01-03")!=0 ||
+     UTC_mktime(&tm_a,&tz_a)!=1005571861 || !same_strp_tz(&strp_tz,&tz_d))
+  	{++errs;
+ 	 red_text();
+ 	 printf("Error: reentrant versions gave \"%s\" and \"%s\"\n",buf_a,buf_b);
+ 	 normal_text();
+ 	}
+ }
+ {/* direct string to seconds, known values (check_plan() also checks every string tested above against strptime()) */
+  struct epoch_test {const char *s,*f; time_t secs; int32_t nsecs; int tz_off_mins;};
+  const struct epoch_test et[]=
+  	{{"2001-11-12 18:31:01.123456789 +0530","%Y-%m-%d %H:%M:%S.%f %z",INT64_C(1005589861),123456789,330},
+  	 {"1970-01-01T00:00:00.000000001Z","%Y-%m-%dT%H:%M:%S.%fZ",0,1,strp_tz_default},
+  	 {"1969-12-31 23:59:59.9999999999","%F %T.%f",0,0,strp_tz_default}, // 10 digits rounds up to next second
+  	 {"1970-01-01 00:00:00.123456789499999999","%F %T.%f",0,123456789,strp_tz_default}, // 18 digits are rounded exactly (a double would round up)
+  	 {"1970-01-01 00:00:00.1234567885000000000001","%F %T.%f",0,123456789,strp_tz_default},
+  	 {"2020-W53-7 -0330","%G-W%V-%u %z",INT64_C(1609632000),0,-210}, // 2021-01-03
+  	 {"2021 00 5","%Y %U %w",INT64_C(1609459200),0,strp_tz_default}, // 2021-01-01
+  	 {"12:00:60 UTC","%T %Z",INT64_C(-2208988800)+43260,0,0}, // leap second in 1900-01-01 (all other fields default)
+  	 {"0001-01-01 00:00:00","%Y-%m-%d %T",INT64_C(-62135596800),0,strp_tz_default},
+  	 {"4000000000","%s",INT64_C(4000000000),0,strp_tz_default},
+  	};
+  printf("checking ya_strptime_epoch():\n");
+  for(size_t i=0;i<sizeof(et)/sizeof(et[0]);++i)
+  	{struct strp_epoch e;
+  	 char *end=ya_strptime_epoch(et[i].s,et[i].f,&e);
+  	 nos_tests++;
+  	 if(end==NULL || *end!=0 || e.secs!=et[i].secs || e.nsecs!=et[i].nsecs || e.tz_off_mins!=et[i].tz_off_mins)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: ya_strptime_epoch(\"%s\",\"%s\") gave secs=%.0f nsecs=%d tz_off_mins=%d\n",et[i].s,et[i].f,end?(double)e.secs:0.0,end?(int)e.nsecs:0,end?e.tz_off_mins:0);
+  	 	 normal_text();
+  	 	}
+  	}
+ }
+
  /* now check UTC_mktime() and UTC_sec_to_tm() [so uses mydate]*/
  err_UTC_chk("2001-11-12 18:31:01 -0500","%Y-%m-%d %H:%M:%S %z",-1); // -1 is isdst "unknown"
  err_UTC_chk("2001-11-12 18:31:01 -0500","%Y-%m-%d %H:%M:%S %z",0); // 0 is isdst "known, not DST"
@@ -594,7 +1753,7 @@ int main(void)
 	  s+=3600*24; // add 1 day
  	  sec_to_tm(s,& tm );
  	  day_of_week=tm.tm_wday;
- 	  if((prev_day_of_week+1)%7 !=day_of_week)
+ 	  if((prev_day_of_week+1)%7 !=day_of_week || !check_tm(&tm))
  	  	{++errs;
  	  	 red_text();
  	  	 printf ("Error: days of week did not increment correctly at secs=%.0f prev day=%d new day=%d\n",(double)s,prev_day_of_week,day_of_week);
@@ -624,7 +1783,7 @@ int main(void)
 	  s-=3600*24; // subtract 1 day
  	  sec_to_tm(s,& tm );
  	  day_of_week=tm.tm_wday;
- 	  if((prev_day_of_week-1<0?6:prev_day_of_week-1)!=day_of_week)
+ 	  if((prev_day_of_week-1<0?6:prev_day_of_week-1)!=day_of_week || !check_tm(&tm))
  	  	{++errs;
  	  	 red_text();
  	  	 printf ("Error: days of week did not decrement correctly at secs=%.0f prev day=%d, previous day of year=%d new day=%d new day of year=%d - ",
@@ -646,6 +1805,855 @@ int main(void)
  	 prev_day_of_week=day_of_week;
  	 pdoy=tm.tm_yday;
  	} 	
+ {/* sec_to_tm() must be the reverse of ya_mktime_tm() over the full range of years, and when compiled with -DSEC_TO_TM_PREV give identical results to the previous versions (in strftime.c) */
+#ifdef SEC_TO_TM_PREV
+  void sec_to_tm_approx(time_t t,struct tm *tp);
+  void sec_to_tm_bsearch(time_t t,struct tm *tp);
+  struct tm tm_a,tm_b;
+#endif
+  const time_t t_max=((time_t)INT_MAX-1900)*INT64_C(31556952); // approx 1st second of the year INT_MAX-1900 (so year-1900 is never clipped)
+  bool ok;
+  printf("checking sec_to_tm() over the full range of years:\n");
+  memset(&tm, 0, sizeof(struct tm));// sec_to_tm() does not set tm_isdst
+#ifdef SEC_TO_TM_PREV
+  memset(&tm_a, 0, sizeof(struct tm));
+  memset(&tm_b, 0, sizeof(struct tm));
+#endif
+  for(s= -t_max;s<t_max;s+=t_max/500000+INT64_C(1234567))
+  	{nos_tests++;
+  	 sec_to_tm(s,&tm);
+  	 ok=check_tm(&tm) && ya_mktime_tm(&tm)==s;
+#ifdef SEC_TO_TM_PREV
+  	 sec_to_tm_approx(s,&tm_a);
+  	 sec_to_tm_bsearch(s,&tm_b);
+  	 ok=ok && same_tm(&tm,&tm_a) && same_tm(&tm,&tm_b);
+#endif
+  	 if(!ok)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf ("Error: sec_to_tm() gives an invalid result (or a different result to previous versions) for secs=%.0f - ",(double)s);
+  	 	 display_tm();
+  	 	 printf("\n");
+  	 	 normal_text();
+  	 	}
+  	}
+  for(s= -INT64_C(62167219200)-INT64_C(86400)*366*50;s< -INT64_C(62167219200)+INT64_C(86400)*366*50;s+=3600*7+13) // every 7 hours around year 0 (-62167219200 is approx 1st Jan 0000)
+  	{nos_tests++;
+  	 sec_to_tm(s,&tm);
+  	 ok=check_tm(&tm) && ya_mktime_tm(&tm)==s;
+#ifdef SEC_TO_TM_PREV
+  	 sec_to_tm_approx(s,&tm_a);
+  	 ok=ok && same_tm(&tm,&tm_a);
+#endif
+  	 if(!ok)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf ("Error: sec_to_tm() gives an invalid result (or a different result to sec_to_tm_approx()) for secs=%.0f - ",(double)s);
+  	 	 display_tm();
+  	 	 printf("\n");
+  	 	 normal_text();
+  	 	}
+  	}
+ }
+ {/* day_of_year(), month_day() and day_of_week() no longer use ya_mktime() so check them against each other and sec_to_tm() */
+  int day_of_year(int64_t year, int month, int day); /* in strftime.c */
+  int day_of_week(int64_t year,int month, int mday); /* from time_local.h, declared again here as its hidden by the variable day_of_week above */
+  int mon,mday;
+  printf("checking day_of_year(), month_day() and day_of_week():\n");
+  for(int64_t y= -(int64_t)INT_MAX+1900;y<(int64_t)INT_MAX+1900;y+=(y>-2500 && y<2500) ? 1 : 655211)
+  	{nos_tests++;
+  	 memset(&tm, 0, sizeof(struct tm));
+  	 tm.tm_year=(int)(y-1900);
+  	 tm.tm_mday=1;
+  	 sec_to_tm(ya_mktime_tm(&tm),&tm); // 1st Jan of year y
+  	 for(int yday=0;yday<(is_leap(y)?366:365);++yday)
+  	 	{month_day(y,yday,&mon,&mday);
+  	 	 if(tm.tm_yday!=yday || tm.tm_mon!=mon || tm.tm_mday!=mday || day_of_year(y,mon,mday)!=yday || day_of_week(y,mon,mday)!=tm.tm_wday)
+  	 		{++errs;
+  	 		 red_text();
+  	 		 printf ("Error: day_of_year(), month_day() or day_of_week() incorrect for year %.0f, yday %d (month_day() gave month %d day %d) - ",(double)y,yday,mon,mday);
+  	 		 display_tm();
+  	 		 printf("\n");
+  	 		 normal_text();
+  	 		 break;
+  	 		}
+  	 	 sec_to_tm(ya_mktime_tm(&tm)+86400,&tm); // next day
+  	 	}
+  	}
+ }
+ {/* batch conversions, every kernel the processor supports must give identical results to sec_to_tm() and ya_mktime_tm() */
+  #define NOS_BATCH 100003 /* not a multiple of the vector size so the scalar code for the remainder is tested */
+  static time_t bt[NOS_BATCH];
+  static int b_year[NOS_BATCH],b_mon[NOS_BATCH],b_mday[NOS_BATCH],b_hour[NOS_BATCH],b_min[NOS_BATCH],b_sec[NOS_BATCH],b_wday[NOS_BATCH],b_yday[NOS_BATCH];
+  struct tm_soa soa={b_year,b_mon,b_mday,b_hour,b_min,b_sec,b_wday,b_yday};
+  struct tm_soa soa_part={b_year,NULL,NULL,NULL,NULL,NULL,b_wday,NULL}; // only some fields
+  const char *kernel_names[]={"scalar","AVX2","AVX-512"};
+  const time_t t_max=((time_t)INT_MAX+1900)*INT64_C(31556952); // approx last second of the year INT_MAX+1900
+  uint64_t x=UINT64_C(88172645463325252);
+  time_t edges[]={0,-1,1,86399,86400,-86400,-86401,INT64_C(-62135596800)/* 1st Jan 0001 */,INT64_C(-62135596801),INT64_C(-62167132800)/* 1st Jan 0000 */,
+  				  INT64_C(-62167132801),INT64_C(-62167219200),INT64_C(-62167219201),INT64_C(253402300799),t_max,-t_max,INT64_MAX,INT64_MIN,INT64_MAX/2,INT64_MIN/2};
+  for(int i=0;i<NOS_BATCH;++i)
+  	{x^=x<<13; x^=x>>7; x^=x<<17; // xorshift random numbers
+  	 switch(i/(NOS_BATCH/5+1)) // in 5 blocks so the vector kernels get whole vectors of values in range
+  	 	{case 0: bt[i]=(time_t)(x%(uint64_t)(2*t_max))-t_max; break; // whole range of years (and a bit more)
+  	 	 case 1: bt[i]=(time_t)(x%(uint64_t)INT64_C(20000000000))-INT64_C(10000000000); break; // +/- 300 years around 1970
+  	 	 case 2: bt[i]=(time_t)(x%(uint64_t)INT64_C(1000000000))+INT64_C(-62167132800)-INT64_C(500000000); break; // around year 0
+  	 	 case 3: bt[i]=(time_t)x; break; // anything
+  	 	 default: bt[i]=edges[(i/3)%(sizeof(edges)/sizeof(edges[0]))]+i%3-1;
+  	 	}
+  	}
+  for(int k=BATCH_SCALAR;k<=BATCH_AVX512;++k)
+  	{if(batch_kernel_supported((enum batch_kernel)k)!=(enum batch_kernel)k) continue;
+  	 printf("checking sec_to_tm_batch() using %s kernel:\n",kernel_names[k]);
+  	 for(int part=0;part<2;++part)
+  	 	{memset(b_year,0,sizeof(b_year));
+  	 	 memset(b_mon,0,sizeof(b_mon));
+  	 	 sec_to_tm_batch_k(bt,NOS_BATCH,part?&soa_part:&soa,(enum batch_kernel)k);
+  	 	 for(int i=0;i<NOS_BATCH;++i)
+  	 		{nos_tests++;
+  	 		 sec_to_tm(bt[i],&tm);
+  	 		 if(b_year[i]!=tm.tm_year || b_wday[i]!=tm.tm_wday || 
+  	 		 	(part==0 && (b_mon[i]!=tm.tm_mon || b_mday[i]!=tm.tm_mday || b_hour[i]!=tm.tm_hour || b_min[i]!=tm.tm_min || b_sec[i]!=tm.tm_sec || b_yday[i]!=tm.tm_yday)) ||
+  	 		 	(part==1 && b_mon[i]!=0))
+  	 			{++errs;
+  	 			 red_text();
+  	 			 printf ("Error: sec_to_tm_batch() using %s kernel gives a different result to sec_to_tm() for secs=%.0f [%d %d %d %d:%d:%d wday %d yday %d] - ",kernel_names[k],(double)bt[i],
+  	 			 	b_year[i],b_mon[i],b_mday[i],b_hour[i],b_min[i],b_sec[i],b_wday[i],b_yday[i]);
+  	 			 display_tm();
+  	 			 printf("\n");
+  	 			 normal_text();
+  	 			 break;
+  	 			}
+  	 		}
+  	 	}
+  	}
+  /* ya_mktime_tm_batch() starting with valid values from sec_to_tm() then changing some so all the special cases are tested */
+  sec_to_tm_batch(bt,NOS_BATCH,&soa);
+  for(int i=0;i<NOS_BATCH;++i)
+  	{x^=x<<13; x^=x>>7; x^=x<<17;
+  	 switch(i%8)
+  	 	{case 0: break; // valid values
+  	 	 case 1: b_sec[i]=60; break; // leap second
+  	 	 case 2: b_hour[i]=24; b_min[i]=0; b_sec[i]=0; break; // 24:00:00
+  	 	 case 3: b_mday[i]=0; break; // use yday
+  	 	 case 4: b_mon[i]=(int)(x%40)-14; b_mday[i]=(int)((x>>8)%100)-20; break; // invalid month and day of month
+  	 	 case 5: b_yday[i]=-(int)(x%400); b_mday[i]=(int)((x>>16)%32); break; // yday<=0
+  	 	 case 6: b_year[i]=(int)(x%20)-1910; break; // around year 0
+  	 	 default: b_year[i]=(int)x; b_mon[i]=(int)(x>>32); b_hour[i]=(int)(x>>16); b_min[i]=(int)(x>>24); b_sec[i]=(int)(x>>8);
+  	 	 	b_mday[i]=(int)(x>>40)>>1; b_yday[i]=(int)(x>>20)>>1; // anything (but mday/yday /2 so day_of_year() cannot overflow an int)
+  	 	}
+  	}
+  for(int k=BATCH_SCALAR;k<=BATCH_AVX512;++k)
+  	{struct tm_soa soa_in[3]={soa,soa,soa};
+  	 soa_in[1].yday=NULL; // mday always used if > 0
+  	 soa_in[2].mon=soa_in[2].mday=NULL; // yday always used
+  	 if(batch_kernel_supported((enum batch_kernel)k)!=(enum batch_kernel)k) continue;
+  	 printf("checking ya_mktime_tm_batch() using %s kernel:\n",kernel_names[k]);
+  	 for(int v=0;v<3;++v)
+  	 	{memset(bt,0,sizeof(bt));
+  	 	 ya_mktime_tm_batch_k(&soa_in[v],NOS_BATCH,bt,(enum batch_kernel)k);
+  	 	 for(int i=0;i<NOS_BATCH;++i)
+  	 		{nos_tests++;
+  	 		 memset(&tm,0,sizeof(tm));
+  	 		 tm.tm_year=b_year[i];
+  	 		 tm.tm_mon=soa_in[v].mon ? b_mon[i] : 0;
+  	 		 tm.tm_mday=soa_in[v].mday ? b_mday[i] : 0;
+  	 		 tm.tm_hour=b_hour[i];
+  	 		 tm.tm_min=b_min[i];
+  	 		 tm.tm_sec=b_sec[i];
+  	 		 tm.tm_yday=soa_in[v].yday ? b_yday[i] : 0;
+  	 		 if(bt[i]!=ya_mktime_tm(&tm))
+  	 			{++errs;
+  	 			 red_text();
+  	 			 printf ("Error: ya_mktime_tm_batch() using %s kernel gives %.0f but ya_mktime_tm() gives %.0f for [%d %d %d %d:%d:%d yday %d]\n",kernel_names[k],(double)bt[i],
+  	 			 	(double)ya_mktime_tm(&tm),tm.tm_year,tm.tm_mon,tm.tm_mday,tm.tm_hour,tm.tm_min,tm.tm_sec,tm.tm_yday);
+  	 			 normal_text();
+  	 			 break;
+  	 			}
+  	 		}
+  	 	}
+  	}
+ }
+ {/* time zones from TZif files - the files in zoneinfo/ are copies of those from tzdata (2025), tests must be run from the directory that contains zoneinfo/ */
+  const char *zone_names[]={"Europe/London","Europe/Dublin","America/New_York","America/Sao_Paulo","Australia/Lord_Howe","Asia/Kolkata","Pacific/Apia","Etc/UTC","Asia/Kathmandu","Pacific/Chatham"};
+  struct tz_zone *zones[sizeof(zone_names)/sizeof(zone_names[0])];
+  struct {int zone; time_t t; const char *expected;} utc_checks[]= /* %Y-%m-%d %H:%M:%S %z %Z (agrees with zdump and date) */
+  	{{0,1616893199,"2021-03-28 00:59:59 +0000 GMT"},{0,1616893200,"2021-03-28 02:00:00 +0100 BST"},{0,1635641999,"2021-10-31 01:59:59 +0100 BST"},
+  	 {0,1635642000,"2021-10-31 01:00:00 +0000 GMT"},{0,INT64_C(-4000000000),"1843-03-31 16:52:05 -0001 LMT"}, // London was 75 secs behind GMT before 1847
+  	 {1,1610712000,"2021-01-15 12:00:00 +0000 GMT"},{1,1626350400,"2021-07-15 13:00:00 +0100 IST"}, // Dublin has "negative" DST, winter is isdst=1
+  	 {2,1636264799,"2021-11-07 01:59:59 -0400 EDT"},{2,1636264800,"2021-11-07 01:00:00 -0500 EST"},{3,1600000000,"2020-09-13 09:26:40 -0300 -03"},
+  	 {4,1617461999,"2021-04-04 01:59:59 +1100 +11"},{4,1617462000,"2021-04-04 01:30:00 +1030 +1030"}, // 30 minute DST, abbreviations longer than the 4 characters of tz_name are output in full
+  	 {5,1600000000,"2020-09-13 17:56:40 +0530 IST"},{6,1325239199,"2011-12-29 23:59:59 -1000 -10"},{6,1325239200,"2011-12-31 00:00:00 +1400 +14"}, // Apia skipped 30/12/2011
+  	 {7,0,"1970-01-01 00:00:00 +0000 UTC"},{8,504901799,"1985-12-31 23:59:59 +0530 +0530"},{8,504901800,"1986-01-01 00:15:00 +0545 +0545"}, // Kathmandu moved 15 minutes
+  	 {9,1600000000,"2020-09-14 01:11:40 +1245 +1245"},{9,1640000000,"2021-12-21 01:18:20 +1345 +1345"}};
+  struct {int zone; const char *local; int isdst; time_t expected_t; const char *expected;} local_checks[]=
+  	{{0,"2021-03-28 01:30:00",-1,1616895000,"2021-03-28 02:30:00 +0100 BST"}, // skipped, moves forward
+  	 {0,"2021-10-31 01:30:00",-1,1635640200,"2021-10-31 01:30:00 +0100 BST"},{0,"2021-10-31 01:30:00",0,1635643800,"2021-10-31 01:30:00 +0000 GMT"}, // repeated
+  	 {0,"2021-10-31 01:30:00",1,1635640200,"2021-10-31 01:30:00 +0100 BST"},{0,"2021-07-01 12:00:00",0,1625137200,"2021-07-01 12:00:00 +0100 BST"}, // tm_isdst only matters for repeated times
+  	 {1,"2021-10-31 01:30:00",0,1635640200,"2021-10-31 01:30:00 +0100 IST"},{1,"2021-10-31 01:30:00",1,1635643800,"2021-10-31 01:30:00 +0000 GMT"},
+  	 {2,"2021-11-07 01:30:00",0,1636266600,"2021-11-07 01:30:00 -0500 EST"},{2,"2021-03-14 02:30:00",-1,1615707000,"2021-03-14 03:30:00 -0400 EDT"},
+  	 {4,"2021-04-04 01:45:00",0,1617462900,"2021-04-04 01:45:00 +1030 +1030"},{4,"2021-04-04 01:45:00",1,1617461100,"2021-04-04 01:45:00 +1100 +11"},
+  	 {6,"2011-12-30 12:00:00",-1,1325282400,"2011-12-31 12:00:00 +1400 +14"}};
+  const char *zformat="%Y-%m-%d %H:%M:%S %z %Z";
+  char buf[128];
+  uint64_t x=UINT64_C(0x2545F4914F6CDD1D);
+  int tz_zone_offset_bsearch(const struct tz_zone *z, time_t t, int *isdst, const char **abbrev); /* in strftime.c, not in time_local.h as its only for testing */
+  printf("checking time zones from TZif files:\n");
+  for(size_t i=0;i<sizeof(zones)/sizeof(zones[0]);++i)
+  	{nos_tests++;
+  	 zones[i]=tz_zone_load("zoneinfo",zone_names[i]);
+  	 if(zones[i]==NULL)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: tz_zone_load() cannot load zoneinfo/%s (tests must be run from the directory that contains zoneinfo/)\n",zone_names[i]);
+  	 	 normal_text();
+  	 	}
+  	}
+  for(size_t i=0;i<sizeof(utc_checks)/sizeof(utc_checks[0]);++i)
+  	{struct tm tm_z;
+  	 struct strp_tz_struct tz_z;
+  	 int isdst=-1;
+  	 const char *abbrev="";
+  	 if(zones[utc_checks[i].zone]==NULL) continue;
+  	 nos_tests++;
+  	 init_strp_tz(&tz_z);
+  	 UTC_sec_to_tm_zone(utc_checks[i].t,&tm_z,&tz_z,zones[utc_checks[i].zone]);
+  	 ya_strftime_r(buf,sizeof(buf),zformat,&tm_z,&tz_z);
+  	 if(strcmp(buf,utc_checks[i].expected)!=0 || abs(tz_zone_offset(zones[utc_checks[i].zone],utc_checks[i].t,&isdst,&abbrev)-tz_z.tz_off_mins*60)>30 || // tz_off_mins is to the nearest minute
+  	 	isdst!=tm_z.tm_isdst || strcmp(abbrev,utc_checks[i].expected+26)!=0)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: UTC_sec_to_tm_zone() for %s t=%.0f gave \"%s\" (tz_zone_offset() %s isdst=%d) expected \"%s\"\n",zone_names[utc_checks[i].zone],(double)utc_checks[i].t,buf,abbrev,isdst,utc_checks[i].expected);
+  	 	 normal_text();
+  	 	}
+  	}
+  for(size_t i=0;i<sizeof(local_checks)/sizeof(local_checks[0]);++i)
+  	{struct tm tm_z;
+  	 struct strp_tz_struct tz_z;
+  	 time_t t;
+  	 if(zones[local_checks[i].zone]==NULL) continue;
+  	 nos_tests++;
+  	 init_strp_tz(&tz_z);
+  	 memset(&tm_z,0,sizeof(tm_z));
+  	 ya_strptime_r(local_checks[i].local,"%Y-%m-%d %H:%M:%S",&tm_z,&tz_z);
+  	 tm_z.tm_isdst=local_checks[i].isdst;
+  	 t=UTC_mktime_zone(&tm_z,&tz_z,zones[local_checks[i].zone]);
+  	 ya_strftime_r(buf,sizeof(buf),zformat,&tm_z,&tz_z);
+  	 if(t!=local_checks[i].expected_t || strcmp(buf,local_checks[i].expected)!=0)
+  	 	{++errs;
+  	 	 red_text();
+  	 	 printf("Error: UTC_mktime_zone() for %s \"%s\" isdst=%d gave %.0f \"%s\" expected %.0f \"%s\"\n",zone_names[local_checks[i].zone],local_checks[i].local,local_checks[i].isdst,
+  	 	 	(double)t,buf,(double)local_checks[i].expected_t,local_checks[i].expected);
+  	 	 normal_text();
+  	 	}
+  	}
+#ifdef __linux
+  {/* compare with the C library using the same files (via TZ) */
+   char cwd[1024],tzenv[1200];
+   const char *old_tz=getenv("TZ");
+   char saved_tz[256]="";
+   if(old_tz!=NULL) snprintf(saved_tz,sizeof(saved_tz),"%s",old_tz);
+   if(getcwd(cwd,sizeof(cwd))!=NULL)
+   	for(size_t z=0;z<sizeof(zones)/sizeof(zones[0]);++z)
+   		{if(zones[z]==NULL) continue;
+   		 snprintf(tzenv,sizeof(tzenv),":%s/zoneinfo/%s",cwd,zone_names[z]);
+   		 setenv("TZ",tzenv,1);
+   		 tzset();
+   		 for(int i=0;i<20000;++i)
+   		 	{time_t t;
+   		 	 struct tm tm_c,tm_z;
+   		 	 struct strp_tz_struct tz_z;
+   		 	 x^=x<<13; x^=x>>7; x^=x<<17;
+   		 	 t=(time_t)(x%UINT64_C(6200000000))-INT64_C(4100000000); // 1840 -> 2036 (the files have transitions up to 2037)
+   		 	 if(i%4==3) t=(time_t)(x%UINT64_C(10000000000))+INT64_C(2100000000); // 2036 -> 2352, from the TZ string at the end of the file after 2037
+   		 	 if(i<2*12) t=(x>>40)%2 ? 1616893200-1+i/2 : 1635642000-1+i/2; // either side of London transitions (the same instants are tested in every zone)
+   		 	 nos_tests++;
+   		 	 init_strp_tz(&tz_z);
+   		 	 if(localtime_r(&t,&tm_c)==NULL) continue;
+   		 	 UTC_sec_to_tm_zone(t,&tm_z,&tz_z,zones[z]);
+   		 	 ya_strftime_r(buf,sizeof(buf),"%Z",&tm_z,&tz_z); // the whole abbreviation, not just the 4 characters in tz_name
+   		 	 if(!same_tm(&tm_c,&tm_z) || tm_c.tm_gmtoff!=tz_zone_offset(zones[z],t,NULL,NULL) || strcmp(tm_c.tm_zone,buf)!=0)
+   		 	 	{++errs;
+   		 	 	 red_text();
+   		 	 	 printf("Error: UTC_sec_to_tm_zone() for %s t=%.0f gave %d-%d-%d %d:%d:%d isdst=%d %s but localtime_r() gave %d-%d-%d %d:%d:%d isdst=%d %s\n",zone_names[z],(double)t,
+   		 	 	 	tm_z.tm_year,tm_z.tm_mon,tm_z.tm_mday,tm_z.tm_hour,tm_z.tm_min,tm_z.tm_sec,tm_z.tm_isdst,buf,
+   		 	 	 	tm_c.tm_year,tm_c.tm_mon,tm_c.tm_mday,tm_c.tm_hour,tm_c.tm_min,tm_c.tm_sec,tm_c.tm_isdst,tm_c.tm_zone);
+   		 	 	 normal_text();
+   		 	 	 break;
+   		 	 	}
+   		 	}
+   		}
+   if(old_tz!=NULL) setenv("TZ",saved_tz,1);
+   else unsetenv("TZ");
+   tzset();
+  }
+#endif
+#ifdef __linux
+  {/* %z and %Z from the OS are read once into tz (so tzset() is not called for every field), and read again when tz is next initialised */
+   const char *old_tz=getenv("TZ");
+   char saved_tz[256]="",buf[64];
+   const char *expected[]={"-0300 AAA","-0300 BBB","-0300 AAA","-0400 CCC","-0400 CCC"};
+   struct strp_tz_struct tz_o;
+   struct tm tm_o;
+   if(old_tz!=NULL) snprintf(saved_tz,sizeof(saved_tz),"%s",old_tz);
+   memset(&tm_o,0,sizeof(tm_o));
+   setenv("TZ","AAA3BBB,M3.2.0,M11.1.0",1);
+   init_strp_tz(&tz_o);
+   for(int i=0;i<5;++i)
+   	{if(i==2) setenv("TZ","CCC4",1); // not used until tz_o is initialised again
+   	 if(i==3) init_strp_tz(&tz_o);
+   	 tm_o.tm_isdst=i%2; // CCC4 has no summer time so its name is used for both
+   	 nos_tests++;
+   	 if(ya_strftime_r(buf,sizeof(buf),"%z %Z",&tm_o,&tz_o)==0 || strcmp(buf,expected[i])!=0)
+   	 	{++errs;
+   	 	 red_text();
+   	 	 printf("Error: %%z %%Z from the OS (step %d) gave \"%s\" expected \"%s\"\n",i,buf,expected[i]);
+   	 	 normal_text();
+   	 	}
+   	}
+   if(old_tz!=NULL) setenv("TZ",saved_tz,1);
+   else unsetenv("TZ");
+   tzset();
+  }
+#endif
+  for(size_t z=0;z<sizeof(zones)/sizeof(zones[0]);++z)
+  	{// local -> UTC -> local gives the same time, and the same instant unless its a repeated local time that tm_isdst cannot tell apart
+  	 if(zones[z]==NULL) continue;
+  	 for(int i=0;i<20000;++i)
+  	 	{time_t t,t2;
+  	 	 struct tm tm_z,tm_2;
+  	 	 struct strp_tz_struct tz_z,tz_2;
+  	 	 x^=x<<13; x^=x>>7; x^=x<<17;
+  	 	 t=(time_t)(x%UINT64_C(6200000000))-INT64_C(4100000000);
+  	 	 nos_tests++;
+  	 	 init_strp_tz(&tz_z);
+  	 	 init_strp_tz(&tz_2);
+  	 	 UTC_sec_to_tm_zone(t,&tm_z,&tz_z,zones[z]);
+  	 	 tm_2=tm_z;
+  	 	 t2=UTC_mktime_zone(&tm_2,&tz_2,zones[z]);
+  	 	 if(!same_tm(&tm_z,&tm_2) || !same_strp_tz(&tz_z,&tz_2) || (t2!=t && tz_zone_offset(zones[z],t,NULL,NULL)==tz_zone_offset(zones[z],t2,NULL,NULL)))
+  	 	 	{++errs;
+  	 	 	 red_text();
+  	 	 	 printf("Error: UTC_mktime_zone() for %s t=%.0f gave %.0f\n",zone_names[z],(double)t,(double)t2);
+  	 	 	 normal_text();
+  	 	 	 break;
+  	 	 	}
+  	 	}
+  	}
+  {/* invalid files must be rejected (and never read past the end of the data) */
+   static unsigned char data[8192];
+   size_t len=0;
+   FILE *f=fopen("zoneinfo/Europe/London","rb");
+   if(f!=NULL)
+   	{len=fread(data,1,sizeof(data),f);
+   	 fclose(f);
+   	}
+   if(len>44 && zones[0]!=NULL)
+   	{struct tz_zone *z;
+   	 uint32_t cnt[6];
+   	 size_t v1_len;
+   	 for(size_t l=0;l<len;++l)
+   	 	{unsigned char *copy=(unsigned char *)malloc(l+1); // exact size, so ASan finds any read past the end
+   	 	 memcpy(copy,data,l);
+   	 	 nos_tests++;
+   	 	 z=tz_zone_from_tzif(copy,l);
+   	 	 if(z!=NULL)
+   	 	 	{++errs;
+   	 	 	 red_text();
+   	 	 	 printf("Error: tz_zone_from_tzif() accepted a file truncated to %d bytes\n",(int)l);
+   	 	 	 normal_text();
+   	 	 	 tz_zone_free(z);
+   	 	 	}
+   	 	 free(copy);
+   	 	}
+   	 for(int i=0;i<6;++i)
+   	 	cnt[i]=(uint32_t)data[20+4*i]<<24 | (uint32_t)data[21+4*i]<<16 | (uint32_t)data[22+4*i]<<8 | data[23+4*i];
+   	 v1_len=44+cnt[3]*5+cnt[4]*6+cnt[5]+cnt[2]*8+cnt[1]+cnt[0];
+   	 data[4]=0; // just the version 1 data (32 bit times)
+   	 z=tz_zone_from_tzif(data,v1_len);
+   	 nos_tests++;
+   	 if(z==NULL)
+   	 	{++errs;
+   	 	 red_text();
+   	 	 printf("Error: tz_zone_from_tzif() rejected the version 1 data\n");
+   	 	 normal_text();
+   	 	}
+   	 else
+   	 	{for(time_t t=INT32_MIN;t<=INT32_MAX;t+=86400/4+7) // 32 bit times only go from 1901 to 2038
+   	 	 	{int d1,d2;
+   	 	 	 nos_tests++;
+   	 	 	 if(tz_zone_offset(z,t,&d1,NULL)!=tz_zone_offset(zones[0],t,&d2,NULL) || d1!=d2)
+   	 	 	 	{++errs;
+   	 	 	 	 red_text();
+   	 	 	 	 printf("Error: version 1 data gives a different offset to version 2 data at t=%.0f\n",(double)t);
+   	 	 	 	 normal_text();
+   	 	 	 	 break;
+   	 	 	 	}
+   	 	 	}
+   	 	 tz_zone_free(z);
+   	 	}
+   	 data[4]='2';
+   	 data[0]='X'; // bad magic number
+   	 nos_tests++;
+   	 if((z=tz_zone_from_tzif(data,len))!=NULL)
+   	 	{++errs;
+   	 	 red_text();
+   	 	 printf("Error: tz_zone_from_tzif() accepted a file with a bad magic number\n");
+   	 	 normal_text();
+   	 	 tz_zone_free(z);
+   	 	}
+   	}
+   nos_tests++;
+   if(tz_zone_load("zoneinfo","../zoneinfo/Etc/UTC")!=NULL || tz_zone_load("zoneinfo","/Etc/UTC")!=NULL || tz_zone_load("zoneinfo","No/Such_Zone")!=NULL || tz_zone_load("zoneinfo",NULL)!=NULL)
+   	{++errs;
+   	 red_text();
+   	 printf("Error: tz_zone_load() accepted an invalid name\n");
+   	 normal_text();
+   	}
+  }
+  printf("checking time zone index against binary search:\n");
+  {/* a version 2 file with transitions that are close together (several in 1 bucket of the index) and one long before the rest (left out of the index) */
+   static unsigned char data[44*2+8+4096*9+2*6+8+4];
+   static time_t trans[4096];
+   unsigned char *p=data;
+   int n=0;
+   struct tz_zone *z;
+   trans[n++]=-(INT64_C(1)<<50);
+   for(time_t t=-INT64_C(2000000000);n<4000;)
+   	{x^=x<<13; x^=x>>7; x^=x<<17;
+   	 switch(x%4)
+   	 	{case 0: t+=1+(time_t)((x>>8)%7200); break; // close together
+   	 	 case 1: t+=(time_t)((x>>8)%40000000); break; // random
+   	 	 default: t+=15552000; break; // about every 6 months
+   	 	}
+   	 trans[n++]=t;
+   	}
+   memset(data,0,sizeof(data));
+   for(int part=0;part<2;++part)
+   	{// version 1 data (no transitions) then version 2 data
+   	 uint32_t cnt[6]={0,0,0,part ? (uint32_t)n : 0,2,8};
+   	 memcpy(p,"TZif2",5);
+   	 for(int i=0;i<6;++i)
+   	 	{p[20+4*i]=(unsigned char)(cnt[i]>>24); p[21+4*i]=(unsigned char)(cnt[i]>>16); p[22+4*i]=(unsigned char)(cnt[i]>>8); p[23+4*i]=(unsigned char)cnt[i];}
+   	 p+=44;
+   	 for(uint32_t i=0;i<cnt[3];++i)
+   	 	for(int j=0;j<8;++j) *p++=(unsigned char)((uint64_t)trans[i]>>(56-8*j));
+   	 for(uint32_t i=0;i<cnt[3];++i) *p++=(unsigned char)(1-i%2); // alternate between the 2 types
+   	 memcpy(p,"\0\0\0\0\0\0\0\0\x0e\x10\1\4",12); // type 0 is +0000 "STD", type 1 +0100 "DST"
+   	 p+=12;
+   	 memcpy(p,"STD\0DST\0",8);
+   	 p+=8;
+   	}
+   *p++='\n';
+   *p++='\n';
+   z=tz_zone_from_tzif(data,(size_t)(p-data));
+   nos_tests++;
+   if(z==NULL)
+   	{++errs;
+   	 red_text();
+   	 printf("Error: tz_zone_from_tzif() rejected a valid file\n");
+   	 normal_text();
+   	}
+   else
+   	{for(int i=0;i<n;++i)
+   		for(int d=-1;d<=1;++d)
+   	 		{const char *a1,*a2;
+   	 		 int i1,i2;
+   	 		 nos_tests++;
+   	 		 if(tz_zone_offset(z,trans[i]+d,&i1,&a1)!=tz_zone_offset_bsearch(z,trans[i]+d,&i2,&a2) || i1!=i2 || a1!=a2 ||
+   	 		 	tz_zone_offset(z,trans[i]+d,NULL,NULL)!=(d<0 ? (i%2 ? 3600 : 0) : (i%2 ? 0 : 3600))) // the offset is the one before transition i if d<0
+   	 		 	{++errs;
+   	 		 	 red_text();
+   	 		 	 printf("Error: tz_zone_offset() gives %d but tz_zone_offset_bsearch() gives %d at transition %d %+d\n",tz_zone_offset(z,trans[i]+d,NULL,NULL),tz_zone_offset_bsearch(z,trans[i]+d,NULL,NULL),i,d);
+   	 		 	 normal_text();
+   	 		 	 i=n;
+   	 		 	 break;
+   	 		 	}
+   	 		}
+   	 for(int i=0;i<100000;++i)
+   	 	{time_t t;
+   	 	 x^=x<<13; x^=x>>7; x^=x<<17;
+   	 	 t= i%2 ? (time_t)x : (time_t)(x%(uint64_t)(trans[n-1]-trans[1]+4000000))+trans[1]-2000000; // anything, or around the transitions
+   	 	 nos_tests++;
+   	 	 if(tz_zone_offset(z,t,NULL,NULL)!=tz_zone_offset_bsearch(z,t,NULL,NULL))
+   	 	 	{++errs;
+   	 	 	 red_text();
+   	 	 	 printf("Error: tz_zone_offset() gives %d but tz_zone_offset_bsearch() gives %d for t=%.0f\n",tz_zone_offset(z,t,NULL,NULL),tz_zone_offset_bsearch(z,t,NULL,NULL),(double)t);
+   	 	 	 normal_text();
+   	 	 	 break;
+   	 	 	}
+   	 	}
+   	 tz_zone_free(z);
+   	}
+  }
+  for(size_t z=0;z<sizeof(zones)/sizeof(zones[0]);++z)
+  	{if(zones[z]==NULL) continue;
+  	 for(int i=0;i<100000;++i)
+  	 	{time_t t;
+  	 	 x^=x<<13; x^=x>>7; x^=x<<17;
+  	 	 t= i%4==0 ? (time_t)x : (time_t)(x%UINT64_C(6200000000))-INT64_C(4100000000);
+  	 	 nos_tests++;
+  	 	 if(tz_zone_offset(zones[z],t,NULL,NULL)!=tz_zone_offset_bsearch(zones[z],t,NULL,NULL))
+  	 	 	{++errs;
+  	 	 	 red_text();
+  	 	 	 printf("Error: tz_zone_offset() gives %d but tz_zone_offset_bsearch() gives %d for %s t=%.0f\n",tz_zone_offset(zones[z],t,NULL,NULL),
+  	 	 	 	tz_zone_offset_bsearch(zones[z],t,NULL,NULL),zone_names[z],(double)t);
+  	 	 	 normal_text();
+  	 	 	 break;
+  	 	 	}
+  	 	}
+  	}
+  printf("checking tz_cursor_offset():\n");
+  for(size_t z=0;z<sizeof(zones)/sizeof(zones[0]);++z)
+  	{// step through every transition, checking either side of each one
+  	 struct tz_cursor cur;
+  	 time_t t=-INT64_C(5000000000);
+  	 if(zones[z]==NULL) continue;
+  	 tz_cursor_init(&cur,zones[z]);
+  	 for(int i=0;i<1000 && t!=INT64_MAX;++i)
+  	 	{time_t tests[6];
+  	 	 struct tz_cursor next;
+  	 	 tz_cursor_offset(&cur,t);
+  	 	 tests[0]=t;
+  	 	 tests[1]= cur.end==INT64_MAX ? t : cur.end-1;
+  	 	 tests[2]= cur.end==INT64_MAX ? t : cur.end; // the next interval
+  	 	 tests[3]=tests[1]; // back again
+  	 	 next=cur;
+  	 	 tz_cursor_offset(&next,tests[2]);
+  	 	 tests[4]= next.end==INT64_MAX ? t : next.end-1; // the end of the next interval
+  	 	 tests[5]= next.end==INT64_MAX ? t : next.end; // the start of the one after
+  	 	 for(int j=0;j<6;++j)
+  	 	 	{int dst;
+  	 	 	 const char *abbrev;
+  	 	 	 nos_tests++;
+  	 	 	 if(tz_cursor_offset(&cur,tests[j])!=tz_zone_offset(zones[z],tests[j],&dst,&abbrev) || cur.isdst!=dst || cur.abbrev!=abbrev || tests[j]<cur.start || tests[j]>=cur.end)
+  	 	 	 	{++errs;
+  	 	 	 	 red_text();
+  	 	 	 	 printf("Error: tz_cursor_offset() for %s t=%.0f gave %d expected %d\n",zone_names[z],(double)tests[j],cur.off,tz_zone_offset(zones[z],tests[j],NULL,NULL));
+  	 	 	 	 normal_text();
+  	 	 	 	 i=1000;
+  	 	 	 	 break;
+  	 	 	 	}
+  	 	 	 if(j==4 || j==5) tz_cursor_offset(&cur,tests[1]); // so the next test moves 2 intervals
+  	 	 	}
+  	 	 t=cur.end; // INT64_MAX after the last transition
+  	 	}
+  	}
+  printf("checking sec_to_tm_zone_batch():\n");
+  for(size_t z=0;z<sizeof(zones)/sizeof(zones[0]);++z)
+  	{// times in ascending order (with repeats and jumps), then the same times shuffled, converted in pieces of random size with the cursor kept between calls
+  	 static time_t zt[5000];
+  	 static int z_year[5000],z_mon[5000],z_mday[5000],z_hour[5000],z_min[5000],z_sec[5000],z_wday[5000],z_yday[5000],z_off[5000],z_isdst[5000];
+  	 struct tz_cursor cur;
+  	 time_t t=-INT64_C(4100000000);
+  	 if(zones[z]==NULL) continue;
+  	 tz_cursor_init(&cur,zones[z]);
+  	 for(int i=0;i<5000;++i)
+  	 	{x^=x<<13; x^=x>>7; x^=x<<17;
+  	 	 switch(x%8)
+  	 	 	{case 0: break; // repeat
+  	 	 	 case 1: t+=(time_t)((x>>8)%100000000); break; // jump
+  	 	 	 case 2: tz_cursor_offset(&cur,t);
+  	 	 	 	if(cur.end!=INT64_MAX) t=cur.end-(time_t)((x>>8)%2); // the next transition or 1 sec before it
+  	 	 	 	break;
+  	 	 	 default: t+=(time_t)((x>>8)%2000000); break;
+  	 	 	}
+  	 	 zt[i]=t;
+  	 	}
+  	 tz_cursor_init(&cur,zones[z]);
+  	 for(int order=0;order<3;++order)
+  	 	{if(order==1)
+  	 	 	for(int i=4999;i>0;--i)
+  	 	 		{time_t tmp=zt[i];
+  	 	 		 int j;
+  	 	 		 x^=x<<13; x^=x>>7; x^=x<<17;
+  	 	 		 j=(int)(x%(uint64_t)(i+1));
+  	 	 		 zt[i]=zt[j];
+  	 	 		 zt[j]=tmp;
+  	 	 		}
+  	 	 if(order==2)
+  	 	 	for(int i=0;i<5000;++i) zt[i]=INT64_C(1600000000)-(time_t)i*3601; // descending
+  	 	 memset(z_year,0,sizeof(z_year));
+  	 	 for(int i=0;i<5000;)
+  	 	 	{int m;
+  	 	 	 struct tm_soa piece={z_year+i,z_mon+i,z_mday+i,z_hour+i,z_min+i,z_sec+i,z_wday+i,z_yday+i};
+  	 	 	 x^=x<<13; x^=x>>7; x^=x<<17;
+  	 	 	 m=(int)(x%700);
+  	 	 	 if(m>5000-i) m=5000-i;
+  	 	 	 for(int j=i;j<i+m;++j) z_isdst[j]=-1; // so its not checked if isdst is NULL
+  	 	 	 sec_to_tm_zone_batch(zt+i,(size_t)m,&cur,&piece,z_off+i,(x>>20)%2 ? z_isdst+i : NULL);
+  	 	 	 i+=m;
+  	 	 	}
+  	 	 for(int i=0;i<5000;++i)
+  	 	 	{struct tm tm_z;
+  	 	 	 struct strp_tz_struct tz_z;
+  	 	 	 int dst;
+  	 	 	 nos_tests++;
+  	 	 	 init_strp_tz(&tz_z);
+  	 	 	 UTC_sec_to_tm_zone(zt[i],&tm_z,&tz_z,zones[z]);
+  	 	 	 if(z_year[i]!=tm_z.tm_year || z_mon[i]!=tm_z.tm_mon || z_mday[i]!=tm_z.tm_mday || z_hour[i]!=tm_z.tm_hour || z_min[i]!=tm_z.tm_min || z_sec[i]!=tm_z.tm_sec ||
+  	 	 	 	z_wday[i]!=tm_z.tm_wday || z_yday[i]!=tm_z.tm_yday || z_off[i]!=tz_zone_offset(zones[z],zt[i],&dst,NULL) || (z_isdst[i]>=0 && z_isdst[i]!=dst))
+  	 	 	 	{++errs;
+  	 	 	 	 red_text();
+  	 	 	 	 printf("Error: sec_to_tm_zone_batch() for %s t=%.0f (%s order) gave %d-%d-%d %d:%d:%d off=%d isdst=%d\n",zone_names[z],(double)zt[i],order==0 ? "ascending" : order==1 ? "random" : "descending",
+  	 	 	 	 	z_year[i],z_mon[i],z_mday[i],z_hour[i],z_min[i],z_sec[i],z_off[i],z_isdst[i]);
+  	 	 	 	 normal_text();
+  	 	 	 	 break;
+  	 	 	 	}
+  	 	 	}
+  	 	}
+  	}
+  printf("checking time zones from POSIX TZ strings:\n");
+  {const char *footers[]={"GMT0BST,M3.5.0/1,M10.5.0","IST-1GMT0,M10.5.0,M3.5.0/1","EST5EDT,M3.2.0,M11.1.0","<-03>3","<+1030>-10:30<+11>-11,M10.1.0,M4.1.0","IST-5:30","<+13>-13","UTC0","<+0545>-5:45",
+   	 "<+1245>-12:45<+1345>,M9.5.0/2:45,M4.1.0/3:45"}; // from the end of the files in zoneinfo/
+   const char *bad_strings[]={"","EST","ES5","5","EST5ED","EST5EDT,M3.2.0","EST5EDT,M3.2.0,","EST5EDT,M3.2.0,M11.1.0x","EST5EDT,M13.1.0,M11.1.0","EST5EDT,M3.6.0,M11.1.0","EST5EDT,M3.0.0,M11.1.0",
+   	"EST5EDT,M3.2.7,M11.1.0","EST5EDT,M3.2,M11.1.0","EST5EDT,J0,J365","EST5EDT,J1,J366","EST5EDT,0,366","EST25","EST5:60","<+05","<+0>5","EST5EDT,M3.2.0/168,M11.1.0","EST5EDT,M3.2.0/,M11.1.0","EST5EDT;M3.2.0,M11.1.0",NULL};
+   const char *good_strings[]={"EST5EDT,M3.2.0,M11.1.0","AEST-10AEDT,M10.1.0,M4.1.0/3","<+0530>-5:30","XXX3YYY,J60/1:30,J300","XXX3YYY,59/1:30,300","EST5EDT,0/0,J365/25","<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",
+   	"CET-1CEST,M3.5.0,M10.5.0/3","<-0330>3:30<-0230>,M3.2.0/-1:30,M11.1.0/30:15:10","ABC+3:30DEF+2:30,M2.5.3/12,M12.4.6/0","NZST-12NZDT,M9.5.0,M4.1.0/3","EST5EDT","UTC0"};
+   struct {int tz; time_t t; const char *expected;} rule_checks[]= /* tz is an index into good_strings[] */
+   	{{0,INT64_C(4108690799),"2100-03-14 01:59:59 -0500 EST"},{0,INT64_C(4108690800),"2100-03-14 03:00:00 -0400 EDT"},{0,INT64_C(13575625199),"2400-03-12 01:59:59 -0500 EST"},
+   	 {0,INT64_C(13575625200),"2400-03-12 03:00:00 -0400 EDT"},{0,INT64_C(13596184799),"2400-11-05 01:59:59 -0400 EDT"},{0,INT64_C(13596184800),"2400-11-05 01:00:00 -0500 EST"},
+   	 {1,1617465599,"2021-04-04 02:59:59 +1100 AEDT"},{1,1617465600,"2021-04-04 02:00:00 +1000 AEST"},{2,0,"1970-01-01 05:30:00 +0530 +0530"},
+   	 {3,1709267399,"2024-03-01 01:29:59 -0300 XXX"},{3,1709267400,"2024-03-01 02:30:00 -0200 YYY"},{4,1709180999,"2024-02-29 01:29:59 -0300 XXX"},{4,1709181000,"2024-02-29 02:30:00 -0200 YYY"}, // J ignores Feb 29th, n counts it
+   	 {5,1956527999,"2031-12-31 19:59:59 -0400 EDT"},{5,1956542400,"2032-01-01 00:00:00 -0400 EDT"},{11,1615705200,"2021-03-14 03:00:00 -0400 EDT"}}; // DST all year, and US rules if there are none
+   struct {int tz; const char *local; int isdst; time_t expected_t; const char *expected;} rule_local_checks[]=
+   	{{0,"2100-03-14 02:30:00",-1,INT64_C(4108692600),"2100-03-14 03:30:00 -0400 EDT"},{0,"2100-11-07 01:30:00",-1,INT64_C(4129248600),"2100-11-07 01:30:00 -0400 EDT"}, // skipped, repeated
+   	 {0,"2100-11-07 01:30:00",0,INT64_C(4129252200),"2100-11-07 01:30:00 -0500 EST"},{0,"2100-11-07 01:30:00",1,INT64_C(4129248600),"2100-11-07 01:30:00 -0400 EDT"},
+   	 {0,"2100-07-01 12:00:00",0,INT64_C(4118140800),"2100-07-01 12:00:00 -0400 EDT"},{1,"2021-04-04 02:30:00",0,1617467400,"2021-04-04 02:30:00 +1000 AEST"}};
+   struct tz_zone *rz[sizeof(good_strings)/sizeof(good_strings[0])];
+   for(int i=0;bad_strings[i]!=NULL;++i)
+   	{struct tz_zone *z=tz_zone_from_posix(bad_strings[i]);
+   	 nos_tests++;
+   	 if(z!=NULL)
+   	 	{++errs;
+   	 	 red_text();
+   	 	 printf("Error: tz_zone_from_posix(\"%s\") accepted an invalid string\n",bad_strings[i]);
+   	 	 normal_text();
+   	 	 tz_zone_free(z);
+   	 	}
+   	}
+   nos_tests++;
+   if(tz_zone_from_posix(NULL)!=NULL)
+   	{++errs;
+   	 red_text();
+   	 printf("Error: tz_zone_from_posix(NULL) did not return NULL\n");
+   	 normal_text();
+   	}
+   for(size_t i=0;i<sizeof(rz)/sizeof(rz[0]);++i)
+   	{nos_tests++;
+   	 if((rz[i]=tz_zone_from_posix(good_strings[i]))==NULL)
+   	 	{++errs;
+   	 	 red_text();
+   	 	 printf("Error: tz_zone_from_posix(\"%s\") rejected a valid string\n",good_strings[i]);
+   	 	 normal_text();
+   	 	}
+   	}
+   for(size_t i=0;i<sizeof(rule_checks)/sizeof(rule_checks[0]);++i)
+   	{struct tm tm_z;
+   	 struct strp_tz_struct tz_z;
+   	 if(rz[rule_checks[i].tz]==NULL) continue;
+   	 nos_tests++;
+   	 init_strp_tz(&tz_z);
+   	 UTC_sec_to_tm_zone(rule_checks[i].t,&tm_z,&tz_z,rz[rule_checks[i].tz]);
+   	 ya_strftime_r(buf,sizeof(buf),zformat,&tm_z,&tz_z);
+   	 if(strcmp(buf,rule_checks[i].expected)!=0)
+   	 	{++errs;
+   	 	 red_text();
+   	 	 printf("Error: UTC_sec_to_tm_zone() for \"%s\" t=%.0f gave \"%s\" expected \"%s\"\n",good_strings[rule_checks[i].tz],(double)rule_checks[i].t,buf,rule_checks[i].expected);
+   	 	 normal_text();
+   	 	}
+   	}
+   for(size_t i=0;i<sizeof(rule_local_checks)/sizeof(rule_local_checks[0]);++i)
+   	{struct tm tm_z;
+   	 struct strp_tz_struct tz_z;
+   	 time_t t;
+   	 if(rz[rule_local_checks[i].tz]==NULL) continue;
+   	 nos_tests++;
+   	 init_strp_tz(&tz_z);
+   	 memset(&tm_z,0,sizeof(tm_z));
+   	 ya_strptime_r(rule_local_checks[i].local,"%Y-%m-%d %H:%M:%S",&tm_z,&tz_z);
+   	 tm_z.tm_isdst=rule_local_checks[i].isdst;
+   	 t=UTC_mktime_zone(&tm_z,&tz_z,rz[rule_local_checks[i].tz]);
+   	 ya_strftime_r(buf,sizeof(buf),zformat,&tm_z,&tz_z);
+   	 if(t!=rule_local_checks[i].expected_t || strcmp(buf,rule_local_checks[i].expected)!=0)
+   	 	{++errs;
+   	 	 red_text();
+   	 	 printf("Error: UTC_mktime_zone() for \"%s\" \"%s\" isdst=%d gave %.0f \"%s\" expected %.0f \"%s\"\n",good_strings[rule_local_checks[i].tz],rule_local_checks[i].local,rule_local_checks[i].isdst,
+   	 	 	(double)t,buf,(double)rule_local_checks[i].expected_t,rule_local_checks[i].expected);
+   	 	 normal_text();
+   	 	}
+   	}
+   const time_t footer_from[]={1230768000,1230768000,1230768000,1577836800,1230768000,1230768000,1640995200,1230768000,1230768000,1230768000}; // 2009 (2020 for Sao Paulo and 2022 for Apia, which stopped using DST)
+   for(size_t z=0;z<sizeof(zones)/sizeof(zones[0]);++z)
+   	{// the TZ string alone gives the same times as the file while the rules have not changed - zic worked out the transitions in the file from the same rules
+   	 struct tz_zone *fz=tz_zone_from_posix(footers[z]);
+   	 nos_tests++;
+   	 if(fz==NULL || zones[z]==NULL)
+   	 	{if(fz==NULL)
+   	 	 	{++errs;
+   	 	 	 red_text();
+   	 	 	 printf("Error: tz_zone_from_posix(\"%s\") rejected a valid string\n",footers[z]);
+   	 	 	 normal_text();
+   	 	 	}
+   	 	 tz_zone_free(fz);
+   	 	 continue;
+   	 	}
+   	 for(int i=0;i<40000;++i)
+   	 	{time_t t;
+   	 	 int d1,d2;
+   	 	 const char *a1,*a2;
+   	 	 struct tm tm_1,tm_2;
+   	 	 struct strp_tz_struct tz_1,tz_2;
+   	 	 x^=x<<13; x^=x>>7; x^=x<<17;
+   	 	 t=(time_t)(x%(uint64_t)(INT64_C(2130000000)-footer_from[z]))+footer_from[z]; // up to 2037
+   	 	 if(i%4==1)
+   	 	 	{struct tz_cursor cur;
+   	 	 	 tz_cursor_init(&cur,zones[z]);
+   	 	 	 tz_cursor_offset(&cur,t);
+   	 	 	 if(cur.end<INT64_C(2140000000)) t=cur.end-(time_t)((x>>40)%2); // a transition in the file, or 1 sec before it
+   	 	 	}
+   	 	 nos_tests++;
+   	 	 if(tz_zone_offset(fz,t,&d1,&a1)!=tz_zone_offset(zones[z],t,&d2,&a2) || d1!=d2 || strcmp(a1,a2)!=0)
+   	 	 	{++errs;
+   	 	 	 red_text();
+   	 	 	 printf("Error: tz_zone_from_posix(\"%s\") gives %d %s for t=%.0f but the file gives %d %s\n",footers[z],tz_zone_offset(fz,t,NULL,NULL),a1,(double)t,tz_zone_offset(zones[z],t,NULL,NULL),a2);
+   	 	 	 normal_text();
+   	 	 	 break;
+   	 	 	}
+   	 	 init_strp_tz(&tz_1);
+   	 	 init_strp_tz(&tz_2);
+   	 	 sec_to_tm(t+(time_t)(x>>50)%7200-3600,&tm_1); // local times either side of the transitions
+   	 	 tm_1.tm_isdst=(int)((x>>20)%3)-1;
+   	 	 tm_2=tm_1;
+   	 	 nos_tests++;
+   	 	 if(UTC_mktime_zone(&tm_1,&tz_1,fz)!=UTC_mktime_zone(&tm_2,&tz_2,zones[z]) || !same_tm(&tm_1,&tm_2) || !same_strp_tz(&tz_1,&tz_2))
+   	 	 	{++errs;
+   	 	 	 red_text();
+   	 	 	 printf("Error: UTC_mktime_zone() with tz_zone_from_posix(\"%s\") is not the same as the file near t=%.0f\n",footers[z],(double)t);
+   	 	 	 normal_text();
+   	 	 	 break;
+   	 	 	}
+   	 	}
+   	 tz_zone_free(fz);
+   	}
+#ifdef __linux
+   {/* compare with the C library (which does not apply DST before 1970 for a TZ string, and takes the rule for the UTC year rather than the local one, so times near the new year are left out for rules that cross it) */
+    const char *old_tz=getenv("TZ");
+    char saved_tz[256]="";
+    if(old_tz!=NULL) snprintf(saved_tz,sizeof(saved_tz),"%s",old_tz);
+    for(size_t z=0;z<sizeof(rz)/sizeof(rz[0]);++z)
+    	{if(rz[z]==NULL || z==5 || z==11) continue; // DST all year, and glibc reads the file EST5EDT if there are no rules
+    	 setenv("TZ",good_strings[z],1);
+    	 tzset();
+    	 for(int i=0;i<20000;++i)
+    	 	{time_t t;
+    	 	 struct tm tm_c,tm_z;
+    	 	 struct strp_tz_struct tz_z;
+    	 	 x^=x<<13; x^=x>>7; x^=x<<17;
+    	 	 t=(time_t)(x%UINT64_C(13000000000)); // 1970 -> 2381
+    	 	 sec_to_tm(t,&tm_c);
+    	 	 if(tm_c.tm_yday==0 || tm_c.tm_yday>=364) continue; // near the new year in UTC
+    	 	 nos_tests++;
+    	 	 init_strp_tz(&tz_z);
+    	 	 if(localtime_r(&t,&tm_c)==NULL) continue;
+    	 	 UTC_sec_to_tm_zone(t,&tm_z,&tz_z,rz[z]);
+    	 	 ya_strftime_r(buf,sizeof(buf),"%Z",&tm_z,&tz_z);
+    	 	 if(!same_tm(&tm_c,&tm_z) || tm_c.tm_gmtoff!=tz_zone_offset(rz[z],t,NULL,NULL) || strcmp(tm_c.tm_zone,buf)!=0)
+    	 	 	{++errs;
+    	 	 	 red_text();
+    	 	 	 printf("Error: UTC_sec_to_tm_zone() for \"%s\" t=%.0f gave %d-%d-%d %d:%d:%d isdst=%d %s but localtime_r() gave %d-%d-%d %d:%d:%d isdst=%d %s\n",good_strings[z],(double)t,
+    	 	 	 	tm_z.tm_year,tm_z.tm_mon,tm_z.tm_mday,tm_z.tm_hour,tm_z.tm_min,tm_z.tm_sec,tm_z.tm_isdst,buf,
+    	 	 	 	tm_c.tm_year,tm_c.tm_mon,tm_c.tm_mday,tm_c.tm_hour,tm_c.tm_min,tm_c.tm_sec,tm_c.tm_isdst,tm_c.tm_zone);
+    	 	 	 normal_text();
+    	 	 	 break;
+    	 	 	}
+    	 	}
+    	}
+    if(old_tz!=NULL) setenv("TZ",saved_tz,1);
+    else unsetenv("TZ");
+    tzset();
+   }
+#endif
+   for(size_t z=0;z<sizeof(rz)/sizeof(rz[0]);++z)
+   	{// round trips over a wide range of years (including years <= 0 which are not in the table), and the cursor agrees with tz_zone_offset()
+   	 struct tz_cursor cur;
+   	 if(rz[z]==NULL) continue;
+   	 tz_cursor_init(&cur,rz[z]);
+   	 for(int i=0;i<20000;++i)
+   	 	{time_t t,t2;
+   	 	 int dst;
+   	 	 const char *abbrev;
+   	 	 struct tm tm_z,tm_2;
+   	 	 struct strp_tz_struct tz_z,tz_2;
+   	 	 x^=x<<13; x^=x>>7; x^=x<<17;
+   	 	 t=(time_t)(x%UINT64_C(200000000000))-INT64_C(100000000000); // -1200 -> 5100
+   	 	 if(i%8==0) t=(time_t)x;
+   	 	 nos_tests++;
+   	 	 init_strp_tz(&tz_z);
+   	 	 init_strp_tz(&tz_2);
+   	 	 UTC_sec_to_tm_zone(t,&tm_z,&tz_z,rz[z]);
+   	 	 tm_2=tm_z;
+   	 	 t2=UTC_mktime_zone(&tm_2,&tz_2,rz[z]);
+   	 	 if(i%8!=0 && (!same_tm(&tm_z,&tm_2) || !same_strp_tz(&tz_z,&tz_2) || (t2!=t && tz_zone_offset(rz[z],t,NULL,NULL)==tz_zone_offset(rz[z],t2,NULL,NULL))))
+   	 	 	{++errs;
+   	 	 	 red_text();
+   	 	 	 printf("Error: UTC_mktime_zone() for \"%s\" t=%.0f gave %.0f\n",good_strings[z],(double)t,(double)t2);
+   	 	 	 normal_text();
+   	 	 	 break;
+   	 	 	}
+   	 	 for(int j=0;j<3;++j)
+   	 	 	{time_t tc= j==0 ? t : j==1 ? cur.end-1 : cur.end; // then either side of the end of its interval
+   	 	 	 tz_cursor_offset(&cur,t);
+   	 	 	 if(j>0 && cur.end==INT64_MAX) break;
+   	 	 	 nos_tests++;
+   	 	 	 if(tz_cursor_offset(&cur,tc)!=tz_zone_offset(rz[z],tc,&dst,&abbrev) || cur.isdst!=dst || cur.abbrev!=abbrev || tc<cur.start || tc>=cur.end)
+   	 	 	 	{++errs;
+   	 	 	 	 red_text();
+   	 	 	 	 printf("Error: tz_cursor_offset() for \"%s\" t=%.0f gave %d expected %d\n",good_strings[z],(double)tc,cur.off,tz_zone_offset(rz[z],tc,NULL,NULL));
+   	 	 	 	 normal_text();
+   	 	 	 	 i=20000;
+   	 	 	 	 break;
+   	 	 	 	}
+   	 	 	}
+   	 	}
+   	}
+   if(rz[0]!=NULL)
+   	for(int i=0;i<4000;++i)
+   		{// DST starts on the 2nd Sunday in March in any year (years <= 0 are not in the table, and do not follow the 400 year cycle if year 0 is not a leap year)
+   		 int64_t year;
+   		 int sunday;
+   		 int day_of_week(int64_t year,int month, int mday); /* in time_local.h, hidden by the variable day_of_week above */
+   		 x^=x<<13; x^=x>>7; x^=x<<17;
+   		 year=(int64_t)(x%6000)-3000;
+   		 sunday=1+(7-day_of_week(year,2,1))%7; // the 1st Sunday
+   		 for(int j=0;j<3;++j)
+   		 	{struct tm tm_z;
+   		 	 struct strp_tz_struct tz_z;
+   		 	 memset(&tm_z,0,sizeof(tm_z));
+   		 	 tm_z.tm_year=(int)(year-1900);
+   		 	 tm_z.tm_mon=2;
+   		 	 tm_z.tm_mday=sunday+(j==0 ? 0 : j==1 ? 6 : 7); // 1st Sunday, the Saturday after it, 2nd Sunday
+   		 	 tm_z.tm_hour=12;
+   		 	 tm_z.tm_isdst= -1;
+   		 	 init_strp_tz(&tz_z);
+   		 	 UTC_mktime_zone(&tm_z,&tz_z,rz[0]);
+   		 	 nos_tests++;
+   		 	 if(tm_z.tm_isdst!=(j==2) || tm_z.tm_hour!=12)
+   		 	 	{++errs;
+   		 	 	 red_text();
+   		 	 	 printf("Error: \"%s\" gives isdst=%d on %d-03-%02d\n",good_strings[0],tm_z.tm_isdst,(int)year,tm_z.tm_mday);
+   		 	 	 normal_text();
+   		 	 	 i=4000;
+   		 	 	 break;
+   		 	 	}
+   		 	}
+   		}
+   for(size_t z=0;z<sizeof(rz)/sizeof(rz[0]);++z)
+   	tz_zone_free(rz[z]);
+  }
+  for(size_t z=0;z<sizeof(zones)/sizeof(zones[0]);++z)
+  	tz_zone_free(zones[z]);
+ }
  if(errs)
  	printf("\n%u tests conducted, %u error(s) found\n",nos_tests,errs);
  else
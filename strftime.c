@@ -13,11 +13,12 @@
    This allows for example strptime() to be used to decode "time stamps" in a "Log file" recorded at a different time (and even time zone), 
    with strftime() used to display values from these timestamps as if it was in the locale where the log was created.
    If you want to guarantee that no information is passed into strftime() from strptime(), then call init_strp_tz() before calling strptime(). 
+   ya_strftime_r() and ya_strftime_plan_r() take a pointer to a caller owned struct strp_tz_struct instead of using the global strp_tz, so they can be used from multiple threads at once.
    
    An extensive test program is also provided (main.c).
    For gcc under Linux compile test program with :
 
-     gcc -Wall -O3 -o date-time main.c strftime.c strptime.c
+     gcc -Wall -O3 -o date-time main.c strftime.c strptime.c time_batch.c
      ./date-time
   
    For dev-C++ (tested with tdmgcc 10.3.0) there is a *.dev file, and the project files (*.cbproj) for Builder C++ are also present. 
@@ -62,7 +63,8 @@
  * For extensions from SunOS, add SUNOS_EXT.
  * For extensions from HP/UX, add HPUX_EXT.
  * For VMS dates, add VMS_EXT.
- * For complete POSIX semantics, add POSIX_SEMANTICS.
+ * The OS values for %z and %Z are read (after calling tzset()) the 1st time they are needed after the strp_tz_struct
+ *  was initialised, so changes to TZ are picked up by the next strptime() or init_strp_tz() (POSIX_SEMANTICS is no longer needed).
  *
  * The code for %X follows the C99 specification for
  * the "C" locale.
@@ -115,6 +117,7 @@
 #include <ctype.h>
 #include <time.h>
 #include <stdint.h>
+#include <stddef.h> /* for ptrdiff_t */
 // #include <inttypes.h>
 #include <limits.h>
 #include <stdlib.h>
@@ -129,7 +132,7 @@
 // #define SUNOS_EXT		/* stuff in SunOS strftime routine */
 // #define VMS_EXT			/* include %v for VMS date format */
 // #define HPUX_EXT		/* non-conflicting stuff in HP-UX date */
-// #define POSIX_SEMANTICS		/* call tzset() if TZ changes */
+// #define POSIX_SEMANTICS		/* no longer used - tzset() is now always called before the OS values for %z and %Z are used */
 // #define POSIX_2008		/* flag and fw for C, F, G, Y formats */
 // #define HAVE_NL_LANGINFO		/* locale-based values [ does not work for Windows at present ] */
 #define HAVE_TZNAME 1 /* has to be defined as 1 ! */
@@ -151,6 +154,7 @@
 
 extern const char * strp_weekdays[] ;/* full names of weekdays and months - defined in strptime.c */
 extern const char * strp_monthnames[];
+bool strp_f_digits(const struct strp_tz_struct *tz, uint64_t *digits); /* digits for %f from tz->f_asecs - defined in strptime.c */
 
 extern void tzset(void);
 static int weeknumber(const struct tm *timeptr, int firstweekday);
@@ -198,10 +202,10 @@ int strnicmp( const char * s1, const char * s2, size_t n )
 }
 #endif 
 
-// 3 functions below based on those in K&R 2nd ed pp 111, changed so month is 0..11 to match the rest of the code
-static char daytab[2][13]={ /* table of days in a month for non leap years and leap years*/
-	 {31,28,31,30,31,30,31,31,30,31,30,31},
-	 {31,29,31,30,31,30,31,31,30,31,30,31}
+// 3 functions below originally based on those in K&R 2nd ed pp 111, changed so month is 0..11 to match the rest of the code and to use a table of cumulative days so no loops are needed
+static const short cumdays[2][13]={ /* days in the year before the start of each month for non leap years and leap years, [12] is the number of days in the year */
+	 {0,31,59,90,120,151,181,212,243,273,304,334,365},
+	 {0,31,60,91,121,152,182,213,244,274,305,335,366}
 };
 
 
@@ -221,41 +225,42 @@ void month_day(int64_t year, int yearday, int*pmonth, int *pday)
 /* set month, day from year (actual year with no offset) and day of year (actually days since jan 1st, 0-365) */
 /* returns pmonth as 0->11, 0-Jan, and pday=1->31 */
 {int i;
- bool leap =is_leap(year);
- ++yearday; // supplied as 0=jan 1st, below treats that as the 1st day of the year
- for(i=0;yearday>daytab[leap][i] && i<12;i++) // test for i<12 avoids overrunning the array if yearday is too big
-	yearday-=daytab[leap][i];
+ const short *cd=cumdays[is_leap(year)];
+ if(yearday<0) i=0; // invalid, gives day<=0 
+ else if(yearday>=cd[12]) i=12; // invalid, past the end of the year (gives month=12)
+ else
+ 	{i=yearday>>5; // every month has <=31 days so month is yearday/32 or the month after that
+ 	 i+=(yearday>=cd[i+1]);
+ 	}
  *pmonth=i;// 0->11
- *pday=yearday;
+ *pday=yearday-cd[i]+1;
 }
 
 int day_of_year(int64_t year, int month, int day) // year without offset, month 0->11, day 1->31, returns days since 1st jan (0>365)
-{bool leap =is_leap(year);
- if(month>11) month=11;// ensure we don't overrun the array
- for(int i=0;i<month;++i)
- 	 day+=daytab[leap][i];
- return day-1; // days since 1st jan start at 0
+{if(month>11) month=11;// ensure we don't overrun the array
+ else if(month<0) month=0;
+ return cumdays[is_leap(year)][month]+day-1; // days since 1st jan start at 0
+}
+
+#define CIVIL_ERAS INT64_C(8388608) /* 2^23 eras (of 400 years) = 3,355,443,200 years, more than the most negative year allowed. Used to make values +ve so unsigned divisions can be used */
+
+static inline int64_t year_to_days(int64_t year)
+{ // converts year to days since 1st Jan 1970 (of 1st Jan of year), uses the "days from civil" method (see sec_to_tm() for more details) which has no loops
+  // While year is a int64_t its assumed to come from an int (32 bits) with a 1900 offset, so we don't need to worry about overflow in the conversion
+ uint64_t y=(uint64_t)(year-1+CIVIL_ERAS*400); // years start on 1st March, so Jan 1st is in the previous year
+ uint64_t era=y/400; // 400 years is always 146097 days
+ unsigned int yoe=(unsigned int)(y-era*400); // year of era 0..399
+ int64_t days=((int64_t)era-CIVIL_ERAS)*146097 + yoe*365 + yoe/4 - yoe/100 /* days to 1st March of year-1 */
+ 			  + 306 /* 1st March to 1st Jan */ - 719468 /* offset to make 1st Jan 1970=0 (as 1st March 0000 is day 0 above) */;
+#ifndef YEAR0LEAP
+ days+=(year<=0); // year 0 is not a leap year, so years <=0 start 1 day later than in the (proleptic) Gregorian calendar
+#endif
+ return days;
 }
 
 static inline time_t year_to_s(int64_t year)
 { // converts year to seconds since 1st Jan 1970.
-  // While year is a int64_t its assumed to come from an int (32 bits) with a 1900 offset, so we don't need to worry about overflow in the conversion
- int64_t lyears;
- /* we want to factor in leap years to the year before noting year 0 is not a leap year, so 0,1,2,3,4,5,6,.. we want to count 1st leap year when year=5 (as year 4 is a leap year) 
- 	for negative years the first one we want to count is the year -5 */
- if(year>=0) lyears=year-1; /* 5-1=4 so lyears/4=1.  0 => -1 but -1/4 is still 0 so thats OK */
- else lyears=year+1;/* -5 +1 = -4 so lyears/4= -1 */
-  // calculation now just needs to use yday, year and lyears
-#ifdef YEAR0LEAP  
-	/* if year>0 then 1 more leap year to add, also adds 1 to offset for 1970 so overall this cancels out for 1970 */
- return ( (time_t)(lyears/4) - (time_t)(lyears/100) + (time_t)(lyears/400 )   + (time_t)(year>0?1:0)+  
-		  (time_t)year*365 - (time_t)719528  /* offset to make 1st Jan 1970=0 */
-	    )*(time_t)86400; /* 86400=24*60*60;  hours->minutes->seconds */ 
-#else
- return ( (time_t)(lyears/4) - (time_t)(lyears/100) + (time_t)(lyears/400 )   +  
-		  (time_t)year*365 - (time_t)719527  /* offset to make 1st Jan 1970=0 */
-	    )*(time_t)86400; /* 86400=24*60*60;  hours->minutes->seconds */
-#endif	    
+ return (time_t)year_to_days(year)*86400; /* 86400=24*60*60;  hours->minutes->seconds */
 }
 
 static inline time_t ya_mktime_s(int64_t year, int month, int mday, int yday, int hour, int min, int sec ) /* version of mktime() that returns secs  */
@@ -273,7 +278,7 @@ static inline time_t ya_mktime_s(int64_t year, int month, int mday, int yday, in
  	{// get yday from month & mday [ yday might already be valid, but we have no way to know ]
  	 yday=day_of_year(year,month,mday);
  	}
- return year_to_s(year)+((( (time_t)yday 
+ return ((( (time_t)(year_to_days(year)+yday)
 						    )*24 + hour /* now have hours - midnight tomorrow handled here */
 						  )*60 + min /* now have minutes */
 						)*60 + sec; /* finally seconds */
@@ -289,12 +294,10 @@ time_t ya_mktime_tm(const struct tm *tp) /* version of mktime() that returns sec
 
 
 int day_of_week_yd(int64_t year,int yday) /* year with no offset eg 1900 and yday is days since 1st Jan 0->365 */ 
-{// time_t ya_mktime_s(int64_t year, int month,int mday,const int yday,const int hour,const int min, const int sec ) /* version of mktime() that returns secs  */
- int64_t sy=ya_mktime_s(year, 0,0,yday,0,0,0 ); /* version of mktime() that returns secs since 1st Jan 1970 */
- int64_t days=sy/(3600*24); 
- days=(days+4)%7; // +4 as 1st jan 1970 (secs=0) was a Thursday . 
- if(days<0)days+=7;
- return days;
+{int64_t days=year_to_days(year)+yday; // days since 1st Jan 1970
+ int wday=(int)((days+4)%7); // +4 as 1st jan 1970 (days=0) was a Thursday . 
+ if(wday<0) wday+=7;
+ return wday;
 }
 
 int day_of_week(int64_t y, int m, int d)	/* 0 = Sunday  */
@@ -312,8 +315,11 @@ int cmp_tm(struct tm *tm1,struct tm *tm2) /* returns sign(tm1-tm2) */
  return 1;
 }
 
-#if 0 /* use a binary search to find the year This takes 11.4 secs for test program vs 10.3 secs for approximation below, so #if 0 is recommended */
-void sec_to_tm(time_t t,struct tm *tp) // reverse of ya_mktime_tm, converts secs since epoch to the numbers of tp
+#ifdef SEC_TO_TM_PREV
+/* The two functions below are the previous versions of sec_to_tm(), they are only compiled when SEC_TO_TM_PREV is defined (eg -DSEC_TO_TM_PREV on the gcc command line)
+   so bench.c can compare their speed with sec_to_tm() and main.c can check they all give identical results. They are not declared in time_local.h. */
+/* use a binary search to find the year This takes 11.4 secs for test program vs 10.3 secs for approximation below */
+void sec_to_tm_bsearch(time_t t,struct tm *tp) // reverse of ya_mktime_tm, converts secs since epoch to the numbers of tp
 {
  int64_t year;
  int month=0, mday=1, hour=0, min=0, sec=0,yday=0;
@@ -363,8 +369,8 @@ else year=mid;// found exactly
  tp->tm_wday=day_of_week_yd(year,yday);
  // does not set  tm_isdst
 }
-#else /* use an approximation to find the year */
-void sec_to_tm(time_t t,struct tm *tp) // reverse of ya_mktime_tm, converts secs since epoch to the numbers of tp
+/* use an approximation to find the year */
+void sec_to_tm_approx(time_t t,struct tm *tp) // reverse of ya_mktime_tm, converts secs since epoch to the numbers of tp
 {/* note that sec_to_tm() sets all fields in tm (except tz), whereas ya_mktime_tm() does not need all fields set to work, so calling ya_mktime_tm() then sec_to_tm() will ensure all fields are set */
  int64_t year;
  int month, mday, hour, min, sec,yday;
@@ -404,6 +410,52 @@ void sec_to_tm(time_t t,struct tm *tp) // reverse of ya_mktime_tm, converts secs
 }
 #endif
 
+/* sec_to_tm() uses the "days from civil" method (see http://howardhinnant.github.io/date_algorithms.html#civil_from_days ) 
+   days are counted from 1st March 0000 so leap days are at the end of the year, 400 years (an era) is always exactly 146097 days
+   so the year, day of year, month and day of month can all be calculated directly without any loops (and without calling ya_mktime_s() again to find the day of the week).
+   This is about twice as fast as sec_to_tm_approx() and more than 10 times faster than sec_to_tm_bsearch() (see bench.c)
+*/
+void sec_to_tm(time_t t,struct tm *tp) // reverse of ya_mktime_tm, converts secs since epoch to the numbers of tp
+{/* note that sec_to_tm() sets all fields in tm (except tz), whereas ya_mktime_tm() does not need all fields set to work, so calling ya_mktime_tm() then sec_to_tm() will ensure all fields are set */
+ uint64_t u, days, era;
+ int64_t year;
+ unsigned int doe, yoe, doy, mp, secs, shift=0, leap;
+ int month, mday, yday;
+#ifndef YEAR0LEAP
+ shift=(t < INT64_C(-62135596800)); // -62135596800 is 1st Jan 0001, year 0 is not a leap year here so everything before that is 1 day later than the (proleptic) Gregorian calendar used below 
+ t-=shift*86400;
+#endif
+ /* offset t so its always positive (for all valid years) so unsigned divisions can be used, the offset is a multiple of 400 years (1 era = 146097 days) plus
+    719468 days so days are counted from 1st March 0000 */
+ u=(uint64_t)t + (uint64_t)(CIVIL_ERAS*146097+719468)*86400;
+ days=u/86400; // 86400=24*60*60
+ secs=(unsigned int)(u-days*86400); // 0..86399
+ era=days/146097; // 146097 days in 400 years
+ doe=(unsigned int)(days-era*146097); // day of era 0..146096, from here on everything fits into an unsigned int
+ yoe=(doe - doe/1460 + doe/36524 - doe/146096)/365; // year of era 0..399
+ doy=doe-(365*yoe + yoe/4 - yoe/100); // day of year starting at 1st March 0..365
+ mp=(5*doy+2)/153; // month starting at March 0..11
+ mday=(int)(doy-(153*mp+2)/5+1); // 1..31
+ month=mp<10 ? (int)mp+2 : (int)mp-10; // 0..11 0=Jan
+ leap=((yoe&3)==0) & ((yoe%100!=0) | (yoe==0)); // Gregorian leap year (used for March onwards), & and | rather than && and || to avoid branches
+ yday=mp<10 ? (int)(doy+59+leap) : (int)doy-306; // days since 1st Jan
+ year=((int64_t)era-CIVIL_ERAS)*400+yoe+(mp>=10); // Jan and Feb are in the next year
+#ifndef YEAR0LEAP
+ if(year==0) month_day(year,yday,&month,&mday); // yday is correct, but month & day need to allow for year 0 not being a leap year
+#endif
+ if(year-1900 < -INT_MAX ) year=-INT_MAX+1900; // clip at min (subtract 1900 below)
+ else if(year-1900 > INT_MAX ) year=(int64_t)INT_MAX+1900; // clip at max (subtract 1900 below)
+ tp->tm_year=year-1900;
+ tp->tm_mon=month;
+ tp->tm_mday=mday;
+ tp->tm_hour=secs/3600;
+ tp->tm_min=(secs/60)%60;
+ tp->tm_sec=secs%60;
+ tp->tm_yday=yday;
+ tp->tm_wday=(doe+3+shift)%7; // 146097 is a multiple of 7 so the day of the week only depends on doe, 1st March 0000 was a Wednesday (3)
+ // does not set  tm_isdst
+}
+
 time_t ya_mktime(struct tm *tp) /* fully functional version of mktime() that returns secs and takes (and changes if necessary) timeptr */
 {time_t s;
  s=ya_mktime_tm(tp); // convert tp to secs
@@ -427,34 +479,6 @@ void UTC_sec_to_tm(time_t t,struct tm *tp,struct strp_tz_struct *tz ) // reverse
  sec_to_tm(s,tp); 	
 }
 
-#ifdef POSIX_2008
-/* iso_8601_2000_year --- format a year per ISO 8601:2000 as in 1003.1 */
-
-static void
-iso_8601_2000_year(char *buf, int year, size_t fw)
-{
-	int extra;
-	char sign = '\0';
-
-	if (year >= -9999 && year <= 9999) {
-		sprintf(buf, "%0*d", (int) fw, year);
-		return;
-	}
-
-	/* now things get weird */
-	if (year > 9999) {
-		sign = '+';
-	} else {
-		sign = '-';
-		year = -year;
-	}
-
-	extra = year / 10000;
-	year %= 10000;
-	sprintf(buf, "%c_%04d_%d", sign, extra, year);
-}
-#endif /* POSIX_2008 */
-
 #ifdef HAVE_NL_LANGINFO
 /* days_a() --- return the short name for the day of the week */
 static const char *
@@ -542,128 +566,270 @@ ampm(int index)
 }
 #endif /* ifdef HAVE_NL_LANGINFO */
 
+struct strf_spec /* one conversion specification from a format string */
+	{
+	 char conv; /* the conversion specifier eg 'Y' */
+	 char flag; /* POSIX_2008 '+' flag or '\0' */
+	 int pad; /* POSIX_2008 pad character ('0') or '\0' */
+	 size_t fw; /* POSIX_2008 field width, 0 if not given */
+	};
+#define STRF_MAX_FW 99 /* the output of any field (including its POSIX_2008 field width) is at most this many characters, so it fits in a 100 character buffer */
+#define STRF_ZONE_LEN 7 /* longest zone abbreviation %Z outputs (from a struct tz_zone, see TZ_ABBREV_LEN) */
 
-/* strftime() --- produce formatted time */
-size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm *timeptr)
-{
-	char *endp = s + maxsize;
-	char *start = s;
-	auto char tbuf[100];
-	long off;
-	int i, w;
-	long y;
-	static short first = 1;
-#ifdef POSIX_SEMANTICS
-	static char *savetz = NULL;
-	static int savetzlen = 0;
-	char *tz;
-#endif /* POSIX_SEMANTICS */
+static const char *
+strf_composite(char conv)
+{/* returns the format that conversion specifier conv is equivalent to, or NULL if conv is not a composite specifier */
+	switch (conv) {
+	case 'c':	/* appropriate date and time representation */
+		/*
+		 * This used to be:
+		 *
+		 * strftime(tbuf, sizeof tbuf, "%a %b %e %H:%M:%S %Y", timeptr);
+		 *
+		 * Per the ISO 1999 C standard, it was this:
+		 * strftime(tbuf, sizeof tbuf, "%A %B %d %T %Y", timeptr);
+		 *
+		 * Per the ISO 2011 C standard, it is now this:
+		 */
+#ifdef HAVE_NL_LANGINFO
+		return nl_langinfo(D_T_FMT);
+#else
+		return "%a %b %e %T %Y";
+#endif
 
-#ifdef POSIX_2008
-	int pad;
-	size_t fw;
-	char flag;
+	case 'D':	/* date as %m/%d/%y */
+		return "%m/%d/%y";
+
+#ifndef POSIX_2008
+	case 'F':	/* ISO 8601 date representation (POSIX_2008 version is in strf_field() as it supports a field width) */
+		return "%Y-%m-%d";
 #endif /* POSIX_2008 */
 
-	if(strp_tz.initialised==0)
-    	init_strp_tz(&strp_tz);
-#ifdef __GNUC__ 
- #pragma GCC diagnostic ignored "-Wnonnull-compare" /* Peter Miller - "fix" incorrect gcc warning 321	26	strftime.c	[Warning] 'nonnull' argument 'format' compared to NULL [-Wnonnull-compare] */
+	case 'r':	/* time as %I:%M:%S %p */
+		return "%I:%M:%S %p";
+
+	case 'R':	/* time as %H:%M */
+		return "%H:%M";
+
+	case 'T':	/* time as %H:%M:%S */
+		return "%H:%M:%S";
+
+	case 'x':	/* appropriate date representation */
+		/*
+		 * Up to the 2011 standard, this code used:
+		 * strftime(tbuf, sizeof tbuf, "%A %B %d %Y", timeptr);
+		 *
+		 * Now, per the 2011 C standard (C99), this is: "%m/%d/%y"
+		 */
+#ifdef HAVE_NL_LANGINFO
+		return nl_langinfo(D_FMT);
+#else
+		return "%m/%d/%y";
 #endif
-	if (s == NULL || format == NULL || timeptr == NULL || maxsize == 0)
-		return 0;
-#ifdef __GNUC__ 		
- #pragma GCC diagnostic warning "-Wnonnull-compare" /* turn warning back on again */
-#endif 
-	/* quick check if we even need to bother */
-	if (strchr(format, '%') == NULL && strlen(format) + 1 >= maxsize)
-		return 0;
 
-#ifndef POSIX_SEMANTICS
-	if (first) {
-		tzset();
-		first = 0;
+	case 'X':	/* appropriate time representation */
+#ifdef HAVE_NL_LANGINFO
+		return nl_langinfo(T_FMT);
+#else
+		return "%H:%M:%S"; /* same as %T */
+#endif
 	}
-#else	/* POSIX_SEMANTICS */
-	tz = getenv("TZ");
-	if (first) {
-		if (tz != NULL) {
-			int tzlen = strlen(tz);
-
-			savetz = (char *) malloc(tzlen + 1);
-			if (savetz != NULL) {
-				savetzlen = tzlen + 1;
-				strcpy(savetz, tz);
-			}
-		}
-		tzset();
-		first = 0;
+	return NULL;
+}
+
+/* Integer emitters used by strf_field() in place of snprintf(), each writes the number (and a terminating null) to p and returns a pointer to the null */
+static const char strf_2digits[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+/* strf_2d() --- 0 <= v <= 99 as 2 digits, as "%02d" */
+static inline char *
+strf_2d(char *p, unsigned int v)
+{
+	memcpy(p, strf_2digits + 2 * v, 2);
+	p[2] = '\0';
+	return p + 2;
+}
+
+/* strf_2s() --- 0 <= v <= 99 space padded to 2 characters, as "%2d" */
+static inline char *
+strf_2s(char *p, unsigned int v)
+{
+	if (v < 10) {
+		p[0] = ' ';
+		p[1] = (char) ('0' + v);
+		p[2] = '\0';
+		return p + 2;
 	}
-	/* if we have a saved TZ, and it is different, recapture and reset */
-	if (tz && savetz && (tz[0] != savetz[0] || strcmp(tz, savetz) != 0)) {
-		i = strlen(tz) + 1;
-		if (i > savetzlen) {
-			savetz = (char *) realloc(savetz, i);
-			if (savetz) {
-				savetzlen = i;
-				strcpy(savetz, tz);
-			}
-		} else
-			strcpy(savetz, tz);
-		tzset();
+	return strf_2d(p, v);
+}
+
+/* strf_uint() --- v zero padded to at least width digits, as "%0*llu" */
+static char *
+strf_uint(char *p, uint64_t v, int width)
+{
+	char d[20]; /* 2^64 has 20 digits */
+	char *q = d + sizeof d;
+	int n;
+
+	while (v >= 100) {
+		q -= 2;
+		memcpy(q, strf_2digits + 2 * (v % 100), 2);
+		v /= 100;
 	}
-#endif	/* POSIX_SEMANTICS */
+	if (v >= 10) {
+		q -= 2;
+		memcpy(q, strf_2digits + 2 * v, 2);
+	} else
+		*--q = (char) ('0' + v);
+	n = (int) (d + sizeof d - q);
+	for (; width > n; --width)
+		*p++ = '0';
+	memcpy(p, q, n);
+	p += n;
+	*p = '\0';
+	return p;
+}
+
+/* strf_int() --- v zero padded to at least width characters (including any sign), as "%0*lld" */
+static inline char *
+strf_int(char *p, int64_t v, int width)
+{
+	if (v < 0) {
+		*p++ = '-';
+		return strf_uint(p, 0 - (uint64_t) v, width - 1);
+	}
+	return strf_uint(p, (uint64_t) v, width);
+}
+
+/* strf_sint() --- v zero padded to at least width characters with a sign if v is negative or plus is true, as "%0*lld" or "%+0*lld" */
+static inline char *
+strf_sint(char *p, int64_t v, int width, bool plus)
+{
+	if (plus && v >= 0) {
+		*p++ = '+';
+		return strf_uint(p, (uint64_t) v, width - 1);
+	}
+	return strf_int(p, v, width);
+}
 
-	for (; *format && s < endp - 1; format++) {
-		tbuf[0] = '\0';
-		if (*format != '%') {
-			*s++ = *format;
-			continue;
-		}
 #ifdef POSIX_2008
-		pad = '\0';
-		fw = 0;
-		flag = '\0';
-		switch (*++format) {
-		case '+':
-			flag = '+';
-			/* fall through */
-		case '0':
-			pad = '0';
-			format++;
-			break;
+/* iso_8601_2000_year --- format a year per ISO 8601:2000 as in 1003.1, returns the end of the output */
+static char *
+iso_8601_2000_year(char *buf, int64_t year, size_t fw)
+{
+	uint64_t u;
 
-		case '1':
-		case '2':
-		case '3':
-		case '4':
-		case '5':
-		case '6':
-		case '7':
-		case '8':
-		case '9':
-			break;
+	if (year >= -9999 && year <= 9999)
+		return strf_int(buf, year, (int) fw);
 
-		default:
-			format--;
-			goto again;
-		}
-		for (; isdigit(*format); format++) {
-			fw = fw * 10 + (*format - '0');
-		}
-		format--;
+	/* now things get weird */
+	if (year > 9999) {
+		*buf++ = '+';
+		u = (uint64_t) year;
+	} else {
+		*buf++ = '-';
+		u = 0 - (uint64_t) year;
+	}
+	*buf++ = '_';
+	buf = strf_uint(buf, u / 10000, 4);
+	*buf++ = '_';
+	return strf_uint(buf, u % 10000, 1);
+}
 #endif /* POSIX_2008 */
 
-	again:
-		switch (*++format) {
-		case '\0':
-			*s++ = '%';
-			goto out;
+/* strf_round_f() --- 0 <= f < 1 rounded to n (0 -> STRP_F_DIGITS) decimal places as an integer, returns 10^n-1 (all 9's) if f rounds up to 1 as strptime() never rounds up to a whole second.
+   The exact binary value of f is used and halves are rounded to even, so the digits are the same as printf("%.*f") gives with glibc */
+static uint64_t
+strf_round_f(double f, int n)
+{
+	uint64_t bits, m, scale = 1, x00, x01, x10, t, lo, hi, q, rem_hi, rem_lo, half_hi, half_lo;
+	int k;
+
+	while (n-- > 0)
+		scale *= 10;
+	memcpy(&bits, &f, sizeof bits); /* IEEE 754 double */
+	m = bits & ((UINT64_C(1) << 52) - 1);
+	k = (int) ((bits >> 52) & 0x7ff);
+	if (k == 0)
+		k = 1074; /* subnormal */
+	else {
+		m |= UINT64_C(1) << 52;
+		k = 1075 - k;
+	}
+	/* now f = m/2^k with k >= 53 (as f < 1), so the result is m*10^n/2^k rounded. m*10^n < 2^113 so if k > 113 its less than a half */
+	if (k > 113)
+		return 0;
+	/* hi:lo = m*scale using 32 bit multiplications */
+	x00 = (m & 0xffffffff) * (scale & 0xffffffff);
+	x01 = (m & 0xffffffff) * (scale >> 32);
+	x10 = (m >> 32) * (scale & 0xffffffff);
+	t = (x00 >> 32) + (x01 & 0xffffffff) + (x10 & 0xffffffff);
+	lo = (t << 32) | (x00 & 0xffffffff);
+	hi = (m >> 32) * (scale >> 32) + (x01 >> 32) + (x10 >> 32) + (t >> 32);
+	/* q = hi:lo >> k, rem_hi:rem_lo are the bits shifted out and half_hi:half_lo is 2^(k-1) */
+	if (k < 64) {
+		q = (hi << (64 - k)) | (lo >> k);
+		rem_hi = half_hi = 0;
+		rem_lo = lo & ((UINT64_C(1) << k) - 1);
+		half_lo = UINT64_C(1) << (k - 1);
+	} else if (k == 64) {
+		q = hi;
+		rem_hi = half_hi = 0;
+		rem_lo = lo;
+		half_lo = UINT64_C(1) << 63;
+	} else {
+		q = hi >> (k - 64);
+		rem_hi = hi & ((UINT64_C(1) << (k - 64)) - 1);
+		rem_lo = lo;
+		half_hi = UINT64_C(1) << (k - 65);
+		half_lo = 0;
+	}
+	if ((rem_hi > half_hi || (rem_hi == half_hi && (rem_lo > half_lo || (rem_lo == half_lo && (q & 1))))) && q < scale - 1)
+		++q;
+	return q;
+}
 
-		case '%':
-			*s++ = '%';
-			continue;
+/* strf_os_zone() --- read the OS time zone into tz if its not already there, so tzset() and its globals are only used once for each initialisation of tz */
+static void
+strf_os_zone(struct strp_tz_struct *tz)
+{
+	const char *name;
+	int i, j;
+
+	if (tz->os_off_mins != strp_tz_default)
+		return;
+	tzset();
+	/*
+	 * Systems with tzname[] probably have timezone as
+	 * secs west of GMT.  Convert to mins east of GMT.
+	 */
+	tz->os_off_mins = (int) (-timezone / 60);
+	for (i = 0; i < 2; i++) {
+		name = _tzname[daylight ? i : 0]; /* the summer time name is only used if the zone has one */
+		for (j = 0; j < 4 && isalpha((unsigned char) name[j]); ++j) /* at most 4 chars - all must be letters */
+			tz->os_name[i][j] = name[j];
+		for (; j < 4; ++j)
+			tz->os_name[i][j] = '\0';
+	}
+}
+
+/* strf_field() --- convert one (non composite) field into tbuf, returns its length */
+static size_t
+strf_field(char *tbuf, size_t tbufsize, const struct strf_spec *sp, const struct tm *timeptr, struct strp_tz_struct *tz)
+{
+	long off;
+	int i, w;
+	long y;
+	char *p = NULL; /* end of the field if created by one of the integer emitters, otherwise strlen() is used */
+#ifdef POSIX_2008
+	int pad = sp->pad;
+	size_t fw = sp->fw;
+	char flag = sp->flag;
+#endif /* POSIX_2008 */
 
+	(void) tbufsize; /* only used by the POSIX_2008 and locale dependent fields */
+	tbuf[0] = '\0';
+	switch (sp->conv) {
 		case 'a':	/* abbreviated weekday name */
 			if (timeptr->tm_wday < 0 || timeptr->tm_wday > 6)
 				strcpy(tbuf, "?");
@@ -715,86 +881,40 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 #endif				
 			break;
 
-		case 'c':	/* appropriate date and time representation */
-			/*
-			 * This used to be:
-			 *
-			 * strftime(tbuf, sizeof tbuf, "%a %b %e %H:%M:%S %Y", timeptr);
-			 *
-			 * Per the ISO 1999 C standard, it was this:
-			 * strftime(tbuf, sizeof tbuf, "%A %B %d %T %Y", timeptr);
-			 *
-			 * Per the ISO 2011 C standard, it is now this:
-			 */
-#ifdef HAVE_NL_LANGINFO
-			ya_strftime(tbuf, sizeof tbuf, nl_langinfo(D_T_FMT), timeptr);
-#else
-			{ const char *f="%a %b %e %T %Y";// done this way to avoid gcc -Wformat= errors in line below
-			 ya_strftime(tbuf, sizeof tbuf, f, timeptr);
-			}
-#endif
-			break;
-
 		case 'C':
 #ifdef POSIX_2008
 			if (pad != '\0' && fw > 0) {
 				size_t min_fw = (flag ? 3 : 2);
 
-				fw = max(fw, min_fw);
-				snprintf(tbuf,sizeof(tbuf), flag
-						? "%+0*ld"
-						: "%0*ld", (int) fw,
-						(timeptr->tm_year + 1900L) / 100);
+				fw = range(min_fw, fw, STRF_MAX_FW);
+				p = strf_sint(tbuf, ((int64_t) timeptr->tm_year + 1900) / 100, (int) fw, flag != '\0');
 			} else
 #endif /* POSIX_2008 */
 #ifdef HPUX_EXT
 		century:
 #endif			
-				snprintf(tbuf,sizeof(tbuf), "%02ld", (timeptr->tm_year + 1900L) / 100);
+				p = strf_int(tbuf, ((int64_t) timeptr->tm_year + 1900) / 100, 2);
 			break;
 
 		case 'd':	/* day of the month, 01 - 31 */
 			i = range(1, timeptr->tm_mday, 31);
-			snprintf(tbuf,sizeof(tbuf), "%02d", i);
-			break;
-
-		case 'D':	/* date as %m/%d/%y */
-			ya_strftime(tbuf, sizeof tbuf, "%m/%d/%y", timeptr);
+			p = strf_2d(tbuf, i);
 			break;
 
 		case 'e':	/* day of month, blank padded */
-			snprintf(tbuf,sizeof(tbuf), "%2d", range(1, timeptr->tm_mday, 31));
+			p = strf_2s(tbuf, range(1, timeptr->tm_mday, 31));
 			break;
 
-		case 'E':
-			/* POSIX (now C99) locale extensions, ignored for now */
-			goto again;
 		case 'f': /* local extension - fractional part of seconds */
 			{
-			 if(strp_tz.f_secs_p10>=0)
-				{// -ve values for f_secs_p10 are not allowed (default is big negative)
-#if 1
-				 snprintf(tbuf,sizeof(tbuf),"%0.*f",strp_tz.f_secs_p10,strp_tz.f_secs);
-				 if(tbuf[0]=='0' && tbuf[1]=='.')
-					{ // delete leading 0. from number as we only want digits after decimal point
-					 char *s1,*s2;
-					 for(s1=tbuf,s2=tbuf+2;*s1!=0 && *s2!=0;)*s1++=*s2++; // copy backwards so we overwrite 0. at start which we don't want
-					 *s1=0;// null terminate resultant string (above copy should have stopped with *s2==0)
-					}
-#else
- #ifdef __GNUC__
-  #pragma GCC diagnostic ignored "-Wformat=" /* Peter Miller - "fix" [Warning] unknown conversion type character '#' in format [-Wformat=] */
-  #pragma GCC diagnostic ignored "-Wformat-extra-args" /* Peter Miller - "fix" [Warning] too many arguments for format [-Wformat-extra-args] */
- #endif
-				 snprintf(tbuf,sizeof(tbuf),"%0.*#f",strp_tz.f_secs_p10,strp_tz.f_secs);// the # in this line causes gcc compiler warnings which are turned off before and on again after this line.
- #ifdef __GNUC__
-  #pragma GCC diagnostic warning "-Wformat" /* turn warning back on again. If this says  "-Wformat=" as you might expect to match "ignored" above, GCCgives an error and fails compilation! */
-  #pragma GCC diagnostic warning "-Wformat-extra-args" /* turn warning back on again */
- #endif
-				 char *s1,*s2;
-				 for(s1=tbuf,s2=tbuf+2;*s1!=0 && *s2!=0;)*s1++=*s2++; // copy backwards so we overwrite 0. at start which we don't want
-				 *s1=0;// null terminate resultant string (above copy should have stopped with *s2==0)
-#endif
+			 uint64_t digits;
+			 if(strp_f_digits(tz,&digits))
+				p = strf_uint(tbuf, digits, tz->f_secs_p10); // exactly the digits strptime() read (f_asecs)
+			 else if(tz->f_secs_p10>=0 && tz->f_secs>=0 && tz->f_secs<1)
+				{// -ve values for f_secs_p10 are not allowed (default is big negative), at most STRP_F_DIGITS digits are output (as many as strptime() reads)
+				 int n=min(tz->f_secs_p10,STRP_F_DIGITS);
+				 if(n>0)
+					p=strf_uint(tbuf,strf_round_f(tz->f_secs,n),n); // only the digits after the decimal point
 			 	}
 			 else
 			 	{tbuf[0]='?'; // produce "?" for invalid inputs (otherwise test program fails)
@@ -802,45 +922,44 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 				}
 			}		
 			break;
+#ifdef POSIX_2008
 		case 'F':	/* ISO 8601 date representation */
 		{
-#ifdef POSIX_2008
 			/*
 			 * Field width for %F is for the whole thing.
 			 * It must be at least 10.
 			 */
-			char m_d[10];
-			ya_strftime(m_d, sizeof m_d, "-%m-%d", timeptr);
 			size_t min_fw = 10;
 
 			if (pad != '\0' && fw > 0) {
-				fw = max(fw, min_fw);
+				fw = range(min_fw, fw, STRF_MAX_FW);
 			} else {
 				fw = min_fw;
 			}
 
 			fw -= 6;	/* -XX-XX at end are invariant */
 
-			iso_8601_2000_year(tbuf, timeptr->tm_year + 1900, fw);
-			strcat(tbuf, m_d);
-#else
-			ya_strftime(tbuf, sizeof tbuf, "%Y-%m-%d", timeptr);
-#endif /* POSIX_2008 */
+			p = iso_8601_2000_year(tbuf, (int64_t) timeptr->tm_year + 1900, fw);
+			*p++ = '-';
+			p = strf_2d(p, range(0, timeptr->tm_mon, 11) + 1);
+			*p++ = '-';
+			p = strf_2d(p, range(1, timeptr->tm_mday, 31));
 		}
 			break;
+#endif /* POSIX_2008 */
 
 		case 'g':
 		case 'G':
 			/*
 			 * Year of ISO week.
-			 * If strp_tz.year_G!= strp_tz_default we already have it, otherwsie calculate it as below
+			 * If tz->year_G!= strp_tz_default we already have it, otherwsie calculate it as below
 			 *  If it's December but the ISO week number is one,
 			 *  that week is in next year.
 			 *  If it's January but the ISO week number is 52 or
 			 *  53, that week is in last year.
 			 *  Otherwise, it's this year.
 			 */
-			if(strp_tz.year_G== strp_tz_default)
+			if(tz->year_G== strp_tz_default)
 				{
 				 w = iso8601wknum(timeptr);
 				 if (timeptr->tm_mon == 11 && w == 1)
@@ -851,23 +970,20 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 					y = 1900L + timeptr->tm_year;
 				}
 			else
-				y=strp_tz.year_G;	// simple case - we already have the correct year
-			if (*format == 'G') {
+				y=tz->year_G;	// simple case - we already have the correct year
+			if (sp->conv == 'G') {
 #ifdef POSIX_2008
 				if (pad != '\0' && fw > 0) {
 					size_t min_fw = 4;
 
-					fw = max(fw, min_fw);
-					snprintf(tbuf,sizeof(tbuf), flag
-							? "%+0*ld"
-							: "%0*ld", (int) fw,
-							y);
+					fw = range(min_fw, fw, STRF_MAX_FW);
+					p = strf_sint(tbuf, y, (int) fw, flag != '\0');
 				} else
 #endif /* POSIX_2008 */
-					snprintf(tbuf,sizeof(tbuf), "%ld", y);
+					p = strf_int(tbuf, y, 1);
 			}
 			else
-				snprintf(tbuf,sizeof(tbuf), "%02ld", y % 100);
+				p = strf_int(tbuf, y % 100, 2);
 			break;
 
 		case 'h':	/* abbreviated month name */
@@ -875,7 +991,7 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 
 		case 'H':	/* hour, 24-hour clock, 00 - 23 */
 			i = range(0, timeptr->tm_hour, 23);
-			snprintf(tbuf,sizeof(tbuf), "%02d", i);
+			p = strf_2d(tbuf, i);
 			break;
 
 		case 'I':	/* hour, 12-hour clock, 01 - 12 */
@@ -884,21 +1000,22 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 				i = 12;
 			else if (i > 12)
 				i -= 12;
-			snprintf(tbuf,sizeof(tbuf), "%02d", i);
+			p = strf_2d(tbuf, i);
 			break;
 
 		case 'j':	/* day of the year, 001 - 366 */
-			snprintf(tbuf,sizeof(tbuf), "%03d", timeptr->tm_yday + 1);
+			i = range(0, timeptr->tm_yday, 365);
+			p = strf_uint(tbuf, i + 1, 3);
 			break;
 
 		case 'm':	/* month, 01 - 12 */
 			i = range(0, timeptr->tm_mon, 11);
-			snprintf(tbuf,sizeof(tbuf), "%02d", i + 1);
+			p = strf_2d(tbuf, i + 1);
 			break;
 
 		case 'M':	/* minute, 00 - 59 */
 			i = range(0, timeptr->tm_min, 59);
-			snprintf(tbuf,sizeof(tbuf), "%02d", i);
+			p = strf_2d(tbuf, i);
 			break;
 
 		case 'n':	/* same as \n */
@@ -906,10 +1023,6 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 			tbuf[1] = '\0';
 			break;
 
-		case 'O':
-			/* POSIX (now C99) locale extensions, ignored for now */
-			goto again;
-
 		case 'p':	/* am or pm based on 12-hour clock */
 			i = range(0, timeptr->tm_hour, 23);
 #ifndef HAVE_NL_LANGINFO
@@ -925,21 +1038,13 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 #endif				
 			break;
 
-		case 'r':	/* time as %I:%M:%S %p */
-			ya_strftime(tbuf, sizeof tbuf, "%I:%M:%S %p", timeptr);
-			break;
-
-		case 'R':	/* time as %H:%M */
-			ya_strftime(tbuf, sizeof tbuf, "%H:%M", timeptr);
-			break;
-			
 		case 's':	/* time as seconds since the Epoch */
-			 snprintf(tbuf,sizeof(tbuf), "%lld", (long long)ya_mktime_tm(timeptr)); // (long long) added as time_t might only be long
+			 p = strf_int(tbuf, ya_mktime_tm(timeptr), 1);
 			 break;
 			 
 		case 'S':	/* second, 00 - 60 */
 			i = range(0, timeptr->tm_sec, 60);
-			snprintf(tbuf,sizeof(tbuf), "%02d", i);
+			p = strf_2d(tbuf, i);
 			break;
 
 		case 't':	/* same as \t */
@@ -947,66 +1052,42 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 			tbuf[1] = '\0';
 			break;
 
-		case 'T':	/* time as %H:%M:%S */
-		the_time:
-			ya_strftime(tbuf, sizeof tbuf, "%H:%M:%S", timeptr);
-			break;
-
 		case 'u':
 		/* ISO 8601: Weekday as a decimal number [1 (Monday) - 7] {very similar to %w which outputs 0->6 with sunday as 0 }*/
 			i = range(0, timeptr->tm_wday, 6);
-			snprintf(tbuf,sizeof(tbuf), "%d", i== 0 ? 7 :i);
+			p = strf_uint(tbuf, i == 0 ? 7 : i, 1);
 			break;
 
 		case 'U':	/* week of year, Sunday is first day of week */
-				//  if a value has been set in strp_tz.week_nos_U then use that, otherwise calculate it from other entries		
-			if(strp_tz.week_nos_U== strp_tz_default)
-				snprintf(tbuf,sizeof(tbuf), "%02d", weeknumber(timeptr, 0));
+				//  if a value has been set in tz->week_nos_U then use that, otherwise calculate it from other entries		
+			if(tz->week_nos_U== strp_tz_default)
+				i = weeknumber(timeptr, 0);
 			else
-				snprintf(tbuf,sizeof(tbuf), "%02d", strp_tz.week_nos_U);				
+				i = tz->week_nos_U;
+			p = strf_2d(tbuf, range(0, i, 53));
 			break;
 
 		case 'V':	/* week of year according ISO 8601 */
-			//  if a value has been set in strp_tz.week_nos_V then use that, otherwise calculate it from other entries
-			if(strp_tz.week_nos_V== strp_tz_default)
-				snprintf(tbuf,sizeof(tbuf), "%02d", iso8601wknum(timeptr));
+			//  if a value has been set in tz->week_nos_V then use that, otherwise calculate it from other entries
+			if(tz->week_nos_V== strp_tz_default)
+				i = iso8601wknum(timeptr);
 			else
-				snprintf(tbuf,sizeof(tbuf), "%02d", strp_tz.week_nos_V);
+				i = tz->week_nos_V;
+			p = strf_2d(tbuf, range(0, i, 53));
 			break;
 
 		case 'w':	/* weekday, Sunday == 0, 0 - 6 */
 			i = range(0, timeptr->tm_wday, 6);
-			snprintf(tbuf,sizeof(tbuf), "%d", i);
+			p = strf_uint(tbuf, i, 1);
 			break;
 
 		case 'W':	/* week of year, Monday is first day of week */
-				//  if a value has been set in strp_tz.week_nos_U then use that, otherwise calculate it from other entries		
-			if(strp_tz.week_nos_W== strp_tz_default)		
-				snprintf(tbuf,sizeof(tbuf), "%02d", weeknumber(timeptr, 1));
+				//  if a value has been set in tz->week_nos_U then use that, otherwise calculate it from other entries		
+			if(tz->week_nos_W== strp_tz_default)		
+				i = weeknumber(timeptr, 1);
 			else
-				snprintf(tbuf,sizeof(tbuf), "%02d", strp_tz.week_nos_W);				
-			break;
-
-		case 'x':	/* appropriate date representation */
-			/*
-			 * Up to the 2011 standard, this code used:
-			 * strftime(tbuf, sizeof tbuf, "%A %B %d %Y", timeptr);
-			 *
-			 * Now, per the 2011 C standard (C99), this is: "%m/%d/%y"
-			 */
-#ifdef HAVE_NL_LANGINFO
-			ya_strftime(tbuf, sizeof tbuf, nl_langinfo(D_FMT), timeptr);
-#else
-			ya_strftime(tbuf, sizeof tbuf, "%m/%d/%y", timeptr);
-#endif
-			break;
-
-		case 'X':	/* appropriate time representation */
-#ifdef HAVE_NL_LANGINFO
-			ya_strftime(tbuf, sizeof tbuf, nl_langinfo(T_FMT), timeptr);
-#else
-			goto the_time; /* same as %T */
-#endif
+				i = tz->week_nos_W;
+			p = strf_2d(tbuf, range(0, i, 53));
 			break;
 
 		case 'y':	/* year without a century, 00 - 99 */
@@ -1017,7 +1098,7 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 				i = timeptr->tm_year % 100;
 			else
 				i = 100+(timeptr->tm_year % 100); // Peter Miller - fix for negative years, which otherwise gave a negative i
-			snprintf(tbuf,sizeof(tbuf), "%02d", i);
+			p = strf_int(tbuf, i, 2); // i can be 100
 			break;
 
 		case 'Y':	/* year with century */
@@ -1025,42 +1106,27 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 			if (pad != '\0' && fw > 0) {
 				size_t min_fw = 4;
 
-				fw = max(fw, min_fw);
-				snprintf(tbuf,sizeof(tbuf), flag
-						? "%+0*ld"
-						: "%0*ld", (int) fw,
-						1900L + timeptr->tm_year);
+				fw = range(min_fw, fw, STRF_MAX_FW);
+				p = strf_sint(tbuf, (int64_t) timeptr->tm_year + 1900, (int) fw, flag != '\0');
 			} else
 #endif /* POSIX_2008 */
-			snprintf(tbuf,sizeof(tbuf), "%ld", 1900L + timeptr->tm_year);
+			p = strf_int(tbuf, (int64_t) timeptr->tm_year + 1900, 1);
 			break;
 
  		case 'z':	/* time zone offset east of GMT e.g. -0600 */
- 			if(strp_tz.tz_off_mins== strp_tz_default)
- 				{// strp_tz.tz_off_mins has not been set - get value from operating system
+ 			if(tz->tz_off_mins== strp_tz_default)
+ 				{// tz->tz_off_mins has not been set - get value from operating system
  				 if (timeptr->tm_isdst < 0)
  					break;
-				 /*
-			 	  * Systems with tzname[] probably have timezone as
-			 	  * secs west of GMT.  Convert to mins east of GMT.
-			 	 */
-				 off = -timezone / 60;
-				 if (off < 0) 
-				 	{
-					 tbuf[0] = '-';
-					 off = -off;
-				 	} 
-				  else 
-				  	{
-					 tbuf[0] = '+';
-					}
-				 snprintf(tbuf+1,sizeof(tbuf)-1, "%02ld%02ld", off/60, off%60);
+				 strf_os_zone(tz); /* only calls tzset() the 1st time */
+				 off = tz->os_off_mins; /* the sign is added below */
 				}
 			else
-				{//strp_tz.tz_off_mins has been set - use it
-				 off = strp_tz.tz_off_mins;			
+				{//tz->tz_off_mins has been set - use it
+				 off = tz->tz_off_mins;			
 				}
-			// common code
+			// common code, hh is at most 99 so the output is always 5 characters
+			off = range(-(99 * 60 + 59), off, 99 * 60 + 59);
 			if (off < 0) 
 			 	{
 				 tbuf[0] = '-';
@@ -1070,23 +1136,29 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 			  	{
 				 tbuf[0] = '+';
 				}
-			snprintf(tbuf+1,sizeof(tbuf)-1, "%02ld%02ld", off/60, off%60);					
+			p = strf_2d(strf_2d(tbuf + 1, off / 60), off % 60);
 			break;
 
 		case 'Z':	/* time zone name or abbrevation */
 #if 1
-			if(strp_tz.tz_name[0]!=0) // has been set by strptime()
+			if(tz->zone_abbrev!=NULL && strncmp(tz->tz_name, tz->zone_abbrev, sizeof(tz->tz_name))==0)
+				{// set by UTC_sec_to_tm_zone() (and tz_name not changed since), tz_name may only be the start of the abbreviation (eg "+054" for "+0545")
+				 p = tbuf;
+				 for (i = 0; i < STRF_ZONE_LEN && tz->zone_abbrev[i] != '\0'; ++i)
+					*p++ = tz->zone_abbrev[i];
+				 *p = '\0';
+				}
+			else if(tz->tz_name[0]!=0) // has been set by strptime()
 				{for(int i=0;i<4;++i)
-					tbuf[i]=strp_tz.tz_name[i];
+					tbuf[i]=tz->tz_name[i];
 				 tbuf[4]=0;// make 0 terminated string 
 				}
 			else
 				{// has NOT been set by strptime(), use OS supplied value 	
-				 int j;
-				 i = (daylight && timeptr->tm_isdst > 0); /* 0 or 1 */
-				 for(j=0;j<4 && isalpha(_tzname[i][j]);++j); // at most 4 chars - all must be letters 
-				 strncpy(tbuf, _tzname[i],j); // at most 4 chars copied 
-				 tbuf[j]=0;// ensure 0 terminated string 
+				 strf_os_zone(tz); /* only calls tzset() the 1st time */
+				 i = (timeptr->tm_isdst > 0); /* 0 or 1 */
+				 memcpy(tbuf, tz->os_name[i], 4); // at most 4 letters
+				 tbuf[4]=0;// ensure 0 terminated string 
 				}
 #else	/* original code, use OS value always */
 			i = (daylight && timeptr->tm_isdst > 0); /* 0 or 1 */
@@ -1096,7 +1168,7 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 
 #ifdef SUNOS_EXT
 		case 'k':	/* hour, 24-hour clock, blank pad */
-			snprintf(tbuf,sizeof(tbuf), "%2d", range(0, timeptr->tm_hour, 23));
+			p = strf_2s(tbuf, range(0, timeptr->tm_hour, 23));
 			break;
 
 		case 'l':	/* hour, 12-hour clock, 1 - 12, blank pad */
@@ -1105,14 +1177,14 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 				i = 12;
 			else if (i > 12)
 				i -= 12;
-			snprintf(tbuf,sizeof(tbuf), "%2d", i);
+			p = strf_2s(tbuf, i);
 			break;
 #endif
 
 #ifdef HPUX_EXT
 		case 'N':	/* Emperor/Era name */
 #ifdef HAVE_NL_LANGINFO
-			ya_strftime(tbuf, sizeof tbuf, nl_langinfo(ERA), timeptr);
+			ya_strftime(tbuf, tbufsize, nl_langinfo(ERA), timeptr);
 #else
 			/* this is essentially the same as the century */
 			goto century;	/* %C */
@@ -1125,37 +1197,1438 @@ size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm
 
 #ifdef VMS_EXT
 		case 'v':	/* date as dd-bbb-YYYY */
-			snprintf(tbuf,sizeof(tbuf), "%2d-%3.3s-%4ld",
-				range(1, timeptr->tm_mday, 31),
-				months_a(range(0, timeptr->tm_mon, 11)),
-				timeptr->tm_year + 1900L);
-			for (i = 3; i < 6; i++)
-				if (islower(tbuf[i]))
-					tbuf[i] = toupper(tbuf[i]);
+			{
+			const char *mon = months_a(range(0, timeptr->tm_mon, 11));
+			char ybuf[24];
+			size_t n = strlen(mon);
+
+			p = strf_2s(tbuf, range(1, timeptr->tm_mday, 31));
+			*p++ = '-';
+			n = (n < 3 ? n : 3); /* "%3.3s" in upper case */
+			for (i = (int) n; i < 3; i++)
+				*p++ = ' ';
+			for (i = 0; i < (int) n; i++)
+				*p++ = (char) toupper((unsigned char) mon[i]);
+			*p++ = '-';
+			n = strf_int(ybuf, (int64_t) timeptr->tm_year + 1900, 1) - ybuf; /* "%4ld" */
+			for (i = (int) n; i < 4; i++)
+				*p++ = ' ';
+			memcpy(p, ybuf, n + 1);
+			p += n;
+			}
 			break;
 #endif
 
 		default:
 			tbuf[0] = '%';
-			tbuf[1] = *format;
+			tbuf[1] = sp->conv;
 			tbuf[2] = '\0';
 			break;
-		}
-		i = strlen(tbuf);
-		if (i) {
-			if (s + i < endp - 1) {
-				strcpy(s, tbuf);
-				s += i;
-			} else
-				return 0;
-		}
 	}
-out:
-	if (s < endp && *format == '\0') {
-		*s = '\0';
-		return (s - start);
-	} else
+	return p != NULL ? (size_t) (p - tbuf) : strlen(tbuf);
+}
+
+/* strf_field_width() --- maximum number of characters strf_field() can produce for sp (whatever the values in struct tm and strp_tz) */
+static size_t
+strf_field_width(const struct strf_spec *sp)
+{
+	size_t w;
+#ifdef HAVE_NL_LANGINFO
+	if (strchr("aAbBhpN", sp->conv) != NULL)
+		return STRF_MAX_FW; /* names come from the locale so could be any length */
+#endif
+	switch (sp->conv) {
+	case 'n': case 't': case 'u': case 'w':
+		w = 1;
+		break;
+	case 'd': case 'e': case 'H': case 'I': case 'k': case 'l': case 'm': case 'M': case 'p': case 'S':
+	case 'U': case 'V': case 'W': /* 00-53 */
+		w = 2;
+		break;
+	case 'a': case 'b': case 'h':
+	case 'j': /* 001-366 */
+	case 'g': case 'o': case 'y': /* -99 for %g or 100 for %y with negative years */
+		w = 3;
+		break;
+	case 'Z':
+		w = STRF_ZONE_LEN;
+		break;
+	case 'z': /* +hhmm, the offset is limited to 99:59 */
+		w = 5;
+		break;
+	case 'A': case 'B': /* "wednesday" and "september" */
+		w = 9;
+		break;
+	case 'C': case 'N': /* (tm_year+1900)/100 */
+		w = 9;
+#ifdef POSIX_2008
+		if (sp->pad != '\0' && sp->fw > w)
+			w = (sp->fw < STRF_MAX_FW ? sp->fw : STRF_MAX_FW);
+#endif /* POSIX_2008 */
+		break;
+	case 'G': case 'Y': 
+		w = 11; /* any int with a sign */
+#ifdef POSIX_2008
+		if (sp->pad != '\0' && sp->fw > w)
+			w = (sp->fw < STRF_MAX_FW ? sp->fw : STRF_MAX_FW);
+#endif /* POSIX_2008 */
+		break;
+#ifdef POSIX_2008
+	case 'F': /* worst case is +_eeeeee_yyyy-mm-dd */
+		w = 19;
+		if (sp->pad != '\0' && sp->fw > w)
+			w = (sp->fw < STRF_MAX_FW ? sp->fw : STRF_MAX_FW);
+		break;
+#endif /* POSIX_2008 */
+	case 'v': /* dd-bbb-yyyy */
+		w = 18;
+		break;
+	case 's': /* any 64 bit integer with a sign */
+		w = 20;
+		break;
+	case 'f': /* at most as many digits as strptime() reads */
+		w = STRP_F_DIGITS;
+		break;
+	default: /* %x for unknown x */
+		w = 2;
+		break;
+	}
+	return w;
+}
+
+/* struct tm for ya_strftime_epoch() and ya_strftime_plan_epoch(), the parts of it are only calculated when a field needs them */
+struct strf_epoch
+	{
+	 struct tm tm; /* tm_isdst is always 0, the other fields are set as done says */
+	 time_t t; /* local time in seconds since 1970 */
+	 int32_t nsecs; /* nanoseconds for %f */
+	 unsigned int done; /* STRF_NEED_ flags for the parts already set */
+	};
+
+/* parts of struct strf_epoch (and the strp_tz_struct used with it) needed to output a field */
+#define STRF_NEED_TIME 1 /* tm_hour, tm_min & tm_sec (from the seconds of the day) */
+#define STRF_NEED_DATE 2 /* everything in struct tm (calculated with sec_to_tm()) */
+#define STRF_NEED_F 4 /* the fractional seconds in strp_tz_struct (from nsecs) */
+
+/* strf_needs() --- STRF_NEED_ flags for a (non composite) conversion specifier */
+static unsigned int
+strf_needs(char conv)
+{
+	switch (conv) {
+	case 'H': case 'I': case 'M': case 'S': case 'p': case 'k': case 'l':
+		return STRF_NEED_TIME;
+	case 'f':
+		return STRF_NEED_F;
+	case 'n': case 't': case 'z': case 'Z': case '%':
 		return 0;
+	default: /* everything else (including %s and unknown specifiers) is assumed to need the whole date */
+		return STRF_NEED_DATE;
+	}
+}
+
+/* strf_epoch_fill() --- calculate the parts of ep (and the %f fields of tz) in needs, apart from STRF_NEED_DATE */
+static void
+strf_epoch_fill(struct strf_epoch *ep, struct strp_tz_struct *tz, unsigned int needs)
+{
+	int64_t sod;
+
+	if (needs & STRF_NEED_TIME) {
+		sod = ep->t % 86400;
+		if (sod < 0)
+			sod += 86400;
+		ep->tm.tm_hour = (int) (sod / 3600);
+		ep->tm.tm_min = (int) (sod / 60 % 60);
+		ep->tm.tm_sec = (int) (sod % 60);
+		ep->done |= STRF_NEED_TIME;
+	}
+	if (needs & STRF_NEED_F) {
+		if (ep->nsecs >= 0 && ep->nsecs < 1000000000) {
+			tz->f_secs = ep->nsecs / 1e9;
+			tz->f_asecs = (uint64_t) ep->nsecs * UINT64_C(1000000000);
+			tz->f_secs_p10 = 9;
+		}
+		ep->done |= STRF_NEED_F;
+	}
+}
+
+/* strf_epoch_need() --- make sure the parts of ep in needs have been calculated */
+static inline void
+strf_epoch_need(struct strf_epoch *ep, struct strp_tz_struct *tz, unsigned int needs)
+{
+	needs &= ~ep->done;
+	if (needs & STRF_NEED_DATE) {
+		sec_to_tm(ep->t, &ep->tm); /* sets the time of day as well */
+		ep->done |= STRF_NEED_DATE | STRF_NEED_TIME;
+		needs &= STRF_NEED_F;
+	}
+	if (needs)
+		strf_epoch_fill(ep, tz, needs);
+}
+
+/* strftime() --- produce formatted time */
+size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm *timeptr)
+{
+	return ya_strftime_r(s, maxsize, format, timeptr, &strp_tz);
+}
+
+/* strf_format() --- output format to s (but not the terminating null), returns a pointer to the end of the output or NULL if there was not enough space.
+   A field is only added if it leaves at least 2 characters free in the buffer. Composite specifiers are expanded in place by a recursive call.
+   If ep is not NULL timeptr is &ep->tm, and ep is completed as each field needs it */
+static char *
+strf_format(char *s, char *endp, const char *format, const struct tm *timeptr, struct strp_tz_struct *tz, struct strf_epoch *ep)
+{
+	char tbuf[STRF_MAX_FW + 1];
+	const char *sub;
+	struct strf_spec spec;
+	size_t i, w;
+
+	for (; *format; format++) {
+		if (s >= endp - 1)
+			return NULL;
+		if (*format != '%') {
+			*s++ = *format;
+			continue;
+		}
+		spec.pad = '\0';
+		spec.fw = 0;
+		spec.flag = '\0';
+#ifdef POSIX_2008
+		switch (*++format) {
+		case '+':
+			spec.flag = '+';
+			/* fall through */
+		case '0':
+			spec.pad = '0';
+			format++;
+			break;
+
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+		case '8':
+		case '9':
+			break;
+
+		default:
+			format--;
+			goto again;
+		}
+		for (; isdigit(*format); format++) {
+			spec.fw = spec.fw * 10 + (*format - '0');
+		}
+		format--;
+#endif /* POSIX_2008 */
+
+	again:
+		switch (*++format) {
+		case '\0':
+			*s++ = '%';
+			return s;
+
+		case '%':
+			*s++ = '%';
+			continue;
+
+		case 'E':
+		case 'O':
+			/* POSIX (now C99) locale extensions, ignored for now */
+			goto again;
+
+		default:
+			sub = strf_composite(*format);
+			if (sub != NULL) {
+				s = strf_format(s, endp, sub, timeptr, tz, ep);
+				if (s == NULL)
+					return NULL;
+				continue;
+			}
+			spec.conv = *format;
+			if (ep != NULL)
+				strf_epoch_need(ep, tz, strf_needs(spec.conv));
+			w = (endp - s > STRF_MAX_FW + 1 ? STRF_MAX_FW : strf_field_width(&spec)); /* only work out the width near the end of the buffer */
+			if (s + w < endp - 1) {
+				/* the widest possible field fits, create it directly in the output */
+				s += strf_field(s, w + 1, &spec, timeptr, tz);
+				continue;
+			}
+			i = strf_field(tbuf, sizeof tbuf, &spec, timeptr, tz);
+			if (i) {
+				if (s + i < endp - 1) {
+					memcpy(s, tbuf, i);
+					s += i;
+				} else
+					return NULL;
+			}
+			break;
+		}
+	}
+	return s;
+}
+
+/* strf_output() --- ya_strftime_r() once tz has been initialised, with ep as strf_format() */
+static size_t
+strf_output(char *s, size_t maxsize, const char *format, const struct tm *timeptr, struct strp_tz_struct *tz, struct strf_epoch *ep)
+{
+	char *e;
+
+#ifdef __GNUC__ 
+ #pragma GCC diagnostic ignored "-Wnonnull-compare" /* Peter Miller - "fix" incorrect gcc warning 321	26	strftime.c	[Warning] 'nonnull' argument 'format' compared to NULL [-Wnonnull-compare] */
+#endif
+	if (s == NULL || format == NULL || timeptr == NULL || maxsize == 0)
+		return 0;
+#ifdef __GNUC__ 		
+ #pragma GCC diagnostic warning "-Wnonnull-compare" /* turn warning back on again */
+#endif 
+	/* quick check if we even need to bother */
+	if (strchr(format, '%') == NULL && strlen(format) + 1 >= maxsize)
+		return 0;
+
+	e = strf_format(s, s + maxsize, format, timeptr, tz, ep);
+	if (e == NULL)
+		return 0;
+	*e = '\0';
+	return (e - s);
+}
+
+/* ya_strftime_r() --- reentrant version of ya_strftime(), uses *tz rather than the global strp_tz */
+size_t ya_strftime_r(char *s, size_t maxsize, const char *format, const struct tm *timeptr, struct strp_tz_struct *tz)
+{
+	if (tz == NULL)
+		return 0;
+	if(tz->initialised==0)
+    	init_strp_tz(tz);
+	return strf_output(s, maxsize, format, timeptr, tz, NULL);
+}
+
+/* Precompiled formats for ya_strftime()
+   ======================================
+   strf_compile() converts a format string once into a list of literal strings and fields (with composite specifiers like %c and %T already expanded),
+   ya_strftime_plan() then produces the output in one pass without decoding the format again.
+   The plan also knows the maximum number of characters it can produce (strf_plan_max_width()), when the output buffer is known to be big enough no checks
+   on the space left are done while the output is being created.
+   ya_strftime_plan() gives identical results to ya_strftime() called with the same format (including the use of strp_tz for %f, %z, %Z etc).
+   A plan is never changed after it has been compiled, so one plan can be used by many callers. Call strf_free_plan() when it is no longer needed.
+*/
+enum strf_op_code {STRF_OP_LIT, STRF_OP_FIELD, STRF_OP_2D};
+
+struct strf_op
+	{
+	 unsigned char code; /* enum strf_op_code */
+	 unsigned char low, high, offset; /* STRF_OP_2D: the member of struct tm is limited to low..high then offset is added */
+	 struct strf_spec spec; /* field to output (STRF_OP_FIELD and STRF_OP_2D) */
+	 size_t off, len; /* STRF_OP_LIT: the literal characters are lits[off]..lits[off+len-1]. STRF_OP_FIELD: len is the maximum width of the field (strf_field_width()).
+	                     STRF_OP_2D: off is the offsetof() member of struct tm output as 2 digits (as strf_field() does for %d, %H, %m, %M and %S) */
+	};
+
+struct strf_plan
+	{
+	 size_t nops; /* number of operations in ops[] */
+	 struct strf_op *ops;
+	 char *lits; /* literal characters from the format */
+	 size_t max_width; /* maximum number of characters the plan can output (excluding the terminating null) */
+	 bool no_conv; /* true if format has no % in it */
+	 unsigned int needs; /* STRF_NEED_ flags for all the fields in the plan (see ya_strftime_plan_epoch()) */
+	};
+
+/* strf_emit() --- convert format to operations, if plan->ops is NULL just count them.
+   Composite specifiers are expanded in place, so *last_lit and *in_lit (the last operation if it was a literal) are shared with the recursive calls */
+static void
+strf_emit(const char *format, struct strf_plan *plan, size_t *nops, size_t *nlits, size_t *width, size_t *last_lit, bool *in_lit)
+{
+	struct strf_spec spec;
+	const char *sub;
+
+	for (; *format; format++) {
+		char c;
+		if (*format != '%') {
+			c = *format;
+			goto literal;
+		}
+		spec.pad = '\0';
+		spec.fw = 0;
+		spec.flag = '\0';
+#ifdef POSIX_2008
+		switch (*++format) { /* this must match the code in ya_strftime() */
+		case '+':
+			spec.flag = '+';
+			/* fall through */
+		case '0':
+			spec.pad = '0';
+			format++;
+			break;
+
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+		case '8':
+		case '9':
+			break;
+
+		default:
+			format--;
+			goto again;
+		}
+		for (; isdigit(*format); format++) {
+			spec.fw = spec.fw * 10 + (*format - '0');
+		}
+		format--;
+#endif /* POSIX_2008 */
+
+	again:
+		switch (*++format) {
+		case '\0':
+			format--; /* so the loop terminates */
+			/* fall through */
+		case '%':
+			c = '%';
+			goto literal;
+
+		case 'E':
+		case 'O':
+			goto again;
+
+		default:
+			sub = strf_composite(*format);
+			if (sub != NULL) {
+				strf_emit(sub, plan, nops, nlits, width, last_lit, in_lit);
+				continue;
+			}
+			spec.conv = *format;
+			if (plan->ops != NULL) {
+				struct strf_op *op = plan->ops + *nops;
+				op->code = STRF_OP_2D;
+				op->offset = 0;
+				switch (spec.conv) { /* these must match the code in strf_field() */
+				case 'd': op->off = offsetof(struct tm, tm_mday); op->low = 1; op->high = 31; break;
+				case 'H': op->off = offsetof(struct tm, tm_hour); op->low = 0; op->high = 23; break;
+				case 'm': op->off = offsetof(struct tm, tm_mon); op->low = 0; op->high = 11; op->offset = 1; break;
+				case 'M': op->off = offsetof(struct tm, tm_min); op->low = 0; op->high = 59; break;
+				case 'S': op->off = offsetof(struct tm, tm_sec); op->low = 0; op->high = 60; break;
+				default: op->code = STRF_OP_FIELD; break;
+				}
+				op->spec = spec;
+				op->len = strf_field_width(&spec);
+				plan->needs |= strf_needs(spec.conv);
+			}
+			++*nops;
+			*width += strf_field_width(&spec);
+			*in_lit = false;
+			continue;
+		}
+	literal:
+		if (!*in_lit) {
+			/* start a new literal */
+			*in_lit = true;
+			*last_lit = *nops;
+			if (plan->ops != NULL) {
+				plan->ops[*last_lit].code = STRF_OP_LIT;
+				plan->ops[*last_lit].off = *nlits;
+				plan->ops[*last_lit].len = 0;
+			}
+			++*nops;
+		}
+		if (plan->ops != NULL) {
+			plan->lits[*nlits] = c;
+			plan->ops[*last_lit].len++;
+		}
+		++*nlits;
+		++*width;
+	}
+}
+
+/* strf_compile() --- compile format for ya_strftime_plan(), returns NULL if format is NULL or out of memory */
+struct strf_plan *
+strf_compile(const char *format)
+{
+	struct strf_plan *plan, count;
+	size_t nops = 0, nlits = 0, width = 0, last_lit = 0;
+	bool in_lit = false;
+
+	if (format == NULL)
+		return NULL;
+	count.ops = NULL;
+	strf_emit(format, &count, &nops, &nlits, &width, &last_lit, &in_lit);
+	/* plan, ops[] and lits[] are all in one block of memory */
+	plan = (struct strf_plan *) malloc(sizeof(struct strf_plan) + (nops + 1) * sizeof(struct strf_op) + nlits + 1);
+	if (plan == NULL)
+		return NULL;
+	plan->ops = (struct strf_op *) (plan + 1);
+	plan->lits = (char *) (plan->ops + nops + 1);
+	plan->nops = nlits = 0;
+	plan->max_width = 0;
+	plan->needs = 0;
+	in_lit = false;
+	strf_emit(format, plan, &plan->nops, &nlits, &plan->max_width, &last_lit, &in_lit);
+	plan->no_conv = (strchr(format, '%') == NULL);
+	return plan;
+}
+
+/* strf_plan_max_width() --- maximum number of characters ya_strftime_plan() can output (excluding the terminating null) */
+size_t
+strf_plan_max_width(const struct strf_plan *plan)
+{
+	return plan->max_width;
+}
+
+/* strf_free_plan() --- free memory used by plan */
+void
+strf_free_plan(struct strf_plan *plan)
+{
+	free(plan);
+}
+
+/* strf_exec() --- output operations op to end, returns pointer to the end of the output or NULL if there was not enough space.
+   if checked is false the output is known to fit, so no checks are made */
+static char *
+strf_exec(const struct strf_plan *plan, const struct strf_op *op, const struct strf_op *end, char *s, char *endp, bool checked, const struct tm *timeptr, struct strp_tz_struct *tz)
+{
+	char tbuf[STRF_MAX_FW + 1];
+	size_t i;
+
+	for (; op < end; op++) {
+		if (checked && s >= endp - 1)
+			return NULL;
+		switch (op->code) {
+		case STRF_OP_LIT:
+			if (checked && s + op->len > endp - 1)
+				return NULL;
+			memcpy(s, plan->lits + op->off, op->len);
+			s += op->len;
+			break;
+
+		case STRF_OP_FIELD:
+			if (!checked || s + op->len < endp - 1) /* the widest possible field fits, so create it directly in the output */
+				s += strf_field(s, op->len + 1, &op->spec, timeptr, tz);
+			else {
+				i = strf_field(tbuf, sizeof tbuf, &op->spec, timeptr, tz);
+				if (i) {
+					if (s + i < endp - 1) {
+						memcpy(s, tbuf, i);
+						s += i;
+					} else
+						return NULL;
+				}
+			}
+			break;
+
+		case STRF_OP_2D:
+			if (checked && s + 2 >= endp - 1)
+				return NULL;
+			i = range(op->low, *(const int *) ((const char *) timeptr + op->off), op->high) + op->offset;
+			memcpy(s, strf_2digits + 2 * i, 2);
+			s += 2;
+			break;
+		}
+	}
+	return s;
+}
+
+/* ya_strftime_plan() --- identical to ya_strftime(s, maxsize, format, timeptr) where plan = strf_compile(format) */
+size_t
+ya_strftime_plan(char *s, size_t maxsize, const struct strf_plan *plan, const struct tm *timeptr)
+{
+	return ya_strftime_plan_r(s, maxsize, plan, timeptr, &strp_tz);
+}
+
+/* ya_strftime_plan_r() --- reentrant version of ya_strftime_plan(), uses *tz rather than the global strp_tz */
+size_t
+ya_strftime_plan_r(char *s, size_t maxsize, const struct strf_plan *plan, const struct tm *timeptr, struct strp_tz_struct *tz)
+{
+	char *e;
+
+	if (tz == NULL)
+		return 0;
+	if(tz->initialised==0)
+    	init_strp_tz(tz);
+	if (s == NULL || plan == NULL || timeptr == NULL || maxsize == 0)
+		return 0;
+	/* quick check if we even need to bother */
+	if (plan->no_conv && plan->max_width + 1 >= maxsize)
+		return 0;
+	/* ya_strftime() only adds a field if it leaves at least 2 characters free, so if max_width+1 < maxsize everything fits */
+	e = strf_exec(plan, plan->ops, plan->ops + plan->nops, s, s + maxsize, plan->max_width + 1 >= maxsize, timeptr, tz);
+	if (e == NULL)
+		return 0;
+	*e = '\0';
+	return (e - s);
+}
+
+/* Direct formatting of seconds since the epoch
+   =============================================
+   ya_strftime_epoch() formats secs (UTC seconds since 1970) plus nsecs nanoseconds, shown in the time zone tz_off_mins minutes east of UTC.
+   The output is identical to ya_strftime_r() with the struct tm from sec_to_tm(secs+60*tz_off_mins) (tm_isdst=0) and a strp_tz_struct with tz_off_mins set
+   and %f as 9 digits of nsecs. If tz_off_mins is strp_tz_default secs is not adjusted and %z and %Z come from the OS (as ya_strftime()), if nsecs is not 0->999999999 %f gives "?".
+   The time of day comes straight from the seconds of the day, the date is only worked out (by sec_to_tm()) when the 1st field
+   that needs it is output, so eg "%H:%M:%S" never works out the year, month or day. The format is only scanned once (a plan already knows which fields it has).
+   No global variables are used so these functions are reentrant.
+*/
+#define CIVIL_T_MIN (-(CIVIL_ERAS*146097+719468)*86400+86400) /* secs below this are always converted by sec_to_tm() (its unsigned calculation would wrap) */
+
+/* strf_epoch_init() --- set ep and tz for ya_strftime_epoch(), nothing is calculated from secs until a field needs it */
+static void
+strf_epoch_init(struct strf_epoch *ep, struct strp_tz_struct *tz, time_t secs, int32_t nsecs, int tz_off_mins)
+{
+	time_t t = secs;
+
+	init_strp_tz(tz);
+	if (tz_off_mins != strp_tz_default) {
+		tz->tz_off_mins = tz_off_mins;
+		t += 60 * (time_t) tz_off_mins; /* as UTC_sec_to_tm() */
+	}
+	ep->t = t;
+	ep->nsecs = nsecs;
+	ep->done = 0;
+	ep->tm.tm_isdst = 0;
+	if (t < CIVIL_T_MIN)
+		strf_epoch_need(ep, tz, STRF_NEED_DATE); /* the seconds of the day are only calculated for times sec_to_tm() can do directly */
+}
+
+/* ya_strftime_epoch() --- format secs (and nsecs) directly */
+size_t
+ya_strftime_epoch(char *s, size_t maxsize, const char *format, time_t secs, int32_t nsecs, int tz_off_mins)
+{
+	struct strf_epoch ep;
+	struct strp_tz_struct tz;
+
+	if (format == NULL)
+		return 0;
+	strf_epoch_init(&ep, &tz, secs, nsecs, tz_off_mins);
+	return strf_output(s, maxsize, format, &ep.tm, &tz, &ep);
+}
+
+/* ya_strftime_plan_epoch() --- identical to ya_strftime_epoch(s, maxsize, format, secs, nsecs, tz_off_mins) where plan = strf_compile(format) */
+size_t
+ya_strftime_plan_epoch(char *s, size_t maxsize, const struct strf_plan *plan, time_t secs, int32_t nsecs, int tz_off_mins)
+{
+	struct strf_epoch ep;
+	struct strp_tz_struct tz;
+
+	if (plan == NULL)
+		return 0;
+	strf_epoch_init(&ep, &tz, secs, nsecs, tz_off_mins);
+	strf_epoch_need(&ep, &tz, plan->needs); /* the plan knows which fields it has */
+	return ya_strftime_plan_r(s, maxsize, plan, &ep.tm, &tz);
+}
+
+/* Cached formatting of seconds since the epoch
+   =============================================
+   A log writer formats a timestamp for every record, and usually many records share the same second. A struct strf_cache keeps the output of ya_strftime_epoch()
+   for the current second (or minute if the format has no %S or %s) and the positions of any %f fields in it. ya_strftime_cached() then just copies this output
+   and writes the 9 digits of nsecs for each %f, the whole output is only created again when the second (or minute) or tz_off_mins changes.
+   The results are identical to ya_strftime_epoch() with the format given to strf_cache_create(). If tz_off_mins is strp_tz_default (so %z and %Z come from the OS),
+   nsecs is invalid, the output might not fit in maxsize or the format has more than STRF_CACHE_F %f fields, ya_strftime_plan_epoch() is called instead.
+   A struct strf_cache is changed by ya_strftime_cached(), so each thread needs its own (no global variables are used so threads with their own caches never interact).
+*/
+#define STRF_CACHE_F 4 /* maximum number of %f fields in a format that can be cached */
+
+struct strf_cache
+	{
+	 struct strf_plan *plan;
+	 time_t period; /* 1, or 60 if the output only changes every minute */
+	 bool cacheable; /* false if the format has more than STRF_CACHE_F %f fields */
+	 bool valid; /* buf[] holds the output for key and tz_off_mins */
+	 time_t key; /* 1st second of the period (as local time, ie secs+60*tz_off_mins) for buf[] */
+	 int tz_off_mins;
+	 size_t len; /* number of characters in buf[] (excluding the terminating null) */
+	 int nf; /* number of %f fields */
+	 size_t f_pos[STRF_CACHE_F]; /* position in buf[] of each %f field (always 9 digits) */
+	 char *buf; /* plan->max_width+1 characters */
+	};
+
+/* strf_cache_create() --- create a cache for ya_strftime_cached() with format, returns NULL if format is NULL or out of memory */
+struct strf_cache *
+strf_cache_create(const char *format)
+{
+	struct strf_cache *c = (struct strf_cache *) calloc(1, sizeof(struct strf_cache));
+	int nf = 0;
+
+	if (c == NULL)
+		return NULL;
+	c->plan = strf_compile(format);
+	if (c->plan != NULL)
+		c->buf = (char *) malloc(c->plan->max_width + 1);
+	if (c->plan == NULL || c->buf == NULL) {
+		strf_cache_free(c);
+		return NULL;
+	}
+	c->period = 60;
+	for (size_t i = 0; i < c->plan->nops; i++) {
+		const struct strf_op *op = c->plan->ops + i;
+		if (op->code == STRF_OP_LIT)
+			continue;
+		if (op->spec.conv == 'S' || op->spec.conv == 's')
+			c->period = 1; /* every other field (apart from %f) is the same for a whole minute */
+		else if (op->spec.conv == 'f')
+			++nf; /* %f is never part of a composite specifier */
+	}
+	c->cacheable = (nf <= STRF_CACHE_F);
+	return c;
+}
+
+/* strf_cache_fill() --- create the output for secs in c->buf, noting where the %f fields are */
+static void
+strf_cache_fill(struct strf_cache *c, time_t secs, int tz_off_mins)
+{
+	const struct strf_plan *plan = c->plan;
+	struct strf_epoch ep;
+	struct strp_tz_struct tz;
+	char *s = c->buf;
+	size_t i;
+
+	strf_epoch_init(&ep, &tz, secs, 0, tz_off_mins);
+	strf_epoch_need(&ep, &tz, plan->needs);
+	c->nf = 0;
+	for (i = 0; i < plan->nops; i++) {
+		const struct strf_op *op = plan->ops + i;
+		if (op->code == STRF_OP_FIELD && op->spec.conv == 'f')
+			c->f_pos[c->nf++] = s - c->buf;
+		s = strf_exec(plan, op, op + 1, s, c->buf + plan->max_width + 1, false, &ep.tm, &tz); /* the output always fits in max_width characters */
+	}
+	*s = '\0';
+	c->len = s - c->buf;
+}
+
+/* strf_9d() --- 0 <= v <= 999999999 as 9 digits (no terminating null) */
+static inline void
+strf_9d(char *p, uint32_t v)
+{
+	for (int i = 7; i > 0; i -= 2) {
+		memcpy(p + i, strf_2digits + 2 * (v % 100), 2);
+		v /= 100;
+	}
+	p[0] = (char) ('0' + v);
+}
+
+/* ya_strftime_cached() --- identical to ya_strftime_epoch(s, maxsize, format, secs, nsecs, tz_off_mins) where c = strf_cache_create(format) */
+size_t
+ya_strftime_cached(char *s, size_t maxsize, struct strf_cache *c, time_t secs, int32_t nsecs, int tz_off_mins)
+{
+	time_t t, key;
+
+	if (c == NULL)
+		return 0;
+	if (!c->cacheable || tz_off_mins == strp_tz_default || nsecs < 0 || nsecs >= 1000000000)
+		return ya_strftime_plan_epoch(s, maxsize, c->plan, secs, nsecs, tz_off_mins);
+	t = secs + 60 * (time_t) tz_off_mins; /* as strf_epoch_init() */
+	key = t % c->period;
+	key = t - (key < 0 ? key + c->period : key);
+	if (!c->valid || key != c->key || tz_off_mins != c->tz_off_mins) {
+		strf_cache_fill(c, secs, tz_off_mins);
+		c->key = key;
+		c->tz_off_mins = tz_off_mins;
+		c->valid = true;
+	}
+	/* ya_strftime_plan_r() gives the whole output when there is at least 1 character to spare (otherwise it depends on where the fields are) */
+	if (s == NULL || c->len + 1 >= maxsize)
+		return ya_strftime_plan_epoch(s, maxsize, c->plan, secs, nsecs, tz_off_mins);
+	memcpy(s, c->buf, c->len + 1);
+	for (int i = 0; i < c->nf; i++)
+		strf_9d(s + c->f_pos[i], (uint32_t) nsecs);
+	return c->len;
+}
+
+/* strf_cache_free() --- free memory used by c */
+void
+strf_cache_free(struct strf_cache *c)
+{
+	if (c == NULL)
+		return;
+	strf_free_plan(c->plan);
+	free(c->buf);
+	free(c);
+}
+
+/* Time zones from TZif files
+   ==========================
+   UTC_mktime() and UTC_sec_to_tm() only know a fixed offset (tz->tz_off_mins, plus 1 hour if tm_isdst>0) and %z and %Z otherwise come from the OS (the globals set by tzset()),
+   so only one real time zone can be used at a time. A struct tz_zone holds the complete history of one IANA time zone read from a TZif file (RFC 8536, as found in
+   /usr/share/zoneinfo): the UTC instants at which the local time changes (transitions) in ascending order, and the local time type (offset, dst flag and abbreviation)
+   in force between them. UTC_sec_to_tm_zone() and UTC_mktime_zone() convert between UTC and local time in a zone
+   and set tz->tz_off_mins and tz->tz_name to the values for that instant so %z and %Z are correct for it.
+   A zone is never changed once it has been loaded, so any number of zones can be used at once and each can be shared between threads.
+   Version 1 (32 bit times) and version 2+ (64 bit times) files are read. Files with leap seconds (the "right/" zones) are rejected.
+   After the last transition (tzdata files normally have transitions up to 2037) the POSIX TZ string at the end of a version 2+ file gives the offset, eg "GMT0BST,M3.5.0/1,M10.5.0"
+   is GMT, with BST (1 hour ahead) from 01:00 GMT on the last Sunday in March to 02:00 BST on the last Sunday in October. tz_zone_from_posix() creates a zone that is just a TZ string
+   (eg from $TZ). DST starts and ends on the same dates every 400 years (146097 days is an exact number of weeks), so when a rule is read the dates it gives for each year of the
+   400 year cycle are worked out (using day_of_week() and day_of_year()) and saved in a table (3.2KB), so a conversion looks up its year rather than evaluating the rule.
+   The table is filled in before the zone is used, so the zone is still never changed and can be shared between threads.
+   The transition for an instant is found with an index rather than a binary search: time is split into buckets of 2^TZ_BUCKET_SHIFT secs (~194 days) from the 1st
+   transition and the index has the number of transitions before each bucket. As a bucket is shorter than a year it normally contains at most 2 transitions, so a lookup
+   is a table load and 1 or 2 compares whatever the number of transitions. There is one index for UTC times and one for local times, each is 2 bytes per bucket
+   (~750 bytes for a zone with transitions from 1847 to 2037, ~1.5KB for both). tz_zone_offset_bsearch() does the same lookup with a binary search (for bench.c).
+*/
+#define TZ_ABBREV_LEN (STRF_ZONE_LEN + 1) /* space for each abbreviation including the terminating null, longer ones are truncated (tzdata has none longer than 6) */
+#define TZ_MAX_OFFSET (26 * 3600) /* largest offset from UTC (secs) accepted */
+#define TZ_MAX_FILE (1 << 20) /* largest file tz_zone_load() reads */
+#define TZ_HEADER 44 /* size of a TZif header */
+#define TZ_BUCKET_SHIFT 24 /* index buckets are 2^24 secs (~194 days) */
+#define TZ_MAX_BUCKETS (1 << 14) /* largest index (~8700 years), transitions long before the rest (if any) are left out of the index */
+#define TZ_MAX_RULE_TIME 167 /* largest hour for the time DST starts or ends (RFC 8536 allows -167 to 167) */
+#define TZ_RULE_MAX (INT64_C(1) << 55) /* rules are used for UTC times -2^55 to 2^55 (~1 billion years), outside that the offset at the nearer end applies */
+
+struct tz_ltype	/* local time type */
+	{
+	 int32_t off; /* secs east of UTC */
+	 bool isdst;
+	 char abbrev[TZ_ABBREV_LEN]; /* eg "BST", null terminated */
+	};
+
+struct tz_rule_date	/* when DST starts or ends in a POSIX TZ string */
+	{
+	 char kind; /* 'J' for Jn (day 1-365, Feb 29th is never counted), 'D' for n (day 0-365), 'M' for Mm.w.d (day d (0=Sunday) of week w (5=last) of month m) */
+	 int day, week, month;
+	 int32_t secs; /* local time of day, default 02:00:00 */
+	};
+
+struct tz_rule	/* a POSIX TZ string, eg "EST5EDT,M3.2.0,M11.1.0" */
+	{
+	 struct tz_ltype std, dst; /* dst is only used if hasdst */
+	 bool hasdst;
+	 struct tz_rule_date start, end; /* start is in standard time, end in DST */
+	 int32_t (*years)[2]; /* years[y % 400] is {start, end} in year y as secs from the start of the year in local time, NULL if no DST */
+	};
+
+struct tz_index	/* number of transitions before each bucket */
+	{
+	 time_t base; /* start of bucket 0 */
+	 int nbuckets; /* the last transition is in bucket nbuckets-1 */
+	 uint16_t *first; /* first[b] is the number of transitions before bucket b (nbuckets+1 entries), NULL if there is no index (no transitions or too many) */
+	};
+
+struct tz_zone
+	{
+	 int ntrans; /* number of transitions */
+	 time_t *trans; /* UTC instant of each transition, strictly increasing */
+	 time_t *wall; /* local time at which each transition happens (in the offset before it), never decreasing - used to convert local times to UTC */
+	 unsigned char *ltype; /* ltype[i] is the local time type in force before trans[i], ltype[ntrans] the one after the last transition */
+	 int ntypes;
+	 struct tz_ltype *types;
+	 char *footer; /* TZ string from the end of a version 2+ file ("" if none) */
+	 struct tz_rule *rule; /* footer (or the string given to tz_zone_from_posix()) which applies after the last transition, NULL if none */
+	 struct tz_index trans_index, wall_index; /* indexes for trans[] and wall[] */
+	};
+
+/* tz_be32() --- 32 bit big endian signed integer at p */
+static inline int32_t
+tz_be32(const unsigned char *p)
+{
+	return (int32_t) ((uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3]);
+}
+
+/* tz_be64() --- 64 bit big endian signed integer at p */
+static inline int64_t
+tz_be64(const unsigned char *p)
+{
+	return (int64_t) ((uint64_t) (uint32_t) tz_be32(p) << 32 | (uint32_t) tz_be32(p + 4));
+}
+
+/* tz_find() --- number of the n values in ascending order in a[] that are <= t */
+static inline int
+tz_find(const time_t *a, int n, time_t t)
+{
+	int lo = 0, hi = n;
+
+	while (lo < hi) {
+		int mid = (lo + hi) >> 1;
+		if (a[mid] <= t)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* tz_index_init() --- create index ix for the n values in ascending order in a[], returns false if out of memory */
+static bool
+tz_index_init(struct tz_index *ix, const time_t *a, int n)
+{
+	int k = 0;
+
+	ix->first = NULL;
+	if (n == 0 || n > UINT16_MAX)
+		return true; /* tz_lookup() uses a binary search */
+	while (((uint64_t) a[n - 1] - (uint64_t) a[k]) >> TZ_BUCKET_SHIFT >= TZ_MAX_BUCKETS)
+		k++;
+	ix->base = a[k];
+	ix->nbuckets = (int) (((uint64_t) a[n - 1] - (uint64_t) ix->base) >> TZ_BUCKET_SHIFT) + 1;
+	ix->first = (uint16_t *) malloc((ix->nbuckets + 1) * sizeof(uint16_t));
+	if (ix->first == NULL)
+		return false;
+	for (int b = 0; b <= ix->nbuckets; b++) {
+		while (k < n && ((uint64_t) a[k] - (uint64_t) ix->base) >> TZ_BUCKET_SHIFT < (uint64_t) b)
+			k++;
+		ix->first[b] = (uint16_t) k;
+	}
+	return true;
+}
+
+/* tz_lookup() --- identical to tz_find(a, n, t) using index ix */
+static inline int
+tz_lookup(const struct tz_index *ix, const time_t *a, int n, time_t t)
+{
+	uint64_t b;
+	int k, e;
+
+	if (ix->first == NULL)
+		return tz_find(a, n, t);
+	if (t < ix->base)
+		return tz_find(a, ix->first[0], t);
+	b = ((uint64_t) t - (uint64_t) ix->base) >> TZ_BUCKET_SHIFT;
+	if (b >= (uint64_t) ix->nbuckets)
+		return n; /* after the last transition */
+	k = ix->first[b];
+	e = ix->first[b + 1];
+	if (e - k > 2)
+		return k + tz_find(a + k, e - k, t); /* only where transitions were close together */
+	k += (k < e && a[k] <= t);
+	k += (k < e && a[k] <= t);
+	return k;
+}
+
+/* tz_parse_name() --- parse an abbreviation ("EST" or quoted "<+0530>") at s into abbrev, returns the character after it or NULL if invalid */
+static const char *
+tz_parse_name(const char *s, char *abbrev)
+{
+	const char *e;
+	size_t len;
+
+	if (*s == '<') {
+		for (e = ++s; isalnum((unsigned char) *e) || *e == '+' || *e == '-'; e++)
+			;
+		if (*e != '>')
+			return NULL;
+	} else {
+		for (e = s; isalpha((unsigned char) *e); e++)
+			;
+	}
+	len = (size_t) (e - s);
+	if (len < 3)
+		return NULL;
+	memset(abbrev, 0, TZ_ABBREV_LEN);
+	memcpy(abbrev, s, len < TZ_ABBREV_LEN - 1 ? len : TZ_ABBREV_LEN - 1);
+	return e + (*e == '>');
+}
+
+/* tz_parse_time() --- parse [+-]hh[:mm[:ss]] with hh at most maxh at s into *secs, returns the character after it or NULL if invalid */
+static const char *
+tz_parse_time(const char *s, int32_t *secs, int maxh)
+{
+	static const int32_t scale[3] = {3600, 60, 1};
+	int32_t sign = 1;
+
+	if (*s == '+' || *s == '-')
+		sign = (*s++ == '-' ? -1 : 1);
+	*secs = 0;
+	for (int part = 0; part < 3; part++) {
+		int n = 0, digits = 0;
+		if (part > 0) {
+			if (*s != ':')
+				break;
+			s++;
+		}
+		while (isdigit((unsigned char) *s) && digits < (part == 0 ? 3 : 2)) {
+			n = n * 10 + (*s++ - '0');
+			digits++;
+		}
+		if (digits == 0 || n > (part == 0 ? maxh : 59))
+			return NULL;
+		*secs += n * scale[part];
+	}
+	*secs *= sign;
+	return s;
+}
+
+/* tz_parse_date() --- parse a rule date (Jn, n or Mm.w.d) with an optional /time at s into d, returns the character after it or NULL if invalid */
+static const char *
+tz_parse_date(const char *s, struct tz_rule_date *d)
+{
+	static const int lo[3] = {1, 1, 0}, hi[3] = {12, 5, 6};
+	int v[3] = {0, 0, 0}, nv = 1;
+
+	d->kind = 'D';
+	if (*s == 'J' || *s == 'M')
+		d->kind = *s++;
+	if (d->kind == 'M')
+		nv = 3;
+	for (int i = 0; i < nv; i++) {
+		int digits = 0;
+		if (i > 0 && *s++ != '.')
+			return NULL;
+		while (isdigit((unsigned char) *s) && digits < 3) {
+			v[i] = v[i] * 10 + (*s++ - '0');
+			digits++;
+		}
+		if (digits == 0 || (d->kind == 'M' && (v[i] < lo[i] || v[i] > hi[i])))
+			return NULL;
+	}
+	if ((d->kind == 'J' && (v[0] < 1 || v[0] > 365)) || (d->kind == 'D' && v[0] > 365))
+		return NULL;
+	d->month = v[0];
+	d->week = v[1];
+	d->day = (d->kind == 'M' ? v[2] : v[0]);
+	d->secs = 2 * 3600;
+	if (*s == '/')
+		s = tz_parse_time(s + 1, &d->secs, TZ_MAX_RULE_TIME);
+	return s;
+}
+
+/* tz_rule_day() --- day of the year (0 for 1st Jan) of rule date d in year */
+static int
+tz_rule_day(const struct tz_rule_date *d, int64_t year)
+{
+	int mday, mdays;
+
+	if (d->kind == 'J')
+		return d->day - 1 + (d->day >= 60 && is_leap(year)); /* Feb 29th is not counted */
+	if (d->kind == 'D')
+		return d->day;
+	mday = 1 + (d->day - day_of_week(year, d->month - 1, 1) + 7) % 7 + 7 * (d->week - 1);
+	mdays = (d->month == 12 ? 31 : day_of_year(year, d->month, 1) - day_of_year(year, d->month - 1, 1));
+	if (mday > mdays)
+		mday -= 7; /* week 5 is the last one in the month, which may be the 4th */
+	return day_of_year(year, d->month - 1, mday);
+}
+
+/* tz_rule_eval() --- set *start and *end to when DST starts and ends in year, as secs from the start of the year in local time */
+static void
+tz_rule_eval(const struct tz_rule *r, int64_t year, int32_t *start, int32_t *end)
+{
+	*start = tz_rule_day(&r->start, year) * 86400 + r->start.secs;
+	*end = tz_rule_day(&r->end, year) * 86400 + r->end.secs;
+}
+
+/* tz_rule_year() --- identical to tz_rule_eval() using the table for the 400 year cycle */
+static inline void
+tz_rule_year(const struct tz_rule *r, int64_t year, int32_t *start, int32_t *end)
+{
+	int y = (int) (year % 400);
+
+#ifndef YEAR0LEAP
+	if (year <= 0) {
+		/* year 0 is not a leap year, so years <= 0 are not in step with the cycle */
+		tz_rule_eval(r, year, start, end);
+		return;
+	}
+#endif
+	if (y < 0)
+		y += 400;
+	*start = r->years[y][0];
+	*end = r->years[y][1];
+}
+
+/* tz_rule_create() --- parse POSIX TZ string s (eg "EST5EDT,M3.2.0,M11.1.0"), returns NULL if invalid or out of memory */
+static struct tz_rule *
+tz_rule_create(const char *s)
+{
+	struct tz_rule *r;
+	int32_t off;
+
+	if (s == NULL || (r = (struct tz_rule *) calloc(1, sizeof(struct tz_rule))) == NULL)
+		return NULL;
+	if ((s = tz_parse_name(s, r->std.abbrev)) == NULL || (s = tz_parse_time(s, &off, 24)) == NULL)
+		goto bad;
+	r->std.off = -off; /* POSIX offsets are west of UTC */
+	if (*s != '\0') {
+		r->hasdst = true;
+		r->dst.isdst = true;
+		if ((s = tz_parse_name(s, r->dst.abbrev)) == NULL)
+			goto bad;
+		r->dst.off = r->std.off + 3600;
+		if (*s != ',' && *s != '\0') {
+			if ((s = tz_parse_time(s, &off, 24)) == NULL)
+				goto bad;
+			r->dst.off = -off;
+		}
+		if (*s == '\0')
+			s = ",M3.2.0,M11.1.0"; /* no dates, use the US rules (as glibc does) */
+		if (*s++ != ',' || (s = tz_parse_date(s, &r->start)) == NULL || *s++ != ',' || (s = tz_parse_date(s, &r->end)) == NULL || *s != '\0')
+			goto bad;
+		r->years = (int32_t (*)[2]) malloc(400 * sizeof(*r->years));
+		if (r->years == NULL)
+			goto bad;
+		for (int y = 0; y < 400; y++)
+			tz_rule_eval(r, 2000 + y, &r->years[y][0], &r->years[y][1]); /* 2000 is a multiple of 400 */
+	}
+	return r;
+bad:
+	free(r);
+	return NULL;
+}
+
+/* tz_year_of() --- year that contains local time t (secs) */
+static inline int64_t
+tz_year_of(time_t t)
+{
+	int64_t year = 1970 + t / 31556952 - (t % 31556952 < 0); /* 31556952 secs is the average length of a year */
+
+	while (year_to_s(year) > t)
+		year--;
+	while (year_to_s(year + 1) <= t)
+		year++;
+	return year;
+}
+
+/* tz_rule_at() --- local time type from rule r at UTC time t, sets *from and *to so it applies from UTC time *from to *to-1 */
+static const struct tz_ltype *
+tz_rule_at(const struct tz_rule *r, time_t t, time_t *from, time_t *to)
+{
+	time_t base, ts, te;
+	int64_t year;
+	int32_t start, end;
+	bool dst;
+
+	if (!r->hasdst) {
+		*from = INT64_MIN;
+		*to = INT64_MAX;
+		return &r->std;
+	}
+	if (t < -TZ_RULE_MAX || t >= TZ_RULE_MAX) {
+		const struct tz_ltype *lt = tz_rule_at(r, t < 0 ? -TZ_RULE_MAX : TZ_RULE_MAX - 1, from, to);
+		*from = (t < 0 ? INT64_MIN : TZ_RULE_MAX);
+		*to = (t < 0 ? -TZ_RULE_MAX : INT64_MAX);
+		return lt;
+	}
+	/* the rule for the year (in standard time) that contains t decides, as glibc does (but it uses the year in UTC) */
+	year = tz_year_of(t + r->std.off);
+	tz_rule_year(r, year, &start, &end);
+	base = year_to_s(year) - r->std.off; /* start of the year as UTC */
+	ts = base + start; /* start is in standard time */
+	te = base + end + r->std.off - r->dst.off; /* end is in DST */
+	if (ts > te)
+		dst = (t < te || t >= ts); /* southern hemisphere, DST at the start and end of the year */
+	else
+		dst = (t >= ts && t < te);
+	*from = base;
+	*to = year_to_s(year + 1) - r->std.off;
+	if (ts <= t && ts > *from)
+		*from = ts;
+	else if (ts > t && ts < *to)
+		*to = ts;
+	if (te <= t && te > *from)
+		*from = te;
+	else if (te > t && te < *to)
+		*to = te;
+	return dst ? &r->dst : &r->std;
+}
+
+/* tz_rule_local() --- local time type whose offset converts local time local to UTC using rule r, tm_isdst picks between repeated times and skipped times use the type before the change (as UTC_mktime_zone()) */
+static const struct tz_ltype *
+tz_rule_local(const struct tz_rule *r, time_t local, int tm_isdst)
+{
+	const struct tz_ltype *early, *late, *a, *b;
+	time_t from, to;
+
+	if (!r->hasdst)
+		return &r->std;
+	early = (r->dst.off > r->std.off ? &r->dst : &r->std); /* the larger offset gives the earlier UTC time */
+	late = (early == &r->dst ? &r->std : &r->dst);
+	a = tz_rule_at(r, local - early->off, &from, &to);
+	b = tz_rule_at(r, local - late->off, &from, &to);
+	if (a == early && b == late)
+		return (tm_isdst >= 0 && late->isdst == (tm_isdst > 0) ? late : early); /* repeated */
+	if (a == early)
+		return early;
+	if (b == late)
+		return late;
+	return a; /* skipped, a is the type before the change */
+}
+
+/* tz_type() --- local time type in zone z at UTC time t, where k is the number of transitions <= t */
+static inline const struct tz_ltype *
+tz_type(const struct tz_zone *z, int k, time_t t)
+{
+	time_t from, to;
+
+	if (k == z->ntrans && z->rule != NULL)
+		return tz_rule_at(z->rule, t, &from, &to);
+	return z->types + z->ltype[k];
+}
+
+/* tz_counts() --- read the counts from the TZif header at p (isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt), returns size of the data that follows (0 if invalid) */
+static uint64_t
+tz_counts(const unsigned char *p, uint32_t cnt[6], int tsize)
+{
+	if (memcmp(p, "TZif", 4) != 0)
+		return 0;
+	for (int i = 0; i < 6; i++)
+		cnt[i] = (uint32_t) tz_be32(p + 20 + 4 * i);
+	if (cnt[4] == 0 || cnt[4] > 256 || cnt[5] == 0 || (cnt[0] != 0 && cnt[0] != cnt[4]) || (cnt[1] != 0 && cnt[1] != cnt[4]) || cnt[3] > INT_MAX / 4)
+		return 0;
+	return (uint64_t) cnt[3] * (tsize + 1) + (uint64_t) cnt[4] * 6 + cnt[5] + (uint64_t) cnt[2] * (tsize + 4) + cnt[1] + cnt[0];
+}
+
+/* tz_zone_from_tzif() --- create a zone from the len bytes of a TZif file at data, returns NULL if its invalid or out of memory */
+struct tz_zone *
+tz_zone_from_tzif(const unsigned char *data, size_t len)
+{
+	const unsigned char *p, *idx, *tt, *chars;
+	uint32_t cnt[6];
+	uint64_t size;
+	int tsize = 4;
+	struct tz_zone *z;
+
+	if (data == NULL || len < TZ_HEADER || (size = tz_counts(data, cnt, 4)) == 0 || size > len - TZ_HEADER)
+		return NULL;
+	p = data;
+	if (data[4] >= '2') {
+		/* skip the version 1 data, the same zone follows with 64 bit times */
+		p = data + TZ_HEADER + size;
+		tsize = 8;
+		if ((size_t) (data + len - p) < TZ_HEADER || (size = tz_counts(p, cnt, 8)) == 0 || size > (size_t) (data + len - p) - TZ_HEADER)
+			return NULL;
+	}
+	if (cnt[2] != 0)
+		return NULL; /* leap seconds are not supported */
+	z = (struct tz_zone *) calloc(1, sizeof(struct tz_zone));
+	if (z == NULL)
+		return NULL;
+	z->ntrans = (int) cnt[3];
+	z->ntypes = (int) cnt[4];
+	z->trans = (time_t *) malloc((cnt[3] + 1) * sizeof(time_t));
+	z->wall = (time_t *) malloc((cnt[3] + 1) * sizeof(time_t));
+	z->ltype = (unsigned char *) malloc(cnt[3] + 1);
+	z->types = (struct tz_ltype *) calloc(cnt[4], sizeof(struct tz_ltype));
+	if (z->trans == NULL || z->wall == NULL || z->ltype == NULL || z->types == NULL)
+		goto bad;
+	p += TZ_HEADER;
+	idx = p + (size_t) cnt[3] * tsize;
+	tt = idx + cnt[3];
+	chars = tt + (size_t) cnt[4] * 6;
+	for (int i = 0; i < z->ntypes; i++) {
+		struct tz_ltype *lt = z->types + i;
+		lt->off = tz_be32(tt + 6 * i);
+		lt->isdst = tt[6 * i + 4];
+		if (lt->off < -TZ_MAX_OFFSET || lt->off > TZ_MAX_OFFSET || tt[6 * i + 4] > 1 || tt[6 * i + 5] >= cnt[5])
+			goto bad;
+		for (uint32_t j = tt[6 * i + 5], k = 0; j < cnt[5] && chars[j] != '\0' && k < TZ_ABBREV_LEN - 1; j++, k++)
+			lt->abbrev[k] = (char) chars[j];
+	}
+	z->ltype[0] = 0; /* type 0 is used before the 1st transition */
+	for (int i = 0; i < z->ntrans; i++) {
+		z->trans[i] = (tsize == 8 ? tz_be64(p + 8 * i) : tz_be32(p + 4 * i));
+		z->ltype[i + 1] = idx[i];
+		if (idx[i] >= cnt[4] || (i > 0 && z->trans[i] <= z->trans[i - 1]))
+			goto bad;
+		z->wall[i] = z->trans[i] + z->types[z->ltype[i]].off;
+		if (i > 0 && z->wall[i] < z->wall[i - 1])
+			z->wall[i] = z->wall[i - 1]; /* only if 2 transitions are closer than the change in offset, keeps the binary search in UTC_mktime_zone() valid */
+	}
+	if (tsize == 8) {
+		/* footer is "\n" TZ string "\n" */
+		const char *f = (const char *) chars + size - ((size_t) cnt[3] * 9 + (size_t) cnt[4] * 6), *nl;
+		size_t flen = (size_t) ((const char *) data + len - f);
+		if (flen < 2 || f[0] != '\n' || (nl = (const char *) memchr(f + 1, '\n', flen - 1)) == NULL)
+			goto bad;
+		z->footer = (char *) malloc(nl - f);
+		if (z->footer == NULL)
+			goto bad;
+		memcpy(z->footer, f + 1, nl - f - 1);
+		z->footer[nl - f - 1] = '\0';
+		if (z->footer[0] != '\0')
+			z->rule = tz_rule_create(z->footer); /* NULL if its not understood, the last type is then used after the last transition */
+	}
+	if (!tz_index_init(&z->trans_index, z->trans, z->ntrans) || !tz_index_init(&z->wall_index, z->wall, z->ntrans))
+		goto bad;
+	return z;
+bad:
+	tz_zone_free(z);
+	return NULL;
+}
+
+/* tz_zone_from_posix() --- create a zone from POSIX TZ string s (eg "EST5EDT,M3.2.0,M11.1.0" or "<+0530>-5:30"), returns NULL if its invalid or out of memory */
+struct tz_zone *
+tz_zone_from_posix(const char *s)
+{
+	struct tz_zone *z = (struct tz_zone *) calloc(1, sizeof(struct tz_zone));
+
+	if (z == NULL)
+		return NULL;
+	z->rule = tz_rule_create(s); /* with no transitions the rule is used for all times */
+	if (z->rule == NULL) {
+		tz_zone_free(z);
+		return NULL;
+	}
+	return z;
+}
+
+/* tz_zone_load() --- load zone name (eg "Europe/London") from the zoneinfo directory dir (NULL for $TZDIR or /usr/share/zoneinfo), returns NULL if not found, invalid or out of memory */
+struct tz_zone *
+tz_zone_load(const char *dir, const char *name)
+{
+	struct tz_zone *z = NULL;
+	unsigned char *data;
+	char *path;
+	size_t len;
+	FILE *f;
+
+	if (name == NULL || name[0] == '\0' || name[0] == '/' || name[0] == '\\' || strstr(name, "..") != NULL)
+		return NULL; /* name must be inside dir */
+	if (dir == NULL && (dir = getenv("TZDIR")) == NULL)
+		dir = "/usr/share/zoneinfo";
+	path = (char *) malloc(strlen(dir) + strlen(name) + 2);
+	data = (unsigned char *) malloc(TZ_MAX_FILE + 1);
+	if (path != NULL && data != NULL) {
+		sprintf(path, "%s/%s", dir, name);
+		f = fopen(path, "rb");
+		if (f != NULL) {
+			len = fread(data, 1, TZ_MAX_FILE + 1, f);
+			fclose(f);
+			if (len <= TZ_MAX_FILE)
+				z = tz_zone_from_tzif(data, len);
+		}
+	}
+	free(path);
+	free(data);
+	return z;
+}
+
+/* tz_zone_offset() --- returns offset from UTC in secs at UTC time t in zone z, sets *isdst and *abbrev (either can be NULL) */
+int
+tz_zone_offset(const struct tz_zone *z, time_t t, int *isdst, const char **abbrev)
+{
+	const struct tz_ltype *lt = tz_type(z, tz_lookup(&z->trans_index, z->trans, z->ntrans, t), t);
+
+	if (isdst != NULL)
+		*isdst = lt->isdst;
+	if (abbrev != NULL)
+		*abbrev = lt->abbrev;
+	return lt->off;
+}
+
+/* tz_zone_offset_bsearch() --- identical to tz_zone_offset() using a binary search rather than the index, so bench.c can compare them */
+int
+tz_zone_offset_bsearch(const struct tz_zone *z, time_t t, int *isdst, const char **abbrev)
+{
+	const struct tz_ltype *lt = tz_type(z, tz_find(z->trans, z->ntrans, t), t);
+
+	if (isdst != NULL)
+		*isdst = lt->isdst;
+	if (abbrev != NULL)
+		*abbrev = lt->abbrev;
+	return lt->off;
+}
+
+/* tz_cursor_init() --- start a cursor for zone z, the 1st tz_cursor_offset() finds its position */
+void
+tz_cursor_init(struct tz_cursor *c, const struct tz_zone *z)
+{
+	c->zone = z;
+	c->start = INT64_MAX; /* empty interval */
+	c->end = INT64_MIN;
+	c->off = 0;
+	c->isdst = 0;
+	c->abbrev = "";
+	c->next = z->ntrans;
+}
+
+/* tz_cursor_offset() --- identical to tz_zone_offset(c->zone, t, &c->isdst, &c->abbrev), moving the cursor to the interval between transitions that contains t */
+int
+tz_cursor_offset(struct tz_cursor *c, time_t t)
+{
+	const struct tz_zone *z = c->zone;
+	const struct tz_ltype *lt;
+	int k;
+
+	if (t >= c->start && t < c->end)
+		return c->off;
+	if (t >= c->end && c->next < z->ntrans && (c->next + 1 == z->ntrans || t < z->trans[c->next + 1]))
+		k = c->next + 1; /* the next interval, normal for times in ascending order */
+	else
+		k = tz_lookup(&z->trans_index, z->trans, z->ntrans, t); /* times not in order, or more than 1 transition later */
+	if (k == z->ntrans && z->rule != NULL) {
+		lt = tz_rule_at(z->rule, t, &c->start, &c->end); /* between 2 changes given by the rule */
+		if (k > 0 && c->start < z->trans[k - 1])
+			c->start = z->trans[k - 1];
+	} else {
+		lt = z->types + z->ltype[k];
+		c->start = (k > 0 ? z->trans[k - 1] : INT64_MIN);
+		c->end = (k < z->ntrans ? z->trans[k] : INT64_MAX); /* t=INT64_MAX is always looked up, but gives the correct result */
+	}
+	c->off = lt->off;
+	c->isdst = lt->isdst;
+	c->abbrev = lt->abbrev;
+	c->next = k;
+	return c->off;
+}
+
+/* tz_set_tm() --- set tp to the local time for UTC time t in local time type lt, and tz to its offset and abbreviation */
+static void
+tz_set_tm(struct tm *tp, struct strp_tz_struct *tz, const struct tz_ltype *lt, time_t t)
+{
+	if (tz->initialised == 0)
+		init_strp_tz(tz);
+	sec_to_tm(t + lt->off, tp);
+	tp->tm_isdst = lt->isdst;
+	tz->tz_off_mins = (lt->off + (lt->off < 0 ? -30 : 30)) / 60; /* to the nearest minute, only a few offsets before 1900 are not whole minutes */
+	memcpy(tz->tz_name, lt->abbrev, sizeof(tz->tz_name)); /* abbrev is null padded so this is all 0's after the abbreviation */
+	tz->zone_abbrev = lt->abbrev; /* the whole abbreviation for %Z, which is in the zone so it must not be freed before tz is used */
+}
+
+/* UTC_sec_to_tm_zone() --- as UTC_sec_to_tm() using zone z, sets tp->tm_isdst and tz->tz_off_mins, tz->tz_name and tz->zone_abbrev so %z and %Z are correct for t */
+void
+UTC_sec_to_tm_zone(time_t t, struct tm *tp, struct strp_tz_struct *tz, const struct tz_zone *z)
+{
+	tz_set_tm(tp, tz, tz_type(z, tz_lookup(&z->trans_index, z->trans, z->ntrans, t), t), t);
+}
+
+/* UTC_mktime_zone() --- reverse of UTC_sec_to_tm_zone(), converts local time tp in zone z to UTC secs since the epoch and sets tp (normalised), tz->tz_off_mins and tz->tz_name */
+time_t
+UTC_mktime_zone(struct tm *tp, struct strp_tz_struct *tz, const struct tz_zone *z)
+{
+	time_t local = ya_mktime_tm(tp), t;
+	int k;
+	const struct tz_ltype *lt, *next;
+
+	if (z->rule != NULL && (z->ntrans == 0 || local - TZ_MAX_OFFSET >= z->trans[z->ntrans - 1])) {
+		/* a day or more after the last transition, so the rule applies */
+		time_t from, to;
+		t = local - tz_rule_local(z->rule, local, tp->tm_isdst)->off;
+		tz_set_tm(tp, tz, tz_rule_at(z->rule, t, &from, &to), t); /* for a skipped time t is after the change */
+		return t;
+	}
+	k = tz_lookup(&z->wall_index, z->wall, z->ntrans, local); /* local is before transition k (in the offset before it) */
+	lt = z->types + z->ltype[k];
+	t = local - lt->off;
+	if (k > 0 && t < z->trans[k - 1]) {
+		/* local is skipped (eg clocks go forward from 01:00 to 02:00 and local is 01:30), use the offset before the change so the time moves forward by the gap */
+		t = local - z->types[z->ltype[k - 1]].off;
+	} else if (k < z->ntrans) {
+		next = z->types + z->ltype[k + 1];
+		if (local - next->off >= z->trans[k] && tp->tm_isdst >= 0 && next->isdst == (tp->tm_isdst > 0) && lt->isdst != next->isdst) {
+			/* local happens twice (eg clocks go back from 02:00 to 01:00 and local is 01:30) and tm_isdst chose the later one */
+			lt = next;
+			t = local - lt->off;
+		}
+	}
+	tz_set_tm(tp, tz, lt, t);
+	return t;
+}
+
+/* tz_zone_free() --- free memory used by z */
+void
+tz_zone_free(struct tz_zone *z)
+{
+	if (z == NULL)
+		return;
+	free(z->trans);
+	free(z->wall);
+	free(z->ltype);
+	free(z->types);
+	free(z->footer);
+	if (z->rule != NULL)
+		free(z->rule->years);
+	free(z->rule);
+	free(z->trans_index.first);
+	free(z->wall_index.first);
+	free(z);
 }
 
 /* iso8601wknum --- compute week number according to ISO 8601 */
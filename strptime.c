@@ -70,10 +70,9 @@ D The date as %m/%d/%y.
 e The day of month (1-31), leading space if only 1 digit
 f fraction of a second (the values after the decimal point). The decimal point is implied (so needs to be in the format string if its actually present)  
 	Eg "%H:%M:%S.%f" will read 12:59:59.12345 
-	The fractional seconds are stored as a double f_secs and an integer number of input digits in f_secs_p10 element of struct strp_tz.
-	This approach is done to allow exact "round the loop" input by strptime() and then output by strftime.
-	 15 significant figures for %f is the limit for a double (beyond this not round loop exact, but the double f_secs should still be valid).
-	Normally only the f_secs bit is needed to extract the fractional seconds. 
+	The fractional seconds are stored as an integer number of attoseconds (10^-18 secs) f_asecs, as a double f_secs and the number of input digits in f_secs_p10 elements of struct strp_tz.
+	This approach is done to allow exact "round the loop" input by strptime() and then output by strftime(), which uses f_asecs so this is exact for up to 18 digits.
+	 Only the 1st 18 digits are used (rounded if there are more). f_secs is the nearest double to the digits used, and is there for compatibility.
   This is a local extension it is not defined by C99.	 
 F Equivalent to %Y-%m-%d (the iso 8601 date format)
 %G* The ISO 8601 week-based year with century as a decimal number.
@@ -132,6 +131,7 @@ z Time zone offset from UTC; a leading plus sign stands for east of UTC, a minus
   hours and minutes follow with two digits each and no delimiter between them (as in ISO8601 & common form for RFC 822 date headers). eg -0500 or "+0000". The sign is always required.
   The value input by %z is remembered and will be output by strftime(). If a value has not be set my the immediatly previous strptime() then strftime() will use the value supplied by the OS.
 Z  time zone name. eg EDT, "UTC", "GMT","AKST","ET" etc.  2, 3 or 4 letters is required. See https://www.nist.gov/pml/time-and-frequency-division/local-time-faqs#zones for the names used in the USA
+   If the name is a known abbreviation (see strp_abbrevs[], case is ignored) its offset is put into tz_off_mins, otherwise that is left unknown. An offset from %z is never replaced by %Z.
    The value input by %Z is remembered and will be output by strftime(). If a value has not be set my the immediatly previous strptime() then strftime() will use the value supplied by the OS.
 % Replaced by %.
 
@@ -147,6 +147,7 @@ It does not support a multibyte character sequence for the format string.
 #include <ctype.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h> /* for offsetof() */
 // #include <math.h>
 #include <limits.h>
 
@@ -156,54 +157,262 @@ It does not support a multibyte character sequence for the format string.
 #include "time_local.h"
 
 
-static double const dblpowersOf10[] = /* powers of 10 as doubles */
+static const uint64_t strp_pow10[STRP_F_DIGITS+1]= /* powers of 10 for %f (all of these are also exact as doubles) */
+	{UINT64_C(1),UINT64_C(10),UINT64_C(100),UINT64_C(1000),UINT64_C(10000),UINT64_C(100000),UINT64_C(1000000),UINT64_C(10000000),UINT64_C(100000000),
+	 UINT64_C(1000000000),UINT64_C(10000000000),UINT64_C(100000000000),UINT64_C(1000000000000),UINT64_C(10000000000000),UINT64_C(100000000000000),
+	 UINT64_C(1000000000000000),UINT64_C(10000000000000000),UINT64_C(100000000000000000),UINT64_C(1000000000000000000)};
+
+static void strp_set_f(struct strp_tz_struct *tz, uint64_t digits, unsigned int p10)
+{/* set the fractional seconds in tz to the p10 (1->STRP_F_DIGITS) digits in digits (ie to digits/10^p10 seconds) */
+ tz->f_secs_p10=(int)p10;
+ tz->f_asecs=digits*strp_pow10[STRP_F_DIGITS-p10];
+ tz->f_secs=(double)digits/(double)strp_pow10[p10]; // for up to 15 digits both are exact so this is the nearest double to the digits entered
+}
+
+bool strp_f_digits(const struct strp_tz_struct *tz, uint64_t *digits)
+{/* used by strftime() for %f: if tz->f_asecs is exactly f_secs_p10 (1->STRP_F_DIGITS) digits and matches tz->f_secs (ie f_secs has not been changed since strp_set_f())
+    sets *digits to those digits and returns true, otherwise returns false (and strftime() uses f_secs) */
+ uint64_t d,scale;
+ if(tz->f_secs_p10<1 || tz->f_secs_p10>STRP_F_DIGITS || tz->f_asecs>=strp_pow10[STRP_F_DIGITS]) return false;
+ scale=strp_pow10[STRP_F_DIGITS-tz->f_secs_p10];
+ d=tz->f_asecs/scale;
+ if(d*scale!=tz->f_asecs || (double)d/(double)strp_pow10[tz->f_secs_p10]!=tz->f_secs) return false;
+ *digits=d;
+ return true;
+}
 
-                {
-                    1e0,   1e1,   1e2,   1e3,   1e4,   1e5,   1e6,   1e7,   1e8,    1e9,
-                    1e10,  1e11,  1e12,  1e13,  1e14,  1e15,  1e16,  1e17,  1e18,  1e19,
-                    1e20,  1e21,  1e22,  1e23,  1e24,  1e25,  1e26,  1e27,  1e28,  1e29,
-                    1e30,  1e31,  1e32,  1e33,  1e34,  1e35,  1e36,  1e37,  1e38,  1e39,
-                    1e40,  1e41,  1e42,  1e43,  1e44,  1e45,  1e46,  1e47,  1e48,  1e49,
-                    1e50,  1e51,  1e52,  1e53,  1e54,  1e55,  1e56,  1e57,  1e58,  1e59,
-                    1e60,  1e61,  1e62,  1e63,  1e64,  1e65,  1e66,  1e67,  1e68,  1e69,
-                    1e70,  1e71,  1e72,  1e73,  1e74,  1e75,  1e76,  1e77,  1e78,  1e79,
-                    1e80,  1e81,  1e82,  1e83,  1e84,  1e85,  1e86,  1e87,  1e88,  1e89,
-                    1e90,  1e91,  1e92,  1e93,  1e94,  1e95,  1e96,  1e97,  1e98,  1e99,
-                    1e100, 1e101, 1e102, 1e103, 1e104, 1e105, 1e106, 1e107, 1e108, 1e109,
-                    1e110, 1e111, 1e112, 1e113, 1e114, 1e115, 1e116, 1e117, 1e118, 1e119,
-                    1e120, 1e121, 1e122, 1e123, 1e124, 1e125, 1e126, 1e127, 1e128, 1e129,
-                    1e130, 1e131, 1e132, 1e133, 1e134, 1e135, 1e136, 1e137, 1e138, 1e139,
-                    1e140, 1e141, 1e142, 1e143, 1e144, 1e145, 1e146, 1e147, 1e148, 1e149,
-                    1e150, 1e151, 1e152, 1e153, 1e154, 1e155, 1e156, 1e157, 1e158, 1e159,
-                    1e160, 1e161, 1e162, 1e163, 1e164, 1e165, 1e166, 1e167, 1e168, 1e169,
-                    1e170, 1e171, 1e172, 1e173, 1e174, 1e175, 1e176, 1e177, 1e178, 1e179,
-                    1e180, 1e181, 1e182, 1e183, 1e184, 1e185, 1e186, 1e187, 1e188, 1e189,
-                    1e190, 1e191, 1e192, 1e193, 1e194, 1e195, 1e196, 1e197, 1e198, 1e199,
-                    1e200, 1e201, 1e202, 1e203, 1e204, 1e205, 1e206, 1e207, 1e208, 1e209,
-                    1e210, 1e211, 1e212, 1e213, 1e214, 1e215, 1e216, 1e217, 1e218, 1e219,
-                    1e220, 1e221, 1e222, 1e223, 1e224, 1e225, 1e226, 1e227, 1e228, 1e229,
-                    1e230, 1e231, 1e232, 1e233, 1e234, 1e235, 1e236, 1e237, 1e238, 1e239,
-                    1e240, 1e241, 1e242, 1e243, 1e244, 1e245, 1e246, 1e247, 1e248, 1e249,
-                    1e250, 1e251, 1e252, 1e253, 1e254, 1e255, 1e256, 1e257, 1e258, 1e259,
-                    1e260, 1e261, 1e262, 1e263, 1e264, 1e265, 1e266, 1e267, 1e268, 1e269,
-                    1e270, 1e271, 1e272, 1e273, 1e274, 1e275, 1e276, 1e277, 1e278, 1e279,
-                    1e280, 1e281, 1e282, 1e283, 1e284, 1e285, 1e286, 1e287, 1e288, 1e289,
-                    1e290, 1e291, 1e292, 1e293, 1e294, 1e295, 1e296, 1e297, 1e298, 1e299,
-                    1e300, 1e301, 1e302, 1e303, 1e304, 1e305, 1e306, 1e307, 1e308
-                };
-                
-static double ipow10(unsigned int i) /* 10.0^i where i>=0 */ 
-	{
-	 if(i>308) return 1e308; // largest possible - in the code here this will never happen
-	 return dblpowersOf10[i];
-	}
-	
 const char * strp_weekdays[] = 
     { "sunday", "monday", "tuesday", "wednesday", "thursday", "friday", "saturday"};
     
 const char * strp_monthnames[] = 
     { "january", "february", "march", "april", "may", "june", "july", "august", "september", "october", "november", "december"};
 
+/* Name tables
+   ===========
+   %a %A %b %B and %h match either the full name or its 1st 3 letters (in any case). Rather than comparing against every name in turn the 1st 3 letters of the input
+   are converted to a 15 bit key (5 bits per letter) and a multiplicative hash of this gives a slot in a 64 entry table, the multiplier is chosen when the table is
+   built so every name has a different slot (ie its a perfect hash). Only the name in that slot then needs to be checked, the rest of the full name is then optional.
+   strp_name_table_init() builds a table for any set of names (eg locale names), the tables for weekdays and months below were created by it and are checked by main.c.
+*/
+#define STRP_NAME_MULT UINT32_C(0x9E3779B1) /* 1st multiplier tried (2^32/golden ratio), then +2 until one works */
+#define STRP_NAME_TRIES 65536 /* maximum number of multipliers tried by strp_name_table_init() */
+
+const struct strp_name_table strp_weekday_table=
+	{strp_weekdays,7,STRP_NAME_MULT,
+	 {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	  0,0,4,0,0,0,0,0,0,0,0,0,1,0,0,0,
+	  0,0,5,0,2,0,7,0,0,0,0,0,0,0,0,3,
+	  6,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},
+	 {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	  0,0,23716,0,0,0,0,0,0,0,0,0,20142,0,0,0,
+	  0,0,20757,0,13806,0,19508,0,0,0,0,0,0,0,0,21157,
+	  6729,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}
+	};
+
+const struct strp_name_table strp_month_table=
+	{strp_monthnames,12,STRP_NAME_MULT,
+	 {0,0,0,0,0,0,1,0,0,0,3,0,0,12,0,9,
+	  0,0,0,0,2,0,0,0,11,7,0,4,0,0,0,5,
+	  8,0,0,0,0,0,0,0,6,0,0,0,10,0,0,0,
+	  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},
+	 {0,0,0,0,0,0,10286,0,0,0,13362,0,0,4259,0,19632,
+	  0,0,0,0,6306,0,0,0,14838,10924,0,1554,0,0,0,13369,
+	  1703,0,0,0,0,0,0,0,10926,0,0,0,15476,0,0,0,
+	  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}
+	};
+
+static inline char strp_ch(const char *s, const char *e)
+{/* the character at s, or 0 (as for the terminating null) if s is the end of the input e. e is NULL for null terminated input */
+ return s!=e ? *s : 0;
+}
+
+static inline bool strp_name_key(const char *s, const char *e, unsigned int *key)
+{/* key for the 1st 3 characters of s (which ends at e), returns false if they are not all letters */
+ unsigned int k=0;
+ for(int i=0;i<3;++i)
+ 	{unsigned int l=(unsigned int)((strp_ch(s+i,e)|0x20)-'a'); // 0->25 for a letter in either case, s+i is never past e as s[i-1] was a letter
+ 	 if(l>25) return false; // also false for the terminating null
+ 	 k=(k<<5)|(l+1);
+ 	}
+ *key=k;
+ return true;
+}
+
+static inline unsigned int strp_name_slot(unsigned int key, uint32_t mult)
+{/* hash of key, 0->STRP_NAME_SLOTS-1 */
+ return (uint32_t)(key*mult)>>26; // top 6 bits
+}
+
+bool strp_name_table_init(struct strp_name_table *t, const char **names, int n)
+{/* build t for names[0..n-1] which must be lower case letters, at least 3 of them, with a different 1st 3 letters for every name.
+    Returns false if this is not possible (t is then not usable) */
+ unsigned int keys[STRP_NAME_SLOTS];
+ if(t==NULL || names==NULL || n<=0 || n>STRP_NAME_SLOTS) return false;
+ for(int i=0;i<n;++i)
+ 	{for(const char *c=names[i];*c;++c)
+ 		if(*c<'a' || *c>'z') return false; // only lower case letters are allowed
+ 	 if(!strp_name_key(names[i],NULL,&keys[i])) return false; // less than 3 letters
+ 	 for(int j=0;j<i;++j)
+ 	 	if(keys[j]==keys[i]) return false; // duplicate 1st 3 letters
+ 	}
+ t->names=names;
+ t->n=n;
+ for(uint32_t m=STRP_NAME_MULT,tries=0;tries<STRP_NAME_TRIES;++tries,m+=2)
+ 	{int i;
+ 	 memset(t->slot,0,sizeof(t->slot));
+ 	 memset(t->key,0,sizeof(t->key));
+ 	 for(i=0;i<n;++i)
+ 	 	{unsigned int h=strp_name_slot(keys[i],m);
+ 	 	 if(t->slot[h]!=0) break; // collision, try next multiplier
+ 	 	 t->slot[h]=(unsigned char)(i+1);
+ 	 	 t->key[h]=(uint16_t)keys[i];
+ 	 	}
+ 	 if(i==n)
+ 	 	{// no collisions
+ 	 	 t->mult=m;
+ 	 	 return true;
+ 	 	}
+ 	}
+ return false;
+}
+
+static int strp_name_match_e(const struct strp_name_table *t, const char **ps, const char *e)
+{/* match the name at *ps (case insensitive, the input ends at e) against t, either the full name or its 1st 3 letters.
+    Returns the index of the name and moves *ps past the characters matched, or returns -1 if no match (*ps is then unchanged) */
+ const char *s= *ps;
+ const char *name;
+ unsigned int key,h;
+ int i;
+ if(!strp_name_key(s,e,&key)) return -1;
+ h=strp_name_slot(key,t->mult);
+ if(t->slot[h]==0 || t->key[h]!=key) return -1;
+ i=t->slot[h]-1;
+ name=t->names[i]+3;
+ s+=3;
+ while(*name && (strp_ch(s,e)|0x20)==*name) // names are lower case letters, only the same letter in either case matches
+ 	{++name;
+ 	 ++s;
+ 	}
+ *ps= *name ? *ps+3 : s; // full name or just the 1st 3 letters
+ return i;
+}
+
+int strp_name_match(const struct strp_name_table *t, const char **ps)
+{/* as above for a null terminated string */
+ return strp_name_match_e(t,ps,NULL);
+}
+
+/* Zone abbreviations
+   ==================
+   %Z sets tz_off_mins when the abbreviation is in a table. As for names the whole abbreviation (2-4 letters, any case) is converted to a key of 5 bits per letter and
+   a multiplicative hash of this gives a slot in a 256 entry table, the multiplier is chosen so every abbreviation has a different slot. So one slot and one key
+   are checked whatever the number of abbreviations. Abbreviations that tzdata uses for more than one offset (IST is India, Ireland or Israel,
+   CST is US Central, Cuba or China, CDT is US Central or Cuba, PST is US Pacific or the Philippines) are not in the built in table, so they stay unknown unless
+   a table built by strp_abbrev_table_init() is given for each call (the *_abbrevs_r() functions, strp_stream_begin_abbrevs()
+   and strp_cache_set_abbrevs()) that is then tried 1st. Plans are never changed, so the same plan can be used with different tables at the same time.
+   The built in table was created by strp_abbrev_table_init() and is checked by main.c.
+*/
+const struct strp_abbrev strp_abbrevs[]=
+	{{"UTC",0},{"UT",0},{"GMT",0},{"WET",0},{"WEST",60},{"BST",60},{"IDT",180},{"CET",60},
+	 {"CEST",120},{"MET",60},{"MEST",120},{"EET",120},{"EEST",180},{"MSK",180},{"SAST",120},{"WAT",60},
+	 {"CAT",120},{"EAT",180},{"PKT",300},{"NPT",345},{"ICT",420},{"WIB",420},{"WITA",480},{"WIT",540},
+	 {"HKT",480},{"SGT",480},{"AWST",480},{"JST",540},{"KST",540},{"ACST",570},{"ACDT",630},{"AEST",600},
+	 {"AEDT",660},{"NZST",720},{"NZDT",780},{"ChST",600},{"SST",-660},{"HST",-600},{"HDT",-540},{"AKST",-540},
+	 {"AKDT",-480},{"PDT",-420},{"MST",-420},{"MDT",-360},{"EST",-300},{"EDT",-240},{"AST",-240},{"ADT",-180},
+	 {"NST",-210},{"NDT",-150},{"BRT",-180},{"ART",-180}
+	};
+
+const struct strp_abbrev_table strp_abbrev_table=
+	{strp_abbrevs,52,UINT32_C(0x9E37ACA7), /* STRP_NAME_MULT+2*6523 */
+	 {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,38,51,0,0,0,0,0,0,0,0,
+	  0,0,0,0,0,16,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,52,0,0,0,0,22,0,23,
+	  0,4,0,0,0,0,0,0,0,0,0,0,7,0,49,0,32,0,0,0,26,0,48,0,0,0,0,0,11,24,0,0,
+	  0,0,0,42,0,0,0,0,0,0,0,0,0,39,0,43,0,0,0,0,0,0,0,34,0,0,45,0,18,0,0,0,
+	  0,0,0,0,0,21,0,0,40,0,0,0,0,3,10,0,0,0,30,0,0,0,0,0,12,36,0,0,0,0,0,0,
+	  0,0,0,0,0,50,0,37,33,13,1,0,0,0,2,0,0,0,29,0,0,0,0,0,0,0,0,5,0,0,0,17,
+	  0,0,0,0,0,0,0,44,0,0,0,0,0,0,35,0,0,46,0,28,19,0,0,0,0,0,0,8,0,6,25,14,
+	  41,0,0,0,0,0,0,15,0,0,31,0,0,0,0,0,0,0,0,0,0,0,0,0,27,20,0,0,0,9,0,47},
+	 {22147,692,7604,23732,759412,2676,9364,3252,104052,13492,431732,5300,169588,13931,624244,23604,
+	  3124,5172,16756,14868,9332,23842,763521,23860,8564,19700,56948,10868,11892,36468,35988,38516,
+	  38036,486004,485524,107124,20084,8820,8340,44660,44180,16532,13940,13460,5748,5268,1652,1172,
+	  14964,14484,2644,1620,0,0,0,0,0,0,0,0,0,0,0,0},
+	 {0,0,0,0,60,60,180,60,120,60,120,120,180,180,120,60,
+	  120,180,300,345,420,420,480,540,480,480,480,540,540,570,630,600,
+	  660,720,780,600,-660,-600,-540,-540,-480,-420,-420,-360,-300,-240,-240,-180,
+	  -210,-150,-180,-180,0,0,0,0,0,0,0,0,0,0,0,0}
+	};
+
+static inline bool strp_abbrev_key(const char *s, size_t len, uint32_t *key)
+{/* key for the abbreviation s[0..len-1], returns false if it is not 2-4 letters */
+ uint32_t k=0;
+ if(len<2 || len>4) return false;
+ for(size_t i=0;i<len;++i)
+ 	{uint32_t l=(uint32_t)((s[i]|0x20)-'a'); // 0->25 for a letter in either case
+ 	 if(l>25) return false;
+ 	 k=(k<<5)|(l+1); // letters are never 0 so abbreviations of different lengths have different keys
+ 	}
+ *key=k;
+ return true;
+}
+
+static inline unsigned int strp_abbrev_slot(uint32_t key, uint32_t mult)
+{/* hash of key, 0->STRP_ABBREV_SLOTS-1 */
+ return (uint32_t)(key*mult)>>24; // top 8 bits
+}
+
+bool strp_abbrev_table_init(struct strp_abbrev_table *t, const struct strp_abbrev *abbrevs, int n)
+{/* build t for abbrevs[0..n-1], each name must be 2-4 letters (in any case) with no two the same ignoring case and an offset of less than 24 hours.
+    Returns false if this is not possible (t is then not usable) */
+ uint32_t keys[STRP_ABBREV_MAX];
+ if(t==NULL || abbrevs==NULL || n<=0 || n>STRP_ABBREV_MAX) return false;
+ for(int i=0;i<n;++i)
+ 	{if(abbrevs[i].name==NULL || !strp_abbrev_key(abbrevs[i].name,strlen(abbrevs[i].name),&keys[i])) return false;
+ 	 if(abbrevs[i].off_mins<= -24*60 || abbrevs[i].off_mins>=24*60) return false;
+ 	 for(int j=0;j<i;++j)
+ 	 	if(keys[j]==keys[i]) return false; // duplicate abbreviation
+ 	}
+ t->abbrevs=abbrevs;
+ t->n=n;
+ memset(t->key,0,sizeof(t->key));
+ memset(t->off_mins,0,sizeof(t->off_mins));
+ for(int i=0;i<n;++i)
+ 	{t->key[i]=keys[i];
+ 	 t->off_mins[i]=(int16_t)abbrevs[i].off_mins;
+ 	}
+ for(uint32_t m=STRP_NAME_MULT,tries=0;tries<STRP_NAME_TRIES;++tries,m+=2)
+ 	{int i;
+ 	 memset(t->slot,0,sizeof(t->slot));
+ 	 for(i=0;i<n;++i)
+ 	 	{unsigned int h=strp_abbrev_slot(keys[i],m);
+ 	 	 if(t->slot[h]!=0) break; // collision, try next multiplier
+ 	 	 t->slot[h]=(unsigned char)(i+1);
+ 	 	}
+ 	 if(i==n)
+ 	 	{// no collisions
+ 	 	 t->mult=m;
+ 	 	 return true;
+ 	 	}
+ 	}
+ return false;
+}
+
+static inline bool strp_abbrev_find(const struct strp_abbrev_table *t, uint32_t key, int *off_mins)
+{/* sets *off_mins and returns true if key is in t */
+ unsigned int i=t->slot[strp_abbrev_slot(key,t->mult)];
+ if(i==0 || t->key[i-1]!=key) return false;
+ *off_mins=t->off_mins[i-1];
+ return true;
+}
+
+bool strp_abbrev_lookup(const struct strp_abbrev_table *t, const char *name, int *off_mins)
+{/* sets *off_mins to the offset of the abbreviation name (case insensitive) and returns true if name is in t, otherwise returns false (*off_mins is unchanged) */
+ uint32_t key;
+ size_t len=0;
+ if(t==NULL || name==NULL || off_mins==NULL) return false;
+ while(len<5 && name[len]) ++len; // more than 4 letters is never valid
+ return strp_abbrev_key(name,len,&key) && strp_abbrev_find(t,key,off_mins);
+}
+
 struct strp_tz_struct strp_tz;/* extra variables not in struct tm - initialised on a call to strptime() or strftime() */
 
 void init_strp_tz(struct strp_tz_struct *d) /* initialise d to special values so we can detect when a field has a value written to it */	
@@ -218,7 +427,10 @@ void init_strp_tz(struct strp_tz_struct *d) /* initialise d to special values so
  d->week_nos_W= strp_tz_default; 
  d->year_G= strp_tz_default;
  d->f_secs=0;
+ d->f_asecs=0;
  d->f_secs_p10=strp_tz_default;
+ d->os_off_mins=strp_tz_default; // OS time zone is read again by strftime() if its needed
+ d->zone_abbrev=NULL;
  d->initialised=1; // now initialised
 }
 
@@ -237,19 +449,19 @@ bool check_tm(struct tm *tm)
  return OK;
 }
     
-bool strp_atoi(const char **s, int *result, unsigned int low, unsigned int high, unsigned int offset)
+bool strp_atoi(const char **s, const char *e, int *result, unsigned int low, unsigned int high, unsigned int offset)
     {
-    /* this traps too long input (in terms of total digits including leading zeros) */   
+    /* this traps too long input (in terms of total digits including leading zeros). The input ends at e (NULL for null terminated) */   
     const char * end=*s;
 	unsigned int num=0;
-	if(!isdigit(*end)) return false; // not a number, if we get past here we do have a valid decimal number 
+	if(!isdigit(strp_ch(end,e))) return false; // not a number, if we get past here we do have a valid decimal number 
 	num=(*end++ -'0'); // convert 1st digit to number (doing this outside of loop below avoids the need for a multiply by 10 of zero )
 	// now convert remaining digits (if there are any), check 1st as entering the loop needs a divide 
-	if(isdigit(*end))
+	if(isdigit(strp_ch(end,e)))
 		{for(unsigned int i=high/10;i>0; i/=10) // high defines number of digits allowed - where leading zero's count as a digit so eg high=6 allows 1 digit as (integer)  6/10=0
 			{// know *end is a digit if we get here so no need to check again
 			 num=(*end++ -'0')+num*10;
-			 if(!isdigit(*end))  break; /* end of number (but there has been at least 1 valid decimal digit) */
+			 if(!isdigit(strp_ch(end,e)))  break; /* end of number (but there has been at least 1 valid decimal digit) */
 			}
 		}
     if (num >= low && num <= high)
@@ -261,160 +473,124 @@ bool strp_atoi(const char **s, int *result, unsigned int low, unsigned int high,
     return false; // invalid number found , don't change s        
     }
 
-char * ya_strptime(const char *s, const char *format, struct tm *tm)
-    {
+struct strp_state /* flags set while matching a format, used by strp_finish() to fill in the date from week numbers */
+	{
+	 bool per_C_found; // set when %C found (1st 2 digits year )
+	 bool per_G_found; // set when %G found (iso 8601 year)
+	 bool weekday_found; // set when %a,%A, %u or %w found
+	 bool per_U_found; // set when %U found
+	 bool per_V_found; // set when %V found
+	 bool per_W_found; // set when %W found
+	 struct strp_tz_struct *tz; // where to put items that are not in struct tm
+	 const struct strp_abbrev_table *abbrevs; // zone abbreviations for %Z tried before strp_abbrev_table (NULL if none), given by the caller for each string
+	};
+
+static const char * strp_composite(char conv)
+{/* returns the format that the conversion specifier conv is equivalent to, or NULL if conv is not a composite specifier */
+ switch(conv)
+ 	{
+	 case 'c': return "%a %b %e %T %Y"; /* date and time C99 in C locale defines this to be %a %b %e %T %Y */
+	 case 'x': /* same as %D for now */
+	 case 'D': return "%m/%d/%y"; /* Equivalent to %m/%d/%y. (This is the American style date) */
+	 case 'F': return "%Y-%m-%d"; /* %F Equivalent to %Y-%m-%d (the iso 8601 date format) */
+	 case 'r': return "%I:%M:%S %p"; // 12 hour clock %I:%M:%S %p
+	 case 'R': return "%H:%M"; // %H:%M
+	 case 'X': /* same as T */
+	 case 'T': return "%H:%M:%S"; // %H:%M:%S
+	}
+ return NULL;
+}
+
+static bool strp_conv(char conv, const char **ps, const char *e, struct tm *tm, struct strp_state *st)
+    {/* match the single (non composite) conversion specifier conv (the character after the %) against *ps, the input ends at e (NULL if null terminated).
+        Returns true if valid, *ps is then moved past the characters used */
     bool valid = true;
-    bool per_C_found=false; // set when %C found (1st 2 digits year )
-    bool per_G_found=false; // set when %G found (iso 8601 year)
-    bool weekday_found=false; // set when %a,%A, %u or %w found
-    bool per_U_found=false; // set when %U found
-    bool per_V_found=false; // set when %V found
-    bool per_W_found=false; // set when %W found
-    init_strp_tz(&strp_tz); // always initialse strp_tz as we want to know what items are set by this call to strptime()
-	if (s == NULL || format == NULL || tm == NULL )
-		return NULL;    	
-    while (valid && *format && *s)
-        {
-        switch (*format)
-            {
-        case '%': /* all special format designators start with a % */
-            {
-            ++format;
-            if(*format=='E') ++format;// ignore E modifier (as in C locale)
-            else if(*format=='O') ++ format; // also ignore O modifier (as in C locale)
-            
-            switch (*format)
+    const char *s = *ps;
+    struct strp_tz_struct *tz = st->tz;
+            switch (conv)
                 {
             case 'a':
             case 'A': /* The weekday name, in abbreviated form or the full name */
-                valid = false;
-                for (size_t i = 0; i < 7; ++ i)
-                    {
-                    size_t len = strlen(strp_weekdays[i]);
-                    if (!strnicmp(strp_weekdays[i], s, len)) /* match to full name, strnicmp() does a case insensitive match. strncasecmp() is the equivalent POSIX function  */
-                        {
-                        tm->tm_wday = i;
-                        s += len;
-                        valid = true;
-                        break;
-                        }
-                    else if (!strnicmp(strp_weekdays[i], s, 3)) /* first 3 characters of weekday is an allowable abbreviation */
-                        {
-                        tm->tm_wday = i;
-                        s += 3;
-                        valid = true;
-                        break;
-                        }
-                    }
-                if(valid) weekday_found=true;
+            	{int i=strp_name_match_e(&strp_weekday_table,&s,e); // case insensitive match to the full name or its 1st 3 letters
+            	 valid = i>=0;
+            	 if(valid)
+            	 	{tm->tm_wday = i;
+            	 	 st->weekday_found=true;
+            	 	}
+            	}
                 break;
             case 'b':
             case 'B':
             case 'h': /* The month name, in abbreviated form or the full name.  */
-                valid = false;
-                for (size_t i = 0; i < 12; ++ i)
-                    {
-                    size_t len = strlen(strp_monthnames[i]);
-                    if (!strnicmp(strp_monthnames[i], s, len)) /* match to full name, strnicmp does a case insensitive match */
-                        {
-                        tm->tm_mon = i;
-                        s += len;
-                        valid = true;
-                        break;
-                        }
-                    else if (!strnicmp(strp_monthnames[i], s, 3)) /* first 3 characters of weekday is an allowable abbreviation */
-                        {
-                        tm->tm_mon = i;
-                        s += 3;
-                        valid = true;
-                        break;
-                        }
-                    }
-                break;
-            case 'c': /* date and time C99 in C locale defines this to be %a %b %e %T %Y */
-            	{char *r=ya_strptime(s,"%a %b %e %T %Y", tm);
-            	 valid=r!=NULL;
-            	 if(valid) s=r;
+            	{int i=strp_name_match_e(&strp_month_table,&s,e);
+            	 valid = i>=0;
+            	 if(valid) tm->tm_mon = i;
             	}
-            	break;
+                break;
             case 'C': /*  %C found (1st 2 digits of year ) , normally used before %y but can also be used before %g */
             	{int C=0;
-            	 valid = strp_atoi(&s, &(C), 0, 99, 0);
+            	 valid = strp_atoi(&s, e, &(C), 0, 99, 0);
             	 if(valid)
             	 	{// put in new top 2 digits, leaving lower digits [ which by default will be zero ]
             	 	 if(tm->tm_year>=0) tm->tm_year%=100; // leave just 2 lower digits
             	 	 else tm->tm_year=100+(tm->tm_year % 100); // leave just 2 lower digits
             	 	 
             	 	 tm->tm_year+=C*100-1900; // add in upper digits [ 1900 is required ofset for tm_year ]
-            	 	 per_C_found=true;
-            	 	 // now repeat similar logic for strp_tz.year_G
-            	 	 if(strp_tz.year_G==strp_tz_default)
-            	 	 	{strp_tz.year_G=C*100;// just put century in
+            	 	 st->per_C_found=true;
+            	 	 // now repeat similar logic for tz->year_G
+            	 	 if(tz->year_G==strp_tz_default)
+            	 	 	{tz->year_G=C*100;// just put century in
             	 	 	}
             	 	 else
 					  	{ // already set, just replace upper 2 digits
-					  	 if(strp_tz.year_G>=0) strp_tz.year_G%=100; // leave just 2 lower digits
-            	 	     else strp_tz.year_G=100+(strp_tz.year_G % 100); // leave just 2 lower digits	
-            	 	     strp_tz.year_G+=C*100;
+					  	 if(tz->year_G>=0) tz->year_G%=100; // leave just 2 lower digits
+            	 	     else tz->year_G=100+(tz->year_G % 100); // leave just 2 lower digits	
+            	 	     tz->year_G+=C*100;
 						}
             	 	}
 				}
 				break;
             case 'd':  /* The day of month (01-31)  */
-                valid = strp_atoi(&s, &(tm->tm_mday), 1, 31, 0);
+                valid = strp_atoi(&s, e, &(tm->tm_mday), 1, 31, 0);
                 break;    
             case 'e': /* The day of month (1-31), leading space if only 1 digit  */
-            	if(isspace(*s))
+            	if(isspace(strp_ch(s,e)))
             		{++s;
-            		 valid = strp_atoi(&s, &(tm->tm_mday), 1, 9, 0);
+            		 valid = strp_atoi(&s, e, &(tm->tm_mday), 1, 9, 0);
             		}
 				else		
-                	valid = strp_atoi(&s, &(tm->tm_mday), 1, 31, 0); // 2 digits (or 1 digit and space "gobbled" up on whitespace between fields)
+                	valid = strp_atoi(&s, e, &(tm->tm_mday), 1, 31, 0); // 2 digits (or 1 digit and space "gobbled" up on whitespace between fields)
                 break;   				           
-            case 'x': /* same as %D for now */
-            case 'D': /* Equivalent to %m/%d/%y. (This is the American style date) */
-            	{char *r=ya_strptime(s,"%m/%d/%y", tm);
-            	 valid=r!=NULL;
-            	 if(valid) s=r;
-            	}               
-                break;
-            case 'f': /* fractional seconds (after decimal point) -> store to strp_tz.f_secs and number of digits after dp is stored in strp_tz.f_secs_p10. 
-						 Will accept as many digits as are present, but double is limited to ~ 15 significant digits */
+            case 'f': /* fractional seconds (after decimal point) -> store to tz->f_asecs (as attoseconds) and tz->f_secs (as a double) and number of digits after dp is stored in tz->f_secs_p10. 
+						 Will accept as many digits as are present, but only the 1st STRP_F_DIGITS (18) are used */
             	{
-            	 if(isdigit(*s))
-            	 	{uint64_t fsec=0;// the mantissa of a double is 53 bits, so 64 bits is plenty to use here [ means overflow detection can be quite simple]
+            	 if(isdigit(strp_ch(s,e)))
+            	 	{uint64_t fsec=0;// 18 digits fits easily in 64 bits
             	 	 unsigned int power10=0; // count of digits after dp
 					 valid=true;
-		 			 while(isdigit(*s) && (fsec & UINT64_C(0xf000000000000000)) == 0   )
+		 			 while(isdigit(strp_ch(s,e)) && power10<STRP_F_DIGITS)
 						{fsec=fsec*10+(uint64_t)(*s++ -'0');// note leading zeros just change power10, they do not change fsec
 			 			 power10++; // keep track of decimal point position
 						}
-		 			 if(isdigit(*s) && *s>='5') fsec++; // round if next digit present
-		 			 while(isdigit(*s)) ++s; // eat up any more digits that are present (ignore them)
-		 			 strp_tz.f_secs_p10=power10;// number of digits entered, needed to allow "round loop exact" output (this is limited by the resolution of a double, but that should be OK here)
-		 			 strp_tz.f_secs=(double)fsec/ipow10(power10); 	 			 
+		 			 if(isdigit(strp_ch(s,e)) && *s>='5' && fsec+1<strp_pow10[power10]) fsec++; // round if next digit present (but not up to a whole second)
+		 			 while(isdigit(strp_ch(s,e))) ++s; // eat up any more digits that are present (ignore them)
+		 			 strp_set_f(tz,fsec,power10);// number of digits entered is needed to allow "round loop exact" output
 					}
 				 else valid=false;
             	}
             	break;
-            case 'F': /* %F Equivalent to %Y-%m-%d (the iso 8601 date format) */
-            	{char *r=ya_strptime(s,"%Y-%m-%d", tm);
-            	 valid=r!=NULL;
-            	 if(valid) s=r;
-            	}               
-                break;  
 			case 'g': /* The ISO 8601 week-based year (see * in description at the top of this file) within century as a 2 digit decimal number. Here we treat almost identically to %y   
 					     When a century is not otherwise specified, values in the range 69-99 refer to years in the twentieth century (1969-1999);
 						 values in the range 00-68 refer to years in the twenty-first century (2000-2068). 
 						 if [%C]%g and %G are both present the last will be used. If %C %G %g appear in that order the result may not be what is expected! 
             		 */
             	  {int y;
-                   valid = strp_atoi(&s,&(y), 0, 99, 0);
+                   valid = strp_atoi(&s,e,&(y), 0, 99, 0);
                    //int v=y;// save for printf below
                    if(valid)
                    	{
-                     if (per_G_found || per_C_found)
-                     	{int C=strp_tz.year_G;// extract century from current year (no ofset )
+                     if (st->per_G_found || st->per_C_found)
+                     	{int C=tz->year_G;// extract century from current year (no ofset )
                      	 C/=100;
                      	 C*=100; // above two operations zero out the last 2 digits of any existing date
                 		 y+=C; // add in new century part of year to the 2 digits in y
@@ -422,46 +598,46 @@ char * ya_strptime(const char *s, const char *format, struct tm *tm)
                    	 else if (y < 69) // note tm_year=0 => 1900
                     	y += 2000;// 2000-2068
                      else y+=1900;// 1969-1999	
-                     //printf("\n%%y integer found is %d, tm_year was %d now %d",v,strp_tz.year_G,y);
-                     strp_tz.year_G=y;	// store result back into strp_tz structure                     
+                     //printf("\n%%y integer found is %d, tm_year was %d now %d",v,tz->year_G,y);
+                     tz->year_G=y;	// store result back into strp_tz structure                     
                 	}
             	  }	
                  break;		                
             case 'G': /* The ISO 8601 week-based year (see * in description at the top of this file) with century as a 4 digit decimal number.  */
             	{int t;
-                 valid = strp_atoi(&s,&t, 0, 9999, 0);
-                 if(valid) strp_tz.year_G=t;
-                 per_G_found=valid;// set flag to say we have a century already
+                 valid = strp_atoi(&s,e,&t, 0, 9999, 0);
+                 if(valid) tz->year_G=t;
+                 st->per_G_found=valid;// set flag to say we have a century already
              	}	
                 break;  				               
             case 'H': /* The hour (0-23) */
-                valid = strp_atoi(&s,&(tm->tm_hour), 0, 23, 0);
+                valid = strp_atoi(&s,e,&(tm->tm_hour), 0, 23, 0);
                 break;
             case 'I': /* The hour on a 12-hour clock (1-12) */
-                valid = strp_atoi(&s,&(tm->tm_hour), 1, 12, 0);
+                valid = strp_atoi(&s,e,&(tm->tm_hour), 1, 12, 0);
                 break;
             case 'j': /* The day number in the year (1-366) */
-                valid = strp_atoi(&s,&(tm->tm_yday), 1, 366, -1);
+                valid = strp_atoi(&s,e,&(tm->tm_yday), 1, 366, -1);
                 break;
             case 'm': /* The month number (1-12) */
-                valid = strp_atoi(&s,&(tm->tm_mon), 1, 12, -1);
+                valid = strp_atoi(&s,e,&(tm->tm_mon), 1, 12, -1);
                 break;
             case 'M': /* The minute (0-59) */
-                valid = strp_atoi(&s,&(tm->tm_min), 0, 59, 0);
+                valid = strp_atoi(&s,e,&(tm->tm_min), 0, 59, 0);
                 break;
             case 'n': // arbitrary whitespace
             case 't':
-                while (isspace((int)*s)) 
+                while (isspace((int)strp_ch(s,e))) 
                     ++s;
                 break;
             case 'p': // am / pm
-                if (!strnicmp(s, "am", 2))
+                if ((strp_ch(s,e)|0x20)=='a' && (strp_ch(s+1,e)|0x20)=='m') // s+1 is only read if s[0] is a letter (so not the end of the input)
                     { // the hour will be 1 -> 12 maps to 12 am, 1 am .. 11 am, 12 noon 12 pm .. 11 pm
                     if (tm->tm_hour == 12) // 12 am == 00 hours
                         tm->tm_hour = 0;
                     s += 2;
                     }
-                else if (!strnicmp(s, "pm", 2))
+                else if ((strp_ch(s,e)|0x20)=='p' && (strp_ch(s+1,e)|0x20)=='m')
                     {
                     if (tm->tm_hour < 12) // 12 pm == 12 hours
                         tm->tm_hour += 12; // 1 pm -> 13 hours, 11 pm -> 23 hours
@@ -470,30 +646,18 @@ char * ya_strptime(const char *s, const char *format, struct tm *tm)
                 else
                     valid = false;
                 break;
-            case 'r': // 12 hour clock %I:%M:%S %p
-            	{char *r=ya_strptime(s,"%I:%M:%S %p", tm);
-            	 valid=r!=NULL;
-            	 if(valid) s=r;
-            	}      
-                break;
-            case 'R': // %H:%M
-            	{char *r=ya_strptime(s,"%H:%M", tm);
-            	 valid=r!=NULL;
-            	 if(valid) s=r;
-            	}            
-                break;
             case 's': /* seconds since the epoch [1900] as an signed integer (possibly with leading zeros).  */
             	{bool neg=false;
-            	 if(*s=='-')
+            	 if(strp_ch(s,e)=='-')
             	 	{neg=true;
             	 	 ++s;
             	 	}
-            	 else if(*s=='+') ++s;
-				 valid=isdigit(*s); /* number must start with a digit (but can be any length) */
+            	 else if(strp_ch(s,e)=='+') ++s;
+				 valid=isdigit(strp_ch(s,e)); /* number must start with a digit (but can be any length) */
             	 if(valid)
             	 	{
             	 	 time_t t=(*s++)-'0';/* process 1st digit */
-            	 	 while(isdigit(*s))
+            	 	 while(isdigit(strp_ch(s,e)))
             	 		{/* we have another digit of the number */
             	 		 if(t*10+(*s-'0')<t) valid=false; // overflow - we don't know the type of time_t so this test should always work
             	 	 	 t=t*10+(*s++-'0');
@@ -510,69 +674,62 @@ char * ya_strptime(const char *s, const char *format, struct tm *tm)
             	}
             	break;
             case 'S': /* The second (0-60; 60 may occur for leap seconds). */
-                valid = strp_atoi(&s,&(tm->tm_sec), 0, 60, 0);
+                valid = strp_atoi(&s,e,&(tm->tm_sec), 0, 60, 0);
                 break;
              
             case 'U' : /* %U The week number with Sunday the first day of the week (0-53). The first Sunday of January is the first day of week 1.    */
-            	{int wk_nos;// this value is not in the tm structure, so set it in strp_tz.week_nos_U
-                 valid = strp_atoi(&s,&(wk_nos), 0, 53, 0);
+            	{int wk_nos;// this value is not in the tm structure, so set it in tz->week_nos_U
+                 valid = strp_atoi(&s,e,&(wk_nos), 0, 53, 0);
                  if(valid) 
-				 	{strp_tz.week_nos_U=wk_nos;
-				 	 per_U_found=true; // set when %U found
+				 	{tz->week_nos_U=wk_nos;
+				 	 st->per_U_found=true; // set when %U found
 				 	}
             	}
                 break;    
             case 'u': // weekday number 1->7 where Monday=1 needs to be converted for tm to 0->6 sunday->saturday. Sunday =0.
-                valid = strp_atoi(&s,&(tm->tm_wday), 1, 7, 0);
+                valid = strp_atoi(&s,e,&(tm->tm_wday), 1, 7, 0);
                 if(tm->tm_wday==7) tm->tm_wday=0;// fix sunday from 7 to 0
-                if(valid) weekday_found=true;
+                if(valid) st->weekday_found=true;
                 break;                
             case 'V' : /* %V The week number in week-based year as defined by the ISO 8601 standard   */
-            	{int wk_nos;// this value is not in the tm structure, so we have to put it into strp_tz.week_nos_V
-                 valid = strp_atoi(&s,&(wk_nos), 1, 53, 0);
+            	{int wk_nos;// this value is not in the tm structure, so we have to put it into tz->week_nos_V
+                 valid = strp_atoi(&s,e,&(wk_nos), 1, 53, 0);
                  if(valid) 
-				 	{strp_tz.week_nos_V=wk_nos;
-				 	 per_V_found=true; // set when %V found
+				 	{tz->week_nos_V=wk_nos;
+				 	 st->per_V_found=true; // set when %V found
 				 	}
             	}
                 break; 	
             case 'W' : /* %W The week number with Monday the first day of the week (0-53). The first Monday of January is the first day of week 1.  */    
-            	{int wk_nos;// this value is not in the tm structure, so set it in strp_tz.week_nos_U
-                 valid = strp_atoi(&s,&(wk_nos), 0, 53, 0);
+            	{int wk_nos;// this value is not in the tm structure, so set it in tz->week_nos_U
+                 valid = strp_atoi(&s,e,&(wk_nos), 0, 53, 0);
                  if(valid)
-				 	{strp_tz.week_nos_W=wk_nos;
-				 	 per_W_found=true; // set when %W found
+				 	{tz->week_nos_W=wk_nos;
+				 	 st->per_W_found=true; // set when %W found
 				 	}
             	}
                 break; 							        
-            case 'X' : /* same as T */                
-            case 'T': // %H:%M:%S
-            	{char *r=ya_strptime(s,"%H:%M:%S", tm);
-            	 valid=r!=NULL;
-            	 if(valid) s=r;
-            	}      
-                break;
             case 'w': // weekday number 0->6 sunday->saturday. Sunday =0.
-                valid = strp_atoi(&s,&(tm->tm_wday), 0, 6, 0);
-                if(valid) weekday_found=true;
+                valid = strp_atoi(&s,e,&(tm->tm_wday), 0, 6, 0);
+                if(valid) st->weekday_found=true;
                 break;
           
             case 'Y': /* The year, including century (for example, 1991) - POSIX limits the year to 4 digits */
                 {
 #ifdef POSIX_2008                
-                 valid = strp_atoi(&s,&(tm->tm_year), 0, 9999, -1900);// max 4 digits
+                 valid = strp_atoi(&s,e,&(tm->tm_year), 0, 9999, -1900);// max 4 digits
 #else			/* read in an integer with an optional sign */
 				 bool neg=false;
-            	 if(*s=='-')
+            	 if(strp_ch(s,e)=='-')
             	 	{neg=true;
             	 	 ++s;
             	 	}
-            	 else if(*s=='+') ++s;
-				 valid=isdigit(*s); /* number must start with a digit (but can be any length) */
+            	 else if(strp_ch(s,e)=='+') ++s;
+				 valid=isdigit(strp_ch(s,e)); /* number must start with a digit (but can be any length) */
             	 if(valid)
             	 	{
             	 	 int y=(*s++)-'0';/* process 1st digit */
-            	 	 while(isdigit(*s))
+            	 	 while(isdigit(strp_ch(s,e)))
             	 		{/* we have another digit of the number */
             	 		 if(y*10+(*s-'0')<y) valid=false; // overflow - we don't know the type of time_t so this test should always work
             	 	 	 y=y*10+(*s++-'0');
@@ -584,7 +741,7 @@ char * ya_strptime(const char *s, const char *format, struct tm *tm)
 					 if(valid) tm->tm_year=y-1900;				   
 					}
 #endif                
-                 per_C_found=valid;// set flag to say we have a century already
+                 st->per_C_found=valid;// set flag to say we have a century already
              	}	
                 break;
 	             
@@ -594,11 +751,11 @@ char * ya_strptime(const char *s, const char *format, struct tm *tm)
 						 if [%C]%y and %Y are both present the last will be used. If %C %Y %y appear in that order the result may not be what is expected! 
             		 */
             	  {int y;
-                   valid = strp_atoi(&s,&(y), 0, 99, 0);
+                   valid = strp_atoi(&s,e,&(y), 0, 99, 0);
                    //int v=y;// save for printf below
                    if(valid)
                    	{
-                     if (per_C_found)
+                     if (st->per_C_found)
                      	{int C=tm->tm_year+1900;// extract century from current year (ofset is 1900)
                      	 C/=100;
                      	 C*=100; // above two operations zero out the last 2 digits of any existing date
@@ -612,18 +769,18 @@ char * ya_strptime(const char *s, const char *format, struct tm *tm)
             	  }	
                  break;
 			case 'z': // %z Time zone offset from UTC; a leading plus sign stands for east of UTC, a minus sign or west of UTC, followed by 4 digits eg -0500 .
-#if 1			/* set strp_tz.tz_off_mins */
+#if 1			/* set tz->tz_off_mins */
 				 {bool negative=false;
-				 if(*s=='-') 
+				 if(strp_ch(s,e)=='-') 
 				 	{negative=true;
 				 	 ++s;
 				 	}
-				 else if(*s=='+') ++s; // skip sign
-				 valid=isdigit(*s); /* number must start with a digit (but can be any length) */
+				 else if(strp_ch(s,e)=='+') ++s; // skip sign
+				 valid=isdigit(strp_ch(s,e)); /* number must start with a digit (but can be any length) */
             	 if(valid)
             	 	{int nos_digits=1;
             	 	 int t=(*s++)-'0';/* process 1st digit */
-            	 	 while(isdigit(*s))
+            	 	 while(isdigit(strp_ch(s,e)))
             	 		{/* we have another digit of the number */
             	 	 	 t=t*10+(*s++-'0');
             	 	 	 ++nos_digits;
@@ -631,96 +788,85 @@ char * ya_strptime(const char *s, const char *format, struct tm *tm)
             	 	 valid=nos_digits==4; // we need exactly 4 digits
 					 if(valid)
 					 	{ t = 60*(t/100)+(t%100) ; // last 2 digits are minutes, first 2 digits are hours (which we multiply by 60 to get to minutes)	
-					 	 if(negative)  strp_tz.tz_off_mins= -t;
-					 	 else  strp_tz.tz_off_mins=t;
+					 	 if(negative)  tz->tz_off_mins= -t;
+					 	 else  tz->tz_off_mins=t;
 					 	}
             	 	}
             	 }
-				// use  strp_tz.tz_off_mins= -1; 
+				// use  tz->tz_off_mins= -1; 
 #else  			/* Just check - do not do anything with the value. */
-				if(*s=='+' || *s=='-') ++s; // leading sign (required)
+				if(strp_ch(s,e)=='+' || strp_ch(s,e)=='-') ++s; // leading sign (required)
 				 else valid=false;
-				if(valid && isdigit(*s)) ++s;// 1st digit of number
+				if(valid && isdigit(strp_ch(s,e))) ++s;// 1st digit of number
 				 else valid=false;			
-				if(valid && isdigit(*s)) ++s;// 2nd digit of number
+				if(valid && isdigit(strp_ch(s,e))) ++s;// 2nd digit of number
 				 else valid=false;		
-				if(valid && isdigit(*s)) ++s;// 3rd digit of number
+				if(valid && isdigit(strp_ch(s,e))) ++s;// 3rd digit of number
 				 else valid=false;		
-				if(valid && isdigit(*s)) ++s;// 4th digit of number
+				if(valid && isdigit(strp_ch(s,e))) ++s;// 4th digit of number
 				 else valid=false;						 				 				 	
 #endif				 
 				break;
 			case 'Z':// %Z  time zone name. 2, 3 or 4 letters eg "ET", EDT, "UTC", "GMT", "AKST" etc. Put the value found into the strp_tz structure 
-					/* case is ignored in TZ comparisons (only impacts UTC test below) */
-				if(isalpha(*s)) strp_tz.tz_name[0]=*s++;// 1st character of name (required)
+					/* case is ignored when looking up the offset */
+				if(isalpha(strp_ch(s,e))) tz->tz_name[0]=*s++;// 1st character of name (required)
 				 else valid=false;			
-				if(valid && isalpha(*s)) 
-					{strp_tz.tz_name[1]=*s++;// 2nd character of name (required)	
-					 if(isalpha(*s)) 
-						{strp_tz.tz_name[2]=*s++;// optional 3rd character of name
-					     if(isalpha(*s)) strp_tz.tz_name[3]=*s++;// optional 4th character of name 
+				if(valid && isalpha(strp_ch(s,e))) 
+					{tz->tz_name[1]=*s++;// 2nd character of name (required)	
+					 if(isalpha(strp_ch(s,e))) 
+						{tz->tz_name[2]=*s++;// optional 3rd character of name
+					     if(isalpha(strp_ch(s,e))) tz->tz_name[3]=*s++;// optional 4th character of name 
 					 	}
 					}
 				 else valid=false;				 
 				if(!valid) 
-					{ strp_tz.tz_name[0]=0; // if not valid go back to default TZ
- 					  strp_tz.tz_name[1]=0;
- 					  strp_tz.tz_name[2]=0;	
- 					  strp_tz.tz_name[3]=0;	
+					{ tz->tz_name[0]=0; // if not valid go back to default TZ
+ 					  tz->tz_name[1]=0;
+ 					  tz->tz_name[2]=0;	
+ 					  tz->tz_name[3]=0;	
  					}
  				else
- 					{// we could set mydate.tz_off_mins here - for now just do for UTC as in general this is quite hard and as some time zone names are ambigeous in general may be impossible!
- 					 if(strnicmp(strp_tz.tz_name,"UTC",4)==0)
- 					 	strp_tz.tz_off_mins=0;// UTC has zero offset to UTC
+ 					{// set tz_off_mins if the abbreviation is known (1st from the table given for this call, then the built in one), otherwise it is left unknown.
+ 					 // An offset from %z is exact so is never replaced (whichever comes 1st)
+ 					 uint32_t key;
+ 					 int off;
+ 					 for(size_t i=(size_t)(s- *ps);i<4;++i) tz->tz_name[i]=0; // an earlier %Z may have been longer
+ 					 if(tz->tz_off_mins==strp_tz_default && strp_abbrev_key(*ps,(size_t)(s- *ps),&key) &&
+ 					    ((st->abbrevs!=NULL && strp_abbrev_find(st->abbrevs,key,&off)) || strp_abbrev_find(&strp_abbrev_table,key,&off)))
+ 					 	tz->tz_off_mins=off;
  					}
 				break;			
             case '%': // %% in the format string means we need a % character in the input 
-                if (*s != '%')
+                if (strp_ch(s,e) != '%')
                     valid = false;
                 ++s;
                 break;
             default:
                 valid = false;
                 }
-            }
-            break;
-        case ' ':
-        case '\t':
-        case '\r':
-        case '\n':
-        case '\f':
-        case '\v':
-            // zero or more whitespaces:
-            while (isspace((int)*s))
-                ++ s;
-            break;
-        default:
-            // match character
-            if (*s != *format)
-                valid = false;
-            else
-                ++s;
-            break;
-            }
-        ++format;
-        }
-    if(!valid || *format!=0) return NULL; //  return NULL on error (not using all the format is clearly an error)   
-	/* if %U, %V or %W has been given and we also have day of week (%u or %w) then we can work out date (or rather days in to year (0->366)) from the other things entered */
+    *ps = s;
+    return valid;
+    }
+
+static void strp_finish(struct tm *tm, struct strp_state *st)
+    {/* called once the whole format has been matched */
+	struct strp_tz_struct *tz = st->tz;
 	int day_of_week_yd(int64_t year,int yday); /* year with no offset eg 1900 and yday is day of year 0->365 */ 
-	if(weekday_found) // set when %u or %w found
+	/* if %U, %V or %W has been given and we also have day of week (%u or %w) then we can work out date (or rather days in to year (0->366)) from the other things entered */
+	if(st->weekday_found) // set when %u or %w found
 		{
 		 int wday=tm->tm_wday;// sunday=0
-		 if(per_U_found)
+		 if(st->per_U_found)
 			{// week of year, sunday being first day of week (0-53)
 			 int day1jan=day_of_week_yd(tm->tm_year+1900,0);// day of week of 1st Jan
-			 if(strp_tz.week_nos_U==0)
+			 if(tz->week_nos_U==0)
 			 	{// 1st week is special case
 			 	 tm->tm_yday=wday-day1jan;
 			 	}
 			 else	
-			 	tm->tm_yday=7*(strp_tz.week_nos_U)+wday-day1jan; // days in year is simple
+			 	tm->tm_yday=7*(tz->week_nos_U)+wday-day1jan; // days in year is simple
 			}
-		 else if(per_V_found && strp_tz.year_G!=strp_tz_default)
+		 else if(st->per_V_found && tz->year_G!=strp_tz_default)
 		 	{/* week of year using a week based year - algorithm from https://en.wikipedia.org/wiki/ISO_week_date#Calculating_an_ordinal_or_month_date_from_a_week_date
 		 	    Multiply the week number by 7.
     			Then add the weekday number. (1->7 with 1 as Monday)
@@ -733,8 +879,8 @@ char * ya_strptime(const char *s, const char *format, struct tm *tm)
         		Note input year here comes from %G NOT %Y
         	 */
         	 if(wday==0) wday=7;// make sunday 7 rather than 0, 1=monday
-        	 int i=strp_tz.week_nos_V*7+wday;
-        	 tm->tm_year=strp_tz.year_G-1900;// assume actual year is the same as iso year
+        	 int i=tz->week_nos_V*7+wday;
+        	 tm->tm_year=tz->year_G-1900;// assume actual year is the same as iso year
         	 int dayjan4=day_of_week_yd(tm->tm_year+1900,3);// day of week of 4th Jan
         	 if(dayjan4==0) dayjan4=7; // as above make 1=monday to 7=sunday
         	 i-=dayjan4+3; // note i may be negative (and so in previous year) or > days/year in which case its in the next year !
@@ -755,23 +901,23 @@ char * ya_strptime(const char *s, const char *format, struct tm *tm)
         	 		tm->tm_yday=i-1;
         		}
 			}
-		 else if(per_W_found)
+		 else if(st->per_W_found)
 		 	{// week of year , monday being 1st day
-		 	 // printf("** %%W found year=%d weeknos=%d day of week=%d",tm->tm_year+1900,strp_tz.week_nos_W,wday);
+		 	 // printf("** %%W found year=%d weeknos=%d day of week=%d",tm->tm_year+1900,tz->week_nos_W,wday);
 			 int day1jan=day_of_week_yd(tm->tm_year+1900,0);// day of week of 1st Jan
 			 if(day1jan==0) day1jan=6; // sunday=>6
 			  else day1jan--; // monday=0 etc
 			 if(wday==0) wday=6; // sunday=>6
 			  else wday--; // monday=0 etc	 
-			 if(strp_tz.week_nos_W==0)
+			 if(tz->week_nos_W==0)
 			 	{// 1st week is special case
 			 	 tm->tm_yday=wday-day1jan;
 			 	}
 			 else	
-			 	tm->tm_yday=7*(strp_tz.week_nos_W)+wday-day1jan; // days in year is simple
+			 	tm->tm_yday=7*(tz->week_nos_W)+wday-day1jan; // days in year is simple
 			 // printf(" after calcs wday=%d day1jan=%d\n",wday,day1jan);	
 		 	}
-		 if(per_U_found||(per_V_found && strp_tz.year_G!=strp_tz_default)||per_W_found)
+		 if(st->per_U_found||(st->per_V_found && tz->year_G!=strp_tz_default)||st->per_W_found)
 		 	{	
 		 	 // now set other fields (eg month, day of month) from tm_yday
 		 	 /*
@@ -790,14 +936,1609 @@ char * ya_strptime(const char *s, const char *format, struct tm *tm)
  				tm->tm_year,tm->tm_year+1900,tm->tm_mon,tm->tm_mon+1,strp_monthnames[tm->tm_mon],tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec,
     			(tm->tm_wday>=0 && tm->tm_wday<=6)?strp_weekdays[tm->tm_wday]:"???", tm->tm_yday, tm->tm_isdst);  		 	 
     		*/
- 			 strp_tz.week_nos_U= strp_tz_default; // set back to defaults as we went them to be calculated if used for output, not just echoed ....
-			 strp_tz.week_nos_V= strp_tz_default;
-			 strp_tz.week_nos_W= strp_tz_default; 
-			 strp_tz.year_G= strp_tz_default;	
+ 			 tz->week_nos_U= strp_tz_default; // set back to defaults as we went them to be calculated if used for output, not just echoed ....
+			 tz->week_nos_V= strp_tz_default;
+			 tz->week_nos_W= strp_tz_default; 
+			 tz->year_G= strp_tz_default;	
 		 	}
 
 		} 
+    }
+
+/* Fast path for ISO 8601 timestamps
+   ==================================
+   The formats "%Y-%m-%dT%H:%M:%S" and "%Y-%m-%d %H:%M:%S" (optionally followed by ".%f" and/or "%z") are very common, so these are recognised
+   and the 19 characters of the date and time are checked and converted with 3 64-bit "SWAR" (SIMD within a register) operations rather than one character at a time.
+   The fast path only handles the simple case (a 4 digit year, 2 digits for every other field, 1-9 digits for %f and +hhmm for %z) and only when every field is in range, 
+   anything else (including invalid input) is passed to the generic code so the results (return value, tm and tz) are always identical to the generic code.
+   As the year is exactly 4 digits this also applies the POSIX_2008 limit on %Y.
+*/
+#define STRP_ISO 1 /* format is an ISO 8601 layout (returned by strp_iso_layout()) */
+#define STRP_ISO_SPACE 2 /* date and time are separated by a space (rather than a T) */
+#define STRP_ISO_F 4 /* followed by .%f */
+#define STRP_ISO_Z 8 /* followed by %z */
+#define STRP_ISO_LEN 19 /* length of "YYYY-MM-DDTHH:MM:SS" */
+
+static int strp_iso_layout(const char *format)
+{/* returns 0 if format is not one of the formats handled by strp_iso(), otherwise a combination of the STRP_ISO flags above */
+ int layout=STRP_ISO;
+ if(format[0]!='%' || format[1]!='Y' || strncmp(format+2,"-%m-%d",6)!=0) return 0; // quick check for the common case of a non ISO format
+ format+=8;
+ if(*format==' ') layout|=STRP_ISO_SPACE;
+ else if(*format!='T') return 0;
+ if(strncmp(format+1,"%H:%M:%S",8)!=0) return 0;
+ format+=9;
+ if(format[0]=='.' && format[1]=='%' && format[2]=='f')
+ 	{layout|=STRP_ISO_F;
+ 	 format+=3;
+ 	}
+ if(format[0]=='%' && format[1]=='z')
+ 	{layout|=STRP_ISO_Z;
+ 	 format+=2;
+ 	}
+ return *format==0 ? layout : 0;
+}
+
+static inline uint64_t strp_load8(const char *s)
+{/* load 8 characters, s[0] in the least significant byte */
+ uint64_t w;
+ memcpy(&w,s,8);
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+ w=__builtin_bswap64(w);
+#endif
+ return w;
+}
+
+static inline uint64_t strp_swar_2digits(uint64_t w, uint64_t digits, uint64_t seps_mask, uint64_t seps, bool *ok)
+{/* check the bytes of w selected by digits are '0'-'9' and the bytes selected by seps_mask are seps, clears *ok if not.
+    Returns w with byte i set to the 2 digit number starting at byte i (for bytes where i and i+1 are both digits) */
+ uint64_t x=(w^UINT64_C(0x3030303030303030))&digits; // '0'-'9' -> 0-9, anything else is >9
+ if((w&seps_mask)!=seps || (((x+UINT64_C(0x7676767676767676))|x)&UINT64_C(0x8080808080808080))!=0) *ok=false; // 0x76+9=0x7f so bytes >9 set their top bit
+ return x*10+(x>>8); // each byte is at most 9 so there are no carries between bytes 
+}
+
+static const char * strp_iso(const char *s, const char *e, int layout, struct tm *tm, struct strp_tz_struct *tz)
+{/* match s (which ends at e, or NULL if null terminated) against the ISO 8601 layout, returns the character after the match or NULL if s needs to be matched by the generic code. tz must already be initialised */
+ const uint64_t b1=UINT64_C(0xff),b2=UINT64_C(0xffff); // masks for 1 and 2 bytes
+ uint64_t ymd,d,hms;
+ bool ok=true;
+ int year,mon,mday,hour,min,sec,power10=0,off_mins=0;
+ uint64_t fsec=0;
+ if(e!=NULL ? e-s<STRP_ISO_LEN : memchr(s,0,STRP_ISO_LEN)!=NULL) return NULL; // too short (memchr() stops at the 1st null so never reads past the end of s)
+ ymd=strp_swar_2digits(strp_load8(s),b2|b2<<16|b2<<40,b1<<32|b1<<56,(uint64_t)'-'<<32|(uint64_t)'-'<<56,&ok); // "YYYY-MM-"
+ d=strp_swar_2digits(strp_load8(s+8),b2,b1<<16,(uint64_t)(layout&STRP_ISO_SPACE?' ':'T')<<16,&ok); // "DDT" (rest is checked below)
+ hms=strp_swar_2digits(strp_load8(s+11),b2|b2<<24|b2<<48,b1<<16|b1<<40,(uint64_t)':'<<16|(uint64_t)':'<<40,&ok); // "HH:MM:SS"
+ if(!ok) return NULL;
+ year=(int)(ymd&b1)*100+(int)(ymd>>16&b1);
+ mon=(int)(ymd>>40&b1);
+ mday=(int)(d&b1);
+ hour=(int)(hms&b1);
+ min=(int)(hms>>24&b1);
+ sec=(int)(hms>>48&b1);
+ if(mon<1 || mon>12 || mday<1 || mday>31 || hour>23 || min>59 || sec>60) return NULL; // the same limits as strp_conv()
+ s+=STRP_ISO_LEN;
+ if(layout&STRP_ISO_F)
+ 	{// '.' then 1-9 digits, as %f in strp_conv() (which only rounds if there are more than 18 digits)
+ 	 if(strp_ch(s,e)!='.') return NULL;
+ 	 ++s;
+ 	 while(isdigit(strp_ch(s+power10,e)) && power10<=9) fsec=fsec*10+(uint64_t)(s[power10++]-'0');
+ 	 if(power10==0 || power10>9) return NULL;
+ 	 s+=power10;
+ 	}
+ if(layout&STRP_ISO_Z)
+ 	{// optional sign then exactly 4 digits
+ 	 bool negative= strp_ch(s,e)=='-';
+ 	 if(negative || strp_ch(s,e)=='+') ++s;
+ 	 if(!isdigit(strp_ch(s,e)) || !isdigit(strp_ch(s+1,e)) || !isdigit(strp_ch(s+2,e)) || !isdigit(strp_ch(s+3,e)) || isdigit(strp_ch(s+4,e))) return NULL; // stops at the 1st non digit so never passes e
+ 	 off_mins=60*((s[0]-'0')*10+(s[1]-'0'))+(s[2]-'0')*10+(s[3]-'0');
+ 	 if(negative) off_mins= -off_mins;
+ 	 s+=4;
+ 	}
+ // everything matched so now set the results
+ if(layout&STRP_ISO_F) strp_set_f(tz,fsec,(unsigned int)power10);
+ if(layout&STRP_ISO_Z) tz->tz_off_mins=off_mins;
+ tm->tm_year=year-1900;
+ tm->tm_mon=mon-1;
+ tm->tm_mday=mday;
+ tm->tm_hour=hour;
+ tm->tm_min=min;
+ tm->tm_sec=sec;
+ return s;
+}
+
+char * ya_strptime(const char *s, const char *format, struct tm *tm)
+    {/* uses the global strp_tz for items not in struct tm */
+    return ya_strptime_r(s,format,tm,&strp_tz);
+    }
+
+static char * strp_parse(const char *s, const char *e, const char *format, struct tm *tm, struct strp_tz_struct *tz, const struct strp_abbrev_table *abbrevs)
+    {/* ya_strptime_r() for input s that ends at e (or at a null character), e is NULL for null terminated input. %Z tries abbrevs (if not NULL) before the built in table */
+    bool valid = true;
+    struct strp_state st={false,false,false,false,false,false,tz,abbrevs};
+    if (tz == NULL)
+    	return NULL;
+    init_strp_tz(tz); // always initialse tz as we want to know what items are set by this call to strptime()
+	if (s == NULL || format == NULL || tm == NULL )
+		return NULL;    	
+    int layout=strp_iso_layout(format);
+    if(layout)
+    	{// try the fast path for ISO 8601 timestamps 1st
+    	 const char *r=strp_iso(s,e,layout,tm,tz);
+    	 if(r!=NULL) return (char *)r;
+    	}
+    while (valid && *format && strp_ch(s,e))
+        {
+        switch (*format)
+            {
+        case '%': /* all special format designators start with a % */
+            {
+            const char *sub;
+            ++format;
+            if(*format=='E') ++format;// ignore E modifier (as in C locale)
+            else if(*format=='O') ++ format; // also ignore O modifier (as in C locale)
+            sub=strp_composite(*format);
+            if(sub!=NULL)
+            	{// composite specifiers (eg %T) are processed by a recursive call
+            	 char *r=strp_parse(s,e,sub,tm,tz,abbrevs);
+            	 valid=r!=NULL;
+            	 if(valid) s=r;
+            	}
+            else
+            	valid=strp_conv(*format,&s,e,tm,&st);
+            }
+            break;
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+        case '\f':
+        case '\v':
+            // zero or more whitespaces:
+            while (isspace((int)strp_ch(s,e)))
+                ++ s;
+            break;
+        default:
+            // match character
+            if (strp_ch(s,e) != *format)
+                valid = false;
+            else
+                ++s;
+            break;
+            }
+        ++format;
+        }
+    if(!valid || *format!=0) return NULL; //  return NULL on error (not using all the format is clearly an error)   
+    strp_finish(tm,&st);
 
     return (char *)s;// or character after last match if sucessfull.
     }
 
+char * ya_strptime_r(const char *s, const char *format, struct tm *tm, struct strp_tz_struct *tz)
+    {/* reentrant version of ya_strptime(), items not in struct tm are put into tz (which is always initialised first) rather than the global strp_tz */
+    return strp_parse(s,NULL,format,tm,tz,NULL);
+    }
+
+/* Length bounded input
+   ====================
+   ya_strptime_n() and the other *_n functions take the length of the input rather than needing a null terminated string, so strings can be parsed directly 
+   from (for example) a memory mapped file or a network buffer without first being copied. They never read s[len] or beyond, and otherwise give identical results
+   to the null terminated versions applied to a copy of the 1st len characters of s (a null character before s[len] also ends the input).
+   They return a pointer to the character after the match (so the number of characters used is the return value - s) or NULL if there is no match.
+*/
+char * ya_strptime_n(const char *s, size_t len, const char *format, struct tm *tm)
+    {/* uses the global strp_tz for items not in struct tm */
+    return ya_strptime_n_r(s,len,format,tm,&strp_tz);
+    }
+
+char * ya_strptime_n_r(const char *s, size_t len, const char *format, struct tm *tm, struct strp_tz_struct *tz)
+    {
+    return strp_parse(s,s==NULL?NULL:s+len,format,tm,tz,NULL);
+    }
+
+char * ya_strptime_n_abbrevs_r(const char *s, size_t len, const char *format, struct tm *tm, struct strp_tz_struct *tz, const struct strp_abbrev_table *abbrevs)
+    {/* as ya_strptime_n_r() but %Z looks for the zone abbreviation in abbrevs (if not NULL) before the built in table */
+    return strp_parse(s,s==NULL?NULL:s+len,format,tm,tz,abbrevs);
+    }
+
+/* Precompiled formats for ya_strptime()
+   ======================================
+   strp_compile() converts a format string into a flat array of operations (a "plan") once, ya_strptime_plan() then matches strings against that plan
+   without having to decode the format again. Composite specifiers (%c %D %F %r %R %T %x %X) are expanded into their component specifiers when the plan is compiled.
+   ya_strptime_plan() gives identical results (return value, tm and strp_tz) to ya_strptime() called with the same format string. 
+   A plan is never changed after it has been compiled, so one plan can be used by many callers. Call strp_free_plan() when it is no longer needed.
+*/
+enum strp_op_code {STRP_OP_CHAR, STRP_OP_SPACE, STRP_OP_NUM, STRP_OP_CONV, STRP_OP_GROUP_BEGIN, STRP_OP_GROUP_END, STRP_OP_FAIL};
+#define STRP_MAX_NEST 4 /* maximum nesting of composite specifiers (%c contains %T so this is 2 at present) */
+
+struct strp_op
+	{
+	 unsigned char code; /* enum strp_op_code */
+	 char c; /* character to match (STRP_OP_CHAR) or conversion specifier (STRP_OP_CONV) */
+	 unsigned short field; /* offsetof() member of struct tm set by STRP_OP_NUM */
+	 unsigned int low, high, offset; /* arguments for strp_atoi() used by STRP_OP_NUM */
+	};
+
+struct strp_plan
+	{
+	 size_t nops; /* number of operations in ops[] */
+	 int iso; /* strp_iso_layout() of the format */
+	 struct strp_op *ops;
+	};
+
+static size_t strp_emit(const char *format, struct strp_op *ops)
+{/* convert format to operations, if ops==NULL just count them. Returns number of operations */
+ size_t n=0;
+ struct strp_op op;
+ for(;*format;++format)
+ 	{memset(&op,0,sizeof(op));
+ 	 if(*format=='%')
+ 	 	{const char *sub;
+ 	 	 ++format;
+         if(*format=='E') ++format;// ignore E modifier (as in C locale)
+         else if(*format=='O') ++ format; // also ignore O modifier (as in C locale)
+         sub=strp_composite(*format);
+         if(sub!=NULL)
+         	{// matches ya_strptime() which makes a recursive call for composite specifiers
+         	 if(ops) ops[n].code=STRP_OP_GROUP_BEGIN;
+         	 ++n;
+         	 n+=strp_emit(sub,ops?ops+n:NULL);
+         	 if(ops) ops[n].code=STRP_OP_GROUP_END;
+         	 ++n;
+         	 continue;
+         	}
+         op.code=STRP_OP_CONV;
+         op.c= *format;
+         switch(*format)
+         	{// simple numeric fields are converted directly by strp_atoi(), these must match the values used in strp_conv()
+         	 case 'd': op.code=STRP_OP_NUM; op.field=offsetof(struct tm,tm_mday); op.low=1; op.high=31; op.offset=0; break;
+         	 case 'H': op.code=STRP_OP_NUM; op.field=offsetof(struct tm,tm_hour); op.low=0; op.high=23; op.offset=0; break;
+         	 case 'I': op.code=STRP_OP_NUM; op.field=offsetof(struct tm,tm_hour); op.low=1; op.high=12; op.offset=0; break;
+         	 case 'j': op.code=STRP_OP_NUM; op.field=offsetof(struct tm,tm_yday); op.low=1; op.high=366; op.offset=(unsigned int)-1; break;
+         	 case 'm': op.code=STRP_OP_NUM; op.field=offsetof(struct tm,tm_mon); op.low=1; op.high=12; op.offset=(unsigned int)-1; break;
+         	 case 'M': op.code=STRP_OP_NUM; op.field=offsetof(struct tm,tm_min); op.low=0; op.high=59; op.offset=0; break;
+         	 case 'S': op.code=STRP_OP_NUM; op.field=offsetof(struct tm,tm_sec); op.low=0; op.high=60; op.offset=0; break;
+         	 case 'n':
+         	 case 't': op.code=STRP_OP_SPACE; break;
+         	 case '\0': op.code=STRP_OP_FAIL; --format; break; // % at end of format is invalid (--format so the loop terminates)
+         	 default: break; // all other specifiers (including invalid ones) are handled by strp_conv()
+         	}
+ 	 	}
+ 	 else if(isspace((int)*format))
+ 	 	op.code=STRP_OP_SPACE; // zero or more whitespaces
+ 	 else
+ 	 	{op.code=STRP_OP_CHAR; // match character
+ 	 	 op.c= *format;
+ 	 	}
+ 	 if(ops) ops[n]=op;
+ 	 ++n;
+ 	}
+ return n;
+}
+
+struct strp_plan * strp_compile(const char *format)
+{/* compile format for use with ya_strptime_plan(), returns NULL if format is NULL or memory could not be allocated */
+ struct strp_plan *plan;
+ size_t n;
+ if(format==NULL) return NULL;
+ n=strp_emit(format,NULL);
+ plan=(struct strp_plan *)malloc(sizeof(struct strp_plan)+(n?n:1)*sizeof(struct strp_op)); // plan and ops[] are in one block of memory
+ if(plan==NULL) return NULL;
+ plan->ops=(struct strp_op *)(plan+1);
+ plan->nops=strp_emit(format,plan->ops);
+ plan->iso=strp_iso_layout(format);
+ return plan;
+}
+
+void strp_free_plan(struct strp_plan *plan)
+{
+ free(plan);
+}
+
+char * ya_strptime_plan(const char *s, const struct strp_plan *plan, struct tm *tm)
+{/* identical to ya_strptime(s,format,tm) where plan=strp_compile(format) */
+ return ya_strptime_plan_r(s,plan,tm,&strp_tz);
+}
+
+static char * strp_plan_parse(const char *s, const char *e, const struct strp_plan *plan, struct tm *tm, struct strp_tz_struct *tz, const struct strp_abbrev_table *abbrevs)
+{/* ya_strptime_plan_r() for input s that ends at e (or at a null character), e is NULL for null terminated input. %Z tries abbrevs (if not NULL) before the built in table */
+ bool valid=true;
+ struct strp_state st={false,false,false,false,false,false,tz,abbrevs};
+ struct strp_state saved[STRP_MAX_NEST]; // state of the enclosing format while a composite specifier is processed
+ int depth=0;
+ const struct strp_op *op,*end;
+ if (tz == NULL)
+ 	return NULL;
+ init_strp_tz(tz); // always initialse tz as we want to know what items are set by this call to strptime()
+ if (s == NULL || plan == NULL || tm == NULL )
+ 	return NULL;
+ if(plan->iso)
+ 	{// try the fast path for ISO 8601 timestamps 1st
+ 	 const char *r=strp_iso(s,e,plan->iso,tm,tz);
+ 	 if(r!=NULL) return (char *)r;
+ 	}
+ end=plan->ops+plan->nops;
+ for(op=plan->ops;op<end;++op)
+ 	{if(op->code==STRP_OP_GROUP_END)
+ 		{// end of a composite specifier, ya_strptime() would return from its recursive call here
+ 		 strp_finish(tm,&st);
+ 		 st=saved[--depth];
+ 		 continue;
+ 		}
+ 	 if(strp_ch(s,e)==0) break; // end of input, but not end of format so an error
+ 	 switch(op->code)
+ 	 	{
+ 	 	 case STRP_OP_CHAR:
+ 	 	 	if(*s!=op->c) valid=false; // s is not the end of the input (checked above)
+ 	 	 	else ++s;
+ 	 	 	break;
+ 	 	 case STRP_OP_SPACE:
+ 	 	 	while (isspace((int)strp_ch(s,e)))
+                ++ s;
+ 	 	 	break;
+ 	 	 case STRP_OP_NUM:
+ 	 	 	valid=strp_atoi(&s,e,(int *)((char *)tm+op->field),op->low,op->high,op->offset);
+ 	 	 	break;
+ 	 	 case STRP_OP_CONV:
+ 	 	 	valid=strp_conv(op->c,&s,e,tm,&st);
+ 	 	 	break;
+ 	 	 case STRP_OP_GROUP_BEGIN: 
+ 	 	 	if(depth>=STRP_MAX_NEST) valid=false; // cannot happen with the current composite specifiers
+ 	 	 	else
+ 	 	 		{saved[depth++]=st;
+ 	 	 		 st.per_C_found=st.per_G_found=st.weekday_found=false; // the composite has its own set of flags
+ 	 	 		 st.per_U_found=st.per_V_found=st.per_W_found=false;
+ 	 	 		 init_strp_tz(tz); // ya_strptime() does this at the start of its recursive call
+ 	 	 		}
+ 	 	 	break;
+ 	 	 default: // STRP_OP_FAIL
+ 	 	 	valid=false;
+ 	 	 	break;
+ 	 	}
+ 	 if(!valid) break;
+ 	}
+ if(!valid || op!=end) return NULL; //  return NULL on error (not using all the format is clearly an error)
+ strp_finish(tm,&st);
+ return (char *)s;// or character after last match if sucessfull.
+}
+
+char * ya_strptime_plan_r(const char *s, const struct strp_plan *plan, struct tm *tm, struct strp_tz_struct *tz)
+{/* identical to ya_strptime_r(s,format,tm,tz) where plan=strp_compile(format) */
+ return strp_plan_parse(s,NULL,plan,tm,tz,NULL);
+}
+
+char * ya_strptime_plan_n_r(const char *s, size_t len, const struct strp_plan *plan, struct tm *tm, struct strp_tz_struct *tz)
+{/* identical to ya_strptime_n_r(s,len,format,tm,tz) where plan=strp_compile(format) */
+ return strp_plan_parse(s,s==NULL?NULL:s+len,plan,tm,tz,NULL);
+}
+
+char * ya_strptime_plan_n_abbrevs_r(const char *s, size_t len, const struct strp_plan *plan, struct tm *tm, struct strp_tz_struct *tz, const struct strp_abbrev_table *abbrevs)
+{/* identical to ya_strptime_n_abbrevs_r(s,len,format,tm,tz,abbrevs) where plan=strp_compile(format) */
+ return strp_plan_parse(s,s==NULL?NULL:s+len,plan,tm,tz,abbrevs);
+}
+
+/* Multiple formats
+   ================
+   strp_multi_compile() takes a list of formats and ya_strptime_multi() then matches a string against each of them in turn until one matches, returning which one did.
+   Each format is precompiled (as strp_compile()) and has a set of cheap "prefilters" worked out from it: the minimum length of a string that can match, the characters 
+   that can start a match and up to STRP_MULTI_SEPS literal characters (eg the '-' in "%d-%m") that must be in a known range of positions. A format is only tried if 
+   the string passes all of these (the length is only checked by ya_strptime_multi_n_r() where it is known, finding it would cost more than it saves), and they are 
+   conservative so a format is never skipped when it would have matched.
+   If adaptive is true the formats are reordered by the number of times each has matched (so the most common one is tried 1st), otherwise they are always tried in 
+   the order given. As ya_strptime() allows characters after the match, a string can match more than one format (eg "%Y-%m-%d" and "%Y-%m-%d %H:%M:%S"), 
+   in which case with adaptive ordering which one is used can depend on the strings matched previously.
+   For each format the results are exactly as ya_strptime() with that format applied to a copy of tm as it was when ya_strptime_multi() was called.
+   A struct strp_multi is changed by ya_strptime_multi() if adaptive is true, so each thread needs its own.
+*/
+#define STRP_MULTI_SEPS 4 /* maximum number of literal characters checked by the prefilter for each format */
+#define STRP_MULTI_MAX_HITS 0x100000 /* match counts are halved when one reaches this so the order adapts to changes in the input */
+#define STRP_WIDTH_MAX ((size_t)-1) /* width of a field with no limit on its number of characters */
+
+struct strp_filter
+	{
+	 size_t min_len; /* minimum length of a string that can match */
+	 unsigned char first[32]; /* bit set of the characters that can be the 1st character of a match */
+	 int nseps; /* number of entries used in sep[] */
+	 struct {size_t lo,hi; char c;} sep[STRP_MULTI_SEPS]; /* character c must be at one of s[lo]..s[hi] */
+	};
+
+struct strp_multi
+	{
+	 int n; /* number of formats */
+	 bool adaptive; /* reorder formats by number of matches */
+	 struct strp_plan **plans; /* compiled formats, in the order given */
+	 struct strp_filter *filters; /* prefilter for each format */
+	 int *order; /* indices of the formats in the order they are tried */
+	 unsigned int *hits; /* number of matches for each format */
+	};
+
+static void strp_set_bit(unsigned char *set, int c)
+{
+ set[(unsigned char)c>>3]|=(unsigned char)(1u<<((unsigned char)c&7));
+}
+
+static void strp_set_chars(unsigned char *set, int (*is)(int))
+{/* add all the characters for which is() is true to set */
+ for(int c=1;c<256;++c)
+ 	if(is(c)) strp_set_bit(set,c);
+}
+
+static size_t strp_max_name(const char **names, int n)
+{/* length of the longest name */
+ size_t m=0;
+ for(int i=0;i<n;++i)
+ 	if(strlen(names[i])>m) m=strlen(names[i]);
+ return m;
+}
+
+static void strp_op_filter(const struct strp_op *op, size_t *lo, size_t *hi, unsigned char *first)
+{/* sets *lo and *hi to the minimum and maximum number of characters op can match and adds the characters it can start with to first. These must agree with strp_conv() */
+ *lo=1;
+ *hi=1;
+ switch(op->code)
+ 	{
+ 	 case STRP_OP_CHAR: strp_set_bit(first,op->c); return;
+ 	 case STRP_OP_SPACE: *lo=0; *hi=STRP_WIDTH_MAX; strp_set_chars(first,isspace); return;
+ 	 case STRP_OP_GROUP_BEGIN:
+ 	 case STRP_OP_GROUP_END: *lo=0; *hi=0; return;
+ 	 case STRP_OP_NUM: for(unsigned int h=op->high/10;h>0;h/=10) ++*hi; // number of digits in high (as strp_atoi())
+ 	 				   strp_set_chars(first,isdigit); return;
+ 	 case STRP_OP_FAIL: *lo=STRP_WIDTH_MAX; return; // never matches
+ 	 default: break; // STRP_OP_CONV
+ 	}
+ switch(op->c)
+ 	{
+ 	 case 'a':
+ 	 case 'A': *lo=3; *hi=strp_max_name(strp_weekdays,7);
+ 	 		   for(int i=0;i<7;++i) {strp_set_bit(first,tolower(strp_weekdays[i][0])); strp_set_bit(first,toupper(strp_weekdays[i][0]));} // matching ignores case
+ 	 		   break;
+ 	 case 'b':
+ 	 case 'B':
+ 	 case 'h': *lo=3; *hi=strp_max_name(strp_monthnames,12);
+ 	 		   for(int i=0;i<12;++i) {strp_set_bit(first,tolower(strp_monthnames[i][0])); strp_set_bit(first,toupper(strp_monthnames[i][0]));} // matching ignores case
+ 	 		   break;
+ 	 case 'e': *hi=2; strp_set_chars(first,isdigit); strp_set_chars(first,isspace); break;
+ 	 case 'C':
+ 	 case 'g':
+ 	 case 'U':
+ 	 case 'V':
+ 	 case 'W':
+ 	 case 'y': *hi=2; strp_set_chars(first,isdigit); break;
+ 	 case 'G': *hi=4; strp_set_chars(first,isdigit); break;
+ 	 case 'u':
+ 	 case 'w': strp_set_chars(first,isdigit); break;
+ 	 case 'f': *hi=STRP_WIDTH_MAX; strp_set_chars(first,isdigit); break;
+ 	 case 'p': *lo=*hi=2; strp_set_bit(first,'a'); strp_set_bit(first,'A'); strp_set_bit(first,'p'); strp_set_bit(first,'P'); break;
+ 	 case 'Y':
+#ifdef POSIX_2008
+ 	 		   *hi=4; strp_set_chars(first,isdigit); break;
+#endif
+ 	 case 's': *hi=STRP_WIDTH_MAX; strp_set_chars(first,isdigit); strp_set_bit(first,'+'); strp_set_bit(first,'-'); break;
+ 	 case 'z': *lo=4; *hi=5; strp_set_chars(first,isdigit); strp_set_bit(first,'+'); strp_set_bit(first,'-'); break;
+ 	 case 'Z': *lo=2; *hi=4; strp_set_chars(first,isalpha); break;
+ 	 case '%': strp_set_bit(first,'%'); break;
+ 	 default: break; // invalid specifier, never matches (nothing added to first)
+ 	}
+}
+
+static void strp_make_filter(const struct strp_plan *plan, struct strp_filter *f)
+{/* work out the prefilter for plan */
+ size_t lo=0,hi=0; // range of positions of the current op
+ bool first_done=false;
+ memset(f,0,sizeof(*f));
+ for(size_t i=0;i<plan->nops;++i)
+ 	{size_t op_lo,op_hi;
+ 	 unsigned char first[32];
+ 	 memset(first,0,sizeof(first));
+ 	 strp_op_filter(plan->ops+i,&op_lo,&op_hi,first);
+ 	 if(!first_done)
+ 	 	{// characters that can start a match, if op can match nothing the next op can also start the match
+ 	 	 for(int j=0;j<32;++j) f->first[j]|=first[j];
+ 	 	 first_done=op_lo>0;
+ 	 	}
+ 	 if(plan->ops[i].code==STRP_OP_CHAR && hi!=STRP_WIDTH_MAX && f->nseps<STRP_MULTI_SEPS)
+ 	 	{f->sep[f->nseps].lo=lo;
+ 	 	 f->sep[f->nseps].hi=hi;
+ 	 	 f->sep[f->nseps].c=plan->ops[i].c;
+ 	 	 ++f->nseps;
+ 	 	}
+ 	 lo=(op_lo==STRP_WIDTH_MAX || lo+op_lo<lo) ? STRP_WIDTH_MAX : lo+op_lo;
+ 	 hi=(op_hi==STRP_WIDTH_MAX || hi+op_hi<hi) ? STRP_WIDTH_MAX : hi+op_hi;
+ 	}
+ if(!first_done)
+ 	{// format can match without reading any characters, so any 1st character is possible
+ 	 memset(f->first,0xff,sizeof(f->first));
+ 	 if(plan->nops>0) f->first[0]&=0xfe; // but the input cannot be empty unless the format is (as ya_strptime() fails at the end of the input if any format remains)
+ 	}
+ f->min_len=lo;
+}
+
+static bool strp_filter_pass(const struct strp_filter *f, const char *s, const char *e)
+{/* true if a string starting s (ending at e or a null character, e is NULL for null terminated input) can match the format */
+ unsigned char c=(unsigned char)strp_ch(s,e);
+ if((e!=NULL && (size_t)(e-s)<f->min_len) || (f->first[c>>3]&(1u<<(c&7)))==0) return false;
+ for(int i=0;i<f->nseps;++i)
+ 	{// stops at the end of the input
+ 	 const char *p=s+f->sep[i].lo,*q=s+f->sep[i].hi;
+ 	 while(strp_ch(p,e)!=f->sep[i].c)
+ 	 	{if(strp_ch(p,e)==0 || p==q) return false;
+ 	 	 ++p;
+ 	 	}
+ 	}
+ return true;
+}
+
+struct strp_multi * strp_multi_compile(const char * const *formats, int n, bool adaptive)
+{/* compile n formats for ya_strptime_multi(), returns NULL if a format is NULL or memory could not be allocated */
+ struct strp_multi *m;
+ if(formats==NULL || n<=0) return NULL;
+ m=(struct strp_multi *)calloc(1,sizeof(struct strp_multi));
+ if(m==NULL) return NULL;
+ m->n=n;
+ m->adaptive=adaptive;
+ m->plans=(struct strp_plan **)calloc((size_t)n,sizeof(struct strp_plan *));
+ m->filters=(struct strp_filter *)calloc((size_t)n,sizeof(struct strp_filter));
+ m->order=(int *)calloc((size_t)n,sizeof(int));
+ m->hits=(unsigned int *)calloc((size_t)n,sizeof(unsigned int));
+ if(m->plans==NULL || m->filters==NULL || m->order==NULL || m->hits==NULL)
+ 	{strp_multi_free(m);
+ 	 return NULL;
+ 	}
+ for(int i=0;i<n;++i)
+ 	{m->plans[i]=strp_compile(formats[i]);
+ 	 if(m->plans[i]==NULL)
+ 	 	{strp_multi_free(m);
+ 	 	 return NULL;
+ 	 	}
+ 	 strp_make_filter(m->plans[i],m->filters+i);
+ 	 m->order[i]=i;
+ 	}
+ return m;
+}
+
+void strp_multi_free(struct strp_multi *m)
+{
+ if(m==NULL) return;
+ if(m->plans!=NULL)
+ 	for(int i=0;i<m->n;++i) strp_free_plan(m->plans[i]);
+ free(m->plans);
+ free(m->filters);
+ free(m->order);
+ free(m->hits);
+ free(m);
+}
+
+int strp_multi_order(const struct strp_multi *m, int *order)
+{/* copy the indices of the formats in the order they are currently tried to order[] (which must have space for all of them), returns number of formats */
+ if(m==NULL) return 0;
+ if(order!=NULL) memcpy(order,m->order,(size_t)m->n*sizeof(int));
+ return m->n;
+}
+
+static void strp_multi_hit(struct strp_multi *m, int k)
+{/* the format at position k in m->order has matched, move it forward past formats with fewer matches */
+ int i=m->order[k];
+ if(++m->hits[i]>=STRP_MULTI_MAX_HITS)
+ 	for(int j=0;j<m->n;++j) m->hits[j]/=2; // keep recent matches more important than old ones
+ while(k>0 && m->hits[m->order[k-1]]<m->hits[i])
+ 	{m->order[k]=m->order[k-1];
+ 	 --k;
+ 	}
+ m->order[k]=i;
+}
+
+static char * strp_multi_parse(const char *s, const char *e, struct strp_multi *m, struct tm *tm, struct strp_tz_struct *tz, int *which, const struct strp_abbrev_table *abbrevs)
+{/* ya_strptime_multi_r() for input s that ends at e (or at a null character), e is NULL for null terminated input. %Z tries abbrevs (if not NULL) before the built in table */
+ struct tm tm_in;
+ if(which!=NULL) *which= -1;
+ if(tz==NULL) return NULL;
+ init_strp_tz(tz);
+ if(s==NULL || m==NULL || tm==NULL) return NULL;
+ tm_in= *tm; // each format starts with tm as given
+ for(int k=0;k<m->n;++k)
+ 	{int i=m->order[k];
+ 	 char *r;
+ 	 if(!strp_filter_pass(m->filters+i,s,e)) continue;
+ 	 r=strp_plan_parse(s,e,m->plans[i],tm,tz,abbrevs);
+ 	 if(r!=NULL)
+ 	 	{if(which!=NULL) *which=i;
+ 	 	 if(m->adaptive) strp_multi_hit(m,k);
+ 	 	 return r;
+ 	 	}
+ 	 *tm=tm_in; // undo any changes made by the failed attempt
+ 	}
+ init_strp_tz(tz);
+ return NULL;
+}
+
+char * ya_strptime_multi(const char *s, struct strp_multi *m, struct tm *tm, int *which)
+{/* uses the global strp_tz for items not in struct tm */
+ return ya_strptime_multi_r(s,m,tm,&strp_tz,which);
+}
+
+char * ya_strptime_multi_r(const char *s, struct strp_multi *m, struct tm *tm, struct strp_tz_struct *tz, int *which)
+{/* match s against the formats in m, returns as ya_strptime_r() for the 1st format that matches and sets *which (if which is not NULL) to its index (or -1 if none match) */
+ return strp_multi_parse(s,NULL,m,tm,tz,which,NULL);
+}
+
+char * ya_strptime_multi_n_r(const char *s, size_t len, struct strp_multi *m, struct tm *tm, struct strp_tz_struct *tz, int *which)
+{/* as ya_strptime_multi_r() for the len characters at s (see ya_strptime_n()) */
+ return strp_multi_parse(s,s==NULL?NULL:s+len,m,tm,tz,which,NULL);
+}
+
+char * ya_strptime_multi_n_abbrevs_r(const char *s, size_t len, struct strp_multi *m, struct tm *tm, struct strp_tz_struct *tz, int *which, const struct strp_abbrev_table *abbrevs)
+{/* as ya_strptime_multi_n_r() but %Z looks for the zone abbreviation in abbrevs (if not NULL) before the built in table */
+ return strp_multi_parse(s,s==NULL?NULL:s+len,m,tm,tz,which,abbrevs);
+}
+
+/* Streaming input
+   ===============
+   strp_stream_feed() matches a precompiled format against input given in any number of fragments (eg a timestamp that is split between two buffers read from a file),
+   without the caller having to join them. It returns STRP_STREAM_MORE when it needs more input, STRP_STREAM_DONE when the format has been matched and STRP_STREAM_ERROR when it cannot match.
+   Each operation of the plan is done as the characters arrive: the characters of the current field (at most STRP_STREAM_FIELD) are kept and then given to strp_atoi() or strp_conv(), 
+   so the rules are exactly those of ya_strptime(). A field ends when a character that cannot be part of it arrives (which is then used for the next operation) or it reaches its maximum length.
+   The only case where a field has to give back characters is a month or weekday name, where eg "Janu" matches "Jan" if the next character is not 'a', these are then used again.
+*/
+#define STRP_STREAM_FIELD 40 /* maximum characters of a field that are kept, more is an error except for leading zeros of %s and %Y and digits of %f after the 19th (which are read but not kept) */
+
+enum strp_scan_kind {STRP_SCAN_NONE, STRP_SCAN_SPACE, STRP_SCAN_DIGITS, STRP_SCAN_LETTERS, STRP_SCAN_AMPM, STRP_SCAN_DAY, STRP_SCAN_ONE};
+enum strp_scan_result {STRP_SCAN_ACCEPT, STRP_SCAN_LAST, STRP_SCAN_STOP}; /* character is part of the field, is the last character of the field, is not part of the field */
+
+struct strp_stream
+	{
+	 const struct strp_plan *plan;
+	 struct tm *tm;
+	 struct strp_tz_struct *tz;
+	 struct strp_state st; /* as strp_plan_parse() */
+	 struct strp_state saved[STRP_MAX_NEST];
+	 int depth;
+	 size_t op; /* index in plan->ops[] of the current operation */
+	 bool in_field; /* part way through the field of the current operation */
+	 enum strp_scan_kind scan; /* what characters the field can contain */
+	 bool sign; /* field can start with + or - */
+	 bool squeeze; /* leading zeros after the 1st are not kept (%s and %Y, where they do not change the result) */
+	 bool nonzero; /* a digit other than 0 has been kept */
+	 bool overflow; /* field was too long to keep */
+	 unsigned int max; /* maximum number of characters (digits for STRP_SCAN_DIGITS) in the field */
+	 unsigned int keep; /* maximum number of digits kept */
+	 unsigned int seen; /* number of characters in the field so far */
+	 unsigned int digits; /* number of digits in the field so far */
+	 unsigned int len; /* number of characters in field[] */
+	 char field[STRP_STREAM_FIELD];
+	 size_t pos; /* number of characters matched */
+	 size_t fed; /* number of characters given to strp_stream_feed() */
+	 enum strp_stream_status status;
+	};
+
+static unsigned int strp_atoi_digits(unsigned int high)
+{/* maximum number of digits strp_atoi() reads for high */
+ unsigned int n=1;
+ for(unsigned int i=high/10;i>0;i/=10) ++n;
+ return n;
+}
+
+static void strp_stream_start_field(struct strp_stream *ss, const struct strp_op *op)
+{/* set how the field of op is read, these must agree with strp_atoi() and strp_conv() */
+ ss->in_field=true;
+ ss->sign=ss->squeeze=ss->nonzero=ss->overflow=false;
+ ss->max=STRP_STREAM_FIELD;
+ ss->keep=UINT_MAX;
+ ss->seen=ss->digits=ss->len=0;
+ ss->scan=STRP_SCAN_DIGITS;
+ if(op->code==STRP_OP_SPACE) {ss->scan=STRP_SCAN_SPACE; return;}
+ if(op->code==STRP_OP_NUM) {ss->max=strp_atoi_digits(op->high); return;}
+ switch(op->c) // STRP_OP_CONV
+ 	{
+ 	 case 'a':
+ 	 case 'A':
+ 	 case 'b':
+ 	 case 'B':
+ 	 case 'h': ss->scan=STRP_SCAN_LETTERS; ss->max=9; break; // longest name is 9 letters
+ 	 case 'C':
+ 	 case 'g':
+ 	 case 'U':
+ 	 case 'V':
+ 	 case 'W':
+ 	 case 'y': ss->max=2; break;
+ 	 case 'G': ss->max=4; break;
+ 	 case 'u':
+ 	 case 'w': ss->max=1; break;
+ 	 case 'e': ss->scan=STRP_SCAN_DAY; break;
+ 	 case 'f': ss->max=UINT_MAX; ss->keep=STRP_F_DIGITS+1; break; // 1 more digit is needed to round
+ 	 case 'p': ss->scan=STRP_SCAN_AMPM; break;
+ 	 case 'Y':
+#ifdef POSIX_2008
+ 	 		   ss->max=4; break;
+#endif
+ 	 case 's': ss->max=UINT_MAX; ss->sign=ss->squeeze=true; break;
+ 	 case 'z': ss->max=UINT_MAX; ss->sign=true; break;
+ 	 case 'Z': ss->scan=STRP_SCAN_LETTERS; ss->max=4; break;
+ 	 case '%': ss->scan=STRP_SCAN_ONE; break;
+ 	 default: ss->scan=STRP_SCAN_NONE; break; // strp_conv() fails
+ 	}
+}
+
+static void strp_stream_keep(struct strp_stream *ss, int c)
+{
+ if(ss->len<STRP_STREAM_FIELD) ss->field[ss->len++]=(char)c;
+ else ss->overflow=true;
+}
+
+static enum strp_scan_result strp_stream_scan(struct strp_stream *ss, int c)
+{/* is character c part of the current field? Keeps it in field[] if it is needed */
+ enum strp_scan_result r=STRP_SCAN_ACCEPT;
+ switch(ss->scan)
+ 	{
+ 	 case STRP_SCAN_SPACE:
+ 	 	return isspace(c) ? STRP_SCAN_ACCEPT : STRP_SCAN_STOP; // whitespace does not need to be kept
+ 	 case STRP_SCAN_DIGITS:
+ 	 	if(ss->seen==0 && ss->sign && (c=='+' || c=='-')) strp_stream_keep(ss,c);
+ 	 	else if(isdigit(c) && ss->digits<ss->max)
+ 	 		{++ss->digits;
+ 	 		 if(ss->digits==ss->max) r=STRP_SCAN_LAST;
+ 	 		 if(ss->squeeze && c=='0' && !ss->nonzero && ss->len>0 && ss->field[ss->len-1]=='0') break; // another leading zero
+ 	 		 ss->nonzero=ss->nonzero || c!='0';
+ 	 		 if(ss->digits<=ss->keep) strp_stream_keep(ss,c);
+ 	 		}
+ 	 	else return STRP_SCAN_STOP;
+ 	 	break;
+ 	 case STRP_SCAN_LETTERS:
+ 	 	if((c|0x20)<'a' || (c|0x20)>'z') return STRP_SCAN_STOP;
+ 	 	strp_stream_keep(ss,c);
+ 	 	if(ss->seen+1==ss->max) r=STRP_SCAN_LAST;
+ 	 	break;
+ 	 case STRP_SCAN_AMPM:
+ 	 	if(ss->seen==0 && strchr("aApP",c)==NULL) return STRP_SCAN_STOP;
+ 	 	strp_stream_keep(ss,c);
+ 	 	if(ss->seen==1) r=STRP_SCAN_LAST;
+ 	 	break;
+ 	 case STRP_SCAN_DAY: // %e is a space and 1 digit or 1-2 digits
+ 	 	if(ss->seen==0 && !isspace(c) && !isdigit(c)) return STRP_SCAN_STOP;
+ 	 	if(ss->seen==1 && !isdigit(c)) return STRP_SCAN_STOP;
+ 	 	strp_stream_keep(ss,c);
+ 	 	if(ss->seen==1) r=STRP_SCAN_LAST;
+ 	 	break;
+ 	 case STRP_SCAN_ONE:
+ 	 	strp_stream_keep(ss,c);
+ 	 	r=STRP_SCAN_LAST;
+ 	 	break;
+ 	 default: // STRP_SCAN_NONE
+ 	 	return STRP_SCAN_STOP;
+ 	}
+ ++ss->seen;
+ return r;
+}
+
+static bool strp_stream_end_field(struct strp_stream *ss, const struct strp_op *op, char *left, unsigned int *n_left)
+{/* the field of op is complete, match it. Characters kept but not used are copied to left[] */
+ const char *p=ss->field,*e=ss->field+ss->len;
+ bool valid;
+ *n_left=0;
+ ss->in_field=false;
+ if(op->code==STRP_OP_SPACE) return true;
+ if(ss->overflow) return false;
+ if(op->code==STRP_OP_NUM) valid=strp_atoi(&p,e,(int *)((char *)ss->tm+op->field),op->low,op->high,op->offset);
+ else valid=strp_conv(op->c,&p,e,ss->tm,&ss->st);
+ if(valid && p<e)
+ 	{// names keep all letters they might match, and numbers can keep more digits than strp_atoi() uses
+ 	 *n_left=(unsigned int)(e-p);
+ 	 memcpy(left,p,*n_left);
+ 	}
+ return valid;
+}
+
+static bool strp_stream_complete(struct strp_stream *ss)
+{/* true if all operations are done (the ends of composite specifiers need no input so are done here) */
+ while(ss->op<ss->plan->nops && ss->plan->ops[ss->op].code==STRP_OP_GROUP_END)
+ 	{strp_finish(ss->tm,&ss->st); // as strp_plan_parse()
+ 	 ss->st=ss->saved[--ss->depth];
+ 	 ++ss->op;
+ 	}
+ if(ss->op<ss->plan->nops) return false;
+ strp_finish(ss->tm,&ss->st);
+ return true;
+}
+
+static enum strp_stream_status strp_stream_char(struct strp_stream *ss, int c)
+{/* process the next character c of the input (-1 for the end of the input) */
+ for(;;)
+ 	{const struct strp_op *op;
+ 	 enum strp_scan_result r;
+ 	 char left[STRP_STREAM_FIELD];
+ 	 unsigned int n_left;
+ 	 if(!ss->in_field)
+ 	 	{if(strp_stream_complete(ss)) return STRP_STREAM_DONE; // c is not used
+ 	 	 op=ss->plan->ops+ss->op;
+ 	 	 if(c<0) return STRP_STREAM_ERROR; // end of input, but not end of format
+ 	 	 if(op->code==STRP_OP_CHAR)
+ 	 	 	{if(c!=(unsigned char)op->c) return STRP_STREAM_ERROR;
+ 	 	 	 ++ss->op;
+ 	 	 	 ++ss->pos;
+ 	 	 	 return strp_stream_complete(ss) ? STRP_STREAM_DONE : STRP_STREAM_MORE;
+ 	 	 	}
+ 	 	 if(op->code==STRP_OP_GROUP_BEGIN)
+ 	 	 	{if(ss->depth>=STRP_MAX_NEST) return STRP_STREAM_ERROR;
+ 	 	 	 ss->saved[ss->depth++]=ss->st;
+ 	 	 	 ss->st.per_C_found=ss->st.per_G_found=ss->st.weekday_found=false;
+ 	 	 	 ss->st.per_U_found=ss->st.per_V_found=ss->st.per_W_found=false;
+ 	 	 	 init_strp_tz(ss->tz);
+ 	 	 	 ++ss->op;
+ 	 	 	 continue;
+ 	 	 	}
+ 	 	 if(op->code==STRP_OP_FAIL) return STRP_STREAM_ERROR;
+ 	 	 strp_stream_start_field(ss,op);
+ 	 	}
+ 	 op=ss->plan->ops+ss->op;
+ 	 r= c<0 ? STRP_SCAN_STOP : strp_stream_scan(ss,c);
+ 	 if(r==STRP_SCAN_ACCEPT)
+ 	 	{++ss->pos;
+ 	 	 return STRP_STREAM_MORE;
+ 	 	}
+ 	 if(r==STRP_SCAN_LAST) ++ss->pos;
+ 	 if(!strp_stream_end_field(ss,op,left,&n_left)) return STRP_STREAM_ERROR;
+ 	 ++ss->op;
+ 	 ss->pos-=n_left;
+ 	 for(unsigned int i=0;i<n_left;++i)
+ 	 	{// characters after a name that were not part of it are the start of the next operation
+ 	 	 enum strp_stream_status s=strp_stream_char(ss,(unsigned char)left[i]);
+ 	 	 if(s!=STRP_STREAM_MORE) return s; // if done the rest of left[] (and c) are not used
+ 	 	}
+ 	 if(r==STRP_SCAN_LAST) return strp_stream_complete(ss) ? STRP_STREAM_DONE : STRP_STREAM_MORE; // c has been used
+ 	 // c is not part of the field, so is used by the next operation
+ 	}
+}
+
+struct strp_stream * strp_stream_create(const struct strp_plan *plan)
+{/* create the state to match plan against input in fragments, plan must not be freed before the stream. Returns NULL if plan is NULL or out of memory */
+ struct strp_stream *ss;
+ if(plan==NULL) return NULL;
+ ss=(struct strp_stream *)calloc(1,sizeof(struct strp_stream));
+ if(ss==NULL) return NULL;
+ ss->plan=plan;
+ ss->status=STRP_STREAM_ERROR; // until strp_stream_begin() is called
+ return ss;
+}
+
+void strp_stream_begin(struct strp_stream *ss, struct tm *tm, struct strp_tz_struct *tz)
+{/* start matching a new string, results are put in tm and tz as ya_strptime_plan_r() */
+ strp_stream_begin_abbrevs(ss,tm,tz,NULL);
+}
+
+void strp_stream_begin_abbrevs(struct strp_stream *ss, struct tm *tm, struct strp_tz_struct *tz, const struct strp_abbrev_table *abbrevs)
+{/* as strp_stream_begin() but %Z tries abbrevs (if not NULL, it must not be freed before the string ends) before the built in table, as ya_strptime_plan_n_abbrevs_r() */
+ if(ss==NULL) return;
+ ss->tm=tm;
+ ss->tz=tz;
+ ss->status= tm==NULL || tz==NULL ? STRP_STREAM_ERROR : STRP_STREAM_MORE;
+ if(tz!=NULL) init_strp_tz(tz);
+ ss->st.per_C_found=ss->st.per_G_found=ss->st.weekday_found=false;
+ ss->st.per_U_found=ss->st.per_V_found=ss->st.per_W_found=false;
+ ss->st.tz=tz;
+ ss->st.abbrevs=abbrevs;
+ ss->depth=0;
+ ss->op=0;
+ ss->in_field=false;
+ ss->pos=ss->fed=0;
+}
+
+enum strp_stream_status strp_stream_feed(struct strp_stream *ss, const char *buf, size_t len, size_t *used)
+{/* give the next len characters of input to ss (a null character is the end of the input). *used (if used is not NULL) is set to the number of characters of buf 
+    that are part of the match for STRP_STREAM_DONE, len for STRP_STREAM_MORE and the number of characters looked at for STRP_STREAM_ERROR */
+ size_t i=0,start;
+ if(ss==NULL)
+ 	{if(used!=NULL) *used=0;
+ 	 return STRP_STREAM_ERROR;
+ 	}
+ start=ss->fed;
+ for(;i<len && ss->status==STRP_STREAM_MORE;++i)
+ 	ss->status=strp_stream_char(ss,buf[i]==0 ? -1 : (unsigned char)buf[i]);
+ ss->fed+=i;
+ if(used!=NULL)
+ 	{if(ss->status==STRP_STREAM_DONE) *used= ss->pos>start ? ss->pos-start : 0;
+ 	 else *used= ss->status==STRP_STREAM_MORE ? len : i;
+ 	}
+ return ss->status;
+}
+
+enum strp_stream_status strp_stream_end(struct strp_stream *ss)
+{/* there is no more input */
+ if(ss==NULL) return STRP_STREAM_ERROR;
+ if(ss->status==STRP_STREAM_MORE) ss->status=strp_stream_char(ss,-1);
+ return ss->status;
+}
+
+size_t strp_stream_length(const struct strp_stream *ss)
+{/* number of characters matched, ya_strptime_plan_r() would return s+strp_stream_length() */
+ return ss==NULL ? 0 : ss->pos;
+}
+
+void strp_stream_free(struct strp_stream *ss)
+{
+ free(ss);
+}
+
+/* Direct conversion of a string to seconds since the epoch
+   =========================================================
+   ya_strptime_epoch() matches s against format exactly as ya_strptime_r() does (so %U %V %W %G etc are all used in the same way) starting from a struct tm with all fields zero
+   (ie 1900-01-01 00:00:00 for any fields not in the format), then converts this directly to seconds with ya_mktime_tm(). Unlike calling ya_mktime() after ya_strptime()
+   the struct tm is not normalised (converted back from seconds) as this is not needed to get the seconds.
+   The results are put into *e : secs is the time as written (%z is not applied, UTC is secs-60*tz_off_mins if tz_off_mins!=strp_tz_default),
+   nsecs the fraction of a second from %f as an integer number of nanoseconds (rounded, so 9 digits are exact) and tz_off_mins the offset from %z (or %Z for a known abbreviation).
+   No global variables are used so these functions are reentrant. They return the same value as ya_strptime(), if NULL is returned *e is not changed.
+*/
+static void strp_epoch_fill(time_t secs, const struct strp_tz_struct *tz, struct strp_epoch *e)
+{/* fill in *e from secs (ya_mktime_tm() of the result) and tz */
+ int32_t nsecs=0;
+ if(tz->f_secs_p10!=strp_tz_default)
+ 	{int64_t ns=(int64_t)((tz->f_asecs+500000000)/1000000000); // attoseconds to nanoseconds (rounded), exact when %f has up to 9 digits
+ 	 if(ns>=1000000000)
+ 	 	{// more than 9 digits rounded up to the next second
+ 	 	 ns-=1000000000;
+ 	 	 ++secs;
+ 	 	}
+ 	 nsecs=(int32_t)ns;
+ 	}
+ e->secs=secs;
+ e->nsecs=nsecs;
+ e->tz_off_mins=tz->tz_off_mins;
+}
+
+static char * strp_epoch_result(char *end, const struct tm *tm, const struct strp_tz_struct *tz, struct strp_epoch *e)
+{/* fill in *e from tm and tz if end is not NULL (ie if the match was successful), returns end */
+ time_t ya_mktime_tm(const struct tm *tp); /* in strftime.c */
+ if(end==NULL) return NULL;
+ strp_epoch_fill(ya_mktime_tm(tm),tz,e);
+ return end;
+}
+
+char * ya_strptime_epoch(const char *s, const char *format, struct strp_epoch *e)
+{/* match s against format as ya_strptime() and put the resulting time (as seconds since the epoch, nanoseconds and timezone offset) into e */
+ struct tm tm;
+ struct strp_tz_struct tz;
+ if(e==NULL) return NULL;
+ memset(&tm,0,sizeof(tm));
+ return strp_epoch_result(ya_strptime_r(s,format,&tm,&tz),&tm,&tz,e);
+}
+
+char * ya_strptime_plan_epoch(const char *s, const struct strp_plan *plan, struct strp_epoch *e)
+{/* identical to ya_strptime_epoch(s,format,e) where plan=strp_compile(format) */
+ struct tm tm;
+ struct strp_tz_struct tz;
+ if(e==NULL) return NULL;
+ memset(&tm,0,sizeof(tm));
+ return strp_epoch_result(ya_strptime_plan_r(s,plan,&tm,&tz),&tm,&tz,e);
+}
+
+/* Cached parsing of similar strings
+   ==================================
+   Consecutive timestamps in a log usually only differ in their last few characters (eg the seconds and fraction), yet ya_strptime_epoch() converts every field 
+   of every line. A struct strp_cache remembers the start of the previous input (up to STRP_CACHE_LEN characters) and the state (struct tm, strp_state and strp_tz) 
+   before each operation of the plan when that input was matched, together with the furthest input character each operation looked at.
+   ya_strptime_cached() finds the 1st character where the new input differs from the previous one, then restarts from the latest operation for which all the 
+   characters looked at by the operations before it are unchanged, so only the fields that changed (and those after them) are matched again. If the date is the
+   same as for the previous input the number of days is not recalculated either. Operations that can read past the characters they match (names) are allowed for,
+   so the results are always identical to ya_strptime_plan_epoch(), including when the date or the layout changes or the input does not match.
+   A struct strp_cache is changed by every call, so each thread needs its own.
+*/
+#define STRP_CACHE_LEN 64 /* maximum number of characters of the previous input kept */
+
+struct strp_cache_point /* state before an operation of the plan when the previous input was matched */
+	{
+	 size_t pos; /* position in the input of the operation */
+	 size_t reach; /* the operations before this one only looked at input characters before reach */
+	 struct tm tm;
+	 struct strp_state st; /* st.tz and st.abbrevs are not used (the cache has its own) */
+	 struct strp_tz_struct tz;
+	 struct strp_state saved[STRP_MAX_NEST]; /* as strp_plan_parse() */
+	 int depth;
+	};
+
+struct strp_cache
+	{
+	 struct strp_plan *plan;
+	 size_t *width; /* maximum number of characters each operation can match (from strp_op_filter()) */
+	 struct strp_cache_point *points; /* state before each operation (plan->nops+1 entries, the last is before strp_finish()) */
+	 size_t npoints; /* points[0..npoints-1] are valid for the previous input */
+	 char prev[STRP_CACHE_LEN]; /* start of the previous input, including its end (as 0) if that is within STRP_CACHE_LEN characters */
+	 size_t nprev; /* number of characters in prev[] */
+	 const struct strp_abbrev_table *abbrevs; /* zone abbreviations for %Z tried before the built in ones, NULL if none (see strp_cache_set_abbrevs()) */
+	 struct tm day; /* date of day_secs */
+	 time_t day_secs; /* ya_mktime_tm() of day at 00:00:00 */
+	 bool day_valid;
+	};
+
+struct strp_cache * strp_cache_create(const char *format)
+{/* create a cache for matching strings against format, returns NULL if out of memory */
+ struct strp_cache *c=(struct strp_cache *)calloc(1,sizeof(struct strp_cache));
+ if(c==NULL) return NULL;
+ c->plan=strp_compile(format);
+ if(c->plan!=NULL)
+ 	{c->width=(size_t *)malloc((c->plan->nops+1)*sizeof(size_t));
+ 	 c->points=(struct strp_cache_point *)calloc(c->plan->nops+1,sizeof(struct strp_cache_point));
+ 	}
+ if(c->plan==NULL || c->width==NULL || c->points==NULL)
+ 	{strp_cache_free(c);
+ 	 return NULL;
+ 	}
+ for(size_t i=0;i<c->plan->nops;++i)
+ 	{size_t lo;
+ 	 unsigned char first[32]={0};
+ 	 strp_op_filter(c->plan->ops+i,&lo,c->width+i,first);
+ 	}
+ init_strp_tz(&c->points[0].tz); // the state at the start of every match, tm is all zero (as ya_strptime_epoch())
+ c->npoints=1;
+ return c;
+}
+
+static void strp_cache_save(struct strp_cache_point *pt, size_t pos, size_t reach, const struct tm *tm, const struct strp_state *st, const struct strp_tz_struct *tz, const struct strp_state *saved, int depth)
+{
+ pt->pos=pos;
+ pt->reach=reach;
+ pt->tm=*tm;
+ pt->st=*st;
+ pt->tz=*tz;
+ pt->depth=depth;
+ for(int i=0;i<depth;++i) pt->saved[i]=saved[i];
+}
+
+static void strp_cache_epoch(struct strp_cache *c, const struct tm *tm, const struct strp_tz_struct *tz, struct strp_epoch *e)
+{/* strp_epoch_result() using the number of days for the previous input if the date is the same */
+ if(!c->day_valid || tm->tm_year!=c->day.tm_year || tm->tm_mon!=c->day.tm_mon || tm->tm_mday!=c->day.tm_mday || tm->tm_yday!=c->day.tm_yday)
+ 	{// ya_mktime_tm() is linear in the hours, minutes and seconds so only the number of days needs to be cached
+ 	 time_t ya_mktime_tm(const struct tm *tp); /* in strftime.c */
+ 	 c->day=*tm;
+ 	 c->day.tm_hour=c->day.tm_min=c->day.tm_sec=0;
+ 	 c->day_secs=ya_mktime_tm(&c->day);
+ 	 c->day_valid=true;
+ 	}
+ strp_epoch_fill((c->day_secs+tm->tm_hour*(time_t)3600)+tm->tm_min*(time_t)60+tm->tm_sec,tz,e);
+}
+
+static size_t strp_cache_diff(const struct strp_cache *c, const char *s, const char *e)
+{/* position of the 1st character of s (which ends at e or a null character) that is different from the previous input, or STRP_WIDTH_MAX if s is the same up to the end of both */
+ size_t d=0,n=c->nprev;
+ if(e!=NULL)
+ 	{if((size_t)(e-s)<n) n=(size_t)(e-s);
+ 	 for(;d+8<=n;d+=8)
+ 	 	{// 8 characters at a time, all within the input
+ 	 	 uint64_t a,b;
+ 	 	 memcpy(&a,s+d,8);
+ 	 	 memcpy(&b,c->prev+d,8);
+ 	 	 if(a!=b) break;
+ 	 	}
+ 	}
+ for(;d<n && s[d]==c->prev[d];++d); // prev[] only contains a null character at its end, so this stops at (or before) the end of null terminated input
+ if(d==c->nprev) return c->nprev>0 && c->prev[d-1]==0 ? STRP_WIDTH_MAX : d; // same end of input, so all the characters that can be looked at are the same
+ if(e!=NULL && s+d==e && c->prev[d]==0) return STRP_WIDTH_MAX; // end of bounded input where the previous input ended
+ return d;
+}
+
+static char * strp_cache_parse(const char *s, const char *e, struct strp_cache *c, struct strp_epoch *ep)
+{/* ya_strptime_cached() for input s that ends at e (or at a null character), e is NULL for null terminated input */
+ const struct strp_cache_point *pt;
+ struct tm tm;
+ struct strp_tz_struct tz;
+ struct strp_state st,saved[STRP_MAX_NEST];
+ const char *p;
+ size_t d,k,i,reach,nops;
+ int depth;
+ bool valid=true;
+ if(s==NULL || c==NULL || ep==NULL) return NULL;
+ nops=c->plan->nops;
+ if(c->plan->iso)
+ 	{// the fast path for ISO 8601 timestamps is quicker than restarting part way through the plan, so for these only the number of days is cached
+ 	 const char *r;
+ 	 memset(&tm,0,sizeof(tm));
+ 	 init_strp_tz(&tz);
+ 	 r=strp_iso(s,e,c->plan->iso,&tm,&tz);
+ 	 if(r!=NULL)
+ 	 	{c->npoints=1; // the points are not updated
+ 	 	 c->nprev=0;
+ 	 	 strp_cache_epoch(c,&tm,&tz,ep);
+ 	 	 return (char *)r;
+ 	 	}
+ 	}
+ d=strp_cache_diff(c,s,e);
+ for(k=c->npoints-1;k>0 && c->points[k].reach>d;--k); // latest operation that does not depend on the changed characters (points[0] depends on none)
+ pt=c->points+k;
+ tm=pt->tm;
+ tz=pt->tz;
+ st=pt->st;
+ st.tz=&tz;
+ st.abbrevs=c->abbrevs;
+ depth=pt->depth;
+ for(int j=0;j<depth;++j) saved[j]=pt->saved[j];
+ reach=pt->reach;
+ p=s+pt->pos;
+ for(i=k;i<nops;++i)
+ 	{// as strp_plan_parse(), but the state before each operation is saved
+ 	 const struct strp_op *op=c->plan->ops+i;
+ 	 size_t start=(size_t)(p-s);
+ 	 if(i>k) strp_cache_save(c->points+i,start,reach,&tm,&st,&tz,saved,depth);
+ 	 if(op->code==STRP_OP_GROUP_END)
+ 		{strp_finish(&tm,&st);
+ 		 st=saved[--depth];
+ 		 continue;
+ 		}
+ 	 if(strp_ch(p,e)==0)
+ 	 	{valid=false;
+ 	 	 break;
+ 	 	}
+ 	 switch(op->code)
+ 	 	{
+ 	 	 case STRP_OP_CHAR:
+ 	 	 	if(*p!=op->c) valid=false;
+ 	 	 	else ++p;
+ 	 	 	break;
+ 	 	 case STRP_OP_SPACE:
+ 	 	 	while (isspace((int)strp_ch(p,e)))
+                ++ p;
+ 	 	 	break;
+ 	 	 case STRP_OP_NUM:
+ 	 	 	valid=strp_atoi(&p,e,(int *)((char *)&tm+op->field),op->low,op->high,op->offset);
+ 	 	 	break;
+ 	 	 case STRP_OP_CONV:
+ 	 	 	valid=strp_conv(op->c,&p,e,&tm,&st);
+ 	 	 	break;
+ 	 	 case STRP_OP_GROUP_BEGIN: 
+ 	 	 	if(depth>=STRP_MAX_NEST) valid=false;
+ 	 	 	else
+ 	 	 		{saved[depth++]=st;
+ 	 	 		 st.per_C_found=st.per_G_found=st.weekday_found=false;
+ 	 	 		 st.per_U_found=st.per_V_found=st.per_W_found=false;
+ 	 	 		 init_strp_tz(&tz);
+ 	 	 		}
+ 	 	 	break;
+ 	 	 default: // STRP_OP_FAIL
+ 	 	 	valid=false;
+ 	 	 	break;
+ 	 	}
+ 	 if(!valid) break;
+ 	 // characters looked at: the one at start (checked for the end of the input above), the one after a number or spaces (which ended it) and for names up to the longest name
+ 	 if(reach<start+1) reach=start+1;
+ 	 if(op->code==STRP_OP_SPACE || op->code==STRP_OP_NUM || op->code==STRP_OP_CONV)
+ 	 	{size_t r=(size_t)(p-s)+1;
+ 	 	 if(op->code==STRP_OP_CONV && c->width[i]!=STRP_WIDTH_MAX && start+c->width[i]+1>r) r=start+c->width[i]+1;
+ 	 	 if(reach<r) reach=r;
+ 	 	}
+ 	}
+ if(valid && i>k) strp_cache_save(c->points+i,(size_t)(p-s),reach,&tm,&st,&tz,saved,depth);
+ c->npoints=i+1; // points after i are for the previous input
+ if(d<c->nprev) c->nprev=d; // prev[] now holds the start of s
+ if(d!=STRP_WIDTH_MAX)
+ 	{// keep the characters the saved points depend on
+ 	 size_t need=c->points[c->npoints-1].reach;
+ 	 while(c->nprev<need && c->nprev<STRP_CACHE_LEN)
+ 	 	{char ch=strp_ch(s+c->nprev,e);
+ 	 	 c->prev[c->nprev++]=ch;
+ 	 	 if(ch==0) break; // nothing can be looked at after the end of the input
+ 	 	}
+ 	} // points that depend on characters after prev[] are never used, as the next input is only known to be the same for the 1st c->nprev characters
+ if(!valid) return NULL;
+ strp_finish(&tm,&st);
+ strp_cache_epoch(c,&tm,&tz,ep);
+ return (char *)p;
+}
+
+char * ya_strptime_cached(const char *s, struct strp_cache *c, struct strp_epoch *e)
+{/* identical to ya_strptime_plan_epoch(s,plan,e) where plan=strp_compile(format), format being that given to strp_cache_create() */
+ return strp_cache_parse(s,NULL,c,e);
+}
+
+char * ya_strptime_cached_n(const char *s, size_t len, struct strp_cache *c, struct strp_epoch *e)
+{/* as ya_strptime_cached() for input of len characters (which does not need to be null terminated) */
+ return strp_cache_parse(s,s==NULL?NULL:s+len,c,e);
+}
+
+void strp_cache_set_abbrevs(struct strp_cache *c, const struct strp_abbrev_table *t)
+{/* %Z tries the abbreviations in t (t==NULL for only the built in ones) before the built in table for every string c matches, t must not be freed before c.
+    This only changes c (never its plan), which belongs to one thread. The saved state is discarded as %Z may now give a different offset */
+ if(c==NULL) return;
+ c->abbrevs=t;
+ c->npoints=1;
+ c->nprev=0;
+}
+
+void strp_cache_free(struct strp_cache *c)
+{
+ if(c==NULL) return;
+ strp_free_plan(c->plan);
+ free(c->width);
+ free(c->points);
+ free(c);
+}
+
+/* Format inference
+   ================
+   strp_infer_format() proposes a format for a sample of strings (eg timestamps from a new log file). Each string is split into tokens (runs of digits, runs of letters,
+   runs of whitespace and single other characters) and the token sequence shared by most of the 1st STRP_INFER_SAMPLES strings is used. Each token is then assigned a 
+   conversion specifier using its context (eg numbers separated by ':' are a time) and the range of values seen in the samples (eg 4 digits is a year, a number over 12 
+   in a date is the day). Everything else is a literal. The rules are fixed so the same samples always give the same format.
+   strp_auto_create() etc use this to parse lines with an unknown format, once the format inferred has matched confirm lines in a row it is compiled with strp_compile().
+*/
+#define STRP_INFER_TOKS 48 /* maximum number of tokens in a string */
+#define STRP_INFER_SAMPLES 64 /* maximum number of samples used to find the token sequence and value ranges */
+#define STRP_AUTO_SAMPLES 16 /* number of recent lines kept by struct strp_auto to infer a format from */
+#define STRP_AUTO_SAMPLE_LEN 64 /* maximum length of a line kept by struct strp_auto */
+
+enum strp_tok_kind {STRP_TOK_NUM, STRP_TOK_WORD, STRP_TOK_SPACE, STRP_TOK_CHAR};
+
+struct strp_tok
+	{
+	 const char *s; /* start of token */
+	 unsigned int len; /* number of characters */
+	 enum strp_tok_kind kind;
+	 unsigned int pad; /* number of whitespace characters before a STRP_TOK_NUM that follows a STRP_TOK_CHAR (eg "- 5" from %e), this whitespace is not a token */
+	};
+
+struct strp_tok_info /* what is known about a token from all the samples with the same token sequence */
+	{
+	 unsigned int min_len,max_len;
+	 long min_val,max_val; /* STRP_TOK_NUM only */
+	 bool padded; /* STRP_TOK_NUM padded in any sample */
+	 bool pad_e; /* STRP_TOK_NUM is 1 digit after 1 space whenever it is padded (so %e can read the space) */
+	 bool month,weekday,ampm,upper,constant; /* STRP_TOK_WORD in all samples is a month name, weekday name, am/pm, 2-4 upper case letters, the same word */
+	 const char *spec; /* conversion specifier assigned (NULL for a literal) */
+	};
+
+static int strp_tokenize(const char *s, struct strp_tok *t)
+{/* split s into tokens, returns number of tokens or -1 if there are too many */
+ int n=0;
+ unsigned int pad=0;
+ while(*s)
+ 	{const char *start=s;
+ 	 if(isspace((unsigned char)*s) && n>0 && t[n-1].kind==STRP_TOK_CHAR)
+ 	 	{// whitespace between a separator and a number is padding for the number (as %e)
+ 	 	 while(isspace((unsigned char)*s)) ++s;
+ 	 	 if(isdigit((unsigned char)*s))
+ 	 	 	{pad=(unsigned int)(s-start);
+ 	 	 	 continue;
+ 	 	 	}
+ 	 	 s=start;
+ 	 	}
+ 	 if(n==STRP_INFER_TOKS) return -1;
+ 	 t[n].s=s;
+ 	 t[n].pad=pad;
+ 	 pad=0;
+ 	 if(isdigit((unsigned char)*s))
+ 	 	{t[n].kind=STRP_TOK_NUM;
+ 	 	 while(isdigit((unsigned char)*s)) ++s;
+ 	 	}
+ 	 else if(isalpha((unsigned char)*s))
+ 	 	{t[n].kind=STRP_TOK_WORD;
+ 	 	 while(isalpha((unsigned char)*s)) ++s;
+ 	 	}
+ 	 else if(isspace((unsigned char)*s))
+ 	 	{t[n].kind=STRP_TOK_SPACE;
+ 	 	 while(isspace((unsigned char)*s)) ++s;
+ 	 	}
+ 	 else
+ 	 	{t[n].kind=STRP_TOK_CHAR;
+ 	 	 ++s;
+ 	 	}
+ 	 t[n].len=(unsigned int)(s-t[n].s);
+ 	 ++n;
+ 	}
+ return n;
+}
+
+static bool strp_same_shape(const struct strp_tok *a, int na, const struct strp_tok *b, int nb)
+{/* true if two token sequences have the same kinds of token and the same separators ('+' and '-' are taken as the same as they are the sign of %z) */
+ if(na!=nb) return false;
+ for(int i=0;i<na;++i)
+ 	{if(a[i].kind!=b[i].kind) return false;
+ 	 if(a[i].kind==STRP_TOK_CHAR && a[i].s[0]!=b[i].s[0] && !(strchr("+-",a[i].s[0])!=NULL && strchr("+-",b[i].s[0])!=NULL)) return false;
+ 	}
+ return true;
+}
+
+static bool strp_whole_name(const struct strp_name_table *t, const struct strp_tok *tok)
+{/* true if the word tok is exactly a name (or its 1st 3 letters) in t */
+ const char *p=tok->s;
+ return strp_name_match_e(t,&p,tok->s+tok->len)>=0 && p==tok->s+tok->len;
+}
+
+static void strp_tok_update(struct strp_tok_info *info, const struct strp_tok *tok, const struct strp_tok *first, bool init)
+{/* add what is known from tok to info, first is the same token in the 1st sample (for STRP_TOK_WORD constant) */
+ long v=0;
+ bool upper=tok->len>=2 && tok->len<=4;
+ if(tok->kind==STRP_TOK_NUM)
+ 	for(unsigned int i=0;i<tok->len;++i) v= v<100000000 ? v*10+(tok->s[i]-'0') : 999999999; // values over 9 digits are not needed
+ if(tok->kind==STRP_TOK_WORD)
+ 	for(unsigned int i=0;i<tok->len;++i) upper=upper && isupper((unsigned char)tok->s[i]);
+ if(init)
+ 	{info->min_len=info->max_len=tok->len;
+ 	 info->min_val=info->max_val=v;
+ 	 info->padded=false;
+ 	 info->pad_e=true;
+ 	 info->month=info->weekday=info->ampm=info->upper=info->constant=true;
+ 	 info->spec=NULL;
+ 	}
+ if(tok->len<info->min_len) info->min_len=tok->len;
+ if(tok->len>info->max_len) info->max_len=tok->len;
+ if(v<info->min_val) info->min_val=v;
+ if(v>info->max_val) info->max_val=v;
+ if(tok->pad>0)
+ 	{info->padded=true;
+ 	 info->pad_e=info->pad_e && tok->pad==1 && tok->len==1;
+ 	}
+ if(tok->kind==STRP_TOK_WORD)
+ 	{info->month=info->month && strp_whole_name(&strp_month_table,tok);
+ 	 info->weekday=info->weekday && strp_whole_name(&strp_weekday_table,tok);
+ 	 info->ampm=info->ampm && tok->len==2 && strchr("aApP",tok->s[0])!=NULL && (tok->s[1]|0x20)=='m';
+ 	 info->upper=info->upper && upper;
+ 	 info->constant=info->constant && tok->len==first->len && memcmp(tok->s,first->s,tok->len)==0;
+ 	}
+}
+
+static bool strp_is_num(const struct strp_tok *t, const struct strp_tok_info *info, int n, int i)
+{/* true if token i exists, is a number and has not been assigned a specifier yet */
+ return i<n && t[i].kind==STRP_TOK_NUM && info[i].spec==NULL;
+}
+
+static bool strp_is_char(const struct strp_tok *t, int n, int i, const char *chars)
+{/* true if token i exists and is one of chars */
+ return i<n && t[i].kind==STRP_TOK_CHAR && strchr(chars,t[i].s[0])!=NULL;
+}
+
+static const char *strp_day_spec(const struct strp_tok_info *a)
+{/* %e (as strftime() outputs it) or %d for a day of the month, both read the same numbers */
+ return (a->padded ? a->pad_e : a->min_len==1) ? "%e" : "%d";
+}
+
+static bool strp_assign(const struct strp_tok *t, struct strp_tok_info *info, int n)
+{/* assign conversion specifiers to the tokens of the token sequence t[], returns false if a number cannot be assigned one */
+ bool pm=false,year=false,day=false,hour=false,time=false; // am/pm present, fields already assigned
+ for(int i=0;i<n;++i)
+ 	if(t[i].kind==STRP_TOK_WORD)
+ 		{if(info[i].ampm) {info[i].spec="%p"; pm=true;}
+ 		 else if(info[i].month) info[i].spec=info[i].max_len>3 ? "%B" : "%b";
+ 		 else if(info[i].weekday) info[i].spec=info[i].max_len>3 ? "%A" : "%a";
+ 		}
+ for(int i=0;i<n;++i)
+ 	{if(info[i].spec!=NULL) continue;
+ 	 if(t[i].kind==STRP_TOK_WORD)
+ 	 	{if(info[i].upper && (!info[i].constant || time)) info[i].spec="%Z"; // zone name (a constant upper case word is only taken as a zone after a time)
+ 	 	 continue;
+ 	 	}
+ 	 if(strp_is_char(t,n,i,"+-") && strp_is_num(t,info,n,i+1) && info[i+1].min_len==4 && info[i+1].max_len==4 && t[i+1].pad==0 &&
+ 	 	(i==0 || t[i-1].kind==STRP_TOK_SPACE || time))
+ 	 	{info[i].spec="%z"; // %z reads the sign
+ 	 	 info[i+1].spec="";
+ 	 	 continue;
+ 	 	}
+ 	 if(t[i].kind!=STRP_TOK_NUM) continue;
+ 	 if(strp_is_char(t,n,i+1,":") && strp_is_num(t,info,n,i+2))
+ 	 	{// time hh:mm[:ss[.f]]
+ 	 	 info[i].spec=pm ? "%I" : "%H";
+ 	 	 info[i+2].spec="%M";
+ 	 	 i+=2;
+ 	 	 if(strp_is_char(t,n,i+1,":") && strp_is_num(t,info,n,i+2))
+ 	 	 	{info[i+2].spec="%S";
+ 	 	 	 i+=2;
+ 	 	 	 if(strp_is_char(t,n,i+1,".,") && strp_is_num(t,info,n,i+2) && t[i+2].pad==0)
+ 	 	 	 	{info[i+2].spec="%f";
+ 	 	 	 	 i+=2;
+ 	 	 	 	}
+ 	 	 	}
+ 	 	 hour=time=true;
+ 	 	 continue;
+ 	 	}
+ 	 if(strp_is_char(t,n,i+1,"-") && info[i].max_len==4 && i+3<n && t[i+2].kind==STRP_TOK_WORD && info[i+2].constant && t[i+2].len==1 && t[i+2].s[0]=='W' &&
+ 	 	strp_is_num(t,info,n,i+3))
+ 	 	{// ISO 8601 week date yyyy-Www[-d]
+ 	 	 info[i].spec="%G";
+ 	 	 info[i+3].spec="%V";
+ 	 	 if(strp_is_char(t,n,i+4,"-") && strp_is_num(t,info,n,i+5) && info[i+5].max_len==1) info[i+5].spec="%u";
+ 	 	 year=day=true;
+ 	 	 continue;
+ 	 	}
+ 	 if(strp_is_char(t,n,i+1,"-/.") && i+2<n && (strp_is_num(t,info,n,i+2) || (t[i+2].kind==STRP_TOK_WORD && info[i+2].month)) &&
+ 	 	i+4<n && t[i+3].kind==STRP_TOK_CHAR && t[i+3].s[0]==t[i+1].s[0] && strp_is_num(t,info,n,i+4))
+ 	 	{// date, the field order is found from the number of digits and range of values
+ 	 	 struct strp_tok_info *a=info+i,*b=info+i+2,*c=info+i+4;
+ 	 	 if(t[i+2].kind==STRP_TOK_WORD)
+ 	 	 	{if(a->max_len>=3) {a->spec="%Y"; c->spec="%d";}
+ 	 	 	 else {a->spec="%d"; c->spec=c->max_len>=3 ? "%Y" : "%y";}
+ 	 	 	}
+ 	 	 else if(a->max_len>=3)
+ 	 	 	{a->spec="%Y";
+ 	 	 	 if(b->max_val>12 && c->max_val<=12) {b->spec="%d"; c->spec="%m";}
+ 	 	 	 else {b->spec="%m"; c->spec="%d";}
+ 	 	 	}
+ 	 	 else
+ 	 	 	{c->spec=c->max_len>=3 ? "%Y" : "%y";
+ 	 	 	 if(a->max_val>12 || (b->max_val<=12 && t[i+1].s[0]!='/')) {a->spec="%d"; b->spec="%m";} // day 1st unless it cannot be or the separator is '/' (US order)
+ 	 	 	 else {a->spec="%m"; b->spec="%d";}
+ 	 	 	}
+ 	 	 if(a->spec[1]=='d') a->spec=strp_day_spec(a);
+ 	 	 if(b->spec[1]=='d') b->spec=strp_day_spec(b);
+ 	 	 if(c->spec[1]=='d') c->spec=strp_day_spec(c);
+ 	 	 year=day=true;
+ 	 	 i+=4;
+ 	 	 continue;
+ 	 	}
+ 	 if(strp_is_char(t,n,i+1,"-") && info[i].max_len==4 && strp_is_num(t,info,n,i+2) && !strp_is_char(t,n,i+3,"-"))
+ 	 	{// yyyy-ddd or yyyy-mm
+ 	 	 info[i].spec="%Y";
+ 	 	 info[i+2].spec=info[i+2].min_len==3 ? "%j" : "%m";
+ 	 	 year=true;
+ 	 	 day=info[i+2].min_len==3;
+ 	 	 i+=2;
+ 	 	}
+ 	}
+ for(int i=0;i<n;++i)
+ 	{// numbers on their own, eg the day and year in "Fri, 05 Mar 2021"
+ 	 struct strp_tok_info *a=info+i;
+ 	 if(!strp_is_num(t,info,n,i)) continue;
+ 	 if(a->min_len==4 && a->max_len==4 && !year) {a->spec="%Y"; year=true;}
+ 	 else if(a->max_len<=2 && a->min_val>=1 && a->max_val<=31 && !day) {a->spec=strp_day_spec(a); day=true;}
+ 	 else if(a->max_len<=2 && a->min_val>=1 && a->max_val<=12 && pm && !hour) {a->spec="%I"; hour=true;}
+ 	 else if(a->max_len==3 && a->min_val>=1 && a->max_val<=366 && year && !day) {a->spec="%j"; day=true;}
+ 	 else if(a->min_len>=9 && !year && !day)
+ 	 	{a->spec="%s"; // seconds since the epoch, possibly with a fraction
+ 	 	 year=day=true;
+ 	 	 if(strp_is_char(t,n,i+1,".,") && strp_is_num(t,info,n,i+2)) info[i+2].spec="%f";
+ 	 	}
+ 	 else return false;
+ 	}
+ return true;
+}
+
+static bool strp_full_match(const char *s, const char *format, const struct strp_plan *plan, struct tm *tm, struct strp_tz_struct *tz, char **end)
+{/* true if format (or plan if not NULL) matches all of s (except trailing whitespace), *end is set to the value returned by ya_strptime_r() */
+ char *r=plan!=NULL ? ya_strptime_plan_r(s,plan,tm,tz) : ya_strptime_r(s,format,tm,tz);
+ if(end!=NULL) *end=r;
+ if(r==NULL) return false;
+ while(isspace((unsigned char)*r)) ++r;
+ return *r==0;
+}
+
+int strp_infer_format(const char * const *samples, int n, char *format, size_t size)
+{/* propose a format for samples[0..n-1] in format (size characters including the terminating null).
+    Returns the number of samples it matches completely (except trailing whitespace), or 0 (with format set to "") if no format can be found */
+ struct strp_tok best[STRP_INFER_TOKS],t[STRP_INFER_TOKS];
+ struct strp_tok_info info[STRP_INFER_TOKS];
+ int nbest= -1,best_count=0,m=n<STRP_INFER_SAMPLES ? n : STRP_INFER_SAMPLES,matches=0;
+ size_t len=0;
+ bool specs=false;
+ struct strp_plan *plan;
+ if(format==NULL || size==0) return 0;
+ format[0]=0;
+ if(samples==NULL) return 0;
+ for(int i=0;i<m;++i)
+ 	{// find the token sequence used by most samples (the 1st one if there is a tie)
+ 	 int nt,count=0;
+ 	 if(samples[i]==NULL || (nt=strp_tokenize(samples[i],t))<=0) continue;
+ 	 for(int j=0;j<m;++j)
+ 	 	{struct strp_tok u[STRP_INFER_TOKS];
+ 	 	 int nu;
+ 	 	 if(samples[j]!=NULL && (nu=strp_tokenize(samples[j],u))>0 && strp_same_shape(t,nt,u,nu)) ++count;
+ 	 	}
+ 	 if(count>best_count)
+ 	 	{best_count=count;
+ 	 	 nbest=nt;
+ 	 	 memcpy(best,t,sizeof(best));
+ 	 	}
+ 	}
+ if(nbest<=0) return 0;
+ for(int i=0,first=1;i<m;++i)
+ 	{// values of each token in all samples with this token sequence
+ 	 int nt;
+ 	 if(samples[i]==NULL || (nt=strp_tokenize(samples[i],t))!=nbest || !strp_same_shape(best,nbest,t,nt)) continue;
+ 	 for(int j=0;j<nt;++j) strp_tok_update(info+j,t+j,best+j,first);
+ 	 first=0;
+ 	}
+ if(!strp_assign(best,info,nbest)) return 0;
+ for(int i=0;i<nbest && !specs;++i) specs=info[i].spec!=NULL;
+ if(!specs) return 0; // all literals, so not a date or time
+ for(int i=0;i<nbest;++i)
+ 	{// create the format
+ 	 const char *p=info[i].spec;
+ 	 size_t l;
+ 	 char lit[3];
+ 	 if(p==NULL)
+ 	 	{if(best[i].kind==STRP_TOK_SPACE) p=" "; // matches any amount of whitespace
+ 	 	 else if(best[i].kind==STRP_TOK_CHAR)
+ 	 	 	{lit[0]=best[i].s[0];
+ 	 	 	 lit[1]= lit[0]=='%' ? '%' : 0;
+ 	 	 	 lit[2]=0;
+ 	 	 	 p=lit;
+ 	 	 	}
+ 	 	}
+ 	 if(p==NULL) // a word that is a literal
+ 	 	{p=best[i].s;
+ 	 	 l=best[i].len;
+ 	 	}
+ 	 else l=strlen(p);
+ 	 if(info[i].padded && !(info[i].pad_e && info[i].spec!=NULL && strcmp(info[i].spec,"%e")==0)) // padding (whitespace not in a token) needs a space in the format, unless %e reads it
+ 	 	{if(len+1>=size) {format[0]=0; return 0;}
+ 	 	 format[len++]=' ';
+ 	 	}
+ 	 if(len+l>=size) {format[0]=0; return 0;} // format does not fit
+ 	 memcpy(format+len,p,l);
+ 	 len+=l;
+ 	}
+ format[len]=0;
+ plan=strp_compile(format);
+ if(plan==NULL) {format[0]=0; return 0;}
+ for(int i=0;i<n;++i)
+ 	{struct tm tm;
+ 	 struct strp_tz_struct tz;
+ 	 memset(&tm,0,sizeof(tm));
+ 	 if(samples[i]!=NULL && strp_full_match(samples[i],NULL,plan,&tm,&tz,NULL)) ++matches;
+ 	}
+ strp_free_plan(plan);
+ if(matches==0) format[0]=0;
+ return matches;
+}
+
+struct strp_auto
+	{
+	 int confirm; /* number of lines in a row that must match format before it is compiled */
+	 int matched; /* number of lines in a row that have matched format */
+	 char format[STRP_INFER_FORMAT_SIZE]; /* format inferred ("" if none yet) */
+	 struct strp_plan *plan; /* format compiled once confirmed (NULL until then) */
+	 int nsamples,next; /* number of lines in samples[], and where the next one goes */
+	 char samples[STRP_AUTO_SAMPLES][STRP_AUTO_SAMPLE_LEN]; /* recent lines that format did not match, used to infer a new format */
+	};
+
+struct strp_auto * strp_auto_create(int confirm)
+{/* create a parser for lines with an unknown format, which is inferred from the lines and compiled once it has matched confirm lines in a row. Returns NULL if out of memory */
+ struct strp_auto *a=(struct strp_auto *)calloc(1,sizeof(struct strp_auto));
+ if(a!=NULL) a->confirm= confirm>0 ? confirm : 1;
+ return a;
+}
+
+char * ya_strptime_auto_r(const char *s, struct strp_auto *a, struct tm *tm, struct strp_tz_struct *tz)
+{/* parse s with the format inferred so far (inferring a new one if it does not match all of s), returns as ya_strptime_r() but NULL unless all of s (except trailing whitespace) matches */
+ char *end;
+ if(tz==NULL) return NULL;
+ if(a==NULL || s==NULL || tm==NULL)
+ 	{init_strp_tz(tz);
+ 	 return NULL;
+ 	}
+ if(a->plan!=NULL) return strp_full_match(s,NULL,a->plan,tm,tz,&end) ? end : NULL; // confirmed, use the compiled format
+ if(a->format[0]!=0)
+ 	{struct tm tm_in= *tm;
+ 	 if(strp_full_match(s,a->format,NULL,tm,tz,&end))
+ 	 	{if(++a->matched>=a->confirm) a->plan=strp_compile(a->format);
+ 	 	 return end;
+ 	 	}
+ 	 *tm=tm_in;
+ 	}
+ if(strlen(s)<STRP_AUTO_SAMPLE_LEN)
+ 	{// infer a new format from this line and the recent lines that did not match
+ 	 const char *samples[STRP_AUTO_SAMPLES];
+ 	 char format[STRP_INFER_FORMAT_SIZE];
+ 	 strcpy(a->samples[a->next],s);
+ 	 a->next=(a->next+1)%STRP_AUTO_SAMPLES;
+ 	 if(a->nsamples<STRP_AUTO_SAMPLES) ++a->nsamples;
+ 	 for(int i=0;i<a->nsamples;++i) samples[i]=a->samples[(a->next+STRP_AUTO_SAMPLES-1-i)%STRP_AUTO_SAMPLES]; // newest 1st so it wins a tie
+ 	 if(strp_infer_format(samples,a->nsamples,format,sizeof(format))>0) strcpy(a->format,format); // otherwise keep the previous format
+ 	}
+ a->matched=0;
+ if(a->format[0]==0)
+ 	{init_strp_tz(tz);
+ 	 return NULL;
+ 	}
+ if(!strp_full_match(s,a->format,NULL,tm,tz,&end)) return NULL; // eg a line too long to infer a format from that only starts with a match
+ if(++a->matched>=a->confirm) a->plan=strp_compile(a->format);
+ return end;
+}
+
+const char * strp_auto_format(const struct strp_auto *a)
+{/* the format inferred so far, NULL if none */
+ return a==NULL || a->format[0]==0 ? NULL : a->format;
+}
+
+bool strp_auto_confirmed(const struct strp_auto *a)
+{/* true once the format has been confirmed and compiled */
+ return a!=NULL && a->plan!=NULL;
+}
+
+void strp_auto_free(struct strp_auto *a)
+{
+ if(a==NULL) return;
+ strp_free_plan(a->plan);
+ free(a);
+}
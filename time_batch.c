@@ -0,0 +1,452 @@
+/*  time_batch.c
+	============
+   Batch versions of the conversions in strftime.c, these convert whole arrays at once and give identical results to calling the single value function for each element.
+
+   sec_to_tm_batch() converts an array of time_t (secs since 1970) into a "structure of arrays" (struct tm_soa) - one array for each field of struct tm.
+   This layout lets whole columns of values be converted with vector instructions, and is normally what's wanted when processing large data sets (eg a column of a database).
+
+   On x86 processors compiled with gcc (or clang) AVX2 and AVX-512 kernels are included, these use "target" attributes so no special compiler flags are needed,
+   and the best kernel the processor supports is chosen at runtime. With other compilers (eg Builder C++) only the scalar version (which calls sec_to_tm()) is available.
+
+   The vector kernels use the same "days from civil" method as sec_to_tm() (see strftime.c) but do the arithmetic with doubles, as AVX2 has no 64 bit integer divide or multiply.
+   All values are integers < 2^51 so they are exact in a double, floor(a/b) is calculated as floor(a*(1/b)) with 1/b rounded up slightly which is exact for 0 <= a < 2^49
+   (the largest value (days since 1st March of year -3,355,443,200) is < 2^41). The first division (secs to days) is larger so its result is checked and corrected if necessary.
+   Blocks of values that include a t outside of the range of valid years (or year 0 when YEAR0LEAP is not defined in strftime.c) are converted by sec_to_tm() so the results are always identical.
+
+   ya_mktime_tm_batch() does the reverse, converting a struct tm_soa into an array of time_t, with identical results to ya_mktime_tm() for every value (including sec=60 and hour=24).
+   Any int value is allowed in any field, the vector kernels calculate the day number as a double (its always < 2^51 so is exact) then convert this to 64 bit integers
+   to multiply by 86400 and add the seconds in the day.
+
+   sec_to_tm_zone_batch() converts UTC times to local times in a time zone loaded from a TZif file. The offset for each value comes from a struct tz_cursor which keeps the interval
+   between transitions the previous value was in, so for times in ascending order (eg an event stream) each value just needs 2 compares (and moving to the next interval when a
+   transition is passed). Values that are not in order still give the correct result, the cursor is then moved using the zone's index. The local times are then converted
+   by sec_to_tm_batch() in blocks of ZONE_BLOCK values. The cursor is kept between calls, so a stream can be converted a block at a time.
+*/
+
+/*----------------------------------------------------------------------------
+ * Copyright (c) 2022 Peter Miller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHOR OR COPYRIGHT HOLDER BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include "time_local.h"
+
+time_t ya_mktime_tm(const struct tm *tp); /* in strftime.c */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__BORLANDC__)
+ #define BATCH_X86 /* include the AVX2 and AVX-512 kernels */
+ #include <immintrin.h>
+#endif
+
+#define BATCH_ERAS INT64_C(8388608) /* same as CIVIL_ERAS in strftime.c, 2^23 eras (of 400 years, 146097 days) added to t so all values are +ve */
+#define BATCH_OFFSET ((BATCH_ERAS*146097+719468)*86400) /* offset added to t (as secs) so days are counted from 1st March 0000 (+ BATCH_ERAS eras) */
+#define BATCH_T_MIN (-BATCH_OFFSET) /* the vector kernels are only used when all values in a block are in the range BATCH_T_MIN..BATCH_T_MAX */
+#define BATCH_T_MAX ((INT64_C(1)<<58)-1-BATCH_OFFSET) /* (t+BATCH_OFFSET)/128 must be < 2^51 */
+#define BATCH_YEAR0 INT64_C(-62167132800) /* 1st Jan 0000 (when year 0 is not a leap year) */
+#define BATCH_YEAR1 INT64_C(-62135596800) /* 1st Jan 0001 */
+#define RECIP(b) ((1.0/(b))*(1.0+1.0/1125899906842624.0)) /* 1/b rounded up by 2^-50 so floor(a*RECIP(b)) == floor(a/b) for 0<=a<2^49 */
+
+static void soa_offset(struct tm_soa *d,const struct tm_soa *s,size_t i) /* d=s with all (non NULL) arrays starting at element i */
+{d->year=s->year ? s->year+i : NULL;
+ d->mon=s->mon ? s->mon+i : NULL;
+ d->mday=s->mday ? s->mday+i : NULL;
+ d->hour=s->hour ? s->hour+i : NULL;
+ d->min=s->min ? s->min+i : NULL;
+ d->sec=s->sec ? s->sec+i : NULL;
+ d->wday=s->wday ? s->wday+i : NULL;
+ d->yday=s->yday ? s->yday+i : NULL;
+}
+
+static void sec_to_tm_scalar(const time_t *t, size_t n, const struct tm_soa *out) /* uses sec_to_tm() for each value */
+{struct tm tm;
+ for(size_t i=0;i<n;++i)
+ 	{sec_to_tm(t[i],&tm);
+ 	 if(out->year) out->year[i]=tm.tm_year;
+ 	 if(out->mon) out->mon[i]=tm.tm_mon;
+ 	 if(out->mday) out->mday[i]=tm.tm_mday;
+ 	 if(out->hour) out->hour[i]=tm.tm_hour;
+ 	 if(out->min) out->min[i]=tm.tm_min;
+ 	 if(out->sec) out->sec[i]=tm.tm_sec;
+ 	 if(out->wday) out->wday[i]=tm.tm_wday;
+ 	 if(out->yday) out->yday[i]=tm.tm_yday;
+ 	}
+}
+
+static void mktime_scalar(const struct tm_soa *in, size_t n, time_t *t) /* uses ya_mktime_tm() for each value */
+{struct tm tm={0};
+ for(size_t i=0;i<n;++i)
+ 	{tm.tm_year=in->year ? in->year[i] : 0;
+ 	 tm.tm_mon=in->mon ? in->mon[i] : 0;
+ 	 tm.tm_mday=in->mday ? in->mday[i] : 0;
+ 	 tm.tm_hour=in->hour ? in->hour[i] : 0;
+ 	 tm.tm_min=in->min ? in->min[i] : 0;
+ 	 tm.tm_sec=in->sec ? in->sec[i] : 0;
+ 	 tm.tm_yday=in->yday ? in->yday[i] : 0;
+ 	 t[i]=ya_mktime_tm(&tm);
+ 	}
+}
+
+#ifdef BATCH_X86
+/* AVX2 kernel - 4 values at a time */
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256d floordiv_avx2(__m256d a, double recip) /* floor(a/b) where recip=RECIP(b) and 0<=a<2^49 */
+{return _mm256_floor_pd(_mm256_mul_pd(a,_mm256_set1_pd(recip)));
+}
+
+static inline AVX2 __m256d i64_to_pd_avx2(__m256i v) /* convert 0<=v<2^52 to double, by putting v into the mantissa of 2^52 */
+{const __m256d two52=_mm256_set1_pd(4503599627370496.0);
+ return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(v,_mm256_castpd_si256(two52))),two52);
+}
+
+static inline AVX2 void store_avx2(int *p, __m256d v) /* store 4 doubles as ints */
+{if(p!=NULL) _mm_storeu_si128((__m128i *)p,_mm256_cvttpd_epi32(v));
+}
+
+static AVX2 void sec_to_tm_avx2(const time_t *t, size_t n, const struct tm_soa *out, bool year0leap)
+{const __m256i t_lo=_mm256_set1_epi64x(BATCH_T_MIN-1), t_hi=_mm256_set1_epi64x(BATCH_T_MAX+1);
+ const __m256i y0=_mm256_set1_epi64x(BATCH_YEAR0-1), y1=_mm256_set1_epi64x(BATCH_YEAR1);
+ const __m256d one=_mm256_set1_pd(1.0);
+ struct tm_soa o;
+ size_t i;
+ for(i=0;i+4<=n;i+=4)
+ 	{__m256i vt=_mm256_loadu_si256((const __m256i *)(t+i));
+ 	 __m256i ok=_mm256_and_si256(_mm256_cmpgt_epi64(vt,t_lo),_mm256_cmpgt_epi64(t_hi,vt)); // all -1 if in range
+ 	 __m256i shift=_mm256_setzero_si256();
+ 	 if(!year0leap)
+ 	 	{shift=_mm256_cmpgt_epi64(y1,vt); // before year 1 so 1 day later than the Gregorian calendar
+ 	 	 ok=_mm256_andnot_si256(_mm256_and_si256(shift,_mm256_cmpgt_epi64(vt,y0)),ok); // year 0 needs special treatment so use sec_to_tm()
+ 	 	 vt=_mm256_sub_epi64(vt,_mm256_and_si256(shift,_mm256_set1_epi64x(86400)));
+ 	 	}
+ 	 if(_mm256_movemask_pd(_mm256_castsi256_pd(ok))!=0xf)
+ 	 	{soa_offset(&o,out,i);
+ 	 	 sec_to_tm_scalar(t+i,4,&o);
+ 	 	 continue;
+ 	 	}
+ 	 __m256i u=_mm256_add_epi64(vt,_mm256_set1_epi64x(BATCH_OFFSET)); // 0 <= u < 2^58
+ 	 __m256d x=i64_to_pd_avx2(_mm256_srli_epi64(u,7)); // u/128 (86400=128*675)
+ 	 __m256d lo=i64_to_pd_avx2(_mm256_and_si256(u,_mm256_set1_epi64x(127)));
+ 	 __m256d days=_mm256_floor_pd(_mm256_mul_pd(x,_mm256_set1_pd(RECIP(675)))); // x>=2^49 so may be 1 too large
+ 	 __m256d r=_mm256_sub_pd(x,_mm256_mul_pd(days,_mm256_set1_pd(675))); // exact
+ 	 __m256d neg=_mm256_cmp_pd(r,_mm256_setzero_pd(),_CMP_LT_OQ);
+ 	 days=_mm256_sub_pd(days,_mm256_and_pd(neg,one));
+ 	 r=_mm256_add_pd(r,_mm256_and_pd(neg,_mm256_set1_pd(675)));
+ 	 __m256d secs=_mm256_add_pd(_mm256_mul_pd(r,_mm256_set1_pd(128)),lo); // 0..86399
+ 	 __m256d era=floordiv_avx2(days,RECIP(146097));
+ 	 __m256d doe=_mm256_sub_pd(days,_mm256_mul_pd(era,_mm256_set1_pd(146097))); // 0..146096
+ 	 __m256d yoe=floordiv_avx2(_mm256_add_pd(_mm256_sub_pd(doe,floordiv_avx2(doe,RECIP(1460))),
+ 	 								_mm256_sub_pd(floordiv_avx2(doe,RECIP(36524)),floordiv_avx2(doe,RECIP(146096)))),RECIP(365)); // 0..399
+ 	 __m256d y4=_mm256_floor_pd(_mm256_mul_pd(yoe,_mm256_set1_pd(0.25))), y100=floordiv_avx2(yoe,RECIP(100));
+ 	 __m256d doy=_mm256_sub_pd(doe,_mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(yoe,_mm256_set1_pd(365)),y4),y100)); // 0..365 from 1st March
+ 	 __m256d mp=floordiv_avx2(_mm256_add_pd(_mm256_mul_pd(doy,_mm256_set1_pd(5)),_mm256_set1_pd(2)),RECIP(153)); // 0..11 from March
+ 	 __m256d jf=_mm256_cmp_pd(mp,_mm256_set1_pd(10),_CMP_GE_OQ); // Jan or Feb
+ 	 __m256d mday=_mm256_add_pd(_mm256_sub_pd(doy,floordiv_avx2(_mm256_add_pd(_mm256_mul_pd(mp,_mm256_set1_pd(153)),_mm256_set1_pd(2)),RECIP(5))),one);
+ 	 __m256d mon=_mm256_sub_pd(_mm256_add_pd(mp,_mm256_set1_pd(2)),_mm256_and_pd(jf,_mm256_set1_pd(12)));
+ 	 __m256d leap=_mm256_and_pd(_mm256_cmp_pd(_mm256_mul_pd(y4,_mm256_set1_pd(4)),yoe,_CMP_EQ_OQ),
+ 	 							_mm256_or_pd(_mm256_cmp_pd(_mm256_mul_pd(y100,_mm256_set1_pd(100)),yoe,_CMP_NEQ_OQ),_mm256_cmp_pd(yoe,_mm256_setzero_pd(),_CMP_EQ_OQ)));
+ 	 __m256d yday=_mm256_blendv_pd(_mm256_add_pd(_mm256_add_pd(doy,_mm256_set1_pd(59)),_mm256_and_pd(leap,one)),_mm256_sub_pd(doy,_mm256_set1_pd(306)),jf);
+ 	 __m256d year=_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(era,_mm256_set1_pd((double)BATCH_ERAS)),_mm256_set1_pd(400)),yoe),_mm256_and_pd(jf,one));
+ 	 year=_mm256_min_pd(_mm256_max_pd(year,_mm256_set1_pd(-(double)INT_MAX+1900)),_mm256_set1_pd((double)INT_MAX+1900)); // clip as sec_to_tm()
+ 	 __m256d hour=floordiv_avx2(secs,RECIP(3600)), mins=floordiv_avx2(secs,RECIP(60));
+ 	 __m256d w=_mm256_add_pd(_mm256_add_pd(doe,_mm256_set1_pd(3)),_mm256_and_pd(_mm256_castsi256_pd(shift),one)); // 1st March 0000 was a Wednesday
+ 	 store_avx2(out->year ? out->year+i : NULL,_mm256_sub_pd(year,_mm256_set1_pd(1900)));
+ 	 store_avx2(out->mon ? out->mon+i : NULL,mon);
+ 	 store_avx2(out->mday ? out->mday+i : NULL,mday);
+ 	 store_avx2(out->hour ? out->hour+i : NULL,hour);
+ 	 store_avx2(out->min ? out->min+i : NULL,_mm256_sub_pd(mins,_mm256_mul_pd(hour,_mm256_set1_pd(60))));
+ 	 store_avx2(out->sec ? out->sec+i : NULL,_mm256_sub_pd(secs,_mm256_mul_pd(mins,_mm256_set1_pd(60))));
+ 	 store_avx2(out->wday ? out->wday+i : NULL,_mm256_sub_pd(w,_mm256_mul_pd(floordiv_avx2(w,RECIP(7)),_mm256_set1_pd(7))));
+ 	 store_avx2(out->yday ? out->yday+i : NULL,yday);
+ 	}
+ soa_offset(&o,out,i);
+ sec_to_tm_scalar(t+i,n-i,&o); // any that are left
+}
+
+/* AVX-512 kernel - 8 values at a time, identical to the AVX2 kernel apart from the use of mask registers */
+#define AVX512 __attribute__((target("avx512f")))
+
+static inline AVX512 __m512d floordiv_avx512(__m512d a, double recip) /* floor(a/b) where recip=RECIP(b) and 0<=a<2^49 */
+{return _mm512_roundscale_pd(_mm512_mul_pd(a,_mm512_set1_pd(recip)),_MM_FROUND_TO_NEG_INF|_MM_FROUND_NO_EXC);
+}
+
+static inline AVX512 __m512d i64_to_pd_avx512(__m512i v) /* convert 0<=v<2^52 to double, by putting v into the mantissa of 2^52 */
+{const __m512d two52=_mm512_set1_pd(4503599627370496.0);
+ return _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(v,_mm512_castpd_si512(two52))),two52);
+}
+
+static inline AVX512 void store_avx512(int *p, __m512d v) /* store 8 doubles as ints */
+{if(p!=NULL) _mm256_storeu_si256((__m256i *)p,_mm512_cvttpd_epi32(v));
+}
+
+static AVX512 void sec_to_tm_avx512(const time_t *t, size_t n, const struct tm_soa *out, bool year0leap)
+{const __m512i t_lo=_mm512_set1_epi64(BATCH_T_MIN-1), t_hi=_mm512_set1_epi64(BATCH_T_MAX+1);
+ const __m512i y0=_mm512_set1_epi64(BATCH_YEAR0-1), y1=_mm512_set1_epi64(BATCH_YEAR1);
+ const __m512d one=_mm512_set1_pd(1.0), zero=_mm512_setzero_pd();
+ struct tm_soa o;
+ size_t i;
+ for(i=0;i+8<=n;i+=8)
+ 	{__m512i vt=_mm512_loadu_si512((const void *)(t+i));
+ 	 __mmask8 ok=_mm512_cmpgt_epi64_mask(vt,t_lo) & _mm512_cmpgt_epi64_mask(t_hi,vt); // 1 bits if in range
+ 	 __mmask8 shift=0;
+ 	 if(!year0leap)
+ 	 	{shift=_mm512_cmpgt_epi64_mask(y1,vt); // before year 1 so 1 day later than the Gregorian calendar
+ 	 	 ok&=~(shift & _mm512_cmpgt_epi64_mask(vt,y0)); // year 0 needs special treatment so use sec_to_tm()
+ 	 	 vt=_mm512_mask_sub_epi64(vt,shift,vt,_mm512_set1_epi64(86400));
+ 	 	}
+ 	 if(ok!=0xff)
+ 	 	{soa_offset(&o,out,i);
+ 	 	 sec_to_tm_scalar(t+i,8,&o);
+ 	 	 continue;
+ 	 	}
+ 	 __m512i u=_mm512_add_epi64(vt,_mm512_set1_epi64(BATCH_OFFSET)); // 0 <= u < 2^58
+ 	 __m512d x=i64_to_pd_avx512(_mm512_srli_epi64(u,7)); // u/128 (86400=128*675)
+ 	 __m512d lo=i64_to_pd_avx512(_mm512_and_si512(u,_mm512_set1_epi64(127)));
+ 	 __m512d days=floordiv_avx512(x,RECIP(675)); // x>=2^49 so may be 1 too large
+ 	 __m512d r=_mm512_sub_pd(x,_mm512_mul_pd(days,_mm512_set1_pd(675))); // exact
+ 	 __mmask8 neg=_mm512_cmp_pd_mask(r,zero,_CMP_LT_OQ);
+ 	 days=_mm512_mask_sub_pd(days,neg,days,one);
+ 	 r=_mm512_mask_add_pd(r,neg,r,_mm512_set1_pd(675));
+ 	 __m512d secs=_mm512_add_pd(_mm512_mul_pd(r,_mm512_set1_pd(128)),lo); // 0..86399
+ 	 __m512d era=floordiv_avx512(days,RECIP(146097));
+ 	 __m512d doe=_mm512_sub_pd(days,_mm512_mul_pd(era,_mm512_set1_pd(146097))); // 0..146096
+ 	 __m512d yoe=floordiv_avx512(_mm512_add_pd(_mm512_sub_pd(doe,floordiv_avx512(doe,RECIP(1460))),
+ 	 								_mm512_sub_pd(floordiv_avx512(doe,RECIP(36524)),floordiv_avx512(doe,RECIP(146096)))),RECIP(365)); // 0..399
+ 	 __m512d y4=floordiv_avx512(yoe,0.25), y100=floordiv_avx512(yoe,RECIP(100));
+ 	 __m512d doy=_mm512_sub_pd(doe,_mm512_sub_pd(_mm512_add_pd(_mm512_mul_pd(yoe,_mm512_set1_pd(365)),y4),y100)); // 0..365 from 1st March
+ 	 __m512d mp=floordiv_avx512(_mm512_add_pd(_mm512_mul_pd(doy,_mm512_set1_pd(5)),_mm512_set1_pd(2)),RECIP(153)); // 0..11 from March
+ 	 __mmask8 jf=_mm512_cmp_pd_mask(mp,_mm512_set1_pd(10),_CMP_GE_OQ); // Jan or Feb
+ 	 __m512d mday=_mm512_add_pd(_mm512_sub_pd(doy,floordiv_avx512(_mm512_add_pd(_mm512_mul_pd(mp,_mm512_set1_pd(153)),_mm512_set1_pd(2)),RECIP(5))),one);
+ 	 __m512d mon=_mm512_mask_sub_pd(_mm512_add_pd(mp,_mm512_set1_pd(2)),jf,_mm512_add_pd(mp,_mm512_set1_pd(2)),_mm512_set1_pd(12));
+ 	 __mmask8 leap=_mm512_cmp_pd_mask(_mm512_mul_pd(y4,_mm512_set1_pd(4)),yoe,_CMP_EQ_OQ) &
+ 	 				(_mm512_cmp_pd_mask(_mm512_mul_pd(y100,_mm512_set1_pd(100)),yoe,_CMP_NEQ_OQ) | _mm512_cmp_pd_mask(yoe,zero,_CMP_EQ_OQ));
+ 	 __m512d yday=_mm512_mask_blend_pd(jf,_mm512_mask_add_pd(_mm512_add_pd(doy,_mm512_set1_pd(59)),leap,_mm512_add_pd(doy,_mm512_set1_pd(59)),one),_mm512_sub_pd(doy,_mm512_set1_pd(306)));
+ 	 __m512d year=_mm512_mask_add_pd(_mm512_add_pd(_mm512_mul_pd(_mm512_sub_pd(era,_mm512_set1_pd((double)BATCH_ERAS)),_mm512_set1_pd(400)),yoe),jf,
+ 	 								_mm512_add_pd(_mm512_mul_pd(_mm512_sub_pd(era,_mm512_set1_pd((double)BATCH_ERAS)),_mm512_set1_pd(400)),yoe),one);
+ 	 year=_mm512_min_pd(_mm512_max_pd(year,_mm512_set1_pd(-(double)INT_MAX+1900)),_mm512_set1_pd((double)INT_MAX+1900)); // clip as sec_to_tm()
+ 	 __m512d hour=floordiv_avx512(secs,RECIP(3600)), mins=floordiv_avx512(secs,RECIP(60));
+ 	 __m512d w=_mm512_mask_add_pd(_mm512_add_pd(doe,_mm512_set1_pd(3)),shift,_mm512_add_pd(doe,_mm512_set1_pd(3)),one); // 1st March 0000 was a Wednesday
+ 	 store_avx512(out->year ? out->year+i : NULL,_mm512_sub_pd(year,_mm512_set1_pd(1900)));
+ 	 store_avx512(out->mon ? out->mon+i : NULL,mon);
+ 	 store_avx512(out->mday ? out->mday+i : NULL,mday);
+ 	 store_avx512(out->hour ? out->hour+i : NULL,hour);
+ 	 store_avx512(out->min ? out->min+i : NULL,_mm512_sub_pd(mins,_mm512_mul_pd(hour,_mm512_set1_pd(60))));
+ 	 store_avx512(out->sec ? out->sec+i : NULL,_mm512_sub_pd(secs,_mm512_mul_pd(mins,_mm512_set1_pd(60))));
+ 	 store_avx512(out->wday ? out->wday+i : NULL,_mm512_sub_pd(w,_mm512_mul_pd(floordiv_avx512(w,RECIP(7)),_mm512_set1_pd(7))));
+ 	 store_avx512(out->yday ? out->yday+i : NULL,yday);
+ 	}
+ soa_offset(&o,out,i);
+ sec_to_tm_scalar(t+i,n-i,&o); // any that are left
+}
+
+static inline AVX2 __m128i load_avx2(const int *p, size_t i) /* 4 ints from p+i or 0's if p is NULL */
+{return p!=NULL ? _mm_loadu_si128((const __m128i *)(p+i)) : _mm_setzero_si128();
+}
+
+static inline AVX2 __m256i pd_to_i64_avx2(__m256d v) /* convert integer valued -2^51<v<2^51 to int64 using the mantissa of 1.5*2^52 */
+{const __m256d magic=_mm256_set1_pd(6755399441055744.0);
+ return _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(v,magic)),_mm256_castpd_si256(magic));
+}
+
+static AVX2 void mktime_avx2(const struct tm_soa *in, size_t n, time_t *t, bool year0leap)
+{const __m256d one=_mm256_set1_pd(1.0), zero=_mm256_setzero_pd(), eras400=_mm256_set1_pd((double)(BATCH_ERAS*400));
+ struct tm_soa o;
+ size_t i;
+ for(i=0;i+4<=n;i+=4)
+ 	{__m256d year=_mm256_add_pd(_mm256_cvtepi32_pd(load_avx2(in->year,i)),_mm256_set1_pd(1900)); // year with no offset
+ 	 /* days to 1st Jan of year, as year_to_days() in strftime.c */
+ 	 __m256d y=_mm256_add_pd(year,_mm256_sub_pd(eras400,one)); // year-1 as years start on 1st March, +ve
+ 	 __m256d era=floordiv_avx2(y,RECIP(400));
+ 	 __m256d yoe=_mm256_sub_pd(y,_mm256_mul_pd(era,_mm256_set1_pd(400))); // 0..399
+ 	 __m256d days=_mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(era,_mm256_set1_pd((double)BATCH_ERAS)),_mm256_set1_pd(146097)),
+ 	 							_mm256_add_pd(_mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(yoe,_mm256_set1_pd(365)),floordiv_avx2(yoe,0.25)),floordiv_avx2(yoe,RECIP(100))),
+ 	 										  _mm256_set1_pd(306-719468)));
+ 	 /* leap year ? */
+ 	 __m256d z=_mm256_add_pd(year,eras400); // +ve with the same remainders as year
+ 	 __m256d leap=_mm256_and_pd(_mm256_cmp_pd(_mm256_mul_pd(floordiv_avx2(z,0.25),_mm256_set1_pd(4)),z,_CMP_EQ_OQ),
+ 	 							_mm256_or_pd(_mm256_cmp_pd(_mm256_mul_pd(floordiv_avx2(z,RECIP(100)),_mm256_set1_pd(100)),z,_CMP_NEQ_OQ),
+ 	 										 _mm256_cmp_pd(_mm256_mul_pd(floordiv_avx2(z,RECIP(400)),_mm256_set1_pd(400)),z,_CMP_EQ_OQ)));
+ 	 if(!year0leap)
+ 	 	{__m256d le0=_mm256_cmp_pd(year,zero,_CMP_LE_OQ);
+ 	 	 days=_mm256_add_pd(days,_mm256_and_pd(le0,one)); // years <=0 are 1 day later
+ 	 	 leap=_mm256_andnot_pd(_mm256_cmp_pd(year,zero,_CMP_EQ_OQ),leap); // year 0 is not a leap year
+ 	 	}
+ 	 /* day of year from month and day of month (as day_of_year()) */
+ 	 __m256d mon=_mm256_min_pd(_mm256_max_pd(_mm256_cvtepi32_pd(load_avx2(in->mon,i)),zero),_mm256_set1_pd(11));
+ 	 __m256d jf=_mm256_cmp_pd(mon,_mm256_set1_pd(2),_CMP_LT_OQ); // Jan or Feb
+ 	 __m256d mp=_mm256_add_pd(mon,_mm256_blendv_pd(_mm256_set1_pd(-2),_mm256_set1_pd(10),jf)); // month starting at March 0..11
+ 	 __m256d cm=floordiv_avx2(_mm256_add_pd(_mm256_mul_pd(mp,_mm256_set1_pd(153)),_mm256_set1_pd(2)),RECIP(5)); // days from 1st March to start of month
+ 	 __m256d cum=_mm256_blendv_pd(_mm256_add_pd(_mm256_add_pd(cm,_mm256_set1_pd(59)),_mm256_and_pd(leap,one)),_mm256_sub_pd(cm,_mm256_set1_pd(306)),jf);
+ 	 __m128i mday=load_avx2(in->mday,i), yday=load_avx2(in->yday,i);
+ 	 __m128i ydc=_mm_add_epi32(_mm256_cvttpd_epi32(cum),_mm_sub_epi32(mday,_mm_set1_epi32(1))); // int arithmetic (as day_of_year())
+ 	 __m128i use=_mm_andnot_si128(_mm_cmpgt_epi32(yday,_mm_setzero_si128()),_mm_cmpgt_epi32(mday,_mm_setzero_si128())); // mday>0 && yday<=0
+ 	 days=_mm256_add_pd(days,_mm256_cvtepi32_pd(_mm_blendv_epi8(yday,ydc,use)));
+ 	 /* secs = days*86400 + hour*3600 + min*60 + sec, days*675 < 2^51 so is exact then *128 as int64 */
+ 	 __m256i s=_mm256_slli_epi64(pd_to_i64_avx2(_mm256_mul_pd(days,_mm256_set1_pd(675))),7);
+ 	 __m256d hms=_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(load_avx2(in->hour,i)),_mm256_set1_pd(3600)),
+ 	 										 _mm256_mul_pd(_mm256_cvtepi32_pd(load_avx2(in->min,i)),_mm256_set1_pd(60))),
+ 	 						   _mm256_cvtepi32_pd(load_avx2(in->sec,i)));
+ 	 _mm256_storeu_si256((__m256i *)(t+i),_mm256_add_epi64(s,pd_to_i64_avx2(hms)));
+ 	}
+ soa_offset(&o,in,i);
+ mktime_scalar(&o,n-i,t+i); // any that are left
+}
+
+static inline AVX512 __m256i load_avx512(const int *p, size_t i) /* 8 ints from p+i or 0's if p is NULL */
+{return p!=NULL ? _mm256_loadu_si256((const __m256i *)(p+i)) : _mm256_setzero_si256();
+}
+
+static inline AVX512 __m512i pd_to_i64_avx512(__m512d v) /* convert integer valued -2^51<v<2^51 to int64 using the mantissa of 1.5*2^52 */
+{const __m512d magic=_mm512_set1_pd(6755399441055744.0);
+ return _mm512_sub_epi64(_mm512_castpd_si512(_mm512_add_pd(v,magic)),_mm512_castpd_si512(magic));
+}
+
+static AVX512 void mktime_avx512(const struct tm_soa *in, size_t n, time_t *t, bool year0leap)
+{const __m512d one=_mm512_set1_pd(1.0), zero=_mm512_setzero_pd(), eras400=_mm512_set1_pd((double)(BATCH_ERAS*400));
+ struct tm_soa o;
+ size_t i;
+ for(i=0;i+8<=n;i+=8)
+ 	{__m512d year=_mm512_add_pd(_mm512_cvtepi32_pd(load_avx512(in->year,i)),_mm512_set1_pd(1900)); // year with no offset
+ 	 /* days to 1st Jan of year, as year_to_days() in strftime.c */
+ 	 __m512d y=_mm512_add_pd(year,_mm512_sub_pd(eras400,one)); // year-1 as years start on 1st March, +ve
+ 	 __m512d era=floordiv_avx512(y,RECIP(400));
+ 	 __m512d yoe=_mm512_sub_pd(y,_mm512_mul_pd(era,_mm512_set1_pd(400))); // 0..399
+ 	 __m512d days=_mm512_add_pd(_mm512_mul_pd(_mm512_sub_pd(era,_mm512_set1_pd((double)BATCH_ERAS)),_mm512_set1_pd(146097)),
+ 	 							_mm512_add_pd(_mm512_sub_pd(_mm512_add_pd(_mm512_mul_pd(yoe,_mm512_set1_pd(365)),floordiv_avx512(yoe,0.25)),floordiv_avx512(yoe,RECIP(100))),
+ 	 										  _mm512_set1_pd(306-719468)));
+ 	 /* leap year ? */
+ 	 __m512d z=_mm512_add_pd(year,eras400); // +ve with the same remainders as year
+ 	 __mmask8 leap=_mm512_cmp_pd_mask(_mm512_mul_pd(floordiv_avx512(z,0.25),_mm512_set1_pd(4)),z,_CMP_EQ_OQ) &
+ 	 				(_mm512_cmp_pd_mask(_mm512_mul_pd(floordiv_avx512(z,RECIP(100)),_mm512_set1_pd(100)),z,_CMP_NEQ_OQ) |
+ 	 				 _mm512_cmp_pd_mask(_mm512_mul_pd(floordiv_avx512(z,RECIP(400)),_mm512_set1_pd(400)),z,_CMP_EQ_OQ));
+ 	 if(!year0leap)
+ 	 	{days=_mm512_mask_add_pd(days,_mm512_cmp_pd_mask(year,zero,_CMP_LE_OQ),days,one); // years <=0 are 1 day later
+ 	 	 leap&=~_mm512_cmp_pd_mask(year,zero,_CMP_EQ_OQ); // year 0 is not a leap year
+ 	 	}
+ 	 /* day of year from month and day of month (as day_of_year()) */
+ 	 __m512d mon=_mm512_min_pd(_mm512_max_pd(_mm512_cvtepi32_pd(load_avx512(in->mon,i)),zero),_mm512_set1_pd(11));
+ 	 __mmask8 jf=_mm512_cmp_pd_mask(mon,_mm512_set1_pd(2),_CMP_LT_OQ); // Jan or Feb
+ 	 __m512d mp=_mm512_add_pd(mon,_mm512_mask_blend_pd(jf,_mm512_set1_pd(-2),_mm512_set1_pd(10))); // month starting at March 0..11
+ 	 __m512d cm=floordiv_avx512(_mm512_add_pd(_mm512_mul_pd(mp,_mm512_set1_pd(153)),_mm512_set1_pd(2)),RECIP(5)); // days from 1st March to start of month
+ 	 __m512d cum=_mm512_mask_blend_pd(jf,_mm512_mask_add_pd(_mm512_add_pd(cm,_mm512_set1_pd(59)),leap,_mm512_add_pd(cm,_mm512_set1_pd(59)),one),_mm512_sub_pd(cm,_mm512_set1_pd(306)));
+ 	 __m256i mday=load_avx512(in->mday,i), yday=load_avx512(in->yday,i);
+ 	 __m256i ydc=_mm256_add_epi32(_mm512_cvttpd_epi32(cum),_mm256_sub_epi32(mday,_mm256_set1_epi32(1))); // int arithmetic (as day_of_year())
+ 	 __m256i use=_mm256_andnot_si256(_mm256_cmpgt_epi32(yday,_mm256_setzero_si256()),_mm256_cmpgt_epi32(mday,_mm256_setzero_si256())); // mday>0 && yday<=0
+ 	 days=_mm512_add_pd(days,_mm512_cvtepi32_pd(_mm256_blendv_epi8(yday,ydc,use)));
+ 	 /* secs = days*86400 + hour*3600 + min*60 + sec, days*675 < 2^51 so is exact then *128 as int64 */
+ 	 __m512i s=_mm512_slli_epi64(pd_to_i64_avx512(_mm512_mul_pd(days,_mm512_set1_pd(675))),7);
+ 	 __m512d hms=_mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(_mm512_cvtepi32_pd(load_avx512(in->hour,i)),_mm512_set1_pd(3600)),
+ 	 										 _mm512_mul_pd(_mm512_cvtepi32_pd(load_avx512(in->min,i)),_mm512_set1_pd(60))),
+ 	 						   _mm512_cvtepi32_pd(load_avx512(in->sec,i)));
+ 	 _mm512_storeu_si512((void *)(t+i),_mm512_add_epi64(s,pd_to_i64_avx512(hms)));
+ 	}
+ soa_offset(&o,in,i);
+ mktime_scalar(&o,n-i,t+i); // any that are left
+}
+#endif /* BATCH_X86 */
+
+#define ZONE_BLOCK 256 /* number of local times sec_to_tm_zone_batch() converts at once */
+
+void sec_to_tm_zone_batch(const time_t *t, size_t n, struct tz_cursor *c, const struct tm_soa *out, int *off, int *isdst)
+{/* convert n values of t to local time in zone c->zone (in out, off and isdst), gives identical results to UTC_sec_to_tm_zone() for each value. c is left at the interval of t[n-1] */
+ time_t local[ZONE_BLOCK];
+ struct tm_soa o;
+ if(t==NULL || c==NULL || out==NULL) return;
+ for(size_t i=0;i<n;i+=ZONE_BLOCK)
+ 	{size_t m= n-i<ZONE_BLOCK ? n-i : ZONE_BLOCK;
+ 	 for(size_t j=0;j<m;++j)
+ 	 	{time_t u=t[i+j];
+ 	 	 if(u<c->start || u>=c->end) tz_cursor_offset(c,u); // a different interval
+ 	 	 local[j]=u+c->off;
+ 	 	 if(off!=NULL) off[i+j]=c->off;
+ 	 	 if(isdst!=NULL) isdst[i+j]=c->isdst;
+ 	 	}
+ 	 soa_offset(&o,out,i);
+ 	 sec_to_tm_batch(local,m,&o);
+ 	}
+}
+
+enum batch_kernel batch_kernel_supported(enum batch_kernel k) /* returns k if the processor supports it, otherwise the best kernel below k thats supported */
+{
+#ifdef BATCH_X86
+ if(k>=BATCH_AVX512 && __builtin_cpu_supports("avx512f")) return BATCH_AVX512;
+ if(k>=BATCH_AVX2 && __builtin_cpu_supports("avx2")) return BATCH_AVX2;
+#else
+ (void)k;
+#endif
+ return BATCH_SCALAR;
+}
+
+enum batch_kernel sec_to_tm_batch_k(const time_t *t, size_t n, const struct tm_soa *out, enum batch_kernel k)
+{/* convert n values of t into out using kernel k (if supported, otherwise the best below it), returns the kernel used */
+ if(t==NULL || out==NULL) return BATCH_SCALAR;
+ k=batch_kernel_supported(k);
+ switch(k)
+ 	{
+#ifdef BATCH_X86
+ 	 case BATCH_AVX512:
+ 		sec_to_tm_avx512(t,n,out,is_leap(0));
+ 		break;
+ 	 case BATCH_AVX2:
+ 		sec_to_tm_avx2(t,n,out,is_leap(0));
+ 		break;
+#endif
+ 	 default:
+ 		sec_to_tm_scalar(t,n,out);
+ 		break;
+ 	}
+ return k;
+}
+
+void sec_to_tm_batch(const time_t *t, size_t n, const struct tm_soa *out)
+{/* convert n values of t into out using the fastest kernel the processor supports, gives identical results to calling sec_to_tm() for each value */
+ sec_to_tm_batch_k(t,n,out,BATCH_BEST);
+}
+
+enum batch_kernel ya_mktime_tm_batch_k(const struct tm_soa *in, size_t n, time_t *t, enum batch_kernel k)
+{/* convert n values from in into t using kernel k (if supported, otherwise the best below it), returns the kernel used */
+ if(t==NULL || in==NULL) return BATCH_SCALAR;
+ k=batch_kernel_supported(k);
+ switch(k)
+ 	{
+#ifdef BATCH_X86
+ 	 case BATCH_AVX512:
+ 		mktime_avx512(in,n,t,is_leap(0));
+ 		break;
+ 	 case BATCH_AVX2:
+ 		mktime_avx2(in,n,t,is_leap(0));
+ 		break;
+#endif
+ 	 default:
+ 		mktime_scalar(in,n,t);
+ 		break;
+ 	}
+ return k;
+}
+
+void ya_mktime_tm_batch(const struct tm_soa *in, size_t n, time_t *t)
+{/* convert n values from in into secs since 1970 in t using the fastest kernel the processor supports, gives identical results to calling ya_mktime_tm() for each value */
+ ya_mktime_tm_batch_k(in,n,t,BATCH_BEST);
+}
@@ -5,6 +5,9 @@
 */
 #ifndef __TIME_LOCAL_H
  #define __TIME_LOCAL_H
+ #if defined(__cplusplus) && __cplusplus>=201703L
+  #include <string_view> /* for the std::string_view overloads at the end, included here before time_t is redefined below */
+ #endif
  #ifdef __cplusplus
   extern "C" {
  #endif
@@ -20,6 +23,17 @@
 	
 	char * ya_strptime(const char *s, const char *format, struct tm *tm);// in strptime.c 
 	size_t ya_strftime(char *s, size_t maxsize, const char *format, const struct tm *timeptr); // in strftime.c
+	/* precompiled formats for strptime - compile format once with strp_compile() then use ya_strptime_plan() as often as required. Gives identical results to ya_strptime() */
+	struct strp_plan; /* opaque, defined in strptime.c */
+	struct strp_plan * strp_compile(const char *format); /* returns NULL if out of memory */
+	char * ya_strptime_plan(const char *s, const struct strp_plan *plan, struct tm *tm); // in strptime.c
+	void strp_free_plan(struct strp_plan *plan); /* free memory used by plan */
+	/* precompiled formats for strftime - compile format once with strf_compile() then use ya_strftime_plan() as often as required. Gives identical results to ya_strftime() */
+	struct strf_plan; /* opaque, defined in strftime.c */
+	struct strf_plan * strf_compile(const char *format); /* returns NULL if out of memory */
+	size_t ya_strftime_plan(char *s, size_t maxsize, const struct strf_plan *plan, const struct tm *timeptr); // in strftime.c
+	size_t strf_plan_max_width(const struct strf_plan *plan); /* maximum number of characters ya_strftime_plan() can output (excluding the terminating null) */
+	void strf_free_plan(struct strf_plan *plan); /* free memory used by plan */
 	
 	struct strp_tz_struct
 		{
@@ -34,15 +48,107 @@
 		 int year_G; /* week based year as a decimal number (no offset) (iso 8601) [ strp_tz_default for unknown] */
 		 double f_secs;/* fractional seconds [ portion after decimal point ] from %f , default 0 */
 		 int f_secs_p10;/* number of digits in f_secs (after decimal point), Used to allow %f to be round loop exact. default strp_tz_default */
+		 uint64_t f_asecs;/* fractional seconds from %f as an integer number of attoseconds (10^-18 secs), default 0. strftime() only uses this if it matches f_secs */
+		 // the OS time zone used by strftime() for %z and %Z when tz_off_mins or tz_name are not set, read once (with tzset()) the 1st time its needed after initialisation
+		 int os_off_mins; /* OS offset from UTC in minutes (for standard time) [ strp_tz_default if not read yet ] */
+		 char os_name[2][4]; /* OS names for standard and summer time (at most 4 letters, zero filled) */
+		 const char *zone_abbrev; /* full abbreviation (eg "+0545") set by UTC_sec_to_tm_zone() and UTC_mktime_zone(), used by %Z as tz_name only holds 4 characters [ NULL if not set ] */
 		};
+	 #define STRP_F_DIGITS 18 /* maximum number of digits used by %f (the number of digits in f_asecs) */
 	 #define strp_tz_default (-INT_MAX) /* default value for all apart from tz_name & initialised*/	
 
 	extern struct strp_tz_struct strp_tz;// strp_tz is a global thats sets by strptime() and used by strftime()
 	void init_strp_tz(struct strp_tz_struct *d); /* initialise a strp_tz_struct (mainly to strp_tz_default)  */	
+	/* reentrant versions - these use *tz (which must not be NULL) in place of the global strp_tz so they can be used by multiple threads at once. UTC_mktime() and UTC_sec_to_tm() below already take tz so are reentrant */
+	char * ya_strptime_r(const char *s, const char *format, struct tm *tm, struct strp_tz_struct *tz); // in strptime.c 
+	size_t ya_strftime_r(char *s, size_t maxsize, const char *format, const struct tm *timeptr, struct strp_tz_struct *tz); // in strftime.c
+	char * ya_strptime_plan_r(const char *s, const struct strp_plan *plan, struct tm *tm, struct strp_tz_struct *tz); // in strptime.c
+	size_t ya_strftime_plan_r(char *s, size_t maxsize, const struct strf_plan *plan, const struct tm *timeptr, struct strp_tz_struct *tz); // in strftime.c
+	/* length bounded input - s does not need to be null terminated and s[len] onwards is never read, returns as ya_strptime() (so return value - s is the number of characters used) */
+	char * ya_strptime_n(const char *s, size_t len, const char *format, struct tm *tm); // in strptime.c
+	char * ya_strptime_n_r(const char *s, size_t len, const char *format, struct tm *tm, struct strp_tz_struct *tz); // in strptime.c
+	char * ya_strptime_plan_n_r(const char *s, size_t len, const struct strp_plan *plan, struct tm *tm, struct strp_tz_struct *tz); // in strptime.c
+	/* as above but %Z looks up zone abbreviations in abbrevs (NULL for none) before the built in table (see strp_abbrev_table_init() below), the table is only used for this call */
+	struct strp_abbrev_table;
+	char * ya_strptime_n_abbrevs_r(const char *s, size_t len, const char *format, struct tm *tm, struct strp_tz_struct *tz, const struct strp_abbrev_table *abbrevs); // in strptime.c
+	char * ya_strptime_plan_n_abbrevs_r(const char *s, size_t len, const struct strp_plan *plan, struct tm *tm, struct strp_tz_struct *tz, const struct strp_abbrev_table *abbrevs); // in strptime.c
+	/* multiple formats - compile a list of formats once with strp_multi_compile(), ya_strptime_multi() then tries each in turn (skipping any that cannot match using cheap prefilters).
+	   If adaptive is true the formats are reordered so the one that matches most often is tried 1st, this changes m so each thread needs its own struct strp_multi */
+	struct strp_multi; /* opaque, defined in strptime.c */
+	struct strp_multi * strp_multi_compile(const char * const *formats, int n, bool adaptive); /* returns NULL if out of memory */
+	char * ya_strptime_multi(const char *s, struct strp_multi *m, struct tm *tm, int *which); /* returns as ya_strptime() for the format that matched, its index is put in *which (-1 if none) */
+	char * ya_strptime_multi_r(const char *s, struct strp_multi *m, struct tm *tm, struct strp_tz_struct *tz, int *which); /* reentrant version (but m is still changed if adaptive) */
+	char * ya_strptime_multi_n_r(const char *s, size_t len, struct strp_multi *m, struct tm *tm, struct strp_tz_struct *tz, int *which); /* length bounded version */
+	char * ya_strptime_multi_n_abbrevs_r(const char *s, size_t len, struct strp_multi *m, struct tm *tm, struct strp_tz_struct *tz, int *which, const struct strp_abbrev_table *abbrevs); /* %Z tries abbrevs 1st */
+	int strp_multi_order(const struct strp_multi *m, int *order); /* copies indices of formats in the order they are tried into order[], returns number of formats */
+	void strp_multi_free(struct strp_multi *m); /* free memory used by m */
+	/* streaming input - match a precompiled format against input given in fragments (eg split between 2 buffers) without joining them */
+	enum strp_stream_status {STRP_STREAM_MORE, STRP_STREAM_DONE, STRP_STREAM_ERROR}; /* need more input, format matched, format cannot match */
+	struct strp_stream; /* opaque, defined in strptime.c */
+	struct strp_stream * strp_stream_create(const struct strp_plan *plan); /* returns NULL if out of memory, plan must not be freed before the stream */
+	void strp_stream_begin(struct strp_stream *ss, struct tm *tm, struct strp_tz_struct *tz); /* start matching a new string, results go into tm and tz as ya_strptime_plan_r() */
+	void strp_stream_begin_abbrevs(struct strp_stream *ss, struct tm *tm, struct strp_tz_struct *tz, const struct strp_abbrev_table *abbrevs); /* as strp_stream_begin(), %Z tries abbrevs 1st */
+	enum strp_stream_status strp_stream_feed(struct strp_stream *ss, const char *buf, size_t len, size_t *used); /* next len characters of input, *used is set to the number used */
+	enum strp_stream_status strp_stream_end(struct strp_stream *ss); /* no more input */
+	size_t strp_stream_length(const struct strp_stream *ss); /* number of characters matched */
+	void strp_stream_free(struct strp_stream *ss); /* free memory used by ss */
+	/* format inference - propose a format for a sample of strings, and parse lines with an unknown format (switching to a compiled format once the inferred one is confirmed) */
+	#define STRP_INFER_FORMAT_SIZE 128 /* size of buffer needed for an inferred format */
+	int strp_infer_format(const char * const *samples, int n, char *format, size_t size); /* returns number of samples the format put in format matches completely, 0 if none */
+	struct strp_auto; /* opaque, defined in strptime.c */
+	struct strp_auto * strp_auto_create(int confirm); /* format is compiled once it matches confirm lines in a row, returns NULL if out of memory */
+	char * ya_strptime_auto_r(const char *s, struct strp_auto *a, struct tm *tm, struct strp_tz_struct *tz); /* as ya_strptime_r() using the format inferred so far, NULL unless all of s (except trailing whitespace) matches */
+	const char * strp_auto_format(const struct strp_auto *a); /* format inferred so far, NULL if none */
+	bool strp_auto_confirmed(const struct strp_auto *a); /* true once the format has been confirmed (and compiled) */
+	void strp_auto_free(struct strp_auto *a); /* free memory used by a */
+	/* direct conversion of a string to seconds since the epoch, uses the same rules as ya_strptime() but the result is in seconds (as ya_mktime_tm()), nanoseconds (from %f) and the %z offset */
+	struct strp_epoch
+		{time_t secs; /* seconds since 1970-01-01 00:00:00 for the time as written (%z is not applied) */
+		 int32_t nsecs; /* nanoseconds 0->999999999 from %f (0 if %f not present) */
+		 int tz_off_mins; /* time zone offset from UTC in minutes from %z (or from %Z for a known abbreviation) [ strp_tz_default for unknown ] */
+		};
+	char * ya_strptime_epoch(const char *s, const char *format, struct strp_epoch *e); /* returns as ya_strptime(), fields not in format default to 1900-01-01 00:00:00. Reentrant */
+	char * ya_strptime_plan_epoch(const char *s, const struct strp_plan *plan, struct strp_epoch *e); /* as ya_strptime_epoch() using a precompiled format */
+	/* cached conversion of similar strings to seconds since the epoch, only the fields that differ from the previous string are matched again (results as ya_strptime_epoch()) */
+	struct strp_cache; /* opaque, defined in strptime.c */
+	struct strp_cache * strp_cache_create(const char *format); /* returns NULL if out of memory */
+	char * ya_strptime_cached(const char *s, struct strp_cache *c, struct strp_epoch *e); /* as ya_strptime_epoch() with the format given to strp_cache_create(), c is changed so each thread needs its own */
+	char * ya_strptime_cached_n(const char *s, size_t len, struct strp_cache *c, struct strp_epoch *e); /* as ya_strptime_cached() for input of len characters (not null terminated) */
+	void strp_cache_free(struct strp_cache *c); /* free memory used by c */
+	/* direct formatting of UTC seconds since the epoch (plus nanoseconds for %f) in the time zone tz_off_mins east of UTC (strp_tz_default for none), only the fields of struct tm the format uses are calculated. Reentrant */
+	size_t ya_strftime_epoch(char *s, size_t maxsize, const char *format, time_t secs, int32_t nsecs, int tz_off_mins); /* identical to ya_strftime_r() with sec_to_tm(secs+60*tz_off_mins) */
+	size_t ya_strftime_plan_epoch(char *s, size_t maxsize, const struct strf_plan *plan, time_t secs, int32_t nsecs, int tz_off_mins); /* as ya_strftime_epoch() using a precompiled format */
+	/* cached formatting of seconds since the epoch, the output for the current second (or minute) is kept so only %f needs to be added (results as ya_strftime_epoch()) */
+	struct strf_cache; /* opaque, defined in strftime.c */
+	struct strf_cache * strf_cache_create(const char *format); /* returns NULL if format is NULL or out of memory */
+	size_t ya_strftime_cached(char *s, size_t maxsize, struct strf_cache *c, time_t secs, int32_t nsecs, int tz_off_mins); /* as ya_strftime_epoch() with the format given to strf_cache_create(), c is changed so each thread needs its own */
+	void strf_cache_free(struct strf_cache *c); /* free memory used by c */
 	time_t ya_mktime(struct tm *tp); /* fully functional version of mktime() that returns secs and takes (and changes if necessary) timeptr */
     void sec_to_tm(time_t t,struct tm *tp); // reverse of ya_mktime, converts secs since epoch to the numbers of tp
 	time_t UTC_mktime(struct tm *tp,struct strp_tz_struct *tz ); /* version of mktime() that also uses tz to adjust secs returned for timezones. Returns UTC secs since epoch (time_t) */
 	void UTC_sec_to_tm(time_t t,struct tm *tp,struct strp_tz_struct *tz ); // reverse of UTC_mktime(), converts UTC time as secs since epoch to the numbers of tp, taking into account tz to adjust secs  for timezones
+	/* time zones from IANA TZif (zoneinfo) files - a zone holds all the offset changes for one place, so conversions use the correct offset and abbreviation for each instant.
+	   The POSIX TZ string at the end of a file (or one given to tz_zone_from_posix()) gives the changes after the last transition in the file.
+	   A struct tz_zone is never changed once loaded, so one can be shared by any number of threads (in strftime.c) */
+	struct tz_zone; /* opaque, defined in strftime.c */
+	struct tz_zone * tz_zone_load(const char *dir, const char *name); /* load zone name (eg "Europe/London") from zoneinfo directory dir (NULL for $TZDIR or /usr/share/zoneinfo), returns NULL if not found, invalid or out of memory */
+	struct tz_zone * tz_zone_from_tzif(const unsigned char *data, size_t len); /* as tz_zone_load() from the len bytes of a TZif file */
+	struct tz_zone * tz_zone_from_posix(const char *s); /* create a zone from POSIX TZ string s (eg "EST5EDT,M3.2.0,M11.1.0"), returns NULL if invalid or out of memory */
+	int tz_zone_offset(const struct tz_zone *z, time_t t, int *isdst, const char **abbrev); /* returns offset from UTC in secs at UTC time t, sets *isdst and *abbrev (either can be NULL) */
+	void UTC_sec_to_tm_zone(time_t t, struct tm *tp, struct strp_tz_struct *tz, const struct tz_zone *z); /* as UTC_sec_to_tm() in zone z, sets tp->tm_isdst and tz->tz_off_mins and tz->tz_name so %z and %Z are correct for t */
+	time_t UTC_mktime_zone(struct tm *tp, struct strp_tz_struct *tz, const struct tz_zone *z); /* reverse of UTC_sec_to_tm_zone(), tm_isdst picks between repeated local times (<0 for the earlier), skipped times move forward */
+	void tz_zone_free(struct tz_zone *z); /* free memory used by z */
+	/* a cursor keeps the interval between transitions that contains the last time looked up, so for times in ascending order most lookups are 2 compares and the rest move to the next interval */
+	struct tz_cursor
+		{const struct tz_zone *zone;
+		 time_t start, end; /* off, isdst and abbrev apply from UTC time start to end-1 */
+		 int off; /* secs east of UTC */
+		 int isdst;
+		 const char *abbrev;
+		 int next; /* index of the transition at end (internal) */
+		};
+	void tz_cursor_init(struct tz_cursor *c, const struct tz_zone *z); /* start a cursor for zone z */
+	int tz_cursor_offset(struct tz_cursor *c, time_t t); /* as tz_zone_offset(c->zone,t,&c->isdst,&c->abbrev) but fastest when t is >= the previous t, any order gives correct results */
 	/* year as int64_t below to avoid overflow issues when converting int years with an offset to one with no offset */
 	int day_of_week(int64_t year,int month, int mday); /* returns day of week(0-6), 0=sunday given year (with no offset eg 1970), month (0-11, 0=jan) and day of month (1-31) */
 	void month_day(int64_t year, int yearday, int *pmonth, int *pday);// year with no offset and days in year (0->), sets pmonth (0->11) and pday(1-31)
@@ -50,7 +156,64 @@
 	bool check_tm(struct tm *tm);/* returns true only if all elements of tm are valid */
 	extern const char * strp_weekdays[]; // strings - names of weekdays (Monday,...)
 	extern const char * strp_monthnames[] ;// strings - names of Months (January,...)
+	/* case insensitive matching of names (full name or 1st 3 letters) using a perfect hash of the 1st 3 letters, used by strptime() for %a %b etc (in strptime.c) */
+	#define STRP_NAME_SLOTS 64 /* maximum number of names in a table */
+	struct strp_name_table
+		{const char **names; /* lower case names, at least 3 letters and the 1st 3 letters of each are unique */
+		 int n; /* number of names */
+		 uint32_t mult; /* hash multiplier, chosen so every name has a different slot */
+		 unsigned char slot[STRP_NAME_SLOTS]; /* index+1 of the name for each hash value, 0 if none */
+		 uint16_t key[STRP_NAME_SLOTS]; /* 1st 3 letters of the name in each slot (5 bits per letter) */
+		};
+	extern const struct strp_name_table strp_weekday_table, strp_month_table; /* for strp_weekdays[] and strp_monthnames[] */
+	bool strp_name_table_init(struct strp_name_table *t, const char **names, int n); /* build a table for names[0..n-1], returns false if this is not possible */
+	int strp_name_match(const struct strp_name_table *t, const char **ps); /* returns index of the name at *ps (moving *ps past it) or -1 if none */
+	/* zone abbreviations for %Z - a perfect hash of the whole abbreviation (case insensitive) gives its offset, which %Z puts in tz_off_mins (in strptime.c).
+	   The built in table has common abbreviations, a table given for each call (*_abbrevs_r(), strp_stream_begin_abbrevs()) or to a cache is tried 1st (ambiguous ones such as IST or CST are only found there) */
+	#define STRP_ABBREV_SLOTS 256 /* number of hash values */
+	#define STRP_ABBREV_MAX 64 /* maximum number of abbreviations in a table */
+	struct strp_abbrev
+		{const char *name; /* 2-4 letters in any case, eg "CEST" */
+		 int off_mins; /* offset east of UTC in minutes */
+		};
+	struct strp_abbrev_table
+		{const struct strp_abbrev *abbrevs;
+		 int n; /* number of abbreviations */
+		 uint32_t mult; /* hash multiplier, chosen so every abbreviation has a different slot */
+		 unsigned char slot[STRP_ABBREV_SLOTS]; /* index+1 of the abbreviation for each hash value, 0 if none */
+		 uint32_t key[STRP_ABBREV_MAX]; /* each abbreviation (5 bits per letter) */
+		 int16_t off_mins[STRP_ABBREV_MAX]; /* offset of each abbreviation */
+		};
+	extern const struct strp_abbrev strp_abbrevs[]; // abbreviations in the built in table
+	extern const struct strp_abbrev_table strp_abbrev_table; /* built in table for strp_abbrevs[] */
+	bool strp_abbrev_table_init(struct strp_abbrev_table *t, const struct strp_abbrev *abbrevs, int n); /* build a table for abbrevs[0..n-1], returns false if this is not possible */
+	bool strp_abbrev_lookup(const struct strp_abbrev_table *t, const char *name, int *off_mins); /* sets *off_mins for name and returns true if name is in t */
+	void strp_cache_set_abbrevs(struct strp_cache *c, const struct strp_abbrev_table *t); /* %Z for c tries t (which must not be freed before c) before the built in table, NULL for none. Only c is changed */
+	/* batch conversions (in time_batch.c) - convert whole arrays at once using AVX2 or AVX-512 if the processor supports them. Results are identical to the single value functions */
+	struct tm_soa /* "structure of arrays" - each is an array of values of the matching field of struct tm, pointers can be NULL if that field is not required */
+		{int *year; /* years since 1900 (as tm_year) */
+		 int *mon; /* 0-11 */
+		 int *mday; /* 1-31 */
+		 int *hour; /* 0-23 */
+		 int *min; /* 0-59 */
+		 int *sec; /* 0-59 */
+		 int *wday; /* 0-6 0=Sunday */
+		 int *yday; /* 0-365 */
+		};
+	enum batch_kernel {BATCH_SCALAR,BATCH_AVX2,BATCH_AVX512,BATCH_BEST}; /* kernels for batch conversions, BATCH_BEST uses the best one the processor supports */
+	void sec_to_tm_batch(const time_t *t, size_t n, const struct tm_soa *out); /* sec_to_tm() for n values of t, results in out */
+	enum batch_kernel sec_to_tm_batch_k(const time_t *t, size_t n, const struct tm_soa *out, enum batch_kernel k); /* as sec_to_tm_batch() using kernel k (or the best supported below k), returns kernel used */
+	void ya_mktime_tm_batch(const struct tm_soa *in, size_t n, time_t *t); /* ya_mktime_tm() for n values in in (NULL arrays are taken as 0, so yday=NULL always uses mon & mday), results in t */
+	enum batch_kernel ya_mktime_tm_batch_k(const struct tm_soa *in, size_t n, time_t *t, enum batch_kernel k); /* as ya_mktime_tm_batch() using kernel k (or the best supported below k), returns kernel used */
+	void sec_to_tm_zone_batch(const time_t *t, size_t n, struct tz_cursor *c, const struct tm_soa *out, int *off, int *isdst); /* UTC_sec_to_tm_zone() for n values of t in zone c->zone, results in out, off (secs east of UTC) and isdst (either can be NULL) */
+	enum batch_kernel batch_kernel_supported(enum batch_kernel k); /* returns k if the processor supports it, otherwise the best kernel below k thats supported */
  #ifdef __cplusplus
     }
  #endif
-#endif
\ No newline at end of file
+ #if defined(__cplusplus) && __cplusplus>=201703L
+	/* C++17 overloads for std::string_view, these use the length bounded functions above so never read past the end of s */
+	inline char * ya_strptime(std::string_view s, const char *format, struct tm *tm) {return ya_strptime_n(s.data(),s.size(),format,tm);}
+	inline char * ya_strptime_r(std::string_view s, const char *format, struct tm *tm, struct strp_tz_struct *tz) {return ya_strptime_n_r(s.data(),s.size(),format,tm,tz);}
+	inline char * ya_strptime_plan_r(std::string_view s, const struct strp_plan *plan, struct tm *tm, struct strp_tz_struct *tz) {return ya_strptime_plan_n_r(s.data(),s.size(),plan,tm,tz);}
+ #endif
+#endif